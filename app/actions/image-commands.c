@@ -99,6 +99,7 @@ static void   image_convert_indexed_callback   (GtkWidget              *dialog,
                                                 GimpImage              *image,
                                                 GimpConvertPaletteType  palette_type,
                                                 gint                    max_colors,
+                                                GimpConvertQuantizer    quantizer,
                                                 gboolean                remove_duplicates,
                                                 GimpConvertDitherType   dither_type,
                                                 gboolean                dither_alpha,
@@ -319,6 +320,7 @@ image_convert_base_type_cmd_callback (GtkAction *action,
                                            widget,
                                            config->image_convert_indexed_palette_type,
                                            config->image_convert_indexed_max_colors,
+                                           config->image_convert_indexed_quantizer,
                                            config->image_convert_indexed_remove_duplicates,
                                            config->image_convert_indexed_dither_type,
                                            config->image_convert_indexed_dither_alpha,
@@ -1077,6 +1079,7 @@ image_convert_indexed_callback (GtkWidget              *dialog,
                                 GimpImage              *image,
                                 GimpConvertPaletteType  palette_type,
                                 gint                    max_colors,
+                                GimpConvertQuantizer    quantizer,
                                 gboolean                remove_duplicates,
                                 GimpConvertDitherType   dither_type,
                                 gboolean                dither_alpha,
@@ -1092,6 +1095,7 @@ image_convert_indexed_callback (GtkWidget              *dialog,
   g_object_set (config,
                 "image-convert-indexed-palette-type",       palette_type,
                 "image-convert-indexed-max-colors",         max_colors,
+                "image-convert-indexed-quantizer",          quantizer,
                 "image-convert-indexed-remove-duplicates",  remove_duplicates,
                 "image-convert-indexed-dither-type",        dither_type,
                 "image-convert-indexed-dither-alpha",       dither_alpha,
@@ -1114,6 +1118,7 @@ image_convert_indexed_callback (GtkWidget              *dialog,
   if (! gimp_image_convert_indexed (image,
                                     config->image_convert_indexed_palette_type,
                                     config->image_convert_indexed_max_colors,
+                                    config->image_convert_indexed_quantizer,
                                     config->image_convert_indexed_remove_duplicates,
                                     config->image_convert_indexed_dither_type,
                                     config->image_convert_indexed_dither_alpha,
@@ -106,6 +106,7 @@ enum
   PROP_COLOR_MANAGEMENT,
   PROP_SAVE_DOCUMENT_HISTORY,
   PROP_QUICK_MASK_COLOR,
+  PROP_XCF_REDUCED_LEVELS,
 
   /* ignored, only for backward compatibility: */
   PROP_INSTALL_COLORMAP,
@@ -618,6 +619,13 @@ gimp_core_config_class_init (GimpCoreConfigClass *klass)
                         TRUE, &red,
                         GIMP_PARAM_STATIC_STRINGS);
 
+  GIMP_CONFIG_PROP_BOOLEAN (object_class, PROP_XCF_REDUCED_LEVELS,
+                            "xcf-reduced-levels",
+                            "Save reduced levels in XCF files",
+                            XCF_REDUCED_LEVELS_BLURB,
+                            FALSE,
+                            GIMP_PARAM_STATIC_STRINGS);
+
   /*  only for backward compatibility:  */
   GIMP_CONFIG_PROP_BOOLEAN (object_class, PROP_INSTALL_COLORMAP,
                             "install-colormap",
@@ -902,6 +910,9 @@ gimp_core_config_set_property (GObject      *object,
     case PROP_QUICK_MASK_COLOR:
       gimp_value_get_rgb (value, &core_config->quick_mask_color);
       break;
+    case PROP_XCF_REDUCED_LEVELS:
+      core_config->xcf_reduced_levels = g_value_get_boolean (value);
+      break;
 
     case PROP_INSTALL_COLORMAP:
     case PROP_MIN_COLORS:
@@ -1077,6 +1088,9 @@ gimp_core_config_get_property (GObject    *object,
     case PROP_QUICK_MASK_COLOR:
       gimp_value_set_rgb (value, &core_config->quick_mask_color);
       break;
+    case PROP_XCF_REDUCED_LEVELS:
+      g_value_set_boolean (value, core_config->xcf_reduced_levels);
+      break;
 
     case PROP_INSTALL_COLORMAP:
     case PROP_MIN_COLORS:
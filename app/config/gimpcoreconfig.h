@@ -90,6 +90,7 @@ struct _GimpCoreConfig
   GimpColorConfig        *color_management;
   gboolean                save_document_history;
   GimpRGB                 quick_mask_color;
+  gboolean                xcf_reduced_levels;
 };
 
 struct _GimpCoreConfigClass
@@ -57,6 +57,7 @@ enum
 
   PROP_IMAGE_CONVERT_INDEXED_PALETTE_TYPE,
   PROP_IMAGE_CONVERT_INDEXED_MAX_COLORS,
+  PROP_IMAGE_CONVERT_INDEXED_QUANTIZER,
   PROP_IMAGE_CONVERT_INDEXED_REMOVE_DUPLICATES,
   PROP_IMAGE_CONVERT_INDEXED_DITHER_TYPE,
   PROP_IMAGE_CONVERT_INDEXED_DITHER_ALPHA,
@@ -223,6 +224,15 @@ gimp_dialog_config_class_init (GimpDialogConfigClass *klass)
                         2, 256, 256,
                         GIMP_PARAM_STATIC_STRINGS);
 
+  GIMP_CONFIG_PROP_ENUM (object_class,
+                         PROP_IMAGE_CONVERT_INDEXED_QUANTIZER,
+                         "image-convert-indexed-quantizer",
+                         "Default quantizer for indexed conversion",
+                         IMAGE_CONVERT_INDEXED_QUANTIZER_BLURB,
+                         GIMP_TYPE_CONVERT_QUANTIZER,
+                         GIMP_CONVERT_QUANTIZER_MEDIAN_CUT,
+                         GIMP_PARAM_STATIC_STRINGS);
+
   GIMP_CONFIG_PROP_BOOLEAN (object_class,
                             PROP_IMAGE_CONVERT_INDEXED_REMOVE_DUPLICATES,
                             "image-convert-indexed-remove-duplicates",
@@ -554,6 +564,9 @@ gimp_dialog_config_set_property (GObject      *object,
     case PROP_IMAGE_CONVERT_INDEXED_MAX_COLORS:
       config->image_convert_indexed_max_colors = g_value_get_int (value);
       break;
+    case PROP_IMAGE_CONVERT_INDEXED_QUANTIZER:
+      config->image_convert_indexed_quantizer = g_value_get_enum (value);
+      break;
     case PROP_IMAGE_CONVERT_INDEXED_REMOVE_DUPLICATES:
       config->image_convert_indexed_remove_duplicates = g_value_get_boolean (value);
       break;
@@ -716,6 +729,9 @@ gimp_dialog_config_get_property (GObject    *object,
     case PROP_IMAGE_CONVERT_INDEXED_MAX_COLORS:
       g_value_set_int (value, config->image_convert_indexed_max_colors);
       break;
+    case PROP_IMAGE_CONVERT_INDEXED_QUANTIZER:
+      g_value_set_enum (value, config->image_convert_indexed_quantizer);
+      break;
     case PROP_IMAGE_CONVERT_INDEXED_REMOVE_DUPLICATES:
       g_value_set_boolean (value, config->image_convert_indexed_remove_duplicates);
       break;
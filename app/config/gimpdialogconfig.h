@@ -55,6 +55,7 @@ struct _GimpDialogConfig
 
   GimpConvertPaletteType    image_convert_indexed_palette_type;
   gint                      image_convert_indexed_max_colors;
+  GimpConvertQuantizer      image_convert_indexed_quantizer;
   gboolean                  image_convert_indexed_remove_duplicates;
   GimpConvertDitherType     image_convert_indexed_dither_type;
   gboolean                  image_convert_indexed_dither_alpha;
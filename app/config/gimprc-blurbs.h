@@ -447,6 +447,9 @@ _("Sets the default palette type for the 'Convert to Indexed' dialog.")
 #define IMAGE_CONVERT_INDEXED_MAX_COLORS_BLURB \
 _("Sets the default maximum number of colors for the 'Convert to Indexed' dialog.")
 
+#define IMAGE_CONVERT_INDEXED_QUANTIZER_BLURB \
+_("Sets the default quantizer for the 'Convert to Indexed' dialog.")
+
 #define IMAGE_CONVERT_INDEXED_REMOVE_DUPLICATES_BLURB \
 _("Sets the default 'Remove duplicate colors' state for the 'Convert to Indexed' dialog.")
 
@@ -594,6 +597,11 @@ _("When enabled, uses OpenCL for some operations.")
 "The location of the online user manual. This is used if " \
 "'user-manual-online' is enabled."
 
+#define XCF_REDUCED_LEVELS_BLURB \
+_("When enabled, XCF files also contain reduced-size copies of all " \
+  "layers and channels, which allow for much faster previews of large " \
+  "images, at the cost of somewhat larger files.")
+
 #define ZOOM_QUALITY_BLURB \
 "There's a tradeoff between speed and quality of the zoomed-out display."
 
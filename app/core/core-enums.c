@@ -105,6 +105,35 @@ gimp_convert_dither_type_get_type (void)
   return type;
 }
 
+GType
+gimp_convert_quantizer_get_type (void)
+{
+  static const GEnumValue values[] =
+  {
+    { GIMP_CONVERT_QUANTIZER_MEDIAN_CUT, "GIMP_CONVERT_QUANTIZER_MEDIAN_CUT", "median-cut" },
+    { GIMP_CONVERT_QUANTIZER_KD_TREE, "GIMP_CONVERT_QUANTIZER_KD_TREE", "kd-tree" },
+    { 0, NULL, NULL }
+  };
+
+  static const GimpEnumDesc descs[] =
+  {
+    { GIMP_CONVERT_QUANTIZER_MEDIAN_CUT, NC_("convert-quantizer", "Median cut"), NULL },
+    { GIMP_CONVERT_QUANTIZER_KD_TREE, NC_("convert-quantizer", "k-d tree (fast)"), NULL },
+    { 0, NULL, NULL }
+  };
+
+  static GType type = 0;
+
+  if (G_UNLIKELY (! type))
+    {
+      type = g_enum_register_static ("GimpConvertQuantizer", values);
+      gimp_type_set_translation_context (type, "convert-quantizer");
+      gimp_enum_set_value_descriptions (type, descs);
+    }
+
+  return type;
+}
+
 GType
 gimp_convolution_type_get_type (void)
 {
@@ -76,6 +76,17 @@ typedef enum
 } GimpConvertDitherType;
 
 
+#define GIMP_TYPE_CONVERT_QUANTIZER (gimp_convert_quantizer_get_type ())
+
+GType gimp_convert_quantizer_get_type (void) G_GNUC_CONST;
+
+typedef enum  /*< pdb-skip >*/
+{
+  GIMP_CONVERT_QUANTIZER_MEDIAN_CUT, /*< desc="Median cut"      >*/
+  GIMP_CONVERT_QUANTIZER_KD_TREE     /*< desc="k-d tree (fast)" >*/
+} GimpConvertQuantizer;
+
+
 #define GIMP_TYPE_CONVOLUTION_TYPE (gimp_convolution_type_get_type ())
 
 GType gimp_convolution_type_get_type (void) G_GNUC_CONST;
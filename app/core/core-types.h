@@ -197,12 +197,15 @@ typedef struct _GimpTagged          GimpTagged;      /* dummy typedef */
 /*  non-object types  */
 
 typedef struct _GimpBoundSeg        GimpBoundSeg;
+typedef struct _GimpBoundaryCache   GimpBoundaryCache;
 typedef struct _GimpCoords          GimpCoords;
+typedef struct _GimpDrawableTransformJob GimpDrawableTransformJob;
 typedef struct _GimpGradientSegment GimpGradientSegment;
 typedef struct _GimpPaletteEntry    GimpPaletteEntry;
 typedef struct _GimpSamplePoint     GimpSamplePoint;
 typedef struct _GimpScanConvert     GimpScanConvert;
 typedef struct _GimpTempBuf         GimpTempBuf;
+typedef struct _GimpUndoSwapEntry   GimpUndoSwapEntry;
 typedef         guint32             GimpTattoo;
 
 /* The following hack is made so that we can reuse the definition
@@ -650,7 +650,16 @@ gimp_edit_fade (GimpImage   *image,
       g_object_ref (undo);
       buffer = g_object_ref (undo->applied_buffer);
 
-      gimp_image_undo (image);
+      /*  a step whose pixels can't be read back is refused, and the
+       *  drawable must not be faded on top of the unchanged pixels
+       */
+      if (! gimp_image_undo (image))
+        {
+          g_object_unref (buffer);
+          g_object_unref (undo);
+
+          return FALSE;
+        }
 
       gimp_drawable_apply_buffer (drawable, buffer,
                                   GEGL_RECTANGLE (0, 0,
@@ -0,0 +1,382 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimp-parallel.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+#include <gegl.h>
+
+#include "core-types.h"
+
+#include "config/gimpgeglconfig.h"
+
+#include "gimp.h"
+#include "gimp-parallel.h"
+
+
+typedef struct
+{
+  GimpParallelDistributeFunc  func;
+  gint                        n;
+  gpointer                    user_data;
+
+  gint                        remaining;
+  GMutex                      mutex;
+  GCond                       cond;
+} GimpParallelTask;
+
+typedef struct
+{
+  GimpParallelTask *task;
+  gint              i;
+} GimpParallelItem;
+
+typedef struct
+{
+  GimpParallelDistributeRangeFunc func;
+  gsize                           size;
+  gpointer                        user_data;
+} GimpParallelDistributeRangeData;
+
+typedef struct
+{
+  GimpParallelDistributeAreaFunc  func;
+  const GeglRectangle            *area;
+  gpointer                        user_data;
+} GimpParallelDistributeAreaData;
+
+
+/*  local function prototypes  */
+
+static void   gimp_parallel_notify_num_processors (GimpGeglConfig                  *config);
+
+static void   gimp_parallel_set_n_threads         (gint                             n_threads);
+
+static void   gimp_parallel_worker                (GimpParallelItem                *item,
+                                                   gpointer                         data);
+
+static void   gimp_parallel_distribute_range_func (gint                             i,
+                                                   gint                             n,
+                                                   GimpParallelDistributeRangeData *data);
+static void   gimp_parallel_distribute_area_func  (gint                             i,
+                                                   gint                             n,
+                                                   GimpParallelDistributeAreaData  *data);
+
+
+/*  local variables  */
+
+static GThreadPool *gimp_parallel_pool      = NULL;
+static gint         gimp_parallel_n_threads = 1;
+static GPrivate     gimp_parallel_in_worker;
+
+
+/*  public functions  */
+
+void
+gimp_parallel_init (Gimp *gimp)
+{
+  GimpGeglConfig *config;
+
+  g_return_if_fail (GIMP_IS_GIMP (gimp));
+
+  config = GIMP_GEGL_CONFIG (gimp->config);
+
+  g_signal_connect (config, "notify::num-processors",
+                    G_CALLBACK (gimp_parallel_notify_num_processors),
+                    NULL);
+
+  gimp_parallel_notify_num_processors (config);
+}
+
+void
+gimp_parallel_exit (Gimp *gimp)
+{
+  g_return_if_fail (GIMP_IS_GIMP (gimp));
+
+  g_signal_handlers_disconnect_by_func (gimp->config,
+                                        gimp_parallel_notify_num_processors,
+                                        NULL);
+
+  gimp_parallel_set_n_threads (1);
+}
+
+gint
+gimp_parallel_get_n_threads (void)
+{
+  return g_atomic_int_get (&gimp_parallel_n_threads);
+}
+
+/*  Calls 'func' 'n' times, concurrently, where 'n' is at most 'max_n'
+ *  (or the number of threads, if 'max_n' is negative), and returns
+ *  after all calls have finished.  Each call receives its index 'i'
+ *  and the total number of calls 'n'.  Nested calls, made from within
+ *  'func', are executed serially on the calling thread.
+ */
+void
+gimp_parallel_distribute (gint                       max_n,
+                          GimpParallelDistributeFunc func,
+                          gpointer                   user_data)
+{
+  GimpParallelTask  task;
+  GimpParallelItem *items;
+  gint              n;
+  gint              i;
+
+  g_return_if_fail (func != NULL);
+
+  if (max_n == 0)
+    return;
+
+  n = gimp_parallel_get_n_threads ();
+
+  if (max_n > 0)
+    n = MIN (n, max_n);
+
+  if (n == 1                    ||
+      ! gimp_parallel_pool      ||
+      g_private_get (&gimp_parallel_in_worker))
+    {
+      func (0, 1, user_data);
+
+      return;
+    }
+
+  task.func      = func;
+  task.n         = n;
+  task.user_data = user_data;
+  task.remaining = n - 1;
+
+  g_mutex_init (&task.mutex);
+  g_cond_init (&task.cond);
+
+  items = g_new (GimpParallelItem, n - 1);
+
+  for (i = 1; i < n; i++)
+    {
+      items[i - 1].task = &task;
+      items[i - 1].i    = i;
+
+      g_thread_pool_push (gimp_parallel_pool, &items[i - 1], NULL);
+    }
+
+  /*  the calling thread does its share of the work, too  */
+  g_private_set (&gimp_parallel_in_worker, GINT_TO_POINTER (TRUE));
+
+  func (0, n, user_data);
+
+  g_private_set (&gimp_parallel_in_worker, GINT_TO_POINTER (FALSE));
+
+  g_mutex_lock (&task.mutex);
+
+  while (task.remaining > 0)
+    g_cond_wait (&task.cond, &task.mutex);
+
+  g_mutex_unlock (&task.mutex);
+
+  g_mutex_clear (&task.mutex);
+  g_cond_clear (&task.cond);
+
+  g_free (items);
+}
+
+/*  Splits the range [0, 'size') into disjoint sub-ranges of at least
+ *  'min_sub_size' elements, and calls 'func' for each of them
+ *  concurrently.
+ */
+void
+gimp_parallel_distribute_range (gsize                           size,
+                                gsize                           min_sub_size,
+                                GimpParallelDistributeRangeFunc func,
+                                gpointer                        user_data)
+{
+  GimpParallelDistributeRangeData data;
+  gsize                           n;
+
+  g_return_if_fail (func != NULL);
+
+  if (size == 0)
+    return;
+
+  n = size;
+
+  if (min_sub_size > 1)
+    n /= min_sub_size;
+
+  n = CLAMP (n, 1, gimp_parallel_get_n_threads ());
+
+  if (n == 1)
+    {
+      func (0, size, user_data);
+
+      return;
+    }
+
+  data.func      = func;
+  data.size      = size;
+  data.user_data = user_data;
+
+  gimp_parallel_distribute (n,
+                            (GimpParallelDistributeFunc)
+                            gimp_parallel_distribute_range_func,
+                            &data);
+}
+
+/*  Splits 'area' into disjoint stripes of at least 'min_sub_area'
+ *  pixels, along its longer side, and calls 'func' for each of them
+ *  concurrently.
+ */
+void
+gimp_parallel_distribute_area (const GeglRectangle            *area,
+                               gsize                           min_sub_area,
+                               GimpParallelDistributeAreaFunc  func,
+                               gpointer                        user_data)
+{
+  GimpParallelDistributeAreaData data;
+  gsize                          n;
+
+  g_return_if_fail (area != NULL);
+  g_return_if_fail (func != NULL);
+
+  if (area->width <= 0 || area->height <= 0)
+    return;
+
+  n = (gsize) area->width * (gsize) area->height;
+
+  if (min_sub_area > 1)
+    n /= min_sub_area;
+
+  n = CLAMP (n, 1, gimp_parallel_get_n_threads ());
+  n = MIN (n, MAX (area->width, area->height));
+
+  if (n == 1)
+    {
+      func (area, user_data);
+
+      return;
+    }
+
+  data.func      = func;
+  data.area      = area;
+  data.user_data = user_data;
+
+  gimp_parallel_distribute (n,
+                            (GimpParallelDistributeFunc)
+                            gimp_parallel_distribute_area_func,
+                            &data);
+}
+
+
+/*  private functions  */
+
+static void
+gimp_parallel_notify_num_processors (GimpGeglConfig *config)
+{
+  gimp_parallel_set_n_threads (config->num_processors);
+}
+
+static void
+gimp_parallel_set_n_threads (gint n_threads)
+{
+  n_threads = MAX (n_threads, 1);
+
+  if (n_threads > 1)
+    {
+      /*  the calling thread always takes part in the work, so we need
+       *  one thread less in the pool
+       */
+      if (! gimp_parallel_pool)
+        {
+          gimp_parallel_pool =
+            g_thread_pool_new ((GFunc) gimp_parallel_worker, NULL,
+                               n_threads - 1, FALSE, NULL);
+        }
+      else
+        {
+          g_thread_pool_set_max_threads (gimp_parallel_pool,
+                                         n_threads - 1, NULL);
+        }
+    }
+  else if (gimp_parallel_pool)
+    {
+      g_thread_pool_free (gimp_parallel_pool, FALSE, TRUE);
+
+      gimp_parallel_pool = NULL;
+    }
+
+  g_atomic_int_set (&gimp_parallel_n_threads, n_threads);
+}
+
+static void
+gimp_parallel_worker (GimpParallelItem *item,
+                      gpointer          data)
+{
+  GimpParallelTask *task = item->task;
+
+  g_private_set (&gimp_parallel_in_worker, GINT_TO_POINTER (TRUE));
+
+  task->func (item->i, task->n, task->user_data);
+
+  g_mutex_lock (&task->mutex);
+
+  if (--task->remaining == 0)
+    g_cond_signal (&task->cond);
+
+  g_mutex_unlock (&task->mutex);
+}
+
+static void
+gimp_parallel_distribute_range_func (gint                             i,
+                                     gint                             n,
+                                     GimpParallelDistributeRangeData *data)
+{
+  gsize offset;
+  gsize size;
+
+  offset = (2 * i       * data->size + n) / (2 * n);
+  size   = (2 * (i + 1) * data->size + n) / (2 * n) - offset;
+
+  data->func (offset, size, data->user_data);
+}
+
+static void
+gimp_parallel_distribute_area_func (gint                            i,
+                                    gint                            n,
+                                    GimpParallelDistributeAreaData *data)
+{
+  GeglRectangle area = *data->area;
+
+  if (area.width >= area.height)
+    {
+      gint x1 = area.x + (2 * i       * area.width + n) / (2 * n);
+      gint x2 = area.x + (2 * (i + 1) * area.width + n) / (2 * n);
+
+      area.x     = x1;
+      area.width = x2 - x1;
+    }
+  else
+    {
+      gint y1 = area.y + (2 * i       * area.height + n) / (2 * n);
+      gint y2 = area.y + (2 * (i + 1) * area.height + n) / (2 * n);
+
+      area.y      = y1;
+      area.height = y2 - y1;
+    }
+
+  data->func (&area, data->user_data);
+}
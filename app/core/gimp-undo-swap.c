@@ -0,0 +1,514 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimp-undo-swap.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <zlib.h>
+
+#include <gio/gio.h>
+#include <gegl.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "core-types.h"
+
+#include "gimp.h"
+#include "gimp-undo-swap.h"
+#include "gimp-utils.h"
+
+#include "gimp-intl.h"
+
+
+/*  the pixels are compressed in bands of about this many bytes  */
+#define UNDO_SWAP_BAND_SIZE   (1024 * 1024)
+#define UNDO_SWAP_BUFFER_SIZE (64 * 1024)
+
+
+struct _GimpUndoSwapEntry
+{
+  const Babl *format;
+  gint        width;
+  gint        height;
+  goffset     offset;
+  gsize       size;
+};
+
+/*  a range of the swap file which isn't used by any entry  */
+typedef struct
+{
+  goffset offset;
+  gsize   size;
+} GimpUndoSwapHole;
+
+
+/*  local function prototypes  */
+
+static gboolean   gimp_undo_swap_open     (GError **error);
+
+static goffset    gimp_undo_swap_allocate (gsize    size);
+static void       gimp_undo_swap_release  (goffset  offset,
+                                           gsize    size);
+
+
+/*  local variables  */
+
+static GFile         *gimp_undo_swap_file      = NULL;
+static GFileIOStream *gimp_undo_swap_stream    = NULL;
+static goffset        gimp_undo_swap_end       = 0;
+static GList         *gimp_undo_swap_holes     = NULL;
+static gboolean       gimp_undo_swap_failed    = FALSE;
+
+
+/*  public functions  */
+
+void
+gimp_undo_swap_exit (Gimp *gimp)
+{
+  g_return_if_fail (GIMP_IS_GIMP (gimp));
+
+  if (gimp_undo_swap_stream)
+    {
+      g_io_stream_close (G_IO_STREAM (gimp_undo_swap_stream), NULL, NULL);
+      g_clear_object (&gimp_undo_swap_stream);
+
+      g_file_delete (gimp_undo_swap_file, NULL, NULL);
+      g_clear_object (&gimp_undo_swap_file);
+    }
+
+  while (gimp_undo_swap_holes)
+    {
+      g_slice_free (GimpUndoSwapHole, gimp_undo_swap_holes->data);
+
+      gimp_undo_swap_holes = g_list_delete_link (gimp_undo_swap_holes,
+                                                 gimp_undo_swap_holes);
+    }
+
+  gimp_undo_swap_end = 0;
+}
+
+/*  compresses the pixels of 'buffer' into the swap file, and returns
+ *  the entry to load them back with, or NULL if they couldn't be
+ *  stored.  The compressed pixels go into the first hole left by
+ *  freed entries which is large enough, or to the end of the file.
+ *  'error' is only set when the swap file can't be created, and only
+ *  the first time, so the failure is reported once.
+ */
+GimpUndoSwapEntry *
+gimp_undo_swap_store (GeglBuffer  *buffer,
+                      GError     **error)
+{
+  GimpUndoSwapEntry   *entry;
+  const GeglRectangle *extent;
+  const Babl          *format;
+  GOutputStream       *output;
+  z_stream             zs     = { 0, };
+  guchar              *band;
+  GByteArray          *out;
+  gsize                rowstride;
+  gint                 band_height;
+  goffset              offset;
+  gint                 y;
+  gboolean             success = TRUE;
+
+  g_return_val_if_fail (GEGL_IS_BUFFER (buffer), NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  if (! gimp_undo_swap_open (error))
+    return NULL;
+
+  if (deflateInit (&zs, Z_BEST_SPEED) != Z_OK)
+    return NULL;
+
+  extent = gegl_buffer_get_extent (buffer);
+  format = gegl_buffer_get_format (buffer);
+  output = g_io_stream_get_output_stream (G_IO_STREAM (gimp_undo_swap_stream));
+
+  rowstride   = extent->width * babl_format_get_bytes_per_pixel (format);
+  band_height = CLAMP (UNDO_SWAP_BAND_SIZE / rowstride, 1, extent->height);
+
+  band = g_malloc (band_height * rowstride);
+  out  = g_byte_array_new ();
+
+  /*  compress into memory first, so we know how much of the file the
+   *  entry needs
+   */
+  for (y = 0; success && y < extent->height; y += band_height)
+    {
+      gint height = MIN (band_height, extent->height - y);
+      gint flush  = (y + height == extent->height) ? Z_FINISH : Z_NO_FLUSH;
+
+      gegl_buffer_get (buffer,
+                       GEGL_RECTANGLE (extent->x, extent->y + y,
+                                       extent->width, height),
+                       1.0, format, band, rowstride, GEGL_ABYSS_NONE);
+
+      zs.next_in  = band;
+      zs.avail_in = height * rowstride;
+
+      do
+        {
+          gsize len = out->len;
+
+          g_byte_array_set_size (out, len + UNDO_SWAP_BUFFER_SIZE);
+
+          zs.next_out  = out->data + len;
+          zs.avail_out = UNDO_SWAP_BUFFER_SIZE;
+
+          if (deflate (&zs, flush) == Z_STREAM_ERROR)
+            success = FALSE;
+
+          g_byte_array_set_size (out, out->len - zs.avail_out);
+        }
+      while (success && zs.avail_out == 0);
+    }
+
+  deflateEnd (&zs);
+
+  g_free (band);
+
+  if (success)
+    {
+      offset = gimp_undo_swap_allocate (out->len);
+
+      if (! g_seekable_seek (G_SEEKABLE (gimp_undo_swap_stream),
+                             offset, G_SEEK_SET, NULL, NULL) ||
+          ! g_output_stream_write_all (output, out->data, out->len,
+                                       NULL, NULL, NULL))
+        {
+          gimp_undo_swap_release (offset, out->len);
+
+          success = FALSE;
+        }
+    }
+
+  if (! success)
+    {
+      g_byte_array_free (out, TRUE);
+
+      return NULL;
+    }
+
+  entry = g_slice_new (GimpUndoSwapEntry);
+
+  entry->format = format;
+  entry->width  = extent->width;
+  entry->height = extent->height;
+  entry->offset = offset;
+  entry->size   = out->len;
+
+  g_byte_array_free (out, TRUE);
+
+  return entry;
+}
+
+/*  returns a new buffer with the pixels of 'entry', at (0, 0), or
+ *  NULL if they couldn't be read back.  The entry stays valid until
+ *  it's freed.
+ */
+GeglBuffer *
+gimp_undo_swap_load (GimpUndoSwapEntry  *entry,
+                     GError            **error)
+{
+  GeglBuffer   *buffer;
+  GInputStream *input;
+  z_stream      zs        = { 0, };
+  guchar       *band;
+  guchar       *in;
+  gsize         rowstride;
+  gint          band_height;
+  gint          height;
+  gsize         remaining = entry->size;
+  gint          y         = 0;
+  gboolean      success   = FALSE;
+
+  g_return_val_if_fail (entry != NULL, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0, entry->width, entry->height),
+                            entry->format);
+
+  rowstride   = entry->width * babl_format_get_bytes_per_pixel (entry->format);
+  band_height = CLAMP (UNDO_SWAP_BAND_SIZE / rowstride, 1, entry->height);
+
+  band = g_malloc (band_height * rowstride);
+  in   = g_malloc (UNDO_SWAP_BUFFER_SIZE);
+
+  height = band_height;
+
+  zs.next_out  = band;
+  zs.avail_out = height * rowstride;
+
+  if (gimp_undo_swap_stream                                    &&
+      g_seekable_seek (G_SEEKABLE (gimp_undo_swap_stream),
+                       entry->offset, G_SEEK_SET, NULL, NULL) &&
+      inflateInit (&zs) == Z_OK)
+    {
+      input = g_io_stream_get_input_stream (G_IO_STREAM (gimp_undo_swap_stream));
+
+      success = TRUE;
+
+      while (success && y < entry->height)
+        {
+          gint ret;
+
+          if (zs.avail_in == 0)
+            {
+              gsize n = MIN (remaining, UNDO_SWAP_BUFFER_SIZE);
+              gsize n_read;
+
+              if (n == 0 ||
+                  ! g_input_stream_read_all (input, in, n, &n_read,
+                                             NULL, NULL) ||
+                  n_read != n)
+                {
+                  success = FALSE;
+                  break;
+                }
+
+              remaining -= n;
+
+              zs.next_in  = in;
+              zs.avail_in = n;
+            }
+
+          ret = inflate (&zs, Z_NO_FLUSH);
+
+          if (ret != Z_OK && ret != Z_STREAM_END)
+            {
+              success = FALSE;
+            }
+          else if (zs.avail_out == 0)
+            {
+              gegl_buffer_set (buffer,
+                               GEGL_RECTANGLE (0, y, entry->width, height),
+                               0, entry->format, band, rowstride);
+
+              y      += height;
+              height  = MIN (band_height, entry->height - y);
+
+              zs.next_out  = band;
+              zs.avail_out = height * rowstride;
+            }
+          else if (ret == Z_STREAM_END)
+            {
+              /*  the stream ended before all rows were read  */
+              success = FALSE;
+            }
+        }
+
+      inflateEnd (&zs);
+    }
+
+  g_free (in);
+  g_free (band);
+
+  if (! success)
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                           _("Failed to read undo data from the swap file."));
+
+      g_clear_object (&buffer);
+    }
+
+  return buffer;
+}
+
+void
+gimp_undo_swap_free (GimpUndoSwapEntry *entry)
+{
+  g_return_if_fail (entry != NULL);
+
+  gimp_undo_swap_release (entry->offset, entry->size);
+
+  g_slice_free (GimpUndoSwapEntry, entry);
+}
+
+
+/*  private functions  */
+
+static gboolean
+gimp_undo_swap_open (GError **error)
+{
+  gchar  *swap     = NULL;
+  gchar  *basename;
+  gchar  *filename;
+  GError *my_error = NULL;
+
+  if (gimp_undo_swap_stream)
+    return TRUE;
+
+  /*  don't try again and again if the swap directory is unusable  */
+  if (gimp_undo_swap_failed)
+    return FALSE;
+
+  g_object_get (gegl_config (), "swap", &swap, NULL);
+
+  basename = g_strdup_printf ("gimp-undo-%d", gimp_get_pid ());
+
+  if (swap && g_file_test (swap, G_FILE_TEST_IS_DIR))
+    filename = g_build_filename (swap, basename, NULL);
+  else
+    filename = g_build_filename (g_get_tmp_dir (), basename, NULL);
+
+  g_free (basename);
+  g_free (swap);
+
+  gimp_undo_swap_file = g_file_new_for_path (filename);
+
+  g_free (filename);
+
+  gimp_undo_swap_stream = g_file_replace_readwrite (gimp_undo_swap_file,
+                                                    NULL, FALSE,
+                                                    G_FILE_CREATE_PRIVATE,
+                                                    NULL, &my_error);
+
+  if (! gimp_undo_swap_stream)
+    {
+      g_propagate_prefixed_error (error, my_error,
+                                  _("Failed to create the undo swap file '%s': "),
+                                  gimp_file_get_utf8_name (gimp_undo_swap_file));
+
+      g_clear_object (&gimp_undo_swap_file);
+
+      gimp_undo_swap_failed = TRUE;
+
+      return FALSE;
+    }
+
+  gimp_undo_swap_end = 0;
+
+  return TRUE;
+}
+
+/*  returns the offset of 'size' unused bytes of the swap file, taken
+ *  from the first hole which is large enough, or from the end of the
+ *  file
+ */
+static goffset
+gimp_undo_swap_allocate (gsize size)
+{
+  GList   *list;
+  goffset  offset;
+
+  for (list = gimp_undo_swap_holes; list; list = g_list_next (list))
+    {
+      GimpUndoSwapHole *hole = list->data;
+
+      if (hole->size >= size)
+        {
+          offset = hole->offset;
+
+          hole->offset += size;
+          hole->size   -= size;
+
+          if (hole->size == 0)
+            {
+              g_slice_free (GimpUndoSwapHole, hole);
+
+              gimp_undo_swap_holes = g_list_delete_link (gimp_undo_swap_holes,
+                                                         list);
+            }
+
+          return offset;
+        }
+    }
+
+  offset = gimp_undo_swap_end;
+
+  gimp_undo_swap_end += size;
+
+  return offset;
+}
+
+/*  returns 'size' bytes at 'offset' to the unused space, merging them
+ *  with the neighboring holes.  Unused space at the end of the file is
+ *  truncated.
+ */
+static void
+gimp_undo_swap_release (goffset offset,
+                        gsize   size)
+{
+  GimpUndoSwapHole *hole = NULL;
+  GList            *prev = NULL;
+  GList            *next;
+
+  if (size == 0)
+    return;
+
+  /*  the holes are sorted by offset  */
+  for (next = gimp_undo_swap_holes; next; next = g_list_next (next))
+    {
+      if (((GimpUndoSwapHole *) next->data)->offset > offset)
+        break;
+
+      prev = next;
+    }
+
+  if (prev &&
+      ((GimpUndoSwapHole *) prev->data)->offset +
+      ((GimpUndoSwapHole *) prev->data)->size == offset)
+    {
+      hole = prev->data;
+
+      hole->size += size;
+    }
+  else
+    {
+      hole = g_slice_new (GimpUndoSwapHole);
+
+      hole->offset = offset;
+      hole->size   = size;
+
+      if (next)
+        {
+          gimp_undo_swap_holes = g_list_insert_before (gimp_undo_swap_holes,
+                                                       next, hole);
+          prev = next->prev;
+        }
+      else
+        {
+          gimp_undo_swap_holes = g_list_append (gimp_undo_swap_holes, hole);
+          prev = g_list_last (gimp_undo_swap_holes);
+        }
+    }
+
+  if (next &&
+      hole->offset + hole->size == ((GimpUndoSwapHole *) next->data)->offset)
+    {
+      hole->size += ((GimpUndoSwapHole *) next->data)->size;
+
+      g_slice_free (GimpUndoSwapHole, next->data);
+
+      gimp_undo_swap_holes = g_list_delete_link (gimp_undo_swap_holes, next);
+    }
+
+  if (hole->offset + hole->size == gimp_undo_swap_end)
+    {
+      /*  give the space at the end of the file back  */
+      gimp_undo_swap_end = hole->offset;
+
+      g_slice_free (GimpUndoSwapHole, hole);
+
+      gimp_undo_swap_holes = g_list_delete_link (gimp_undo_swap_holes, prev);
+
+      if (gimp_undo_swap_stream)
+        g_seekable_truncate (G_SEEKABLE (gimp_undo_swap_stream),
+                             gimp_undo_swap_end, NULL, NULL);
+    }
+}
@@ -0,0 +1,38 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimp-undo-swap.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_UNDO_SWAP_H__
+#define __GIMP_UNDO_SWAP_H__
+
+
+/*  The undo swap keeps the pixels of cold undo steps compressed in a
+ *  file in the swap directory, so they don't count against the undo
+ *  memory budget.
+ */
+
+void                gimp_undo_swap_exit  (Gimp               *gimp);
+
+GimpUndoSwapEntry * gimp_undo_swap_store (GeglBuffer         *buffer,
+                                          GError            **error);
+GeglBuffer        * gimp_undo_swap_load  (GimpUndoSwapEntry  *entry,
+                                          GError            **error);
+void                gimp_undo_swap_free  (GimpUndoSwapEntry  *entry);
+
+
+#endif /* __GIMP_UNDO_SWAP_H__ */
@@ -26,12 +26,20 @@
 
 #include "core-types.h"
 
+#include "gegl/gimp-gegl-mask.h"
+
+#include "gimp-parallel.h"
 #include "gimpboundary.h"
 
 
 /* GimpBoundSeg array growth parameter */
 #define MAX_SEGS_INC  2048
 
+/* the number of scanlines whose segments are found together, and
+ * cached together
+ */
+#define BAND_HEIGHT   64
+
 
 typedef struct _GimpBoundary GimpBoundary;
 
@@ -44,14 +52,58 @@ struct _GimpBoundary
 
   /*  The array of vertical segments  */
   gint         *vert_segs;
+};
 
-  /*  The empty segment arrays */
-  gint         *empty_segs_n;
-  gint         *empty_segs_c;
-  gint         *empty_segs_l;
-  gint          max_empty_segs;
+struct _GimpBoundaryCache
+{
+  GeglBuffer        *buffer;
+  const Babl        *format;
+  GimpBoundaryType   type;
+  gint               x1, y1;
+  gint               x2, y2;
+  gfloat             threshold;
+  gint               width;
+  gint               height;
+
+  /*  the horizontal segments of each band, and whether the band's
+   *  pixels, or the pixels next to them, were changed since
+   */
+  GimpBoundary     **bands;
+  guchar            *dirty;
+  gint               n_bands;
 };
 
+typedef struct
+{
+  GeglBuffer          *buffer;
+  const GeglRectangle *region;
+  const Babl          *format;
+  GimpBoundaryType     type;
+  gint                 x1, y1;
+  gint                 x2, y2;
+  gfloat               threshold;
+  gint                 start;
+  gint                 end;
+  gint                 origin;
+  GimpBoundary       **bands;
+  const gint          *todo;
+  gint                 n_todo;
+} GenerateData;
+
+typedef struct
+{
+  gint x;
+  gint y;
+  gint first;  /*  the first segment end at (x, y), or -1 if unused  */
+} SortPoint;
+
+typedef struct
+{
+  SortPoint *points;
+  gint       mask;
+  gint      *next;   /*  the next segment end at the same point, or -1  */
+} SortTable;
+
 
 /*  local function prototypes  */
 
@@ -91,6 +143,18 @@ static void           make_horiz_segs          (GimpBoundary        *boundary,
                                                 gint                 empty[],
                                                 gint                 num_empty,
                                                 gint                 top);
+static void           get_scanlines            (const GeglRectangle *region,
+                                                GimpBoundaryType     type,
+                                                gint                 y1,
+                                                gint                 y2,
+                                                gint                *start,
+                                                gint                *end);
+static void           generate_bands           (gint                 i,
+                                                gint                 n,
+                                                GenerateData        *data);
+static GimpBoundary * stitch_bands             (const GeglRectangle *bounds,
+                                                GimpBoundary       **bands,
+                                                gint                 n_bands);
 static GimpBoundary * generate_boundary        (GeglBuffer          *buffer,
                                                 const GeglRectangle *region,
                                                 const Babl          *format,
@@ -101,26 +165,18 @@ static GimpBoundary * generate_boundary        (GeglBuffer          *buffer,
                                                 gint                 y2,
                                                 gfloat               threshold);
 
-static gint       cmp_segptr_xy1_addr     (const GimpBoundSeg **seg_ptr_a,
-                                           const GimpBoundSeg **seg_ptr_b);
-static gint       cmp_segptr_xy2_addr     (const GimpBoundSeg **seg_ptr_a,
-                                           const GimpBoundSeg **seg_ptr_b);
+static void       gimp_boundary_cache_reset   (GimpBoundaryCache   *cache);
+static void       gimp_boundary_cache_changed (GeglBuffer          *buffer,
+                                               const GeglRectangle *rect,
+                                               GimpBoundaryCache   *cache);
 
-static gint       cmp_segptr_xy1          (const GimpBoundSeg **seg_ptr_a,
-                                           const GimpBoundSeg **seg_ptr_b);
-static gint       cmp_segptr_xy2          (const GimpBoundSeg **seg_ptr_a,
-                                           const GimpBoundSeg **seg_ptr_b);
-
-static const GimpBoundSeg * find_segment  (const GimpBoundSeg **segs_by_xy1,
-                                           const GimpBoundSeg **segs_by_xy2,
-                                           gint                 num_segs,
-                                           gint                 x,
-                                           gint                 y);
-
-static const GimpBoundSeg * find_segment_with_func (const GimpBoundSeg **segs,
-                                                    gint                 num_segs,
-                                                    const GimpBoundSeg  *search_seg,
-                                                    GCompareFunc         cmp_func);
+static SortPoint          * sort_table_lookup (SortTable           *table,
+                                               gint                 x,
+                                               gint                 y);
+static const GimpBoundSeg * find_segment      (SortTable           *table,
+                                               const GimpBoundSeg  *segs,
+                                               gint                 x,
+                                               gint                 y);
 
 static void       simplify_subdivide  (const GimpBoundSeg  *segs,
                                        gint                 start_idx,
@@ -191,6 +247,211 @@ gimp_boundary_find (GeglBuffer          *buffer,
   return gimp_boundary_free (boundary, FALSE);
 }
 
+/**
+ * gimp_boundary_cache_new:
+ *
+ * Creates a cache for the result of gimp_boundary_find_cached(), which
+ * remembers the segments of each band of scanlines until pixels in or
+ * next to the band are changed.
+ *
+ * Return value: the new #GimpBoundaryCache.
+ **/
+GimpBoundaryCache *
+gimp_boundary_cache_new (void)
+{
+  return g_slice_new0 (GimpBoundaryCache);
+}
+
+void
+gimp_boundary_cache_free (GimpBoundaryCache *cache)
+{
+  g_return_if_fail (cache != NULL);
+
+  gimp_boundary_cache_reset (cache);
+
+  g_slice_free (GimpBoundaryCache, cache);
+}
+
+/**
+ * gimp_boundary_cache_invalidate:
+ * @cache: a #GimpBoundaryCache
+ * @rect:  the changed area of the cached buffer, or %NULL
+ *
+ * Makes @cache scan the bands touching @rect again.  The cache follows
+ * the buffer's "changed" signal, but not every operation that replaces
+ * tiles of a buffer emits it, so owners of a cache should also call
+ * this for the areas they update.
+ **/
+void
+gimp_boundary_cache_invalidate (GimpBoundaryCache   *cache,
+                                const GeglRectangle *rect)
+{
+  gint y1, y2;
+  gint band;
+
+  g_return_if_fail (cache != NULL);
+
+  if (! cache->n_bands)
+    return;
+
+  if (! rect)
+    {
+      memset (cache->dirty, TRUE, cache->n_bands);
+      return;
+    }
+
+  /*  the segments of a band also depend on the scanlines above and
+   *  below it
+   */
+  y1 = MAX (rect->y - 1,            0);
+  y2 = MIN (rect->y + rect->height, cache->height - 1);
+
+  if (rect->width <= 0 || y1 > y2)
+    return;
+
+  for (band = y1 / BAND_HEIGHT; band <= y2 / BAND_HEIGHT; band++)
+    cache->dirty[band] = TRUE;
+}
+
+/**
+ * gimp_boundary_find_cached:
+ * @cache:     a #GimpBoundaryCache
+ * @buffer:    a #GeglBuffer
+ * @region:    the area outside of which no pixel is above @threshold
+ * @format:    a #Babl float format representing the component to analyze
+ * @type:      type of bounds
+ * @x1:        left side of bounds
+ * @y1:        top side of bounds
+ * @x2:        right side of bounds
+ * @y2:        botton side of bounds
+ * @threshold: pixel value of boundary line
+ * @num_segs:  number of returned #GimpBoundSeg's
+ *
+ * Like gimp_boundary_find(), but only scans the bands of @buffer which
+ * were changed since the last call with the same @cache and parameters.
+ *
+ * Return value: the boundary array.
+ **/
+GimpBoundSeg *
+gimp_boundary_find_cached (GimpBoundaryCache   *cache,
+                           GeglBuffer          *buffer,
+                           const GeglRectangle *region,
+                           const Babl          *format,
+                           GimpBoundaryType     type,
+                           gint                 x1,
+                           gint                 y1,
+                           gint                 x2,
+                           gint                 y2,
+                           gfloat               threshold,
+                           gint                *num_segs)
+{
+  GimpBoundary  *boundary;
+  GenerateData   data;
+  GeglRectangle  extent = { 0, };
+  GeglRectangle  bounds;
+  gint          *todo;
+  gint           n_todo;
+  gint           i;
+
+  g_return_val_if_fail (cache != NULL, NULL);
+  g_return_val_if_fail (GEGL_IS_BUFFER (buffer), NULL);
+  g_return_val_if_fail (region != NULL, NULL);
+  g_return_val_if_fail (num_segs != NULL, NULL);
+  g_return_val_if_fail (format != NULL, NULL);
+  g_return_val_if_fail (babl_format_get_bytes_per_pixel (format) ==
+                        sizeof (gfloat), NULL);
+
+  extent.width  = gegl_buffer_get_width  (buffer);
+  extent.height = gegl_buffer_get_height (buffer);
+
+  if (buffer        != cache->buffer    ||
+      format        != cache->format    ||
+      type          != cache->type      ||
+      x1            != cache->x1        ||
+      y1            != cache->y1        ||
+      x2            != cache->x2        ||
+      y2            != cache->y2        ||
+      threshold     != cache->threshold ||
+      extent.width  != cache->width     ||
+      extent.height != cache->height)
+    {
+      gimp_boundary_cache_reset (cache);
+
+      cache->buffer    = g_object_ref (buffer);
+      cache->format    = format;
+      cache->type      = type;
+      cache->x1        = x1;
+      cache->y1        = y1;
+      cache->x2        = x2;
+      cache->y2        = y2;
+      cache->threshold = threshold;
+      cache->width     = extent.width;
+      cache->height    = extent.height;
+      cache->n_bands   = (extent.height + BAND_HEIGHT - 1) / BAND_HEIGHT;
+      cache->bands     = g_new0 (GimpBoundary *, cache->n_bands);
+      cache->dirty     = g_new0 (guchar, cache->n_bands);
+
+      gegl_buffer_signal_connect (buffer, "changed",
+                                  G_CALLBACK (gimp_boundary_cache_changed),
+                                  cache);
+    }
+
+  data.buffer    = buffer;
+  data.region    = region;
+  data.format    = format;
+  data.type      = type;
+  data.x1        = x1;
+  data.y1        = y1;
+  data.x2        = x2;
+  data.y2        = y2;
+  data.threshold = threshold;
+  data.origin    = 0;
+  data.bands     = cache->bands;
+
+  /*  the scanlines outside of the buffer are empty, and the bands don't
+   *  depend on the part of the buffer which is scanned, as long as no
+   *  pixel outside of it is above the threshold
+   */
+  get_scanlines (region, type, y1, y2, &data.start, &data.end);
+
+  data.start = MAX (data.start, 0);
+  data.end   = MIN (data.end,   extent.height);
+
+  todo   = g_new (gint, cache->n_bands);
+  n_todo = 0;
+
+  for (i = 0; i < cache->n_bands; i++)
+    {
+      if (! cache->bands[i] || cache->dirty[i])
+        {
+          if (cache->bands[i])
+            gimp_boundary_free (cache->bands[i], TRUE);
+
+          cache->bands[i] = NULL;
+          cache->dirty[i] = FALSE;
+
+          todo[n_todo++] = i;
+        }
+    }
+
+  data.todo   = todo;
+  data.n_todo = n_todo;
+
+  gimp_parallel_distribute (n_todo,
+                            (GimpParallelDistributeFunc) generate_bands,
+                            &data);
+
+  g_free (todo);
+
+  gegl_rectangle_bounding_box (&bounds, region, &extent);
+
+  boundary = stitch_bands (&bounds, cache->bands, cache->n_bands);
+
+  *num_segs = boundary->num_segs;
+
+  return gimp_boundary_free (boundary, FALSE);
+}
+
 /**
  * gimp_boundary_sort:
  * @segs:       unsorted input segs.
@@ -209,12 +470,12 @@ gimp_boundary_sort (const GimpBoundSeg *segs,
                     gint                num_segs,
                     gint               *num_groups)
 {
-  GimpBoundary        *boundary;
-  const GimpBoundSeg **segs_ptrs_by_xy1;
-  const GimpBoundSeg **segs_ptrs_by_xy2;
-  gint                 index;
-  gint                 x, y;
-  gint                 startx, starty;
+  GimpBoundary *boundary;
+  SortTable     table;
+  gint          n_points;
+  gint          index;
+  gint          x, y;
+  gint          startx, starty;
 
   g_return_val_if_fail ((segs == NULL && num_segs == 0) ||
                         (segs != NULL && num_segs >  0), NULL);
@@ -225,22 +486,34 @@ gimp_boundary_sort (const GimpBoundSeg *segs,
   if (num_segs == 0)
     return NULL;
 
-  /* prepare arrays with GimpBoundSeg pointers sorted by xy1 and xy2
-   * accordingly
+  /* hash the ends of all segments by their coordinates, keeping the
+   * segments of each point in the order of their addresses.  the table
+   * is at most half full.
    */
-  segs_ptrs_by_xy1 = g_new (const GimpBoundSeg *, num_segs);
-  segs_ptrs_by_xy2 = g_new (const GimpBoundSeg *, num_segs);
+  n_points = 4;
+  while (n_points < 4 * num_segs)
+    n_points <<= 1;
 
-  for (index = 0; index < num_segs; index++)
+  table.points = g_new (SortPoint, n_points);
+  table.mask   = n_points - 1;
+  table.next   = g_new (gint, 2 * num_segs);
+
+  for (index = 0; index < n_points; index++)
+    table.points[index].first = -1;
+
+  for (index = 2 * num_segs - 1; index >= 0; index--)
     {
-      segs_ptrs_by_xy1[index] = segs + index;
-      segs_ptrs_by_xy2[index] = segs + index;
-    }
+      const GimpBoundSeg *seg = &segs[index / 2];
+      SortPoint          *point;
 
-  qsort (segs_ptrs_by_xy1, num_segs, sizeof (GimpBoundSeg *),
-         (GCompareFunc) cmp_segptr_xy1_addr);
-  qsort (segs_ptrs_by_xy2, num_segs, sizeof (GimpBoundSeg *),
-         (GCompareFunc) cmp_segptr_xy2_addr);
+      if (index & 1)
+        point = sort_table_lookup (&table, seg->x2, seg->y2);
+      else
+        point = sort_table_lookup (&table, seg->x1, seg->y1);
+
+      table.next[index] = point->first;
+      point->first      = index;
+    }
 
   for (index = 0; index < num_segs; index++)
     ((GimpBoundSeg *) segs)[index].visited = FALSE;
@@ -266,8 +539,7 @@ gimp_boundary_sort (const GimpBoundSeg *segs,
       x = segs[index].x2;
       y = segs[index].y2;
 
-      while ((cur_seg = find_segment (segs_ptrs_by_xy1, segs_ptrs_by_xy2,
-                                      num_segs, x, y)) != NULL)
+      while ((cur_seg = find_segment (&table, segs, x, y)) != NULL)
         {
           /*  make sure ordering is correct  */
           if (x == cur_seg->x1 && y == cur_seg->y1)
@@ -300,8 +572,8 @@ gimp_boundary_sort (const GimpBoundSeg *segs,
       gimp_boundary_add_seg (boundary, -1, -1, -1, -1, 0);
   }
 
-  g_free (segs_ptrs_by_xy1);
-  g_free (segs_ptrs_by_xy2);
+  g_free (table.points);
+  g_free (table.next);
 
   return gimp_boundary_free (boundary, FALSE);
 }
@@ -427,15 +699,6 @@ gimp_boundary_new (const GeglRectangle *region)
 
       for (i = 0; i <= (region->width + region->x); i++)
         boundary->vert_segs[i] = -1;
-
-      /*  find the maximum possible number of empty segments
-       *  given the current mask
-       */
-      boundary->max_empty_segs = region->width + 3;
-
-      boundary->empty_segs_n = g_new (gint, boundary->max_empty_segs);
-      boundary->empty_segs_c = g_new (gint, boundary->max_empty_segs);
-      boundary->empty_segs_l = g_new (gint, boundary->max_empty_segs);
     }
 
   return boundary;
@@ -453,15 +716,49 @@ gimp_boundary_free (GimpBoundary *boundary,
     segs = boundary->segs;
 
   g_free (boundary->vert_segs);
-  g_free (boundary->empty_segs_n);
-  g_free (boundary->empty_segs_c);
-  g_free (boundary->empty_segs_l);
 
   g_slice_free (GimpBoundary, boundary);
 
   return segs;
 }
 
+static void
+gimp_boundary_cache_reset (GimpBoundaryCache *cache)
+{
+  gint i;
+
+  if (cache->buffer)
+    {
+      g_signal_handlers_disconnect_by_func (cache->buffer,
+                                            gimp_boundary_cache_changed,
+                                            cache);
+
+      g_clear_object (&cache->buffer);
+    }
+
+  for (i = 0; i < cache->n_bands; i++)
+    {
+      if (cache->bands[i])
+        gimp_boundary_free (cache->bands[i], TRUE);
+    }
+
+  g_clear_pointer (&cache->bands, g_free);
+  g_clear_pointer (&cache->dirty, g_free);
+
+  cache->n_bands = 0;
+}
+
+/*  this can be called from any thread, but a racing update of a flag
+ *  can only make it dirty
+ */
+static void
+gimp_boundary_cache_changed (GeglBuffer          *buffer,
+                             const GeglRectangle *rect,
+                             GimpBoundaryCache   *cache)
+{
+  gimp_boundary_cache_invalidate (cache, rect);
+}
+
 static void
 gimp_boundary_add_seg (GimpBoundary *boundary,
                        gint          x1,
@@ -650,291 +947,313 @@ make_horiz_segs (GimpBoundary *boundary,
 
       if (e_s <= start && e_e >= end)
         {
-          process_horiz_seg (boundary,
-                             start, scanline, end, scanline, top);
+          gimp_boundary_add_seg (boundary,
+                                 start, scanline, end, scanline, top);
         }
       else if ((e_s > start && e_s < end) ||
                (e_e < end && e_e > start))
         {
-          process_horiz_seg (boundary,
-                             MAX (e_s, start), scanline,
-                             MIN (e_e, end), scanline, top);
+          gimp_boundary_add_seg (boundary,
+                                 MAX (e_s, start), scanline,
+                                 MIN (e_e, end), scanline, top);
         }
     }
 }
 
-static GimpBoundary *
-generate_boundary (GeglBuffer          *buffer,
-                   const GeglRectangle *region,
-                   const Babl          *format,
-                   GimpBoundaryType     type,
-                   gint                 x1,
-                   gint                 y1,
-                   gint                 x2,
-                   gint                 y2,
-                   gfloat               threshold)
+static void
+get_scanlines (const GeglRectangle *region,
+               GimpBoundaryType     type,
+               gint                 y1,
+               gint                 y2,
+               gint                *start,
+               gint                *end)
 {
-  GimpBoundary  *boundary;
-  GeglRectangle  line_rect = { 0, };
-  gfloat        *line_data;
-  gint           scanline;
-  gint           i;
-  gint           start, end;
-  gint          *tmp_segs;
-
-  gint          num_empty_n = 0;
-  gint          num_empty_c = 0;
-  gint          num_empty_l = 0;
-
-  boundary = gimp_boundary_new (region);
-
-  line_rect.width  = gegl_buffer_get_width (buffer);
-  line_rect.height = 1;
-
-  line_data = g_alloca (sizeof (gfloat) * line_rect.width);
-
-  start = 0;
-  end   = 0;
+  *start = 0;
+  *end   = 0;
 
   if (type == GIMP_BOUNDARY_WITHIN_BOUNDS)
     {
-      start = y1;
-      end   = y2;
+      *start = y1;
+      *end   = y2;
     }
   else if (type == GIMP_BOUNDARY_IGNORE_BOUNDS)
     {
-      start = region->y;
-      end   = region->y + region->height;
+      *start = region->y;
+      *end   = region->y + region->height;
     }
+}
 
-  /*  Find the empty segments for the previous and current scanlines  */
-  find_empty_segs (region, NULL,
-                   start - 1, boundary->empty_segs_l,
-                   boundary->max_empty_segs, &num_empty_l,
-                   type, x1, y1, x2, y2,
-                   threshold);
-
-  line_rect.y = start;
-  gegl_buffer_get (buffer, &line_rect, 1.0, format,
-                   line_data, GEGL_AUTO_ROWSTRIDE,
-                   GEGL_ABYSS_NONE);
-
-  find_empty_segs (region, line_data,
-                   start, boundary->empty_segs_c,
-                   boundary->max_empty_segs, &num_empty_c,
-                   type, x1, y1, x2, y2,
-                   threshold);
-
-  for (scanline = start; scanline < end; scanline++)
+/*  finds the horizontal segments of the bands in 'data->todo', each
+ *  band independently of the others.  the vertical segments connecting
+ *  them are only added when the bands are stitched, because they can
+ *  span several bands.
+ */
+static void
+generate_bands (gint          i,
+                gint          n,
+                GenerateData *data)
+{
+  GeglRectangle  rows_rect = { 0, };
+  gfloat        *rows;
+  gint          *empty_segs_n;
+  gint          *empty_segs_c;
+  gint          *empty_segs_l;
+  gint          *tmp_segs;
+  gint           max_empty_segs;
+  gint           j;
+
+  rows_rect.width = gegl_buffer_get_width (data->buffer);
+
+  rows = g_new (gfloat, (BAND_HEIGHT + 2) * rows_rect.width);
+
+  /*  find the maximum possible number of empty segments
+   *  given the current mask
+   */
+  max_empty_segs = data->region->width + 3;
+
+  empty_segs_n = g_new (gint, max_empty_segs);
+  empty_segs_c = g_new (gint, max_empty_segs);
+  empty_segs_l = g_new (gint, max_empty_segs);
+
+  for (j = i; j < data->n_todo; j += n)
     {
-      /*  find the empty segment list for the next scanline  */
-      line_rect.y = scanline + 1;
-      if (scanline + 1 == end)
-        line_data = NULL;
-      else
-        gegl_buffer_get (buffer, &line_rect, 1.0, format,
-                         line_data, GEGL_AUTO_ROWSTRIDE,
-                         GEGL_ABYSS_NONE);
-
-      find_empty_segs (region, line_data,
-                       scanline + 1, boundary->empty_segs_n,
-                       boundary->max_empty_segs, &num_empty_n,
-                       type, x1, y1, x2, y2,
-                       threshold);
-
-      /*  process the segments on the current scanline  */
-      for (i = 1; i < num_empty_c - 1; i += 2)
+      GimpBoundary *boundary;
+      gint          band = data->todo[j];
+      gint          band_start;
+      gint          band_end;
+      gint          scanline;
+      gint          k;
+      gint          num_empty_n = 0;
+      gint          num_empty_c = 0;
+      gint          num_empty_l = 0;
+
+      boundary = gimp_boundary_new (NULL);
+
+      data->bands[band] = boundary;
+
+      band_start = MAX (data->origin + band * BAND_HEIGHT, data->start);
+      band_end   = MIN (data->origin + (band + 1) * BAND_HEIGHT, data->end);
+
+      if (band_start >= band_end)
+        continue;
+
+      /*  a band of a mask without any pixel above the threshold has
+       *  no segments
+       */
+      if (data->threshold >= 0.0 &&
+          gimp_gegl_mask_get_state (data->buffer,
+                                    GEGL_RECTANGLE (0, band_start,
+                                                    rows_rect.width,
+                                                    band_end - band_start)) ==
+          GIMP_MASK_TILE_EMPTY)
+        continue;
+
+      /*  fetch the band's scanlines, and the ones above and below
+       *  it, except for the ones outside of the processed area, which
+       *  are empty
+       */
+      rows_rect.y      = MAX (band_start - 1, data->start);
+      rows_rect.height = MIN (band_end + 1, data->end) - rows_rect.y;
+
+      gegl_buffer_get (data->buffer, &rows_rect, 1.0, data->format,
+                       rows, GEGL_AUTO_ROWSTRIDE,
+                       GEGL_ABYSS_NONE);
+
+#define ROW(y) ((y) >= rows_rect.y && (y) < rows_rect.y + rows_rect.height ? \
+                rows + ((y) - rows_rect.y) * rows_rect.width : NULL)
+
+      /*  Find the empty segments for the previous and current scanlines  */
+      find_empty_segs (data->region, ROW (band_start - 1),
+                       band_start - 1, empty_segs_l,
+                       max_empty_segs, &num_empty_l,
+                       data->type, data->x1, data->y1, data->x2, data->y2,
+                       data->threshold);
+
+      find_empty_segs (data->region, ROW (band_start),
+                       band_start, empty_segs_c,
+                       max_empty_segs, &num_empty_c,
+                       data->type, data->x1, data->y1, data->x2, data->y2,
+                       data->threshold);
+
+      for (scanline = band_start; scanline < band_end; scanline++)
         {
-          make_horiz_segs (boundary,
-                           boundary->empty_segs_c [i],
-                           boundary->empty_segs_c [i+1],
-                           scanline,
-                           boundary->empty_segs_l, num_empty_l, 1);
-          make_horiz_segs (boundary,
-                           boundary->empty_segs_c [i],
-                           boundary->empty_segs_c [i+1],
-                           scanline + 1,
-                           boundary->empty_segs_n, num_empty_n, 0);
+          /*  find the empty segment list for the next scanline  */
+          find_empty_segs (data->region, ROW (scanline + 1),
+                           scanline + 1, empty_segs_n,
+                           max_empty_segs, &num_empty_n,
+                           data->type, data->x1, data->y1, data->x2, data->y2,
+                           data->threshold);
+
+          /*  process the segments on the current scanline  */
+          for (k = 1; k < num_empty_c - 1; k += 2)
+            {
+              make_horiz_segs (boundary,
+                               empty_segs_c [k],
+                               empty_segs_c [k+1],
+                               scanline,
+                               empty_segs_l, num_empty_l, 1);
+              make_horiz_segs (boundary,
+                               empty_segs_c [k],
+                               empty_segs_c [k+1],
+                               scanline + 1,
+                               empty_segs_n, num_empty_n, 0);
+            }
+
+          /*  get the next scanline of empty segments, swap others  */
+          tmp_segs     = empty_segs_l;
+          empty_segs_l = empty_segs_c;
+          num_empty_l  = num_empty_c;
+          empty_segs_c = empty_segs_n;
+          num_empty_c  = num_empty_n;
+          empty_segs_n = tmp_segs;
         }
 
-      /*  get the next scanline of empty segments, swap others  */
-      tmp_segs               = boundary->empty_segs_l;
-      boundary->empty_segs_l = boundary->empty_segs_c;
-      num_empty_l            = num_empty_c;
-      boundary->empty_segs_c = boundary->empty_segs_n;
-      num_empty_c            = num_empty_n;
-      boundary->empty_segs_n = tmp_segs;
+#undef ROW
     }
 
-  return boundary;
+  g_free (empty_segs_n);
+  g_free (empty_segs_c);
+  g_free (empty_segs_l);
+  g_free (rows);
 }
 
-/*  sorting utility functions  */
-
-static inline gint
-cmp_xy (const gint ax,
-        const gint ay,
-        const gint bx,
-        const gint by)
+/*  adds the horizontal segments of all bands in order, together with
+ *  the vertical segments closing them, which gives the same result as
+ *  processing all scanlines at once
+ */
+static GimpBoundary *
+stitch_bands (const GeglRectangle  *bounds,
+              GimpBoundary        **bands,
+              gint                  n_bands)
 {
-  if (ay < by)
-    {
-      return -1;
-    }
-  else if (ay > by)
-    {
-      return 1;
-    }
-  else if (ax < bx)
-    {
-      return -1;
-    }
-  else if (ax > bx)
-    {
-      return 1;
-    }
-  else
+  GimpBoundary *boundary = gimp_boundary_new (bounds);
+  gint          i;
+
+  for (i = 0; i < n_bands; i++)
     {
-      return 0;
+      const GimpBoundSeg *segs = bands[i]->segs;
+      gint                j;
+
+      for (j = 0; j < bands[i]->num_segs; j++)
+        {
+          process_horiz_seg (boundary,
+                             segs[j].x1, segs[j].y1,
+                             segs[j].x2, segs[j].y2,
+                             segs[j].open);
+        }
     }
-}
 
+  return boundary;
+}
 
-/*
- * Compares (x1, y1) pairs in specified segments, using their addresses if
- * (x1, y1) pairs are equal.
- */
-static gint
-cmp_segptr_xy1_addr (const GimpBoundSeg **seg_ptr_a,
-                     const GimpBoundSeg **seg_ptr_b)
+static GimpBoundary *
+generate_boundary (GeglBuffer          *buffer,
+                   const GeglRectangle *region,
+                   const Babl          *format,
+                   GimpBoundaryType     type,
+                   gint                 x1,
+                   gint                 y1,
+                   gint                 x2,
+                   gint                 y2,
+                   gfloat               threshold)
 {
-  const GimpBoundSeg *seg_a = *seg_ptr_a;
-  const GimpBoundSeg *seg_b = *seg_ptr_b;
+  GimpBoundary  *boundary;
+  GenerateData   data;
+  gint          *todo;
+  gint           n_bands;
+  gint           i;
 
-  gint result = cmp_xy (seg_a->x1, seg_a->y1, seg_b->x1, seg_b->y1);
+  data.buffer    = buffer;
+  data.region    = region;
+  data.format    = format;
+  data.type      = type;
+  data.x1        = x1;
+  data.y1        = y1;
+  data.x2        = x2;
+  data.y2        = y2;
+  data.threshold = threshold;
 
-  if (result == 0)
-    {
-      if (seg_a < seg_b)
-        result = -1;
-      else if (seg_a > seg_b)
-        result = 1;
-    }
+  get_scanlines (region, type, y1, y2, &data.start, &data.end);
 
-  return result;
-}
+  data.origin = data.start;
 
-/*
- * Compares (x2, y2) pairs in specified segments, using their addresses if
- * (x2, y2) pairs are equal.
- */
-static gint
-cmp_segptr_xy2_addr (const GimpBoundSeg **seg_ptr_a,
-                     const GimpBoundSeg **seg_ptr_b)
-{
-  const GimpBoundSeg *seg_a = *seg_ptr_a;
-  const GimpBoundSeg *seg_b = *seg_ptr_b;
+  n_bands = MAX (data.end - data.start + BAND_HEIGHT - 1, 0) / BAND_HEIGHT;
 
-  gint result = cmp_xy (seg_a->x2, seg_a->y2, seg_b->x2, seg_b->y2);
+  data.bands = g_new0 (GimpBoundary *, n_bands);
 
-  if (result == 0)
-    {
-      if (seg_a < seg_b)
-        result = -1;
-      else if (seg_a > seg_b)
-        result = 1;
-    }
+  todo = g_new (gint, n_bands);
 
-  return result;
-}
+  for (i = 0; i < n_bands; i++)
+    todo[i] = i;
 
+  data.todo   = todo;
+  data.n_todo = n_bands;
 
-/*
- * Compares (x1, y1) pairs in specified segments.
- */
-static gint
-cmp_segptr_xy1 (const GimpBoundSeg **seg_ptr_a,
-                const GimpBoundSeg **seg_ptr_b)
-{
-  const GimpBoundSeg *seg_a = *seg_ptr_a, *seg_b = *seg_ptr_b;
+  gimp_parallel_distribute (n_bands,
+                            (GimpParallelDistributeFunc) generate_bands,
+                            &data);
+
+  boundary = stitch_bands (region, data.bands, n_bands);
+
+  for (i = 0; i < n_bands; i++)
+    gimp_boundary_free (data.bands[i], TRUE);
+
+  g_free (data.bands);
+  g_free (todo);
 
-  return cmp_xy (seg_a->x1, seg_a->y1, seg_b->x1, seg_b->y1);
+  return boundary;
 }
 
-/*
- * Compares (x2, y2) pairs in specified segments.
+/*  sorting utility functions  */
+
+/*  returns the table entry of (x, y), or the unused entry where it
+ *  has to be added
  */
-static gint
-cmp_segptr_xy2 (const GimpBoundSeg **seg_ptr_a,
-                const GimpBoundSeg **seg_ptr_b)
+static SortPoint *
+sort_table_lookup (SortTable *table,
+                   gint       x,
+                   gint       y)
 {
-  const GimpBoundSeg *seg_a = *seg_ptr_a;
-  const GimpBoundSeg *seg_b = *seg_ptr_b;
+  guint index = ((guint) x * 73856093u) ^ ((guint) y * 19349663u);
 
-  return cmp_xy (seg_a->x2, seg_a->y2, seg_b->x2, seg_b->y2);
-}
+  while (TRUE)
+    {
+      SortPoint *point = &table->points[index & table->mask];
 
+      if (point->first < 0)
+        {
+          point->x = x;
+          point->y = y;
 
-static const GimpBoundSeg *
-find_segment (const GimpBoundSeg **segs_by_xy1,
-              const GimpBoundSeg **segs_by_xy2,
-              gint                 num_segs,
-              gint                 x,
-              gint                 y)
-{
-  const GimpBoundSeg *segptr_xy1;
-  const GimpBoundSeg *segptr_xy2;
-  GimpBoundSeg        search_seg;
-
-  search_seg.x1 = search_seg.x2 = x;
-  search_seg.y1 = search_seg.y2 = y;
-
-  segptr_xy1 = find_segment_with_func (segs_by_xy1, num_segs, &search_seg,
-                                       (GCompareFunc) cmp_segptr_xy1);
-  segptr_xy2 = find_segment_with_func (segs_by_xy2, num_segs, &search_seg,
-                                       (GCompareFunc) cmp_segptr_xy2);
-
-  /* return segment with smaller address */
-  if (segptr_xy1 != NULL && segptr_xy2 != NULL)
-    return MIN(segptr_xy1, segptr_xy2);
-  else if (segptr_xy1 != NULL)
-    return segptr_xy1;
-  else if (segptr_xy2 != NULL)
-    return segptr_xy2;
+          return point;
+        }
 
-  return NULL;
-}
+      if (point->x == x && point->y == y)
+        return point;
 
+      index++;
+    }
+}
 
+/*  returns the non-visited segment with the lowest address which
+ *  starts or ends at (x, y)
+ */
 static const GimpBoundSeg *
-find_segment_with_func (const GimpBoundSeg **segs,
-                        gint                 num_segs,
-                        const GimpBoundSeg  *search_seg,
-                        GCompareFunc         cmp_func)
+find_segment (SortTable          *table,
+              const GimpBoundSeg *segs,
+              gint                x,
+              gint                y)
 {
-  const GimpBoundSeg **seg;
-  const GimpBoundSeg *found_seg = NULL;
+  SortPoint *point = sort_table_lookup (table, x, y);
+  gint       end;
 
-  seg = bsearch (&search_seg, segs, num_segs, sizeof (GimpBoundSeg *), cmp_func);
-
-  if (seg != NULL)
+  for (end = point->first; end >= 0; end = table->next[end])
     {
-      /* find first matching segment */
-      while (seg > segs && cmp_func (seg - 1, &search_seg) == 0)
-        seg--;
-
-      /* find first non-visited segment */
-      while (seg != segs + num_segs && cmp_func (seg, &search_seg) == 0)
-        if (!(*seg)->visited)
-          {
-            found_seg = *seg;
-            break;
-          }
-        else
-          seg++;
+      if (! segs[end / 2].visited)
+        return &segs[end / 2];
     }
 
-    return found_seg;
+  return NULL;
 }
 
 
@@ -41,6 +41,13 @@
 #include "gimp-intl.h"
 
 
+/*  transformed brushes are quantized to 2^TRANSFORM_SIZE_BITS sizes
+ *  per octave, with sizes below 2^TRANSFORM_SIZE_BITS pixels
+ *  quantized to whole pixels
+ */
+#define TRANSFORM_SIZE_BITS 6
+
+
 enum
 {
   SPACING_CHANGED,
@@ -93,6 +100,12 @@ static gboolean      gimp_brush_real_want_null_motion (GimpBrush            *bru
 
 static gchar       * gimp_brush_get_checksum          (GimpTagged           *tagged);
 
+static void          gimp_brush_transform_quantize    (GimpBrush            *brush,
+                                                       gdouble              *scale,
+                                                       gdouble              *aspect_ratio,
+                                                       gdouble              *angle,
+                                                       gdouble              *hardness);
+
 
 G_DEFINE_TYPE_WITH_CODE (GimpBrush, gimp_brush, GIMP_TYPE_DATA,
                          G_IMPLEMENT_INTERFACE (GIMP_TYPE_TAGGED,
@@ -427,13 +440,18 @@ static void
 gimp_brush_real_begin_use (GimpBrush *brush)
 {
   brush->priv->mask_cache =
-    gimp_brush_cache_new ((GDestroyNotify) gimp_temp_buf_unref, 'M', 'm');
+    gimp_brush_cache_new ((GDestroyNotify) gimp_temp_buf_unref,
+                          (GimpBrushCacheMemsizeFunc) gimp_temp_buf_get_memsize,
+                          'M', 'm');
 
   brush->priv->pixmap_cache =
-    gimp_brush_cache_new ((GDestroyNotify) gimp_temp_buf_unref, 'P', 'p');
+    gimp_brush_cache_new ((GDestroyNotify) gimp_temp_buf_unref,
+                          (GimpBrushCacheMemsizeFunc) gimp_temp_buf_get_memsize,
+                          'P', 'p');
 
   brush->priv->boundary_cache =
-    gimp_brush_cache_new ((GDestroyNotify) gimp_bezier_desc_free, 'B', 'b');
+    gimp_brush_cache_new ((GDestroyNotify) gimp_bezier_desc_free, NULL,
+                          'B', 'b');
 }
 
 static void
@@ -500,6 +518,61 @@ gimp_brush_get_checksum (GimpTagged *tagged)
   return checksum_string;
 }
 
+/*  quantizes the transform parameters, so that transformed brushes
+ *  can be cached and shared by dabs with slightly different parameters,
+ *  like when painting with dynamics.  The size is quantized to whole
+ *  pixels for small brushes, and to 2^TRANSFORM_SIZE_BITS steps per
+ *  octave for big ones; the other parameters are quantized so that they
+ *  move the brush's outline by about as much as a size step.  Quantizing
+ *  already quantized parameters doesn't change them.
+ */
+static void
+gimp_brush_transform_quantize (GimpBrush *brush,
+                               gdouble   *scale,
+                               gdouble   *aspect_ratio,
+                               gdouble   *angle,
+                               gdouble   *hardness)
+{
+  gdouble max_side;
+  gdouble size;
+  gdouble step;
+  gint    exponent;
+  gint    n_steps;
+
+  max_side = MAX (gimp_temp_buf_get_width  (brush->priv->mask),
+                  gimp_temp_buf_get_height (brush->priv->mask));
+
+  size = *scale * max_side;
+
+  if (size < 1.0)
+    return;
+
+  frexp (size, &exponent);
+  step = ldexp (1.0, MAX (exponent - 1 - TRANSFORM_SIZE_BITS, 0));
+
+  if (*scale != 1.0)
+    {
+      size   = RINT (size / step) * step;
+      *scale = size / max_side;
+    }
+
+  /*  the number of steps across the brush  */
+  n_steps = MAX (ceil (size / step), 1);
+
+  *aspect_ratio = 20.0 * RINT (*aspect_ratio * n_steps / 20.0) / n_steps;
+
+  if (hardness)
+    *hardness = RINT (*hardness * n_steps) / n_steps;
+
+  /*  the number of steps around the brush, a multiple of 4 so that
+   *  right angles are kept exact
+   */
+  n_steps = 4 * (gint) ceil (G_PI * size / (4.0 * step));
+
+  *angle = RINT (*angle * n_steps) / n_steps;
+}
+
+
 /*  public functions  */
 
 GimpData *
@@ -596,6 +669,9 @@ gimp_brush_transform_size (GimpBrush     *brush,
   g_return_if_fail (width != NULL);
   g_return_if_fail (height != NULL);
 
+  gimp_brush_transform_quantize (brush,
+                                 &scale, &aspect_ratio, &angle, NULL);
+
   if (scale        == 1.0 &&
       aspect_ratio == 0.0 &&
       ((angle == 0.0) || (angle == 0.5) || (angle == 1.0)))
@@ -626,6 +702,9 @@ gimp_brush_transform_mask (GimpBrush *brush,
   g_return_val_if_fail (GIMP_IS_BRUSH (brush), NULL);
   g_return_val_if_fail (scale > 0.0, NULL);
 
+  gimp_brush_transform_quantize (brush,
+                                 &scale, &aspect_ratio, &angle, &hardness);
+
   gimp_brush_transform_size (brush,
                              scale, aspect_ratio, angle,
                              &width, &height);
@@ -705,6 +784,9 @@ gimp_brush_transform_pixmap (GimpBrush *brush,
   g_return_val_if_fail (brush->priv->pixmap != NULL, NULL);
   g_return_val_if_fail (scale > 0.0, NULL);
 
+  gimp_brush_transform_quantize (brush,
+                                 &scale, &aspect_ratio, &angle, &hardness);
+
   gimp_brush_transform_size (brush,
                              scale, aspect_ratio, angle,
                              &width, &height);
@@ -783,6 +865,9 @@ gimp_brush_transform_boundary (GimpBrush *brush,
   g_return_val_if_fail (width != NULL, NULL);
   g_return_val_if_fail (height != NULL, NULL);
 
+  gimp_brush_transform_quantize (brush,
+                                 &scale, &aspect_ratio, &angle, &hardness);
+
   gimp_brush_transform_size (brush,
                              scale, aspect_ratio, angle,
                              width, height);
@@ -30,13 +30,19 @@
 #include "gimp-intl.h"
 
 
-#define MAX_CACHED_DATA 20
+/*  the cache keeps at most this many transformed brushes, and drops
+ *  the least recently used ones once they take more than
+ *  MAX_CACHED_MEMSIZE bytes, keeping at least the most recent one
+ */
+#define MAX_CACHED_DATA    256
+#define MAX_CACHED_MEMSIZE (64 * 1024 * 1024)
 
 
 enum
 {
   PROP_0,
-  PROP_DATA_DESTROY
+  PROP_DATA_DESTROY,
+  PROP_DATA_MEMSIZE
 };
 
 
@@ -45,6 +51,8 @@ typedef struct _GimpBrushCacheUnit GimpBrushCacheUnit;
 struct _GimpBrushCacheUnit
 {
   gpointer  data;
+  gsize     memsize;
+  GList     link;     /*  in the cache's LRU queue  */
 
   gint      width;
   gint      height;
@@ -56,16 +64,26 @@ struct _GimpBrushCacheUnit
 };
 
 
-static void   gimp_brush_cache_constructed  (GObject      *object);
-static void   gimp_brush_cache_finalize     (GObject      *object);
-static void   gimp_brush_cache_set_property (GObject      *object,
-                                             guint         property_id,
-                                             const GValue *value,
-                                             GParamSpec   *pspec);
-static void   gimp_brush_cache_get_property (GObject      *object,
-                                             guint         property_id,
-                                             GValue       *value,
-                                             GParamSpec   *pspec);
+static void       gimp_brush_cache_constructed  (GObject                  *object);
+static void       gimp_brush_cache_finalize     (GObject                  *object);
+static void       gimp_brush_cache_set_property (GObject                  *object,
+                                                 guint                     property_id,
+                                                 const GValue             *value,
+                                                 GParamSpec               *pspec);
+static void       gimp_brush_cache_get_property (GObject                  *object,
+                                                 guint                     property_id,
+                                                 GValue                   *value,
+                                                 GParamSpec               *pspec);
+
+static gint64     gimp_brush_cache_get_memsize  (GimpObject               *object,
+                                                 gint64                   *gui_size);
+
+static guint      gimp_brush_cache_unit_hash    (const GimpBrushCacheUnit *unit);
+static gboolean   gimp_brush_cache_unit_equal   (const GimpBrushCacheUnit *unit1,
+                                                 const GimpBrushCacheUnit *unit2);
+
+static void       gimp_brush_cache_remove_unit  (GimpBrushCache           *cache,
+                                                 GimpBrushCacheUnit       *unit);
 
 
 G_DEFINE_TYPE (GimpBrushCache, gimp_brush_cache, GIMP_TYPE_OBJECT)
@@ -76,23 +94,37 @@ G_DEFINE_TYPE (GimpBrushCache, gimp_brush_cache, GIMP_TYPE_OBJECT)
 static void
 gimp_brush_cache_class_init (GimpBrushCacheClass *klass)
 {
-  GObjectClass  *object_class = G_OBJECT_CLASS (klass);
+  GObjectClass    *object_class      = G_OBJECT_CLASS (klass);
+  GimpObjectClass *gimp_object_class = GIMP_OBJECT_CLASS (klass);
+
+  object_class->constructed     = gimp_brush_cache_constructed;
+  object_class->finalize        = gimp_brush_cache_finalize;
+  object_class->set_property    = gimp_brush_cache_set_property;
+  object_class->get_property    = gimp_brush_cache_get_property;
 
-  object_class->constructed  = gimp_brush_cache_constructed;
-  object_class->finalize     = gimp_brush_cache_finalize;
-  object_class->set_property = gimp_brush_cache_set_property;
-  object_class->get_property = gimp_brush_cache_get_property;
+  gimp_object_class->get_memsize = gimp_brush_cache_get_memsize;
 
   g_object_class_install_property (object_class, PROP_DATA_DESTROY,
                                    g_param_spec_pointer ("data-destroy",
                                                          NULL, NULL,
                                                          GIMP_PARAM_READWRITE |
                                                          G_PARAM_CONSTRUCT_ONLY));
+
+  g_object_class_install_property (object_class, PROP_DATA_MEMSIZE,
+                                   g_param_spec_pointer ("data-memsize",
+                                                         NULL, NULL,
+                                                         GIMP_PARAM_READWRITE |
+                                                         G_PARAM_CONSTRUCT_ONLY));
 }
 
 static void
-gimp_brush_cache_init (GimpBrushCache *brush)
+gimp_brush_cache_init (GimpBrushCache *cache)
 {
+  cache->cached_units =
+    g_hash_table_new ((GHashFunc)  gimp_brush_cache_unit_hash,
+                      (GEqualFunc) gimp_brush_cache_unit_equal);
+
+  g_queue_init (&cache->lru);
 }
 
 static void
@@ -112,6 +144,8 @@ gimp_brush_cache_finalize (GObject *object)
 
   gimp_brush_cache_clear (cache);
 
+  g_hash_table_unref (cache->cached_units);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -129,6 +163,10 @@ gimp_brush_cache_set_property (GObject      *object,
       cache->data_destroy = g_value_get_pointer (value);
       break;
 
+    case PROP_DATA_MEMSIZE:
+      cache->data_memsize = g_value_get_pointer (value);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -149,19 +187,34 @@ gimp_brush_cache_get_property (GObject    *object,
       g_value_set_pointer (value, cache->data_destroy);
       break;
 
+    case PROP_DATA_MEMSIZE:
+      g_value_set_pointer (value, cache->data_memsize);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
     }
 }
 
+static gint64
+gimp_brush_cache_get_memsize (GimpObject *object,
+                              gint64     *gui_size)
+{
+  GimpBrushCache *cache = GIMP_BRUSH_CACHE (object);
+
+  return cache->memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
+                                                                         gui_size);
+}
+
 
 /*  public functions  */
 
 GimpBrushCache *
-gimp_brush_cache_new (GDestroyNotify  data_destroy,
-                      gchar           debug_hit,
-                      gchar           debug_miss)
+gimp_brush_cache_new (GDestroyNotify             data_destroy,
+                      GimpBrushCacheMemsizeFunc  data_memsize,
+                      gchar                      debug_hit,
+                      gchar                      debug_miss)
 {
   GimpBrushCache *cache;
 
@@ -169,6 +222,7 @@ gimp_brush_cache_new (GDestroyNotify  data_destroy,
 
   cache =  g_object_new (GIMP_TYPE_BRUSH_CACHE,
                          "data-destroy", data_destroy,
+                         "data-memsize", data_memsize,
                          NULL);
 
   cache->debug_hit  = debug_hit;
@@ -182,20 +236,8 @@ gimp_brush_cache_clear (GimpBrushCache *cache)
 {
   g_return_if_fail (GIMP_IS_BRUSH_CACHE (cache));
 
-  if (cache->cached_units)
-    {
-      GList *iter;
-
-      for (iter = cache->cached_units; iter; iter = g_list_next (iter))
-        {
-          GimpBrushCacheUnit *unit = iter->data;
-
-          cache->data_destroy (unit->data);
-        }
-
-      g_list_free_full (cache->cached_units, g_free);
-      cache->cached_units = NULL;
-    }
+  while (cache->lru.head)
+    gimp_brush_cache_remove_unit (cache, cache->lru.head->data);
 }
 
 gconstpointer
@@ -208,35 +250,31 @@ gimp_brush_cache_get (GimpBrushCache *cache,
                       gdouble         angle,
                       gdouble         hardness)
 {
-  GList *iter;
+  GimpBrushCacheUnit  key;
+  GimpBrushCacheUnit *unit;
 
   g_return_val_if_fail (GIMP_IS_BRUSH_CACHE (cache), NULL);
 
-  for (iter = cache->cached_units; iter; iter = g_list_next (iter))
+  key.width        = width;
+  key.height       = height;
+  key.scale        = scale;
+  key.aspect_ratio = aspect_ratio;
+  key.angle        = angle;
+  key.hardness     = hardness;
+  key.op           = op;
+
+  unit = g_hash_table_lookup (cache->cached_units, &key);
+
+  if (unit)
     {
-      GimpBrushCacheUnit *unit = iter->data;
-
-      if (unit->data                         &&
-          unit->width        == width        &&
-          unit->height       == height       &&
-          unit->scale        == scale        &&
-          unit->aspect_ratio == aspect_ratio &&
-          unit->angle        == angle        &&
-          unit->hardness     == hardness     &&
-          unit->op           == op)
-        {
-          if (gimp_log_flags & GIMP_LOG_BRUSH_CACHE)
-            g_printerr ("%c", cache->debug_hit);
+      if (gimp_log_flags & GIMP_LOG_BRUSH_CACHE)
+        g_printerr ("%c", cache->debug_hit);
 
-          /* Make the returned cached brush first in the list. */
-          cache->cached_units = g_list_remove_link (cache->cached_units, iter);
-          iter->next = cache->cached_units;
-          if (cache->cached_units)
-            cache->cached_units->prev = iter;
-          cache->cached_units = iter;
+      /* Make the returned cached brush first in the list. */
+      g_queue_unlink (&cache->lru, &unit->link);
+      g_queue_push_head_link (&cache->lru, &unit->link);
 
-          return (gconstpointer) unit->data;
-        }
+      return (gconstpointer) unit->data;
     }
 
   if (gimp_log_flags & GIMP_LOG_BRUSH_CACHE)
@@ -256,37 +294,16 @@ gimp_brush_cache_add (GimpBrushCache *cache,
                       gdouble         angle,
                       gdouble         hardness)
 {
-  GList              *iter;
   GimpBrushCacheUnit *unit;
-  GList              *last   = NULL;
-  gint                length = 0;
+  GimpBrushCacheUnit *old_unit;
 
   g_return_if_fail (GIMP_IS_BRUSH_CACHE (cache));
   g_return_if_fail (data != NULL);
 
-  for (iter = cache->cached_units; iter; iter = g_list_next (iter))
-    {
-      unit = iter->data;
-
-      if (data == unit->data)
-        return;
-
-      length++;
-      last = iter;
-    }
-
-  if (length > MAX_CACHED_DATA)
-    {
-      unit = last->data;
-
-      cache->data_destroy (unit->data);
-      cache->cached_units = g_list_delete_link (cache->cached_units, last);
-      g_free (unit);
-    }
-
-  unit = g_new0 (GimpBrushCacheUnit, 1);
+  unit = g_slice_new0 (GimpBrushCacheUnit);
 
   unit->data         = data;
+  unit->link.data    = unit;
   unit->width        = width;
   unit->height       = height;
   unit->scale        = scale;
@@ -295,5 +312,76 @@ gimp_brush_cache_add (GimpBrushCache *cache,
   unit->hardness     = hardness;
   unit->op           = op;
 
-  cache->cached_units = g_list_prepend (cache->cached_units, unit);
+  if (cache->data_memsize)
+    unit->memsize = cache->data_memsize (data);
+
+  old_unit = g_hash_table_lookup (cache->cached_units, unit);
+
+  if (old_unit)
+    {
+      if (old_unit->data == data)
+        {
+          g_slice_free (GimpBrushCacheUnit, unit);
+          return;
+        }
+
+      gimp_brush_cache_remove_unit (cache, old_unit);
+    }
+
+  g_hash_table_add (cache->cached_units, unit);
+  g_queue_push_head_link (&cache->lru, &unit->link);
+  cache->memsize += unit->memsize;
+
+  /*  evict the least recently used units, but never the new one  */
+  while (cache->lru.length > 1 &&
+         (cache->lru.length > MAX_CACHED_DATA ||
+          cache->memsize    > MAX_CACHED_MEMSIZE))
+    {
+      gimp_brush_cache_remove_unit (cache, cache->lru.tail->data);
+    }
+}
+
+
+/*  private functions  */
+
+static guint
+gimp_brush_cache_unit_hash (const GimpBrushCacheUnit *unit)
+{
+  guint hash;
+
+  hash = g_direct_hash (unit->op);
+  hash = hash * 31 + unit->width;
+  hash = hash * 31 + unit->height;
+  hash = hash * 31 + g_double_hash (&unit->scale);
+  hash = hash * 31 + g_double_hash (&unit->aspect_ratio);
+  hash = hash * 31 + g_double_hash (&unit->angle);
+  hash = hash * 31 + g_double_hash (&unit->hardness);
+
+  return hash;
+}
+
+static gboolean
+gimp_brush_cache_unit_equal (const GimpBrushCacheUnit *unit1,
+                             const GimpBrushCacheUnit *unit2)
+{
+  return (unit1->width        == unit2->width        &&
+          unit1->height       == unit2->height       &&
+          unit1->scale        == unit2->scale        &&
+          unit1->aspect_ratio == unit2->aspect_ratio &&
+          unit1->angle        == unit2->angle        &&
+          unit1->hardness     == unit2->hardness     &&
+          unit1->op           == unit2->op);
+}
+
+static void
+gimp_brush_cache_remove_unit (GimpBrushCache     *cache,
+                              GimpBrushCacheUnit *unit)
+{
+  g_hash_table_remove (cache->cached_units, unit);
+  g_queue_unlink (&cache->lru, &unit->link);
+  cache->memsize -= unit->memsize;
+
+  cache->data_destroy (unit->data);
+
+  g_slice_free (GimpBrushCacheUnit, unit);
 }
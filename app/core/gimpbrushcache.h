@@ -35,16 +35,21 @@
 
 typedef struct _GimpBrushCacheClass GimpBrushCacheClass;
 
+typedef gsize (* GimpBrushCacheMemsizeFunc) (gconstpointer data);
+
 struct _GimpBrushCache
 {
-  GimpObject      parent_instance;
+  GimpObject                 parent_instance;
 
-  GDestroyNotify  data_destroy;
+  GDestroyNotify             data_destroy;
+  GimpBrushCacheMemsizeFunc  data_memsize;
 
-  GList          *cached_units;
+  GHashTable                *cached_units;
+  GQueue                     lru;           /*  most recently used first  */
+  gint64                     memsize;
 
-  gchar           debug_hit;
-  gchar           debug_miss;
+  gchar                      debug_hit;
+  gchar                      debug_miss;
 };
 
 struct _GimpBrushCacheClass
@@ -55,29 +60,30 @@ struct _GimpBrushCacheClass
 
 GType            gimp_brush_cache_get_type (void) G_GNUC_CONST;
 
-GimpBrushCache * gimp_brush_cache_new      (GDestroyNotify  data_destory,
-                                            gchar           debug_hit,
-                                            gchar           debug_miss);
-
-void             gimp_brush_cache_clear    (GimpBrushCache *cache);
-
-gconstpointer    gimp_brush_cache_get      (GimpBrushCache *cache,
-                                            GeglNode       *op,
-                                            gint            width,
-                                            gint            height,
-                                            gdouble         scale,
-                                            gdouble         aspect_ratio,
-                                            gdouble         angle,
-                                            gdouble         hardness);
-void             gimp_brush_cache_add      (GimpBrushCache *cache,
-                                            gpointer        data,
-                                            GeglNode       *op,
-                                            gint            width,
-                                            gint            height,
-                                            gdouble         scale,
-                                            gdouble         aspect_ratio,
-                                            gdouble         angle,
-                                            gdouble         hardness);
+GimpBrushCache * gimp_brush_cache_new      (GDestroyNotify             data_destroy,
+                                            GimpBrushCacheMemsizeFunc  data_memsize,
+                                            gchar                      debug_hit,
+                                            gchar                      debug_miss);
+
+void             gimp_brush_cache_clear    (GimpBrushCache            *cache);
+
+gconstpointer    gimp_brush_cache_get      (GimpBrushCache            *cache,
+                                            GeglNode                  *op,
+                                            gint                       width,
+                                            gint                       height,
+                                            gdouble                    scale,
+                                            gdouble                    aspect_ratio,
+                                            gdouble                    angle,
+                                            gdouble                    hardness);
+void             gimp_brush_cache_add      (GimpBrushCache            *cache,
+                                            gpointer                   data,
+                                            GeglNode                  *op,
+                                            gint                       width,
+                                            gint                       height,
+                                            gdouble                    scale,
+                                            gdouble                    aspect_ratio,
+                                            gdouble                    angle,
+                                            gdouble                    hardness);
 
 
 #endif  /*  __GIMP_BRUSH_CACHE_H__  */
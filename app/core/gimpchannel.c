@@ -150,6 +150,11 @@ static void       gimp_channel_convert_type  (GimpDrawable      *drawable,
                                               gint               mask_dither_type,
                                               gboolean           push_undo,
                                               GimpProgress      *progress);
+static void gimp_channel_update               (GimpDrawable       *drawable,
+                                                gint                x,
+                                                gint                y,
+                                                gint                width,
+                                                gint                height);
 static void gimp_channel_invalidate_boundary   (GimpDrawable       *drawable);
 static void gimp_channel_get_active_components (GimpDrawable       *drawable,
                                                 gboolean           *active);
@@ -303,6 +308,7 @@ gimp_channel_class_init (GimpChannelClass *klass)
   item_class->raise_failed         = _("Channel cannot be raised higher.");
   item_class->lower_failed         = _("Channel cannot be lowered more.");
 
+  drawable_class->update                = gimp_channel_update;
   drawable_class->convert_type          = gimp_channel_convert_type;
   drawable_class->invalidate_boundary   = gimp_channel_invalidate_boundary;
   drawable_class->get_active_components = gimp_channel_get_active_components;
@@ -348,6 +354,8 @@ gimp_channel_init (GimpChannel *channel)
   channel->segs_out       = NULL;
   channel->num_segs_in    = 0;
   channel->num_segs_out   = 0;
+  channel->segs_in_cache  = gimp_boundary_cache_new ();
+  channel->segs_out_cache = gimp_boundary_cache_new ();
   channel->empty          = FALSE;
   channel->bounds_known   = FALSE;
   channel->x1             = 0;
@@ -379,6 +387,18 @@ gimp_channel_finalize (GObject *object)
       channel->segs_out = NULL;
     }
 
+  if (channel->segs_in_cache)
+    {
+      gimp_boundary_cache_free (channel->segs_in_cache);
+      channel->segs_in_cache = NULL;
+    }
+
+  if (channel->segs_out_cache)
+    {
+      gimp_boundary_cache_free (channel->segs_out_cache);
+      channel->segs_out_cache = NULL;
+    }
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -550,6 +570,8 @@ gimp_channel_duplicate (GimpItem *item,
       new_channel->y1           = channel->y1;
       new_channel->x2           = channel->x2;
       new_channel->y2           = channel->y2;
+
+      gimp_gegl_mask_track_tiles (gimp_drawable_get_buffer (GIMP_DRAWABLE (new_channel)));
     }
 
   return new_item;
@@ -979,6 +1001,32 @@ gimp_channel_convert_type (GimpDrawable      *drawable,
   g_object_unref (dest_buffer);
 }
 
+static void
+gimp_channel_update (GimpDrawable *drawable,
+                     gint          x,
+                     gint          y,
+                     gint          width,
+                     gint          height)
+{
+  GimpChannel *channel = GIMP_CHANNEL (drawable);
+
+  /*  tiles replaced by copying or filling don't always emit the
+   *  buffer's "changed" signal, but the area is always updated
+   */
+  gimp_gegl_mask_invalidate (gimp_drawable_get_buffer (drawable),
+                             GEGL_RECTANGLE (x, y, width, height));
+
+  if (channel->segs_in_cache)
+    gimp_boundary_cache_invalidate (channel->segs_in_cache,
+                                    GEGL_RECTANGLE (x, y, width, height));
+
+  if (channel->segs_out_cache)
+    gimp_boundary_cache_invalidate (channel->segs_out_cache,
+                                    GEGL_RECTANGLE (x, y, width, height));
+
+  GIMP_DRAWABLE_CLASS (parent_class)->update (drawable, x, y, width, height);
+}
+
 static void
 gimp_channel_invalidate_boundary (GimpDrawable *drawable)
 {
@@ -1064,6 +1112,8 @@ gimp_channel_set_buffer (GimpDrawable *drawable,
                                                   buffer,
                                                   offset_x, offset_y);
 
+  gimp_gegl_mask_track_tiles (buffer);
+
   channel->bounds_known = FALSE;
 
   if (gimp_filter_peek_node (GIMP_FILTER (channel)))
@@ -1150,12 +1200,17 @@ gimp_channel_real_boundary (GimpChannel         *channel,
 
           buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (channel));
 
-          channel->segs_out = gimp_boundary_find (buffer, &rect,
-                                                  babl_format ("Y float"),
-                                                  GIMP_BOUNDARY_IGNORE_BOUNDS,
-                                                  x1, y1, x2, y2,
-                                                  GIMP_BOUNDARY_HALF_WAY,
-                                                  &channel->num_segs_out);
+          /*  only the parts of the boundary next to pixels changed
+           *  since the last time are found again
+           */
+          channel->segs_out =
+            gimp_boundary_find_cached (channel->segs_out_cache,
+                                       buffer, &rect,
+                                       babl_format ("Y float"),
+                                       GIMP_BOUNDARY_IGNORE_BOUNDS,
+                                       x1, y1, x2, y2,
+                                       GIMP_BOUNDARY_HALF_WAY,
+                                       &channel->num_segs_out);
           x1 = MAX (x1, x3);
           y1 = MAX (y1, y3);
           x2 = MIN (x2, x4);
@@ -1163,12 +1218,14 @@ gimp_channel_real_boundary (GimpChannel         *channel,
 
           if (x2 > x1 && y2 > y1)
             {
-              channel->segs_in = gimp_boundary_find (buffer, NULL,
-                                                     babl_format ("Y float"),
-                                                     GIMP_BOUNDARY_WITHIN_BOUNDS,
-                                                     x1, y1, x2, y2,
-                                                     GIMP_BOUNDARY_HALF_WAY,
-                                                     &channel->num_segs_in);
+              channel->segs_in =
+                gimp_boundary_find_cached (channel->segs_in_cache,
+                                           buffer, &rect,
+                                           babl_format ("Y float"),
+                                           GIMP_BOUNDARY_WITHIN_BOUNDS,
+                                           x1, y1, x2, y2,
+                                           GIMP_BOUNDARY_HALF_WAY,
+                                           &channel->num_segs_in);
             }
           else
             {
@@ -1318,15 +1375,16 @@ gimp_channel_real_clear (GimpChannel *channel,
 
   if (channel->bounds_known && ! channel->empty)
     {
-      gegl_buffer_clear (gimp_drawable_get_buffer (GIMP_DRAWABLE (channel)),
-                         GEGL_RECTANGLE (channel->x1, channel->y1,
-                                         channel->x2 - channel->x1,
-                                         channel->y2 - channel->y1));
+      gimp_gegl_mask_fill (gimp_drawable_get_buffer (GIMP_DRAWABLE (channel)),
+                           GEGL_RECTANGLE (channel->x1, channel->y1,
+                                           channel->x2 - channel->x1,
+                                           channel->y2 - channel->y1),
+                           FALSE);
     }
   else
     {
-      gegl_buffer_clear (gimp_drawable_get_buffer (GIMP_DRAWABLE (channel)),
-                         NULL);
+      gimp_gegl_mask_fill (gimp_drawable_get_buffer (GIMP_DRAWABLE (channel)),
+                           NULL, FALSE);
     }
 
   /*  we know the bounds  */
@@ -1346,19 +1404,15 @@ static void
 gimp_channel_real_all (GimpChannel *channel,
                        gboolean     push_undo)
 {
-  GeglColor *color;
-
   if (push_undo)
     gimp_channel_push_undo (channel,
                             GIMP_CHANNEL_GET_CLASS (channel)->all_desc);
   else
     gimp_drawable_invalidate_boundary (GIMP_DRAWABLE (channel));
 
-  /*  clear the channel  */
-  color = gegl_color_new ("#fff");
-  gegl_buffer_set_color (gimp_drawable_get_buffer (GIMP_DRAWABLE (channel)),
-                         NULL, color);
-  g_object_unref (color);
+  /*  fill the channel  */
+  gimp_gegl_mask_fill (gimp_drawable_get_buffer (GIMP_DRAWABLE (channel)),
+                       NULL, TRUE);
 
   /*  we know the bounds  */
   channel->bounds_known = TRUE;
@@ -1659,6 +1713,8 @@ gimp_channel_new (GimpImage     *image,
   channel->x2          = width;
   channel->y2          = height;
 
+  gimp_gegl_mask_track_tiles (gimp_drawable_get_buffer (GIMP_DRAWABLE (channel)));
+
   return channel;
 }
 
@@ -1939,8 +1995,10 @@ gimp_channel_new_mask (GimpImage *image,
   channel->x2          = width;
   channel->y2          = height;
 
-  gegl_buffer_clear (gimp_drawable_get_buffer (GIMP_DRAWABLE (channel)),
-                     NULL);
+  gimp_gegl_mask_track_tiles (gimp_drawable_get_buffer (GIMP_DRAWABLE (channel)));
+
+  gimp_gegl_mask_fill (gimp_drawable_get_buffer (GIMP_DRAWABLE (channel)),
+                       NULL, FALSE);
 
   return channel;
 }
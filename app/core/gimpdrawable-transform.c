@@ -31,9 +31,11 @@
 #include "core-types.h"
 
 #include "gegl/gimp-gegl-apply-operation.h"
+#include "gegl/gimp-gegl-nodes.h"
 #include "gegl/gimp-gegl-utils.h"
 
 #include "gimp.h"
+#include "gimp-parallel.h"
 #include "gimp-transform-resize.h"
 #include "gimpchannel.h"
 #include "gimpcontext.h"
@@ -48,6 +50,8 @@
 #include "gimpprogress.h"
 #include "gimpselection.h"
 
+#include "gimp-priorities.h"
+
 #include "gimp-intl.h"
 
 
@@ -62,6 +66,45 @@
 #endif
 
 
+struct _GimpDrawableTransformJob
+{
+  GeglBuffer                   *buffer;       /*  snapshots of the drawable  */
+  GeglBuffer                   *mask_buffer;  /*  and the selection         */
+  GeglNode                    **graphs;       /*  one per thread            */
+  gint                          n_graphs;
+
+  const Babl                   *format;
+  guchar                       *data;
+  gint                          stride;
+  GeglRectangle                 rect;
+
+  GeglRectangle                *chunks;
+  gint                          n_chunks;
+  gint                          batch_next;
+  gint                          batch_last;
+
+  GimpDrawableTransformJobFunc  chunk_func;
+  gpointer                      user_data;
+
+  GThread                      *thread;
+  gint                          cancel;
+
+  /*  the rendered chunks which weren't passed to 'chunk_func' yet  */
+  GMutex                        mutex;
+  GArray                       *done;
+  guint                         idle_id;
+};
+
+
+/*  local function prototypes  */
+
+static gpointer gimp_drawable_transform_job_thread (GimpDrawableTransformJob *job);
+static void     gimp_drawable_transform_job_render (gint                      i,
+                                                    gint                      n,
+                                                    GimpDrawableTransformJob *job);
+static gboolean gimp_drawable_transform_job_idle   (GimpDrawableTransformJob *job);
+
+
 /*  public functions  */
 
 GeglBuffer *
@@ -1018,3 +1061,281 @@ gimp_drawable_transform_paste (GimpDrawable     *drawable,
 
   return drawable;
 }
+
+/**
+ * gimp_drawable_transform_job_new:
+ * @drawable:      the #GimpDrawable to transform
+ * @bounds:        the part of @drawable to transform, in image coordinates
+ * @matrix:        the transform from image to target coordinates
+ * @interpolation: the interpolation to use
+ * @format:        the format of @data
+ * @data:          the target pixels
+ * @rect:          the area of @data, in target coordinates
+ * @stride:        the rowstride of @data
+ * @chunks:        the areas to render, in the order they are rendered
+ * @n_chunks:      the number of @chunks
+ * @chunk_func:    the function to call with the rendered chunks
+ * @user_data:     data to pass to @chunk_func
+ *
+ * Starts rendering the transformed @drawable, masked by the selection,
+ * into @data in the background.  The chunks are rendered by all
+ * threads, each with its own graph, from a snapshot of the drawable
+ * taken now.  @chunk_func is called from the main loop with the chunks
+ * which were rendered since the last call.
+ *
+ * @data must stay valid until the job is canceled with
+ * gimp_drawable_transform_job_cancel(), which must be called even if
+ * all chunks were rendered.
+ *
+ * Return value: the new #GimpDrawableTransformJob.
+ **/
+GimpDrawableTransformJob *
+gimp_drawable_transform_job_new (GimpDrawable                 *drawable,
+                                 const GeglRectangle          *bounds,
+                                 const GimpMatrix3            *matrix,
+                                 GimpInterpolationType         interpolation,
+                                 const Babl                   *format,
+                                 guchar                       *data,
+                                 const GeglRectangle          *rect,
+                                 gint                          stride,
+                                 const GeglRectangle          *chunks,
+                                 gint                          n_chunks,
+                                 GimpDrawableTransformJobFunc  chunk_func,
+                                 gpointer                      user_data)
+{
+  GimpDrawableTransformJob *job;
+  gint                      offset_x, offset_y;
+  gint                      mask_x1, mask_y1;
+  gint                      mask_x2, mask_y2;
+  gint                      i;
+
+  g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), NULL);
+  g_return_val_if_fail (gimp_item_is_attached (GIMP_ITEM (drawable)), NULL);
+  g_return_val_if_fail (bounds != NULL, NULL);
+  g_return_val_if_fail (matrix != NULL, NULL);
+  g_return_val_if_fail (format != NULL, NULL);
+  g_return_val_if_fail (data != NULL, NULL);
+  g_return_val_if_fail (rect != NULL, NULL);
+  g_return_val_if_fail (chunks != NULL || n_chunks == 0, NULL);
+  g_return_val_if_fail (chunk_func != NULL, NULL);
+
+  job = g_slice_new0 (GimpDrawableTransformJob);
+
+  /*  the drawable may change while we render, the copies share the
+   *  tiles until it does
+   */
+  job->buffer = gegl_buffer_dup (gimp_drawable_get_buffer (drawable));
+
+  if (gimp_item_mask_bounds (GIMP_ITEM (drawable),
+                             &mask_x1, &mask_y1, &mask_x2, &mask_y2))
+    {
+      GimpImage   *image = gimp_item_get_image (GIMP_ITEM (drawable));
+      GimpChannel *mask  = gimp_image_get_mask (image);
+
+      job->mask_buffer =
+        gegl_buffer_dup (gimp_drawable_get_buffer (GIMP_DRAWABLE (mask)));
+    }
+
+  gimp_item_get_offset (GIMP_ITEM (drawable), &offset_x, &offset_y);
+
+  /*  GEGL graphs can't be processed by several threads at once  */
+  job->n_graphs = gimp_parallel_get_n_threads ();
+  job->graphs   = g_new (GeglNode *, job->n_graphs);
+
+  for (i = 0; i < job->n_graphs; i++)
+    {
+      GeglNode *graph;
+      GeglNode *source;
+      GeglNode *crop;
+      GeglNode *opacity;
+      GeglNode *transform;
+
+      graph = gegl_node_new ();
+
+      source = gimp_gegl_add_buffer_source (graph, job->buffer,
+                                            offset_x, offset_y);
+
+      crop = gegl_node_new_child (graph,
+                                  "operation", "gegl:crop",
+                                  "x",         (gdouble) bounds->x,
+                                  "y",         (gdouble) bounds->y,
+                                  "width",     (gdouble) bounds->width,
+                                  "height",    (gdouble) bounds->height,
+                                  NULL);
+
+      opacity = gegl_node_new_child (graph,
+                                     "operation", "gegl:opacity",
+                                     NULL);
+
+      transform = gegl_node_new_child (graph,
+                                       "operation", "gegl:transform",
+                                       "sampler",   interpolation,
+                                       NULL);
+
+      gimp_gegl_node_set_matrix (transform, matrix);
+
+      gegl_node_link_many (source, crop, opacity, transform,
+                           gegl_node_get_output_proxy (graph, "output"),
+                           NULL);
+
+      if (job->mask_buffer)
+        {
+          GeglNode *mask_source;
+
+          mask_source = gimp_gegl_add_buffer_source (graph, job->mask_buffer,
+                                                     0, 0);
+
+          gegl_node_connect_to (mask_source, "output",
+                                opacity,     "aux");
+        }
+
+      job->graphs[i] = graph;
+    }
+
+  job->format     = format;
+  job->data       = data;
+  job->stride     = stride;
+  job->rect       = *rect;
+  job->chunks     = g_memdup (chunks, n_chunks * sizeof (GeglRectangle));
+  job->n_chunks   = n_chunks;
+  job->chunk_func = chunk_func;
+  job->user_data  = user_data;
+  job->done       = g_array_new (FALSE, FALSE, sizeof (GeglRectangle));
+
+  g_mutex_init (&job->mutex);
+
+  job->thread = g_thread_new ("transform job",
+                              (GThreadFunc) gimp_drawable_transform_job_thread,
+                              job);
+
+  return job;
+}
+
+/**
+ * gimp_drawable_transform_job_cancel:
+ * @job: a #GimpDrawableTransformJob
+ *
+ * Stops @job after the chunks which are being rendered right now, and
+ * frees it.  @chunk_func isn't called anymore.
+ **/
+void
+gimp_drawable_transform_job_cancel (GimpDrawableTransformJob *job)
+{
+  gint i;
+
+  g_return_if_fail (job != NULL);
+
+  g_atomic_int_set (&job->cancel, TRUE);
+
+  g_thread_join (job->thread);
+
+  if (job->idle_id)
+    g_source_remove (job->idle_id);
+
+  for (i = 0; i < job->n_graphs; i++)
+    g_object_unref (job->graphs[i]);
+
+  g_free (job->graphs);
+
+  g_object_unref (job->buffer);
+
+  if (job->mask_buffer)
+    g_object_unref (job->mask_buffer);
+
+  g_free (job->chunks);
+  g_array_free (job->done, TRUE);
+
+  g_mutex_clear (&job->mutex);
+
+  g_slice_free (GimpDrawableTransformJob, job);
+}
+
+
+/*  private functions  */
+
+/*  renders the chunks in batches of one chunk per thread, so the
+ *  thread pool is never blocked for long by the job
+ */
+static gpointer
+gimp_drawable_transform_job_thread (GimpDrawableTransformJob *job)
+{
+  gint next = 0;
+
+  while (next < job->n_chunks && ! g_atomic_int_get (&job->cancel))
+    {
+      job->batch_next = next;
+      job->batch_last = MIN (next + job->n_graphs, job->n_chunks);
+
+      gimp_parallel_distribute (job->n_graphs,
+                                (GimpParallelDistributeFunc)
+                                gimp_drawable_transform_job_render,
+                                job);
+
+      next = job->batch_last;
+    }
+
+  return NULL;
+}
+
+static void
+gimp_drawable_transform_job_render (gint                      i,
+                                    gint                      n,
+                                    GimpDrawableTransformJob *job)
+{
+  GeglNode *graph = job->graphs[i];
+  gint      c;
+
+  while ((c = g_atomic_int_add (&job->batch_next, 1)) < job->batch_last)
+    {
+      const GeglRectangle *chunk = &job->chunks[c];
+
+      if (g_atomic_int_get (&job->cancel))
+        return;
+
+      gegl_node_blit (graph, 1.0, chunk, job->format,
+                      job->data +
+                      (chunk->y - job->rect.y) * job->stride +
+                      (chunk->x - job->rect.x) *
+                      babl_format_get_bytes_per_pixel (job->format),
+                      job->stride,
+                      GEGL_BLIT_DEFAULT);
+
+      g_mutex_lock (&job->mutex);
+
+      g_array_append_val (job->done, *chunk);
+
+      if (! job->idle_id)
+        {
+          job->idle_id =
+            g_idle_add_full (GIMP_PRIORITY_TRANSFORM_JOB_IDLE,
+                             (GSourceFunc) gimp_drawable_transform_job_idle,
+                             job, NULL);
+        }
+
+      g_mutex_unlock (&job->mutex);
+    }
+}
+
+static gboolean
+gimp_drawable_transform_job_idle (GimpDrawableTransformJob *job)
+{
+  GArray *done;
+
+  g_mutex_lock (&job->mutex);
+
+  done = job->done;
+
+  job->done    = g_array_new (FALSE, FALSE, sizeof (GeglRectangle));
+  job->idle_id = 0;
+
+  g_mutex_unlock (&job->mutex);
+
+  /*  'chunk_func' may cancel the job  */
+  job->chunk_func (job,
+                   (const GeglRectangle *) done->data, done->len,
+                   job->user_data);
+
+  g_array_free (done, TRUE);
+
+  return G_SOURCE_REMOVE;
+}
@@ -19,6 +19,12 @@
 #define __GIMP_DRAWABLE_TRANSFORM_H__
 
 
+typedef void (* GimpDrawableTransformJobFunc) (GimpDrawableTransformJob *job,
+                                               const GeglRectangle      *chunks,
+                                               gint                      n_chunks,
+                                               gpointer                  user_data);
+
+
 GeglBuffer  * gimp_drawable_transform_buffer_affine (GimpDrawable           *drawable,
                                                      GimpContext            *context,
                                                      GeglBuffer             *orig_buffer,
@@ -90,5 +96,20 @@ GimpDrawable * gimp_drawable_transform_paste        (GimpDrawable           *dra
                                                      gint                    offset_y,
                                                      gboolean                new_layer);
 
+GimpDrawableTransformJob *
+               gimp_drawable_transform_job_new      (GimpDrawable                 *drawable,
+                                                     const GeglRectangle          *bounds,
+                                                     const GimpMatrix3            *matrix,
+                                                     GimpInterpolationType         interpolation,
+                                                     const Babl                   *format,
+                                                     guchar                       *data,
+                                                     const GeglRectangle          *rect,
+                                                     gint                          stride,
+                                                     const GeglRectangle          *chunks,
+                                                     gint                          n_chunks,
+                                                     GimpDrawableTransformJobFunc  chunk_func,
+                                                     gpointer                      user_data);
+void           gimp_drawable_transform_job_cancel   (GimpDrawableTransformJob     *job);
+
 
 #endif  /*  __GIMP_DRAWABLE_TRANSFORM_H__  */
@@ -882,13 +882,10 @@ gimp_drawable_real_push_undo (GimpDrawable *drawable,
 {
   if (! buffer)
     {
-      buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0, width, height),
-                                gimp_drawable_get_format (drawable));
-
-      gegl_buffer_copy (gimp_drawable_get_buffer (drawable),
-                        GEGL_RECTANGLE (x, y, width, height), GEGL_ABYSS_NONE,
-                        buffer,
-                        GEGL_RECTANGLE (0, 0, 0, 0));
+      /*  share the unchanged tiles with the drawable  */
+      buffer = gimp_gegl_buffer_dup_rect (gimp_drawable_get_buffer (drawable),
+                                          GEGL_RECTANGLE (x, y,
+                                                          width, height));
     }
   else
     {
@@ -912,16 +909,17 @@ gimp_drawable_real_swap_pixels (GimpDrawable *drawable,
   gint        width  = gegl_buffer_get_width (buffer);
   gint        height = gegl_buffer_get_height (buffer);
 
-  tmp = gegl_buffer_dup (buffer);
+  tmp = gimp_gegl_buffer_dup_rect (gimp_drawable_get_buffer (drawable),
+                                   GEGL_RECTANGLE (x, y, width, height));
 
-  gegl_buffer_copy (gimp_drawable_get_buffer (drawable),
-                    GEGL_RECTANGLE (x, y, width, height), GEGL_ABYSS_NONE,
-                    buffer,
-                    GEGL_RECTANGLE (0, 0, 0, 0));
-  gegl_buffer_copy (tmp,
+  gegl_buffer_copy (buffer,
                     GEGL_RECTANGLE (0, 0, width, height), GEGL_ABYSS_NONE,
                     gimp_drawable_get_buffer (drawable),
                     GEGL_RECTANGLE (x, y, 0, 0));
+  gegl_buffer_copy (tmp,
+                    GEGL_RECTANGLE (0, 0, width, height), GEGL_ABYSS_NONE,
+                    buffer,
+                    GEGL_RECTANGLE (0, 0, 0, 0));
 
   g_object_unref (tmp);
 
@@ -25,6 +25,7 @@
 #include "core-types.h"
 
 #include "gimp-memsize.h"
+#include "gimp-undo-swap.h"
 #include "gimpimage.h"
 #include "gimpdrawable.h"
 #include "gimpdrawableundo.h"
@@ -152,6 +153,7 @@ gimp_drawable_undo_get_property (GObject    *object,
   switch (property_id)
     {
     case PROP_BUFFER:
+      gimp_drawable_undo_swap_in (drawable_undo, NULL);
       g_value_set_object (value, drawable_undo->buffer);
       break;
     case PROP_X:
@@ -189,6 +191,11 @@ gimp_drawable_undo_pop (GimpUndo            *undo,
 
   GIMP_UNDO_CLASS (parent_class)->pop (undo, undo_mode, accum);
 
+  /*  the image swaps the pixels in before popping the step, and
+   *  refuses to pop it if they can't be read back
+   */
+  g_return_if_fail (drawable_undo->buffer != NULL);
+
   gimp_drawable_swap_pixels (GIMP_DRAWABLE (GIMP_ITEM_UNDO (undo)->item),
                              drawable_undo->buffer,
                              drawable_undo->x,
@@ -207,6 +214,12 @@ gimp_drawable_undo_free (GimpUndo     *undo,
       drawable_undo->buffer = NULL;
     }
 
+  if (drawable_undo->swap_entry)
+    {
+      gimp_undo_swap_free (drawable_undo->swap_entry);
+      drawable_undo->swap_entry = NULL;
+    }
+
   if (drawable_undo->applied_buffer)
     {
       g_object_unref (drawable_undo->applied_buffer);
@@ -215,3 +228,57 @@ gimp_drawable_undo_free (GimpUndo     *undo,
 
   GIMP_UNDO_CLASS (parent_class)->free (undo, undo_mode);
 }
+
+
+/*  public functions  */
+
+/*  moves the pixels of 'undo' to the undo swap, where they don't take
+ *  any memory.  They are loaded back when the undo is popped.  Returns
+ *  TRUE if memory was freed.
+ */
+gboolean
+gimp_drawable_undo_swap_out (GimpDrawableUndo  *undo,
+                             GError           **error)
+{
+  g_return_val_if_fail (GIMP_IS_DRAWABLE_UNDO (undo), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  if (undo->buffer)
+    {
+      undo->swap_entry = gimp_undo_swap_store (undo->buffer, error);
+
+      if (undo->swap_entry)
+        {
+          g_object_unref (undo->buffer);
+          undo->buffer = NULL;
+
+          return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
+/*  loads the pixels of 'undo' back from the undo swap.  Returns FALSE
+ *  if they couldn't be read, in which case they stay in the swap.
+ */
+gboolean
+gimp_drawable_undo_swap_in (GimpDrawableUndo  *undo,
+                            GError           **error)
+{
+  g_return_val_if_fail (GIMP_IS_DRAWABLE_UNDO (undo), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  if (undo->swap_entry)
+    {
+      undo->buffer = gimp_undo_swap_load (undo->swap_entry, error);
+
+      if (! undo->buffer)
+        return FALSE;
+
+      gimp_undo_swap_free (undo->swap_entry);
+      undo->swap_entry = NULL;
+    }
+
+  return TRUE;
+}
@@ -37,9 +37,10 @@ struct _GimpDrawableUndo
 {
   GimpItemUndo  parent_instance;
 
-  GeglBuffer   *buffer;
-  gint          x;
-  gint          y;
+  GeglBuffer        *buffer;      /*  NULL while swapped out  */
+  GimpUndoSwapEntry *swap_entry;
+  gint               x;
+  gint               y;
 
   /* stuff for "Fade" */
   GeglBuffer           *applied_buffer;
@@ -53,7 +54,12 @@ struct _GimpDrawableUndoClass
 };
 
 
-GType   gimp_drawable_undo_get_type (void) G_GNUC_CONST;
+GType      gimp_drawable_undo_get_type (void) G_GNUC_CONST;
+
+gboolean   gimp_drawable_undo_swap_out (GimpDrawableUndo  *undo,
+                                        GError           **error);
+gboolean   gimp_drawable_undo_swap_in  (GimpDrawableUndo  *undo,
+                                        GError           **error);
 
 
 #endif /* __GIMP_DRAWABLE_UNDO_H__ */
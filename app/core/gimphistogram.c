@@ -31,9 +31,17 @@
 
 #include "gegl/gimp-babl.h"
 
+#include "gimp-parallel.h"
 #include "gimphistogram.h"
 
 
+/*  the smallest area worth to be split across threads  */
+#define HISTOGRAM_MIN_SUB_AREA   (64 * 64)
+
+/*  the most blocks whose values an incremental histogram keeps  */
+#define HISTOGRAM_MAX_N_BLOCKS   256
+
+
 enum
 {
   PROP_0,
@@ -44,12 +52,40 @@ enum
 
 struct _GimpHistogramPrivate
 {
-  gboolean gamma_correct;
-  gint     n_channels;
-  gint     n_bins;
-  gdouble *values;
+  gboolean       gamma_correct;
+  gint           n_channels;
+  gint           n_bins;
+  gdouble       *values;
+
+  /*  the values of the blocks of the area the histogram was calculated
+   *  from, when calculating incrementally
+   */
+  gboolean       incremental;
+  GeglBuffer    *buffer;
+  GeglRectangle  buffer_rect;
+  GeglBuffer    *mask;
+  GeglRectangle  mask_rect;
+  const Babl    *format;
+  gint           block_size;
+  gint           n_block_cols;
+  gint           n_block_rows;
+  gdouble       *block_values;
+  gboolean      *block_dirty;
 };
 
+typedef struct
+{
+  GimpHistogram       *histogram;
+  GeglBuffer          *buffer;
+  const GeglRectangle *buffer_rect;
+  GeglBuffer          *mask;
+  const GeglRectangle *mask_rect;
+  const Babl          *format;
+  GMutex               mutex;
+  gint                *blocks;
+  gint                 n_blocks;
+} CalculateContext;
+
 
 /*  local function prototypes  */
 
@@ -70,6 +106,24 @@ static void     gimp_histogram_alloc_values (GimpHistogram *histogram,
                                              gint           n_components,
                                              gint           n_bins);
 
+static void     gimp_histogram_alloc_blocks (GimpHistogram       *histogram,
+                                             CalculateContext    *context);
+static void     gimp_histogram_clear_blocks (GimpHistogram       *histogram);
+static void     gimp_histogram_update_blocks
+                                            (GimpHistogram       *histogram,
+                                             CalculateContext    *context);
+static void     gimp_histogram_calculate_blocks
+                                            (gint                 i,
+                                             gint                 n,
+                                             CalculateContext    *context);
+static void     gimp_histogram_calculate_sub_area
+                                            (const GeglRectangle *area,
+                                             CalculateContext    *context);
+static void     gimp_histogram_calculate_area
+                                            (CalculateContext    *context,
+                                             const GeglRectangle *area,
+                                             gdouble             *values);
+
 
 G_DEFINE_TYPE (GimpHistogram, gimp_histogram, GIMP_TYPE_OBJECT)
 
@@ -181,6 +235,13 @@ gimp_histogram_get_memsize (GimpObject *object,
     memsize += (histogram->priv->n_channels *
                 histogram->priv->n_bins * sizeof (gdouble));
 
+  if (histogram->priv->block_values)
+    memsize += (histogram->priv->n_block_cols *
+                histogram->priv->n_block_rows *
+                (histogram->priv->n_channels *
+                 histogram->priv->n_bins * sizeof (gdouble) +
+                 sizeof (gboolean)));
+
   return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
                                                                   gui_size);
 }
@@ -233,7 +294,7 @@ gimp_histogram_calculate (GimpHistogram       *histogram,
                           const GeglRectangle *mask_rect)
 {
   GimpHistogramPrivate *priv;
-  GeglBufferIterator   *iter;
+  CalculateContext      context;
   const Babl           *format;
   gint                  n_components;
   gint                  n_bins;
@@ -241,6 +302,8 @@ gimp_histogram_calculate (GimpHistogram       *histogram,
   g_return_if_fail (GIMP_IS_HISTOGRAM (histogram));
   g_return_if_fail (GEGL_IS_BUFFER (buffer));
   g_return_if_fail (buffer_rect != NULL);
+  g_return_if_fail (mask == NULL || GEGL_IS_BUFFER (mask));
+  g_return_if_fail (mask == NULL || mask_rect != NULL);
 
   priv = histogram->priv;
 
@@ -316,176 +379,117 @@ gimp_histogram_calculate (GimpHistogram       *histogram,
 
   g_object_freeze_notify (G_OBJECT (histogram));
 
-  gimp_histogram_alloc_values (histogram, n_components, n_bins);
-
-  iter = gegl_buffer_iterator_new (buffer, buffer_rect, 0, format,
-                                   GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
-
-  if (mask)
-    gegl_buffer_iterator_add (iter, mask, mask_rect, 0,
-                              babl_format ("Y float"),
-                              GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
-
-#define VALUE(c,i) (priv->values[(c) * priv->n_bins + \
-                                 (gint) (CLAMP ((i), 0.0, 1.0) * \
-                                         (priv->n_bins - 0.0001))])
-
-  while (gegl_buffer_iterator_next (iter))
+  context.histogram   = histogram;
+  context.buffer      = buffer;
+  context.buffer_rect = buffer_rect;
+  context.mask        = mask;
+  context.mask_rect   = mask_rect;
+  context.format      = format;
+
+  if (priv->block_values                                             &&
+      priv->values                                                   &&
+      priv->n_channels == n_components + 2                           &&
+      priv->n_bins     == n_bins                                     &&
+      priv->buffer     == buffer                                     &&
+      priv->mask       == mask                                       &&
+      priv->format     == format                                     &&
+      gegl_rectangle_equal (&priv->buffer_rect, buffer_rect)         &&
+      (! mask || gegl_rectangle_equal (&priv->mask_rect, mask_rect)))
     {
-      const gfloat *data   = iter->data[0];
-      gint          length = iter->length;
-      gfloat        max;
-      gfloat        luminance;
+      gimp_histogram_update_blocks (histogram, &context);
+    }
+  else
+    {
+      gimp_histogram_alloc_values (histogram, n_components, n_bins);
 
-      if (mask)
+      if (priv->incremental)
         {
-          const gfloat *mask_data = iter->data[1];
-
-          switch (n_components)
-            {
-            case 1:
-              while (length--)
-                {
-                  const gdouble masked = *mask_data;
-
-                  VALUE (0, data[0]) += masked;
-
-                  data += n_components;
-                  mask_data += 1;
-                }
-              break;
-
-            case 2:
-              while (length--)
-                {
-                  const gdouble masked = *mask_data;
-                  const gdouble weight = data[1];
-
-                  VALUE (0, data[0]) += weight * masked;
-                  VALUE (1, data[1]) += masked;
-
-                  data += n_components;
-                  mask_data += 1;
-                }
-              break;
-
-            case 3: /* calculate separate value values */
-              while (length--)
-                {
-                  const gdouble masked = *mask_data;
-
-                  VALUE (1, data[0]) += masked;
-                  VALUE (2, data[1]) += masked;
-                  VALUE (3, data[2]) += masked;
-
-                  max = MAX (data[0], data[1]);
-                  max = MAX (data[2], max);
-                  VALUE (0, max) += masked;
-
-                  luminance = GIMP_RGB_LUMINANCE (data[0], data[1], data[2]);
-                  VALUE (4, luminance) += masked;
-
-                  data += n_components;
-                  mask_data += 1;
-                }
-              break;
-
-            case 4: /* calculate separate value values */
-              while (length--)
-                {
-                  const gdouble masked = *mask_data;
-                  const gdouble weight = data[3];
-
-                  VALUE (1, data[0]) += weight * masked;
-                  VALUE (2, data[1]) += weight * masked;
-                  VALUE (3, data[2]) += weight * masked;
-                  VALUE (4, data[3]) += masked;
-
-                  max = MAX (data[0], data[1]);
-                  max = MAX (data[2], max);
-                  VALUE (0, max) += weight * masked;
-
-                  luminance = GIMP_RGB_LUMINANCE (data[0], data[1], data[2]);
-                  VALUE (5, luminance) += weight * masked;
-
-                  data += n_components;
-                  mask_data += 1;
-                }
-              break;
-            }
+          gimp_histogram_alloc_blocks (histogram, &context);
+          gimp_histogram_update_blocks (histogram, &context);
         }
-      else /* no mask */
+      else
         {
-          switch (n_components)
-            {
-            case 1:
-              while (length--)
-                {
-                  VALUE (0, data[0]) += 1.0;
+          g_mutex_init (&context.mutex);
 
-                  data += n_components;
-                }
-              break;
+          gimp_parallel_distribute_area (buffer_rect, HISTOGRAM_MIN_SUB_AREA,
+                                         (GimpParallelDistributeAreaFunc)
+                                         gimp_histogram_calculate_sub_area,
+                                         &context);
 
-            case 2:
-              while (length--)
-                {
-                  const gdouble weight = data[1];
-
-                  VALUE (0, data[0]) += weight;
-                  VALUE (1, data[1]) += 1.0;
+          g_mutex_clear (&context.mutex);
+        }
+    }
 
-                  data += n_components;
-                }
-              break;
+  g_object_notify (G_OBJECT (histogram), "values");
 
-            case 3: /* calculate separate value values */
-              while (length--)
-                {
-                  VALUE (1, data[0]) += 1.0;
-                  VALUE (2, data[1]) += 1.0;
-                  VALUE (3, data[2]) += 1.0;
+  g_object_thaw_notify (G_OBJECT (histogram));
+}
 
-                  max = MAX (data[0], data[1]);
-                  max = MAX (data[2], max);
-                  VALUE (0, max) += 1.0;
+/**
+ * gimp_histogram_set_incremental:
+ * @histogram:   a %GimpHistogram
+ * @incremental: whether to calculate @histogram incrementally
+ *
+ * Makes @histogram keep the values of blocks of the area it was
+ * calculated from, so that calculating it again from the same area
+ * only has to calculate the blocks which were invalidated using
+ * gimp_histogram_invalidate() since.
+ **/
+void
+gimp_histogram_set_incremental (GimpHistogram *histogram,
+                                gboolean       incremental)
+{
+  g_return_if_fail (GIMP_IS_HISTOGRAM (histogram));
 
-                  luminance = GIMP_RGB_LUMINANCE (data[0], data[1], data[2]);
-                  VALUE (4, luminance) += 1.0;
+  histogram->priv->incremental = incremental;
 
-                  data += n_components;
-                }
-              break;
+  if (! incremental)
+    gimp_histogram_clear_blocks (histogram);
+}
 
-            case 4: /* calculate separate value values */
-              while (length--)
-                {
-                  const gdouble weight = data[3];
+/**
+ * gimp_histogram_invalidate:
+ * @histogram: a %GimpHistogram
+ * @rect:      the changed area of the buffer, or %NULL
+ *
+ * Tells an incremental @histogram that @rect of the buffer it was
+ * calculated from changed, or, if @rect is %NULL, that it has to be
+ * calculated from scratch, for example because the mask changed.
+ **/
+void
+gimp_histogram_invalidate (GimpHistogram       *histogram,
+                           const GeglRectangle *rect)
+{
+  GimpHistogramPrivate *priv;
+  GeglRectangle         area;
+  gint                  col1, row1;
+  gint                  col2, row2;
+  gint                  col, row;
 
-                  VALUE (1, data[0]) += weight;
-                  VALUE (2, data[1]) += weight;
-                  VALUE (3, data[2]) += weight;
-                  VALUE (4, data[3]) += 1.0;
+  g_return_if_fail (GIMP_IS_HISTOGRAM (histogram));
 
-                  max = MAX (data[0], data[1]);
-                  max = MAX (data[2], max);
-                  VALUE (0, max) += weight;
+  priv = histogram->priv;
 
-                  luminance = GIMP_RGB_LUMINANCE (data[0], data[1], data[2]);
-                  VALUE (5, luminance) += weight;
+  if (! priv->block_values)
+    return;
 
-                  data += n_components;
-                }
-              break;
-            }
-        }
+  if (! rect)
+    {
+      gimp_histogram_clear_blocks (histogram);
+      return;
     }
 
-  g_object_notify (G_OBJECT (histogram), "values");
+  if (! gegl_rectangle_intersect (&area, rect, &priv->buffer_rect))
+    return;
 
-  g_object_thaw_notify (G_OBJECT (histogram));
+  col1 = (area.x - priv->buffer_rect.x) / priv->block_size;
+  row1 = (area.y - priv->buffer_rect.y) / priv->block_size;
+  col2 = (area.x + area.width  - 1 - priv->buffer_rect.x) / priv->block_size;
+  row2 = (area.y + area.height - 1 - priv->buffer_rect.y) / priv->block_size;
 
-#undef VALUE
+  for (row = row1; row <= row2; row++)
+    for (col = col1; col <= col2; col++)
+      priv->block_dirty[row * priv->n_block_cols + col] = TRUE;
 }
 
 void
@@ -493,6 +497,8 @@ gimp_histogram_clear_values (GimpHistogram *histogram)
 {
   g_return_if_fail (GIMP_IS_HISTOGRAM (histogram));
 
+  gimp_histogram_clear_blocks (histogram);
+
   if (histogram->priv->values)
     {
       g_free (histogram->priv->values);
@@ -981,3 +987,355 @@ gimp_histogram_alloc_values (GimpHistogram *histogram,
               priv->n_channels * priv->n_bins * sizeof (gdouble));
     }
 }
+
+static void
+gimp_histogram_alloc_blocks (GimpHistogram    *histogram,
+                             CalculateContext *context)
+{
+  GimpHistogramPrivate *priv = histogram->priv;
+  gint                  n_values;
+  gint                  i;
+
+  gimp_histogram_clear_blocks (histogram);
+
+  priv->buffer      = g_object_ref (context->buffer);
+  priv->buffer_rect = *context->buffer_rect;
+  priv->mask        = context->mask ? g_object_ref (context->mask) : NULL;
+  priv->mask_rect   = context->mask ? *context->mask_rect :
+                                      *GEGL_RECTANGLE (0, 0, 0, 0);
+  priv->format      = context->format;
+
+  priv->block_size = 256;
+
+  do
+    {
+      priv->n_block_cols = (priv->buffer_rect.width  + priv->block_size - 1) /
+                           priv->block_size;
+      priv->n_block_rows = (priv->buffer_rect.height + priv->block_size - 1) /
+                           priv->block_size;
+
+      if (priv->n_block_cols * priv->n_block_rows <= HISTOGRAM_MAX_N_BLOCKS)
+        break;
+
+      priv->block_size *= 2;
+    }
+  while (TRUE);
+
+  n_values = priv->n_channels * priv->n_bins;
+
+  priv->block_values = g_new0 (gdouble,
+                               priv->n_block_cols * priv->n_block_rows *
+                               n_values);
+  priv->block_dirty  = g_new (gboolean,
+                              priv->n_block_cols * priv->n_block_rows);
+
+  for (i = 0; i < priv->n_block_cols * priv->n_block_rows; i++)
+    priv->block_dirty[i] = TRUE;
+}
+
+static void
+gimp_histogram_clear_blocks (GimpHistogram *histogram)
+{
+  GimpHistogramPrivate *priv = histogram->priv;
+
+  g_clear_object (&priv->buffer);
+  g_clear_object (&priv->mask);
+
+  g_clear_pointer (&priv->block_values, g_free);
+  g_clear_pointer (&priv->block_dirty,  g_free);
+
+  priv->format       = NULL;
+  priv->n_block_cols = 0;
+  priv->n_block_rows = 0;
+}
+
+/*  subtracts the old values of the dirty blocks, calculates them again,
+ *  and adds them back
+ */
+static void
+gimp_histogram_update_blocks (GimpHistogram    *histogram,
+                              CalculateContext *context)
+{
+  GimpHistogramPrivate *priv     = histogram->priv;
+  gint                  n_values = priv->n_channels * priv->n_bins;
+  gint                  n_blocks = priv->n_block_cols * priv->n_block_rows;
+  gint                  i, j;
+
+  context->blocks   = g_new (gint, n_blocks);
+  context->n_blocks = 0;
+
+  for (i = 0; i < n_blocks; i++)
+    {
+      if (priv->block_dirty[i])
+        {
+          const gdouble *block = priv->block_values + i * n_values;
+
+          for (j = 0; j < n_values; j++)
+            priv->values[j] -= block[j];
+
+          context->blocks[context->n_blocks++] = i;
+
+          priv->block_dirty[i] = FALSE;
+        }
+    }
+
+  if (context->n_blocks > 0)
+    {
+      gimp_parallel_distribute (context->n_blocks,
+                                (GimpParallelDistributeFunc)
+                                gimp_histogram_calculate_blocks,
+                                context);
+
+      for (i = 0; i < context->n_blocks; i++)
+        {
+          const gdouble *block = priv->block_values +
+                                 context->blocks[i] * n_values;
+
+          for (j = 0; j < n_values; j++)
+            priv->values[j] += block[j];
+        }
+
+      /*  don't let rounding errors make emptied bins negative  */
+      for (j = 0; j < n_values; j++)
+        priv->values[j] = MAX (priv->values[j], 0.0);
+    }
+
+  g_free (context->blocks);
+}
+
+static void
+gimp_histogram_calculate_blocks (gint              i,
+                                 gint              n,
+                                 CalculateContext *context)
+{
+  GimpHistogramPrivate *priv     = context->histogram->priv;
+  gint                  n_values = priv->n_channels * priv->n_bins;
+
+  for (; i < context->n_blocks; i += n)
+    {
+      gint           block  = context->blocks[i];
+      gdouble       *values = priv->block_values + block * n_values;
+      GeglRectangle  area;
+
+      area.x      = priv->buffer_rect.x +
+                    (block % priv->n_block_cols) * priv->block_size;
+      area.y      = priv->buffer_rect.y +
+                    (block / priv->n_block_cols) * priv->block_size;
+      area.width  = MIN (priv->block_size,
+                         priv->buffer_rect.x + priv->buffer_rect.width  - area.x);
+      area.height = MIN (priv->block_size,
+                         priv->buffer_rect.y + priv->buffer_rect.height - area.y);
+
+      memset (values, 0, n_values * sizeof (gdouble));
+
+      gimp_histogram_calculate_area (context, &area, values);
+    }
+}
+
+static void
+gimp_histogram_calculate_sub_area (const GeglRectangle *area,
+                                   CalculateContext    *context)
+{
+  GimpHistogramPrivate *priv     = context->histogram->priv;
+  gint                  n_values = priv->n_channels * priv->n_bins;
+  gdouble              *values;
+  gint                  i;
+
+  values = g_new0 (gdouble, n_values);
+
+  gimp_histogram_calculate_area (context, area, values);
+
+  g_mutex_lock (&context->mutex);
+
+  for (i = 0; i < n_values; i++)
+    priv->values[i] += values[i];
+
+  g_mutex_unlock (&context->mutex);
+
+  g_free (values);
+}
+
+static void
+gimp_histogram_calculate_area (CalculateContext    *context,
+                               const GeglRectangle *area,
+                               gdouble             *values)
+{
+  GimpHistogramPrivate *priv         = context->histogram->priv;
+  gint                  n_components = priv->n_channels - 2;
+  gint                  n_bins       = priv->n_bins;
+  GeglBufferIterator   *iter;
+
+  iter = gegl_buffer_iterator_new (context->buffer, area, 0, context->format,
+                                   GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
+
+  if (context->mask)
+    {
+      gegl_buffer_iterator_add (iter, context->mask,
+                                GEGL_RECTANGLE (area->x -
+                                                context->buffer_rect->x +
+                                                context->mask_rect->x,
+                                                area->y -
+                                                context->buffer_rect->y +
+                                                context->mask_rect->y,
+                                                area->width, area->height),
+                                0, babl_format ("Y float"),
+                                GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
+    }
+
+#define VALUE(c,i) (values[(c) * n_bins + \
+                            (gint) (CLAMP ((i), 0.0, 1.0) * \
+                                    (n_bins - 0.0001))])
+
+  while (gegl_buffer_iterator_next (iter))
+    {
+      const gfloat *data   = iter->data[0];
+      gint          length = iter->length;
+      gfloat        max;
+      gfloat        luminance;
+
+      if (context->mask)
+        {
+          const gfloat *mask_data = iter->data[1];
+
+          switch (n_components)
+            {
+            case 1:
+              while (length--)
+                {
+                  const gdouble masked = *mask_data;
+
+                  VALUE (0, data[0]) += masked;
+
+                  data += n_components;
+                  mask_data += 1;
+                }
+              break;
+
+            case 2:
+              while (length--)
+                {
+                  const gdouble masked = *mask_data;
+                  const gdouble weight = data[1];
+
+                  VALUE (0, data[0]) += weight * masked;
+                  VALUE (1, data[1]) += masked;
+
+                  data += n_components;
+                  mask_data += 1;
+                }
+              break;
+
+            case 3: /* calculate separate value values */
+              while (length--)
+                {
+                  const gdouble masked = *mask_data;
+
+                  VALUE (1, data[0]) += masked;
+                  VALUE (2, data[1]) += masked;
+                  VALUE (3, data[2]) += masked;
+
+                  max = MAX (data[0], data[1]);
+                  max = MAX (data[2], max);
+                  VALUE (0, max) += masked;
+
+                  luminance = GIMP_RGB_LUMINANCE (data[0], data[1], data[2]);
+                  VALUE (4, luminance) += masked;
+
+                  data += n_components;
+                  mask_data += 1;
+                }
+              break;
+
+            case 4: /* calculate separate value values */
+              while (length--)
+                {
+                  const gdouble masked = *mask_data;
+                  const gdouble weight = data[3];
+
+                  VALUE (1, data[0]) += weight * masked;
+                  VALUE (2, data[1]) += weight * masked;
+                  VALUE (3, data[2]) += weight * masked;
+                  VALUE (4, data[3]) += masked;
+
+                  max = MAX (data[0], data[1]);
+                  max = MAX (data[2], max);
+                  VALUE (0, max) += weight * masked;
+
+                  luminance = GIMP_RGB_LUMINANCE (data[0], data[1], data[2]);
+                  VALUE (5, luminance) += weight * masked;
+
+                  data += n_components;
+                  mask_data += 1;
+                }
+              break;
+            }
+        }
+      else /* no mask */
+        {
+          switch (n_components)
+            {
+            case 1:
+              while (length--)
+                {
+                  VALUE (0, data[0]) += 1.0;
+
+                  data += n_components;
+                }
+              break;
+
+            case 2:
+              while (length--)
+                {
+                  const gdouble weight = data[1];
+
+                  VALUE (0, data[0]) += weight;
+                  VALUE (1, data[1]) += 1.0;
+
+                  data += n_components;
+                }
+              break;
+
+            case 3: /* calculate separate value values */
+              while (length--)
+                {
+                  VALUE (1, data[0]) += 1.0;
+                  VALUE (2, data[1]) += 1.0;
+                  VALUE (3, data[2]) += 1.0;
+
+                  max = MAX (data[0], data[1]);
+                  max = MAX (data[2], max);
+                  VALUE (0, max) += 1.0;
+
+                  luminance = GIMP_RGB_LUMINANCE (data[0], data[1], data[2]);
+                  VALUE (4, luminance) += 1.0;
+
+                  data += n_components;
+                }
+              break;
+
+            case 4: /* calculate separate value values */
+              while (length--)
+                {
+                  const gdouble weight = data[3];
+
+                  VALUE (1, data[0]) += weight;
+                  VALUE (2, data[1]) += weight;
+                  VALUE (3, data[2]) += weight;
+                  VALUE (4, data[3]) += 1.0;
+
+                  max = MAX (data[0], data[1]);
+                  max = MAX (data[2], max);
+                  VALUE (0, max) += weight;
+
+                  luminance = GIMP_RGB_LUMINANCE (data[0], data[1], data[2]);
+                  VALUE (5, luminance) += weight;
+
+                  data += n_components;
+                }
+              break;
+            }
+        }
+    }
+
+#undef VALUE
+}
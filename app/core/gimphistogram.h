@@ -60,6 +60,12 @@ void            gimp_histogram_calculate     (GimpHistogram        *histogram,
                                               GeglBuffer           *mask,
                                               const GeglRectangle  *mask_rect);
 
+void            gimp_histogram_set_incremental
+                                             (GimpHistogram        *histogram,
+                                              gboolean              incremental);
+void            gimp_histogram_invalidate    (GimpHistogram        *histogram,
+                                              const GeglRectangle  *rect);
+
 void            gimp_histogram_clear_values  (GimpHistogram        *histogram);
 
 gdouble         gimp_histogram_get_maximum   (GimpHistogram        *histogram,
@@ -146,6 +146,7 @@
 #include "gegl/gimp-gegl-utils.h"
 
 #include "gimp.h"
+#include "gimp-parallel.h"
 #include "gimpcontainer.h"
 #include "gimpdrawable.h"
 #include "gimperror.h"
@@ -466,6 +467,23 @@ struct _Color
   gint blue;
 };
 
+/*  A cell of the coarse RGB histogram of the k-d tree quantizer  */
+typedef struct
+{
+  guint64 count;
+  guint64 sum[3];
+} KdCell;
+
+/*  A node of the k-d tree over the colormap, -1 marks no child  */
+typedef struct
+{
+  gint color[3];
+  gint index;
+  gint axis;
+  gint left;
+  gint right;
+} KdNode;
+
 struct _QuantizeObj
 {
   Pass1Func     first_pass;       /* first pass over image data creates colormap  */
@@ -488,6 +506,10 @@ struct _QuantizeObj
   GimpProgress *progress;
   gint          nth_layer;
   gint          n_layers;
+
+  KdCell       *kd_histogram;             /* k-d tree quantizer histogram     */
+  KdNode       *kd_tree;                  /* k-d tree over the colormap       */
+  gint          kd_root;
 };
 
 typedef struct
@@ -537,6 +559,23 @@ static QuantizeObj * initialize_median_cut   (GimpImageBaseType      old_type,
                                               gboolean               dither_alpha,
                                               GimpProgress          *progress);
 
+static void          generate_histogram_kd_tree
+                                             (KdCell                *histogram,
+                                              GimpLayer             *layer,
+                                              gint                   col_limit,
+                                              gboolean               dither_alpha,
+                                              GimpProgress          *progress,
+                                              gint                   nth_layer,
+                                              gint                   n_layers);
+
+static QuantizeObj * initialize_kd_tree      (GimpImageBaseType      old_type,
+                                              gint                   max_colors,
+                                              GimpConvertDitherType  dither_type,
+                                              GimpConvertPaletteType palette_type,
+                                              GimpPalette           *custom_palette,
+                                              gboolean               dither_alpha,
+                                              GimpProgress          *progress);
+
 static void          compute_color_lin8      (QuantizeObj           *quantobj,
                                               CFHistogram            histogram,
                                               boxptr                 boxp,
@@ -752,6 +791,7 @@ gboolean
 gimp_image_convert_indexed (GimpImage               *image,
                             GimpConvertPaletteType   palette_type,
                             gint                     max_colors,
+                            GimpConvertQuantizer     quantizer,
                             gboolean                 remove_duplicates,
                             GimpConvertDitherType    dither_type,
                             gboolean                 dither_alpha,
@@ -835,16 +875,23 @@ gimp_image_convert_indexed (GimpImage               *image,
       dither_type = GIMP_NO_DITHER;
     }
 
-  quantobj = initialize_median_cut (old_type, max_colors, dither_type,
-                                    palette_type, custom_palette,
-                                    dither_alpha,
-                                    progress);
+  /*  the k-d tree quantizer only handles RGB input  */
+  if (quantizer == GIMP_CONVERT_QUANTIZER_KD_TREE && old_type == GIMP_RGB)
+    quantobj = initialize_kd_tree (old_type, max_colors, dither_type,
+                                   palette_type, custom_palette,
+                                   dither_alpha,
+                                   progress);
+  else
+    quantobj = initialize_median_cut (old_type, max_colors, dither_type,
+                                      palette_type, custom_palette,
+                                      dither_alpha,
+                                      progress);
 
   if (palette_type == GIMP_MAKE_PALETTE)
     {
       if (old_type == GIMP_GRAY)
         zero_histogram_gray (quantobj->histogram);
-      else
+      else if (! quantobj->kd_histogram)
         zero_histogram_rgb (quantobj->histogram);
 
       /* To begin, assume that there are fewer colors in the image
@@ -866,6 +913,15 @@ gimp_image_convert_indexed (GimpImage               *image,
               generate_histogram_gray (quantobj->histogram,
                                        layer, dither_alpha);
             }
+          else if (quantobj->kd_histogram)
+            {
+              /* Note: generate_histogram_kd_tree may set
+               * needs_quantize, just like generate_histogram_rgb.
+               */
+              generate_histogram_kd_tree (quantobj->kd_histogram,
+                                          layer, max_colors, dither_alpha,
+                                          progress, nth_layer, n_layers);
+            }
           else
             {
               /* Note: generate_histogram_rgb may set needs_quantize
@@ -4331,7 +4387,7 @@ initialize_median_cut (GimpImageBaseType       type,
   QuantizeObj *quantobj;
 
   /* Initialize the data structures */
-  quantobj = g_new (QuantizeObj, 1);
+  quantobj = g_new0 (QuantizeObj, 1);
 
   if (type == GIMP_GRAY && palette_type == GIMP_MAKE_PALETTE)
     quantobj->histogram = g_new (ColorFreq, 256);
@@ -4475,3 +4531,758 @@ initialize_median_cut (GimpImageBaseType       type,
 
   return quantobj;
 }
+
+
+/*
+ *  The k-d tree quantizer
+ *
+ *  The histogram is a coarse RGB histogram with 5 bits per channel,
+ *  where each cell accumulates the sum of the colors falling into it,
+ *  and is built in parallel.  The colormap is created by recursively
+ *  splitting the set of used cells, always splitting the box with the
+ *  largest (weighted) squared error along its axis of largest error,
+ *  at the point which minimizes the error of the two halves, and
+ *  taking the mean color of each box.
+ *
+ *  Non-dithered remapping looks up the nearest colormap entry in a
+ *  k-d tree over the colormap, in parallel, each thread keeping a
+ *  small cache of recently mapped colors.  Dithered remapping uses
+ *  the median-cut passes, which work with any colormap.
+ */
+
+#define KD_BITS         5
+#define KD_SHIFT        (BITS_IN_SAMPLE - KD_BITS)
+#define KD_N_CELLS      (1 << (3 * KD_BITS))
+#define KD_CELL(r,g,b)  ((((r) >> KD_SHIFT) << (2 * KD_BITS)) | \
+                         (((g) >> KD_SHIFT) << KD_BITS)       | \
+                         ((b) >> KD_SHIFT))
+
+#define KD_CACHE_SIZE   4096  /* must be a power of 2 */
+#define KD_MIN_SUB_AREA (64 * 64)
+
+
+typedef struct
+{
+  gint    start;
+  gint    n;
+  gdouble count;
+  gdouble sum[3];
+  gdouble error;
+  gint    axis;    /* -1 if the box can't be split */
+} KdBox;
+
+typedef struct
+{
+  GeglBuffer *buffer;
+  const Babl *format;
+  gboolean    has_alpha;
+  gboolean    dither_alpha;
+  gint        offset_x;
+  gint        offset_y;
+  gint        col_limit;
+  KdCell     *histogram;
+  GMutex      mutex;
+} KdHistogramData;
+
+typedef struct
+{
+  QuantizeObj *quantobj;
+  GeglBuffer  *src_buffer;
+  GeglBuffer  *dest_buffer;
+  gboolean     has_alpha;
+  gint         offset_x;
+  gint         offset_y;
+  GMutex       mutex;
+} KdRemapData;
+
+typedef struct
+{
+  guint32 key;    /* 0 if unused */
+  guchar  index;
+} KdCacheEntry;
+
+
+/*  weights of the red, green and blue differences in color distances  */
+static const gint kd_weights[3] = { 3, 4, 2 };
+
+
+static void
+generate_histogram_kd_tree_area (const GeglRectangle *area,
+                                 KdHistogramData     *data)
+{
+  GeglBufferIterator *iter;
+  KdCell             *histogram;
+  KdCell             *dest;
+  guchar              colors[MAXNUMCOLORS + 1][3];
+  gint                n_colors = 0;
+  gint                last     = 0;
+  gboolean            track    = ! g_atomic_int_get (&needs_quantize);
+  gint                bpp      = babl_format_get_bytes_per_pixel (data->format);
+  gint                i;
+
+  histogram = g_new0 (KdCell, KD_N_CELLS);
+
+  iter = gegl_buffer_iterator_new (data->buffer, area, 0, data->format,
+                                   GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
+
+  while (gegl_buffer_iterator_next (iter))
+    {
+      const guchar  *src = iter->data[0];
+      GeglRectangle *roi = &iter->roi[0];
+      gint           x, y;
+
+      for (y = 0; y < roi->height; y++)
+        {
+          /* if alpha-dithering, we need to be deterministic w.r.t. offsets */
+          gint row = roi->y + y + data->offset_y;
+
+          for (x = 0; x < roi->width; x++, src += bpp)
+            {
+              KdCell *cell;
+
+              if (data->has_alpha)
+                {
+                  gint col = roi->x + x + data->offset_x;
+
+                  if (data->dither_alpha ?
+                      src[ALPHA] < DM[col & DM_WIDTHMASK][row & DM_HEIGHTMASK] :
+                      src[ALPHA] <= 127)
+                    continue;
+                }
+
+              cell = &histogram[KD_CELL (src[RED], src[GREEN], src[BLUE])];
+
+              /*  the cells are too coarse to tell colors apart, so
+               *  remember the distinct colors separately, as long as
+               *  there are few enough of them to be used as is
+               */
+              if (track &&
+                  (! n_colors                      ||
+                   colors[last][0] != src[RED]     ||
+                   colors[last][1] != src[GREEN]   ||
+                   colors[last][2] != src[BLUE]))
+                {
+                  for (i = n_colors - 1; i >= 0; i--)
+                    {
+                      if (colors[i][0] == src[RED]   &&
+                          colors[i][1] == src[GREEN] &&
+                          colors[i][2] == src[BLUE])
+                        break;
+                    }
+
+                  if (i < 0)
+                    {
+                      i = n_colors++;
+
+                      colors[i][0] = src[RED];
+                      colors[i][1] = src[GREEN];
+                      colors[i][2] = src[BLUE];
+
+                      if (n_colors > data->col_limit)
+                        track = FALSE;
+                    }
+
+                  last = i;
+                }
+
+              cell->count++;
+              cell->sum[0] += src[RED];
+              cell->sum[1] += src[GREEN];
+              cell->sum[2] += src[BLUE];
+            }
+        }
+    }
+
+  g_mutex_lock (&data->mutex);
+
+  if (! track)
+    {
+      g_atomic_int_set (&needs_quantize, TRUE);
+    }
+  else
+    {
+      for (i = 0; ! needs_quantize && i < n_colors; i++)
+        {
+          gint j;
+
+          for (j = 0; j < num_found_cols; j++)
+            {
+              if (found_cols[j][0] == colors[i][0] &&
+                  found_cols[j][1] == colors[i][1] &&
+                  found_cols[j][2] == colors[i][2])
+                break;
+            }
+
+          if (j < num_found_cols)
+            continue;
+
+          if (num_found_cols == data->col_limit)
+            {
+              g_atomic_int_set (&needs_quantize, TRUE);
+            }
+          else
+            {
+              found_cols[num_found_cols][0] = colors[i][0];
+              found_cols[num_found_cols][1] = colors[i][1];
+              found_cols[num_found_cols][2] = colors[i][2];
+              num_found_cols++;
+            }
+        }
+    }
+
+  for (i = 0, dest = data->histogram; i < KD_N_CELLS; i++, dest++)
+    {
+      const KdCell *cell = &histogram[i];
+
+      if (! cell->count)
+        continue;
+
+      dest->count  += cell->count;
+      dest->sum[0] += cell->sum[0];
+      dest->sum[1] += cell->sum[1];
+      dest->sum[2] += cell->sum[2];
+    }
+
+  g_mutex_unlock (&data->mutex);
+
+  g_free (histogram);
+}
+
+/*  like generate_histogram_rgb, sets needs_quantize if the image
+ *  contains more than 'col_limit' colors, and otherwise collects them
+ *  in found_cols
+ */
+static void
+generate_histogram_kd_tree (KdCell       *histogram,
+                            GimpLayer    *layer,
+                            gint          col_limit,
+                            gboolean      dither_alpha,
+                            GimpProgress *progress,
+                            gint          nth_layer,
+                            gint          n_layers)
+{
+  KdHistogramData data;
+
+  data.format = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
+
+  g_return_if_fail (data.format == babl_format ("R'G'B' u8") ||
+                    data.format == babl_format ("R'G'B'A u8"));
+
+  data.buffer       = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
+  data.has_alpha    = babl_format_has_alpha (data.format);
+  data.dither_alpha = dither_alpha;
+  data.col_limit    = col_limit;
+  data.histogram    = histogram;
+
+  gimp_item_get_offset (GIMP_ITEM (layer), &data.offset_x, &data.offset_y);
+
+  g_mutex_init (&data.mutex);
+
+  gimp_parallel_distribute_area (gegl_buffer_get_extent (data.buffer),
+                                 KD_MIN_SUB_AREA,
+                                 (GimpParallelDistributeAreaFunc)
+                                 generate_histogram_kd_tree_area,
+                                 &data);
+
+  g_mutex_clear (&data.mutex);
+
+  if (progress)
+    gimp_progress_set_value (progress,
+                             (nth_layer + 1) / (gdouble) n_layers);
+}
+
+static gint
+kd_cell_compare (gconstpointer a,
+                 gconstpointer b,
+                 gpointer      user_data)
+{
+  const KdCell *cell1 = *(const KdCell **) a;
+  const KdCell *cell2 = *(const KdCell **) b;
+  gint          axis  = GPOINTER_TO_INT (user_data);
+  gdouble       v1    = (gdouble) cell1->sum[axis] / cell1->count;
+  gdouble       v2    = (gdouble) cell2->sum[axis] / cell2->count;
+
+  if (v1 < v2)
+    return -1;
+  else if (v1 > v2)
+    return 1;
+  else
+    return 0;
+}
+
+/*  the squared error of a set of cells along 'axis', given the number
+ *  of pixels, the sum of their values, and the sum of the squared means
+ *  of the cells, weighted by their number of pixels
+ */
+#define KD_ERROR(count,sum,sum_sq) ((sum_sq) - (sum) * (sum) / (count))
+
+static void
+kd_box_update (KdBox         *box,
+               KdCell *const *cells)
+{
+  gdouble sum_sq[3] = { 0.0, 0.0, 0.0 };
+  gdouble max_error = 0.0;
+  gint    i, c;
+
+  box->count  = 0.0;
+  box->sum[0] = box->sum[1] = box->sum[2] = 0.0;
+  box->error  = 0.0;
+  box->axis   = -1;
+
+  for (i = box->start; i < box->start + box->n; i++)
+    {
+      const KdCell *cell = cells[i];
+
+      box->count += cell->count;
+
+      for (c = 0; c < 3; c++)
+        {
+          box->sum[c] += cell->sum[c];
+          sum_sq[c]   += (gdouble) cell->sum[c] * cell->sum[c] / cell->count;
+        }
+    }
+
+  for (c = 0; c < 3; c++)
+    {
+      gdouble error = kd_weights[c] * KD_ERROR (box->count,
+                                                box->sum[c], sum_sq[c]);
+
+      box->error += MAX (error, 0.0);
+
+      if (box->n > 1 && error > max_error)
+        {
+          max_error = error;
+          box->axis = c;
+        }
+    }
+}
+
+static void
+kd_box_split (KdBox   *box,
+              KdBox   *new_box,
+              KdCell **cells)
+{
+  gint    axis        = box->axis;
+  gdouble count       = 0.0;
+  gdouble sum         = 0.0;
+  gdouble sum_sq      = 0.0;
+  gdouble left_sum_sq = 0.0;
+  gdouble min_error   = G_MAXDOUBLE;
+  gint    split       = 1;
+  gint    i;
+
+  g_qsort_with_data (cells + box->start, box->n, sizeof (KdCell *),
+                     kd_cell_compare, GINT_TO_POINTER (axis));
+
+  for (i = box->start; i < box->start + box->n; i++)
+    {
+      const KdCell *cell = cells[i];
+
+      sum_sq += (gdouble) cell->sum[axis] * cell->sum[axis] / cell->count;
+    }
+
+  /*  find the split minimizing the error of the two halves along the
+   *  axis, from the prefix sums of the sorted cells
+   */
+  for (i = 1; i < box->n; i++)
+    {
+      const KdCell *cell = cells[box->start + i - 1];
+      gdouble       error;
+
+      count       += cell->count;
+      sum         += cell->sum[axis];
+      left_sum_sq += (gdouble) cell->sum[axis] * cell->sum[axis] / cell->count;
+
+      error = KD_ERROR (count, sum, left_sum_sq) +
+              KD_ERROR (box->count - count,
+                        box->sum[axis] - sum,
+                        sum_sq - left_sum_sq);
+
+      if (error < min_error)
+        {
+          min_error = error;
+          split     = i;
+        }
+    }
+
+  new_box->start = box->start + split;
+  new_box->n     = box->n - split;
+  box->n         = split;
+
+  kd_box_update (box,     cells);
+  kd_box_update (new_box, cells);
+}
+
+static void
+kd_tree_pass1 (QuantizeObj *quantobj)
+{
+  KdCell  *histogram = quantobj->kd_histogram;
+  gint     desired   = quantobj->desired_number_of_colors;
+  KdCell **cells;
+  KdBox   *boxes;
+  gint     n_cells   = 0;
+  gint     n_boxes;
+  gint     i;
+
+  cells = g_new (KdCell *, KD_N_CELLS);
+
+  for (i = 0; i < KD_N_CELLS; i++)
+    {
+      if (histogram[i].count)
+        cells[n_cells++] = &histogram[i];
+    }
+
+  /*  a completely transparent image  */
+  if (! n_cells)
+    {
+      quantobj->actual_number_of_colors = 1;
+
+      quantobj->cmap[0].red   = 0;
+      quantobj->cmap[0].green = 0;
+      quantobj->cmap[0].blue  = 0;
+
+      g_free (cells);
+
+      return;
+    }
+
+  boxes = g_new (KdBox, desired);
+
+  boxes[0].start = 0;
+  boxes[0].n     = n_cells;
+  kd_box_update (&boxes[0], cells);
+
+  for (n_boxes = 1; n_boxes < desired; n_boxes++)
+    {
+      KdBox *biggest = NULL;
+
+      for (i = 0; i < n_boxes; i++)
+        {
+          if (boxes[i].axis >= 0 &&
+              (! biggest || boxes[i].error > biggest->error))
+            {
+              biggest = &boxes[i];
+            }
+        }
+
+      if (! biggest)
+        break;
+
+      kd_box_split (biggest, &boxes[n_boxes], cells);
+
+      if (quantobj->progress && (n_boxes % 16 == 0))
+        gimp_progress_set_value (quantobj->progress,
+                                 (gdouble) n_boxes / desired);
+    }
+
+  quantobj->actual_number_of_colors = n_boxes;
+
+  for (i = 0; i < n_boxes; i++)
+    {
+      quantobj->cmap[i].red   = RINT (boxes[i].sum[0] / boxes[i].count);
+      quantobj->cmap[i].green = RINT (boxes[i].sum[1] / boxes[i].count);
+      quantobj->cmap[i].blue  = RINT (boxes[i].sum[2] / boxes[i].count);
+    }
+
+  g_free (boxes);
+  g_free (cells);
+}
+
+static gint
+kd_node_compare (gconstpointer a,
+                 gconstpointer b,
+                 gpointer      user_data)
+{
+  const KdNode *node1 = a;
+  const KdNode *node2 = b;
+  gint          axis  = GPOINTER_TO_INT (user_data);
+
+  return node1->color[axis] - node2->color[axis];
+}
+
+/*  builds the tree over 'nodes[start .. start + n)' in place, and
+ *  returns its root
+ */
+static gint
+kd_tree_build (KdNode *nodes,
+               gint    start,
+               gint    n)
+{
+  gint min[3] = { 255, 255, 255 };
+  gint max[3] = { 0, 0, 0 };
+  gint axis   = 0;
+  gint mid;
+  gint i, c;
+
+  if (n <= 0)
+    return -1;
+
+  for (i = start; i < start + n; i++)
+    {
+      for (c = 0; c < 3; c++)
+        {
+          min[c] = MIN (min[c], nodes[i].color[c]);
+          max[c] = MAX (max[c], nodes[i].color[c]);
+        }
+    }
+
+  for (c = 1; c < 3; c++)
+    {
+      if (kd_weights[c] * SQR (max[c] - min[c]) >
+          kd_weights[axis] * SQR (max[axis] - min[axis]))
+        {
+          axis = c;
+        }
+    }
+
+  g_qsort_with_data (nodes + start, n, sizeof (KdNode),
+                     kd_node_compare, GINT_TO_POINTER (axis));
+
+  mid = start + n / 2;
+
+  nodes[mid].axis  = axis;
+  nodes[mid].left  = kd_tree_build (nodes, start, mid - start);
+  nodes[mid].right = kd_tree_build (nodes, mid + 1, start + n - mid - 1);
+
+  return mid;
+}
+
+static void
+kd_tree_find_nearest (const KdNode *nodes,
+                      gint          node,
+                      const gint   *color,
+                      gint         *best_index,
+                      gint         *best_dist)
+{
+  while (node >= 0)
+    {
+      const KdNode *kd_node = &nodes[node];
+      gint          diff    = color[kd_node->axis] - kd_node->color[kd_node->axis];
+      gint          dist;
+      gint          near;
+      gint          far;
+
+      dist = kd_weights[0] * SQR (color[0] - kd_node->color[0]) +
+             kd_weights[1] * SQR (color[1] - kd_node->color[1]) +
+             kd_weights[2] * SQR (color[2] - kd_node->color[2]);
+
+      if (dist < *best_dist)
+        {
+          *best_dist  = dist;
+          *best_index = kd_node->index;
+        }
+
+      if (diff < 0)
+        {
+          near = kd_node->left;
+          far  = kd_node->right;
+        }
+      else
+        {
+          near = kd_node->right;
+          far  = kd_node->left;
+        }
+
+      kd_tree_find_nearest (nodes, near, color, best_index, best_dist);
+
+      /*  only search the far side if it can hold a closer color  */
+      if (kd_weights[kd_node->axis] * SQR (diff) >= *best_dist)
+        break;
+
+      node = far;
+    }
+}
+
+static void
+kd_tree_pass2_init (QuantizeObj *quantobj)
+{
+  gint i;
+
+  /* Mark all indices as currently unused */
+  memset (quantobj->index_used_count, 0, 256 * sizeof (gulong));
+
+  g_free (quantobj->kd_tree);
+  quantobj->kd_tree = g_new (KdNode, quantobj->actual_number_of_colors);
+
+  for (i = 0; i < quantobj->actual_number_of_colors; i++)
+    {
+      quantobj->kd_tree[i].color[0] = quantobj->cmap[i].red;
+      quantobj->kd_tree[i].color[1] = quantobj->cmap[i].green;
+      quantobj->kd_tree[i].color[2] = quantobj->cmap[i].blue;
+      quantobj->kd_tree[i].index    = i;
+    }
+
+  quantobj->kd_root = kd_tree_build (quantobj->kd_tree, 0,
+                                     quantobj->actual_number_of_colors);
+}
+
+static void
+kd_tree_pass2_no_dither_area (const GeglRectangle *area,
+                              KdRemapData         *data)
+{
+  QuantizeObj        *quantobj = data->quantobj;
+  GeglBufferIterator *iter;
+  KdCacheEntry       *cache;
+  gulong              index_used_count[256] = { 0, };
+  gint                src_bpp;
+  gint                dest_bpp;
+  gint                i;
+
+  src_bpp  = babl_format_get_bytes_per_pixel (gegl_buffer_get_format (data->src_buffer));
+  dest_bpp = babl_format_get_bytes_per_pixel (gegl_buffer_get_format (data->dest_buffer));
+
+  cache = g_new0 (KdCacheEntry, KD_CACHE_SIZE);
+
+  iter = gegl_buffer_iterator_new (data->src_buffer, area, 0, NULL,
+                                   GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
+
+  gegl_buffer_iterator_add (iter, data->dest_buffer, area, 0, NULL,
+                            GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
+
+  while (gegl_buffer_iterator_next (iter))
+    {
+      const guchar  *src  = iter->data[0];
+      guchar        *dest = iter->data[1];
+      GeglRectangle *roi  = &iter->roi[0];
+      gint           x, y;
+
+      for (y = 0; y < roi->height; y++)
+        {
+          gint row = roi->y + y + data->offset_y;
+
+          for (x = 0; x < roi->width; x++, src += src_bpp, dest += dest_bpp)
+            {
+              KdCacheEntry *entry;
+              guint32       key;
+
+              if (data->has_alpha)
+                {
+                  gint     col = roi->x + x + data->offset_x;
+                  gboolean transparent;
+
+                  if (quantobj->want_dither_alpha)
+                    transparent = (src[ALPHA] <
+                                   DM[col & DM_WIDTHMASK][row & DM_HEIGHTMASK]);
+                  else
+                    transparent = (src[ALPHA] <= 127);
+
+                  if (transparent)
+                    {
+                      dest[ALPHA_I] = 0;
+                      continue;
+                    }
+
+                  dest[ALPHA_I] = 255;
+                }
+
+              key = (1 << 24) | (src[RED] << 16) | (src[GREEN] << 8) | src[BLUE];
+
+              entry = &cache[((key * 2654435761u) >> 20) & (KD_CACHE_SIZE - 1)];
+
+              if (entry->key != key)
+                {
+                  gint color[3];
+                  gint best_index = 0;
+                  gint best_dist  = G_MAXINT;
+
+                  color[0] = src[RED];
+                  color[1] = src[GREEN];
+                  color[2] = src[BLUE];
+
+                  kd_tree_find_nearest (quantobj->kd_tree, quantobj->kd_root,
+                                        color, &best_index, &best_dist);
+
+                  entry->key   = key;
+                  entry->index = best_index;
+                }
+
+              index_used_count[dest[INDEXED] = entry->index]++;
+            }
+        }
+    }
+
+  g_free (cache);
+
+  g_mutex_lock (&data->mutex);
+
+  for (i = 0; i < quantobj->actual_number_of_colors; i++)
+    quantobj->index_used_count[i] += index_used_count[i];
+
+  g_mutex_unlock (&data->mutex);
+}
+
+static void
+kd_tree_pass2_no_dither (QuantizeObj *quantobj,
+                         GimpLayer   *layer,
+                         GeglBuffer  *new_buffer)
+{
+  KdRemapData data;
+
+  data.quantobj    = quantobj;
+  data.src_buffer  = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
+  data.dest_buffer = new_buffer;
+  data.has_alpha   = gimp_drawable_has_alpha (GIMP_DRAWABLE (layer));
+
+  gimp_item_get_offset (GIMP_ITEM (layer), &data.offset_x, &data.offset_y);
+
+  g_mutex_init (&data.mutex);
+
+  gimp_parallel_distribute_area (gegl_buffer_get_extent (new_buffer),
+                                 KD_MIN_SUB_AREA,
+                                 (GimpParallelDistributeAreaFunc)
+                                 kd_tree_pass2_no_dither_area,
+                                 &data);
+
+  g_mutex_clear (&data.mutex);
+
+  if (quantobj->progress)
+    gimp_progress_set_value (quantobj->progress,
+                             (quantobj->nth_layer + 1) /
+                             (gdouble) quantobj->n_layers);
+}
+
+static void
+delete_kd_tree (QuantizeObj *quantobj)
+{
+  g_free (quantobj->kd_histogram);
+  g_free (quantobj->kd_tree);
+
+  delete_median_cut (quantobj);
+}
+
+static QuantizeObj *
+initialize_kd_tree (GimpImageBaseType       type,
+                    gint                    num_colors,
+                    GimpConvertDitherType   dither_type,
+                    GimpConvertPaletteType  palette_type,
+                    GimpPalette            *custom_palette,
+                    gboolean                want_dither_alpha,
+                    GimpProgress           *progress)
+{
+  QuantizeObj *quantobj;
+
+  g_return_val_if_fail (type == GIMP_RGB, NULL);
+
+  /*  start from the median-cut quantizer, whose dithering passes
+   *  we keep using
+   */
+  quantobj = initialize_median_cut (type, num_colors, dither_type,
+                                    palette_type, custom_palette,
+                                    want_dither_alpha, progress);
+
+  if (palette_type == GIMP_MAKE_PALETTE)
+    {
+      quantobj->kd_histogram = g_new0 (KdCell, KD_N_CELLS);
+      quantobj->first_pass   = kd_tree_pass1;
+    }
+
+  if (dither_type == GIMP_NO_DITHER)
+    {
+      quantobj->second_pass_init = kd_tree_pass2_init;
+      quantobj->second_pass      = kd_tree_pass2_no_dither;
+    }
+
+  quantobj->delete_func = delete_kd_tree;
+
+  return quantobj;
+}
@@ -25,6 +25,7 @@
 gboolean   gimp_image_convert_indexed      (GimpImage               *image,
                                             GimpConvertPaletteType   palette_type,
                                             gint                     max_colors,
+                                            GimpConvertQuantizer     quantizer,
                                             gboolean                 remove_duplicates,
                                             GimpConvertDitherType    dither_type,
                                             gboolean                 dither_alpha,
@@ -109,12 +109,18 @@ gimp_image_get_new_preview (GimpViewable *viewable,
   const Babl  *format;
   gboolean     linear;
   GimpTempBuf *buf;
+  GeglBuffer  *buffer;
   gdouble      scale_x;
   gdouble      scale_y;
+  gdouble      scale;
 
   scale_x = (gdouble) width  / (gdouble) gimp_image_get_width  (image);
   scale_y = (gdouble) height / (gdouble) gimp_image_get_height (image);
 
+  scale  = MIN (scale_x, scale_y);
+  buffer = gimp_projection_get_buffer_at_scale (gimp_image_get_projection (image),
+                                                &scale);
+
   format = gimp_projectable_get_format (GIMP_PROJECTABLE (image));
   linear = gimp_babl_format_get_linear (format);
 
@@ -125,9 +131,9 @@ gimp_image_get_new_preview (GimpViewable *viewable,
 
   buf = gimp_temp_buf_new (width, height, format);
 
-  gegl_buffer_get (gimp_pickable_get_buffer (GIMP_PICKABLE (image)),
+  gegl_buffer_get (buffer,
                    GEGL_RECTANGLE (0, 0, width, height),
-                   MIN (scale_x, scale_y),
+                   scale,
                    gimp_temp_buf_get_format (buf),
                    gimp_temp_buf_get_data (buf),
                    GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_CLAMP);
@@ -143,13 +149,19 @@ gimp_image_get_new_pixbuf (GimpViewable *viewable,
 {
   GimpImage          *image = GIMP_IMAGE (viewable);
   GdkPixbuf          *pixbuf;
+  GeglBuffer         *buffer;
   gdouble             scale_x;
   gdouble             scale_y;
+  gdouble             scale;
   GimpColorTransform *transform;
 
   scale_x = (gdouble) width  / (gdouble) gimp_image_get_width  (image);
   scale_y = (gdouble) height / (gdouble) gimp_image_get_height (image);
 
+  scale  = MIN (scale_x, scale_y);
+  buffer = gimp_projection_get_buffer_at_scale (gimp_image_get_projection (image),
+                                                &scale);
+
   pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8,
                            width, height);
 
@@ -164,9 +176,9 @@ gimp_image_get_new_pixbuf (GimpViewable *viewable,
       temp_buf = gimp_temp_buf_new (width, height,
                                     gimp_pickable_get_format (GIMP_PICKABLE (image)));
 
-      gegl_buffer_get (gimp_pickable_get_buffer (GIMP_PICKABLE (image)),
+      gegl_buffer_get (buffer,
                        GEGL_RECTANGLE (0, 0, width, height),
-                       MIN (scale_x, scale_y),
+                       scale,
                        gimp_temp_buf_get_format (temp_buf),
                        gimp_temp_buf_get_data (temp_buf),
                        GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_CLAMP);
@@ -188,9 +200,9 @@ gimp_image_get_new_pixbuf (GimpViewable *viewable,
     }
   else
     {
-      gegl_buffer_get (gimp_pickable_get_buffer (GIMP_PICKABLE (image)),
+      gegl_buffer_get (buffer,
                        GEGL_RECTANGLE (0, 0, width, height),
-                       MIN (scale_x, scale_y),
+                       scale,
                        gimp_pixbuf_get_format (pixbuf),
                        gdk_pixbuf_get_pixels (pixbuf),
                        gdk_pixbuf_get_rowstride (pixbuf),
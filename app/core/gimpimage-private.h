@@ -75,6 +75,7 @@ struct _GimpImagePrivate
   GFile             *untitled_file;         /*  a file saying "Untitled"     */
 
   gboolean           xcf_compat_mode;       /*  if possible, save compat XCF */
+  gboolean           xcf_fast_compression;  /*  save XCF with zstd           */
 
   gint               dirty;                 /*  dirty flag -- # of ops       */
   gint64             dirty_time;            /*  time when image became dirty */
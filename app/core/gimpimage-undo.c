@@ -35,13 +35,21 @@
 #include "gimpundostack.h"
 
 
+/*  the most recent undo steps are never moved to the undo swap  */
+#define MIN_HOT_UNDO_STEPS 2
+
+
 /*  local function prototypes  */
 
-static void          gimp_image_undo_pop_stack       (GimpImage     *image,
+static gboolean      gimp_image_undo_pop_stack       (GimpImage     *image,
                                                       GimpUndoStack *undo_stack,
                                                       GimpUndoStack *redo_stack,
                                                       GimpUndoMode   undo_mode);
 static void          gimp_image_undo_free_space      (GimpImage     *image);
+static gboolean      gimp_image_undo_swap_out        (GimpUndo      *undo,
+                                                      GError       **error);
+static gboolean      gimp_image_undo_swap_in         (GimpUndo      *undo,
+                                                      GError       **error);
 static void          gimp_image_undo_free_redo       (GimpImage     *image);
 
 static GimpDirtyMask gimp_image_undo_dirty_from_type (GimpUndoType   undo_type);
@@ -124,12 +132,10 @@ gimp_image_undo (GimpImage *image)
   g_return_val_if_fail (private->pushing_undo_group == GIMP_UNDO_GROUP_NONE,
                         FALSE);
 
-  gimp_image_undo_pop_stack (image,
-                             private->undo_stack,
-                             private->redo_stack,
-                             GIMP_UNDO_MODE_UNDO);
-
-  return TRUE;
+  return gimp_image_undo_pop_stack (image,
+                                    private->undo_stack,
+                                    private->redo_stack,
+                                    GIMP_UNDO_MODE_UNDO);
 }
 
 gboolean
@@ -144,12 +150,10 @@ gimp_image_redo (GimpImage *image)
   g_return_val_if_fail (private->pushing_undo_group == GIMP_UNDO_GROUP_NONE,
                         FALSE);
 
-  gimp_image_undo_pop_stack (image,
-                             private->redo_stack,
-                             private->undo_stack,
-                             GIMP_UNDO_MODE_REDO);
-
-  return TRUE;
+  return gimp_image_undo_pop_stack (image,
+                                    private->redo_stack,
+                                    private->undo_stack,
+                                    GIMP_UNDO_MODE_REDO);
 }
 
 /*
@@ -171,13 +175,14 @@ gimp_image_strong_undo (GimpImage *image)
 
   undo = gimp_undo_stack_peek (private->undo_stack);
 
-  gimp_image_undo (image);
+  if (! gimp_image_undo (image))
+    return FALSE;
 
   while (gimp_undo_is_weak (undo))
     {
       undo = gimp_undo_stack_peek (private->undo_stack);
-      if (gimp_undo_is_weak (undo))
-        gimp_image_undo (image);
+      if (gimp_undo_is_weak (undo) && ! gimp_image_undo (image))
+        break;
     }
 
   return TRUE;
@@ -204,13 +209,14 @@ gimp_image_strong_redo (GimpImage *image)
 
   undo = gimp_undo_stack_peek (private->redo_stack);
 
-  gimp_image_redo (image);
+  if (! gimp_image_redo (image))
+    return FALSE;
 
   while (gimp_undo_is_weak (undo))
     {
       undo = gimp_undo_stack_peek (private->redo_stack);
-      if (gimp_undo_is_weak (undo))
-        gimp_image_redo (image);
+      if (gimp_undo_is_weak (undo) && ! gimp_image_redo (image))
+        break;
     }
 
   return TRUE;
@@ -485,7 +491,7 @@ gimp_image_undo_get_fadeable (GimpImage *image)
 
 /*  private functions  */
 
-static void
+static gboolean
 gimp_image_undo_pop_stack (GimpImage     *image,
                            GimpUndoStack *undo_stack,
                            GimpUndoStack *redo_stack,
@@ -493,6 +499,21 @@ gimp_image_undo_pop_stack (GimpImage     *image,
 {
   GimpUndo            *undo;
   GimpUndoAccumulator  accum = { 0, };
+  GError              *error = NULL;
+
+  /*  read the pixels of a swapped out step back before touching the
+   *  image, so a step which can't be read is refused as a whole
+   */
+  undo = gimp_undo_stack_peek (undo_stack);
+
+  if (undo && ! gimp_image_undo_swap_in (undo, &error))
+    {
+      gimp_message_literal (image->gimp, NULL, GIMP_MESSAGE_ERROR,
+                            error->message);
+      g_clear_error (&error);
+
+      return FALSE;
+    }
 
   g_object_freeze_notify (G_OBJECT (image));
 
@@ -532,6 +553,8 @@ gimp_image_undo_pop_stack (GimpImage     *image,
     }
 
   g_object_thaw_notify (G_OBJECT (image));
+
+  return TRUE;
 }
 
 static void
@@ -555,6 +578,37 @@ gimp_image_undo_free_space (GimpImage *image)
               (glong) gimp_object_get_memsize (GIMP_OBJECT (container), NULL));
 #endif
 
+  /*  before throwing away any steps, move the pixels of the oldest
+   *  ones to the undo swap, starting with the oldest
+   */
+  if (gimp_object_get_memsize (GIMP_OBJECT (container), NULL) > undo_size)
+    {
+      GError *error = NULL;
+      gint    i;
+
+      for (i = gimp_container_get_n_children (container) - 1;
+           i >= MIN_HOT_UNDO_STEPS && ! error;
+           i--)
+        {
+          GimpUndo *undo;
+
+          undo = GIMP_UNDO (gimp_container_get_child_by_index (container, i));
+
+          if (gimp_image_undo_swap_out (undo, &error) &&
+              gimp_object_get_memsize (GIMP_OBJECT (container),
+                                       NULL) <= undo_size)
+            break;
+        }
+
+      /*  the steps which weren't swapped out are freed as usual  */
+      if (error)
+        {
+          gimp_message_literal (image->gimp, NULL, GIMP_MESSAGE_WARNING,
+                                error->message);
+          g_clear_error (&error);
+        }
+    }
+
   /*  keep at least min_undo_levels undo steps  */
   if (gimp_container_get_n_children (container) <= min_undo_levels)
     return;
@@ -581,6 +635,72 @@ gimp_image_undo_free_space (GimpImage *image)
     }
 }
 
+/*  moves the pixels of 'undo', or of the undos in it, to the undo
+ *  swap, and stops at the first error.  Returns TRUE if memory was
+ *  freed.
+ */
+static gboolean
+gimp_image_undo_swap_out (GimpUndo  *undo,
+                          GError   **error)
+{
+  if (GIMP_IS_UNDO_STACK (undo))
+    {
+      GimpContainer *undos    = GIMP_UNDO_STACK (undo)->undos;
+      gboolean       swapped  = FALSE;
+      GError        *my_error = NULL;
+      gint           i;
+
+      for (i = 0;
+           i < gimp_container_get_n_children (undos) && ! my_error;
+           i++)
+        {
+          GimpObject *child = gimp_container_get_child_by_index (undos, i);
+
+          if (gimp_image_undo_swap_out (GIMP_UNDO (child), &my_error))
+            swapped = TRUE;
+        }
+
+      if (my_error)
+        g_propagate_error (error, my_error);
+
+      return swapped;
+    }
+  else if (GIMP_IS_DRAWABLE_UNDO (undo))
+    {
+      return gimp_drawable_undo_swap_out (GIMP_DRAWABLE_UNDO (undo), error);
+    }
+
+  return FALSE;
+}
+
+/*  loads the pixels of 'undo', or of the undos in it, back from the
+ *  undo swap.  Returns FALSE if any of them couldn't be read.
+ */
+static gboolean
+gimp_image_undo_swap_in (GimpUndo  *undo,
+                         GError   **error)
+{
+  if (GIMP_IS_UNDO_STACK (undo))
+    {
+      GimpContainer *undos = GIMP_UNDO_STACK (undo)->undos;
+      gint           i;
+
+      for (i = 0; i < gimp_container_get_n_children (undos); i++)
+        {
+          GimpObject *child = gimp_container_get_child_by_index (undos, i);
+
+          if (! gimp_image_undo_swap_in (GIMP_UNDO (child), error))
+            return FALSE;
+        }
+    }
+  else if (GIMP_IS_DRAWABLE_UNDO (undo))
+    {
+      return gimp_drawable_undo_swap_in (GIMP_DRAWABLE_UNDO (undo), error);
+    }
+
+  return TRUE;
+}
+
 static void
 gimp_image_undo_free_redo (GimpImage *image)
 {
@@ -2377,9 +2377,10 @@ gimp_image_get_xcf_version (GimpImage    *image,
                             gint         *gimp_version,
                             const gchar **version_string)
 {
-  GList *layers;
-  GList *list;
-  gint   version = 0;  /* default to oldest */
+  GList  *layers;
+  GList  *list;
+  gint64  pixel_size;
+  gint    version = 0;  /* default to oldest */
 
   /* need version 1 for colormaps */
   if (gimp_image_get_colormap (image))
@@ -2429,6 +2430,29 @@ gimp_image_get_xcf_version (GimpImage    *image,
   if (zlib_compression)
     version = MAX (8, version);
 
+  /* need version 11 for zstd compression, which replaces zlib */
+  if (zlib_compression && gimp_image_get_xcf_fast_compression (image))
+    version = MAX (11, version);
+
+  /* need version 10 for 64-bit offsets, i.e. for files whose pixel
+   * data (which compressed tiles can slightly exceed) might not fit
+   * into 4 GB
+   */
+  pixel_size =
+    gimp_object_get_memsize (GIMP_OBJECT (gimp_image_get_layers (image)),
+                             NULL) +
+    gimp_object_get_memsize (GIMP_OBJECT (gimp_image_get_channels (image)),
+                             NULL) +
+    gimp_object_get_memsize (GIMP_OBJECT (gimp_image_get_mask (image)),
+                             NULL);
+
+  /* reduced levels add up to a third of the full-sized data */
+  if (image->gimp->config->xcf_reduced_levels)
+    pixel_size += pixel_size / 3;
+
+  if (pixel_size >= ((gint64) 1 << 32) * 15 / 16)
+    version = MAX (10, version);
+
   switch (version)
     {
     case 0:
@@ -2449,6 +2473,8 @@ gimp_image_get_xcf_version (GimpImage    *image,
     case 7:
     case 8:
     case 9:
+    case 10:
+    case 11:
       if (gimp_version)   *gimp_version   = 210;
       if (version_string) *version_string = "GIMP 2.10";
       break;
@@ -2474,6 +2500,23 @@ gimp_image_get_xcf_compat_mode (GimpImage *image)
   return GIMP_IMAGE_GET_PRIVATE (image)->xcf_compat_mode;
 }
 
+void
+gimp_image_set_xcf_fast_compression (GimpImage *image,
+                                     gboolean   fast_compression)
+{
+  g_return_if_fail (GIMP_IS_IMAGE (image));
+
+  GIMP_IMAGE_GET_PRIVATE (image)->xcf_fast_compression = fast_compression;
+}
+
+gboolean
+gimp_image_get_xcf_fast_compression (GimpImage *image)
+{
+  g_return_val_if_fail (GIMP_IS_IMAGE (image), FALSE);
+
+  return GIMP_IMAGE_GET_PRIVATE (image)->xcf_fast_compression;
+}
+
 void
 gimp_image_set_resolution (GimpImage *image,
                            gdouble    xresolution,
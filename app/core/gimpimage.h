@@ -175,6 +175,10 @@ void            gimp_image_set_xcf_compat_mode   (GimpImage          *image,
                                                   gboolean            compat_mode);
 gboolean        gimp_image_get_xcf_compat_mode   (GimpImage          *image);
 
+void            gimp_image_set_xcf_fast_compression (GimpImage *image,
+                                                     gboolean   fast_compression);
+gboolean        gimp_image_get_xcf_fast_compression (GimpImage *image);
+
 void            gimp_image_set_resolution        (GimpImage          *image,
                                                   gdouble             xres,
                                                   gdouble             yres);
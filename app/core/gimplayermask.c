@@ -28,6 +28,7 @@
 #include "core-types.h"
 
 #include "gegl/gimp-babl.h"
+#include "gegl/gimp-gegl-mask.h"
 
 #include "gimperror.h"
 #include "gimpimage.h"
@@ -210,6 +211,8 @@ gimp_layer_mask_new (GimpImage     *image,
   GIMP_CHANNEL (layer_mask)->x2 = width;
   GIMP_CHANNEL (layer_mask)->y2 = height;
 
+  gimp_gegl_mask_track_tiles (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer_mask)));
+
   return layer_mask;
 }
 
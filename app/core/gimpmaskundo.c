@@ -22,6 +22,7 @@
 
 #include "core-types.h"
 
+#include "gegl/gimp-gegl-mask.h"
 #include "gegl/gimp-gegl-utils.h"
 
 #include "gimp-memsize.h"
@@ -242,6 +243,11 @@ gimp_mask_undo_pop (GimpUndo            *undo,
       g_object_unref (mask_undo->buffer);
     }
 
+  /*  copying doesn't reliably emit "changed", so the tracked tile
+   *  states have to be forgotten explicitly
+   */
+  gimp_gegl_mask_invalidate (gimp_drawable_get_buffer (drawable), NULL);
+
   /* invalidate the current bounds and boundary of the mask */
   gimp_drawable_invalidate_boundary (drawable);
 
@@ -18,6 +18,7 @@
 #include "config.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include <cairo.h>
 #include <gegl.h>
@@ -30,11 +31,90 @@
 
 #include "gegl/gimp-babl.h"
 
+#include "gimp-parallel.h"
 #include "gimp-utils.h" /* GIMP_TIMER */
 #include "gimppickable.h"
 #include "gimppickable-contiguous-region.h"
 
 
+/*  the contiguous region is filled in blocks of this size, each of
+ *  which is only ever processed by one thread at a time.  It's a
+ *  multiple of GEGL's default tile size, so blocks don't share tiles.
+ */
+#define REGION_TILE_SIZE  128
+
+/*  the smallest area worth to be split across threads  */
+#define REGION_MIN_SUB_AREA  (64 * 64)
+
+
+/*  a horizontal run of pixels, from 'start' to 'end' inclusive, which
+ *  are neighbors of selected pixels and have to be checked
+ */
+typedef struct
+{
+  gint y;
+  gint start;
+  gint end;
+} Segment;
+
+typedef struct
+{
+  GArray   *segments;  /*  segments entering the tile, to be processed  */
+  gboolean  queued;
+  gboolean  busy;
+} RegionTile;
+
+typedef struct
+{
+  GeglBuffer          *src_buffer;
+  GeglBuffer          *mask_buffer;
+  const Babl          *format;
+  gint                 n_components;
+  gboolean             has_alpha;
+  gboolean             select_transparent;
+  GimpSelectCriterion  select_criterion;
+  gboolean             antialias;
+  gfloat               threshold;
+  gboolean             diagonal_neighbors;
+  const gfloat        *col;
+
+  GeglRectangle        extent;
+  gint                 n_tile_cols;
+  gint                 n_tile_rows;
+  RegionTile          *tiles;
+
+  GMutex               mutex;
+  GCond                cond;
+  GArray              *ready;  /*  indices of the tiles to be processed  */
+  gint                 n_busy;
+} Region;
+
+/*  the per-thread state, reused for all the tiles a thread processes  */
+typedef struct
+{
+  GeglRectangle  rect;
+  gfloat        *src;
+  gfloat        *mask;
+  guchar        *rejected;
+  GArray        *stack;     /*  segments in the current tile  */
+  GArray        *outgoing;  /*  segments in other tiles       */
+} RegionWorker;
+
+typedef struct
+{
+  GeglBuffer          *src_buffer;
+  GeglBuffer          *mask_buffer;
+  const Babl          *format;
+  gint                 n_components;
+  gboolean             has_alpha;
+  gboolean             select_transparent;
+  GimpSelectCriterion  select_criterion;
+  gboolean             antialias;
+  gfloat               threshold;
+  const gfloat        *col;
+} ByColorData;
+
+
 /*  local function prototypes  */
 
 static const Babl * choose_format         (GeglBuffer          *buffer,
@@ -49,36 +129,6 @@ static gfloat   pixel_difference          (const gfloat        *col1,
                                            gboolean             has_alpha,
                                            gboolean             select_transparent,
                                            GimpSelectCriterion  select_criterion);
-static void     push_segment              (GQueue              *segment_queue,
-                                           gint                 y,
-                                           gint                 old_y,
-                                           gint                 start,
-                                           gint                 end,
-                                           gint                 new_y,
-                                           gint                 new_start,
-                                           gint                 new_end);
-static void     pop_segment               (GQueue              *segment_queue,
-                                           gint                *y,
-                                           gint                *old_y,
-                                           gint                *start,
-                                           gint                *end);
-static gboolean find_contiguous_segment   (const gfloat        *col,
-                                           GeglBuffer          *src_buffer,
-                                           GeglBuffer          *mask_buffer,
-                                           const Babl          *src_format,
-                                           const Babl          *mask_format,
-                                           gint                 n_components,
-                                           gboolean             has_alpha,
-                                           gint                 width,
-                                           gboolean             select_transparent,
-                                           GimpSelectCriterion  select_criterion,
-                                           gboolean             antialias,
-                                           gfloat               threshold,
-                                           gint                 initial_x,
-                                           gint                 initial_y,
-                                           gint                *start,
-                                           gint                *end,
-                                           gfloat              *row);
 static void     find_contiguous_region    (GeglBuffer          *src_buffer,
                                            GeglBuffer          *mask_buffer,
                                            const Babl          *format,
@@ -93,6 +143,28 @@ static void     find_contiguous_region    (GeglBuffer          *src_buffer,
                                            gint                 y,
                                            const gfloat        *col);
 
+static inline gint region_tile_at         (const Region        *region,
+                                           gint                 x,
+                                           gint                 y);
+static void     region_worker_run         (gint                 i,
+                                           gint                 n,
+                                           Region              *region);
+static void     region_worker_push        (const Region        *region,
+                                           RegionWorker        *worker,
+                                           gint                 y,
+                                           gint                 start,
+                                           gint                 end);
+static inline gboolean
+                region_worker_select      (const Region        *region,
+                                           RegionWorker        *worker,
+                                           gint                 index);
+static void     region_worker_fill_tile   (const Region        *region,
+                                           RegionWorker        *worker,
+                                           gint                 tile);
+static void     contiguous_region_by_color_area
+                                          (const GeglRectangle *area,
+                                           ByColorData         *data);
+
 
 /*  public functions  */
 
@@ -177,13 +249,13 @@ gimp_pickable_contiguous_region_by_color (GimpPickable        *pickable,
    *  fuzzy_select.  Modify the pickable's mask to reflect the
    *  additional selection
    */
-  GeglBufferIterator *iter;
-  GeglBuffer         *src_buffer;
-  GeglBuffer         *mask_buffer;
-  const Babl         *format;
-  gint                n_components;
-  gboolean            has_alpha;
-  gfloat              start_col[MAX_CHANNELS];
+  GeglBuffer  *src_buffer;
+  GeglBuffer  *mask_buffer;
+  const Babl  *format;
+  gint         n_components;
+  gboolean     has_alpha;
+  gfloat       start_col[MAX_CHANNELS];
+  ByColorData  data;
 
   g_return_val_if_fail (GIMP_IS_PICKABLE (pickable), NULL);
   g_return_val_if_fail (color != NULL, NULL);
@@ -215,12 +287,41 @@ gimp_pickable_contiguous_region_by_color (GimpPickable        *pickable,
   mask_buffer = gegl_buffer_new (gegl_buffer_get_extent (src_buffer),
                                  babl_format ("Y float"));
 
-  iter = gegl_buffer_iterator_new (src_buffer,
-                                   NULL, 0, format,
+  data.src_buffer         = src_buffer;
+  data.mask_buffer        = mask_buffer;
+  data.format             = format;
+  data.n_components       = n_components;
+  data.has_alpha          = has_alpha;
+  data.select_transparent = select_transparent;
+  data.select_criterion   = select_criterion;
+  data.antialias          = antialias;
+  data.threshold          = threshold;
+  data.col                = start_col;
+
+  gimp_parallel_distribute_area (gegl_buffer_get_extent (src_buffer),
+                                 REGION_MIN_SUB_AREA,
+                                 (GimpParallelDistributeAreaFunc)
+                                 contiguous_region_by_color_area,
+                                 &data);
+
+  return mask_buffer;
+}
+
+
+/*  private functions  */
+
+static void
+contiguous_region_by_color_area (const GeglRectangle *area,
+                                 ByColorData         *data)
+{
+  GeglBufferIterator *iter;
+
+  iter = gegl_buffer_iterator_new (data->src_buffer,
+                                   area, 0, data->format,
                                    GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
 
-  gegl_buffer_iterator_add (iter, mask_buffer,
-                            NULL, 0, babl_format ("Y float"),
+  gegl_buffer_iterator_add (iter, data->mask_buffer,
+                            area, 0, babl_format ("Y float"),
                             GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
 
   while (gegl_buffer_iterator_next (iter))
@@ -232,25 +333,20 @@ gimp_pickable_contiguous_region_by_color (GimpPickable        *pickable,
       while (count--)
         {
           /*  Find how closely the colors match  */
-          *dest = pixel_difference (start_col, src,
-                                    antialias,
-                                    threshold,
-                                    n_components,
-                                    has_alpha,
-                                    select_transparent,
-                                    select_criterion);
-
-          src  += n_components;
+          *dest = pixel_difference (data->col, src,
+                                    data->antialias,
+                                    data->threshold,
+                                    data->n_components,
+                                    data->has_alpha,
+                                    data->select_transparent,
+                                    data->select_criterion);
+
+          src  += data->n_components;
           dest += 1;
         }
     }
-
-  return mask_buffer;
 }
 
-
-/*  private functions  */
-
 static const Babl *
 choose_format (GeglBuffer          *buffer,
                GimpSelectCriterion  select_criterion,
@@ -386,280 +482,344 @@ pixel_difference (const gfloat        *col1,
 }
 
 static void
-push_segment (GQueue *segment_queue,
-              gint    y,
-              gint    old_y,
-              gint    start,
-              gint    end,
-              gint    new_y,
-              gint    new_start,
-              gint    new_end)
+find_contiguous_region (GeglBuffer          *src_buffer,
+                        GeglBuffer          *mask_buffer,
+                        const Babl          *format,
+                        gint                 n_components,
+                        gboolean             has_alpha,
+                        gboolean             select_transparent,
+                        GimpSelectCriterion  select_criterion,
+                        gboolean             antialias,
+                        gfloat               threshold,
+                        gboolean             diagonal_neighbors,
+                        gint                 x,
+                        gint                 y,
+                        const gfloat        *col)
 {
-  /* To avoid excessive memory allocation (y, old_y, start, end) tuples are
-   * stored in interleaved format:
-   *
-   * [y1] [old_y1] [start1] [end1] [y2] [old_y2] [start2] [end2]
-   */
-
-  if (new_y != old_y)
+  Region  region;
+  Segment segment;
+  gint    n_tiles;
+  gint    tile;
+  gint    i;
+
+  region.src_buffer         = src_buffer;
+  region.mask_buffer        = mask_buffer;
+  region.format             = format;
+  region.n_components       = n_components;
+  region.has_alpha          = has_alpha;
+  region.select_transparent = select_transparent;
+  region.select_criterion   = select_criterion;
+  region.antialias          = antialias;
+  region.threshold          = threshold;
+  region.diagonal_neighbors = diagonal_neighbors;
+  region.col                = col;
+
+  region.extent      = *gegl_buffer_get_extent (src_buffer);
+  region.n_tile_cols = (region.extent.width  + REGION_TILE_SIZE - 1) /
+                       REGION_TILE_SIZE;
+  region.n_tile_rows = (region.extent.height + REGION_TILE_SIZE - 1) /
+                       REGION_TILE_SIZE;
+
+  n_tiles = region.n_tile_cols * region.n_tile_rows;
+
+  region.tiles  = g_new0 (RegionTile, n_tiles);
+  region.ready  = g_array_new (FALSE, FALSE, sizeof (gint));
+  region.n_busy = 0;
+
+  g_mutex_init (&region.mutex);
+  g_cond_init (&region.cond);
+
+  /*  seed the region with the start pixel  */
+  segment.y     = y;
+  segment.start = x;
+  segment.end   = x;
+
+  tile = region_tile_at (&region, x, y);
+
+  region.tiles[tile].segments = g_array_new (FALSE, FALSE, sizeof (Segment));
+  region.tiles[tile].queued   = TRUE;
+
+  g_array_append_val (region.tiles[tile].segments, segment);
+  g_array_append_val (region.ready, tile);
+
+  gimp_parallel_distribute (n_tiles,
+                            (GimpParallelDistributeFunc) region_worker_run,
+                            &region);
+
+  g_cond_clear (&region.cond);
+  g_mutex_clear (&region.mutex);
+
+  for (i = 0; i < n_tiles; i++)
     {
-      /* If the new segment's y-coordinate is different than the old (source)
-       * segment's y-coordinate, push the entire segment.
-       */
-      g_queue_push_tail (segment_queue, GINT_TO_POINTER (new_y));
-      g_queue_push_tail (segment_queue, GINT_TO_POINTER (y));
-      g_queue_push_tail (segment_queue, GINT_TO_POINTER (new_start));
-      g_queue_push_tail (segment_queue, GINT_TO_POINTER (new_end));
+      if (region.tiles[i].segments)
+        g_array_free (region.tiles[i].segments, TRUE);
     }
-  else
+
+  g_array_free (region.ready, TRUE);
+  g_free (region.tiles);
+}
+
+static inline gint
+region_tile_at (const Region *region,
+                gint          x,
+                gint          y)
+{
+  return ((y - region->extent.y) / REGION_TILE_SIZE) * region->n_tile_cols +
+         ((x - region->extent.x) / REGION_TILE_SIZE);
+}
+
+/*  takes tiles with pending segments, fills the region inside them,
+ *  and hands the segments leaving them to their neighbor tiles, until
+ *  no tile has pending segments and no other thread is busy.
+ */
+static void
+region_worker_run (gint    i,
+                   gint    n,
+                   Region *region)
+{
+  RegionWorker worker;
+
+  worker.src      = g_new (gfloat, REGION_TILE_SIZE * REGION_TILE_SIZE *
+                                   region->n_components);
+  worker.mask     = g_new (gfloat, REGION_TILE_SIZE * REGION_TILE_SIZE);
+  worker.rejected = g_new (guchar, REGION_TILE_SIZE * REGION_TILE_SIZE);
+  worker.stack    = g_array_new (FALSE, FALSE, sizeof (Segment));
+  worker.outgoing = g_array_new (FALSE, FALSE, sizeof (Segment));
+
+  g_mutex_lock (&region->mutex);
+
+  while (TRUE)
     {
-      /* Otherwise, only push the set-difference between the new segment and
-       * the source segment (since we've already scanned the source segment.)
-       * Note that the `+ 1` and `- 1` terms of the end/start coordinates below
-       * are only necessary when `diagonal_neighbors` is on (and otherwise make
-       * the segments slightly larger than necessary), but, meh...
-       */
-      if (new_start < start)
+      RegionTile *tile;
+      gint        index;
+      gint        j;
+
+      while (region->ready->len == 0 && region->n_busy > 0)
+        g_cond_wait (&region->cond, &region->mutex);
+
+      if (region->ready->len == 0)
+        break;
+
+      index = g_array_index (region->ready, gint, region->ready->len - 1);
+      g_array_set_size (region->ready, region->ready->len - 1);
+
+      tile = &region->tiles[index];
+
+      tile->queued = FALSE;
+      tile->busy   = TRUE;
+      region->n_busy++;
+
+      g_array_append_vals (worker.stack,
+                           tile->segments->data, tile->segments->len);
+      g_array_set_size (tile->segments, 0);
+
+      g_mutex_unlock (&region->mutex);
+
+      region_worker_fill_tile (region, &worker, index);
+
+      g_mutex_lock (&region->mutex);
+
+      for (j = 0; j < worker.outgoing->len; j++)
         {
-          g_queue_push_tail (segment_queue, GINT_TO_POINTER (new_y));
-          g_queue_push_tail (segment_queue, GINT_TO_POINTER (y));
-          g_queue_push_tail (segment_queue, GINT_TO_POINTER (new_start));
-          g_queue_push_tail (segment_queue, GINT_TO_POINTER (start + 1));
+          const Segment *segment = &g_array_index (worker.outgoing, Segment, j);
+          gint           target  = region_tile_at (region,
+                                                   segment->start, segment->y);
+          RegionTile    *neighbor = &region->tiles[target];
+
+          if (! neighbor->segments)
+            neighbor->segments = g_array_new (FALSE, FALSE, sizeof (Segment));
+
+          g_array_append_val (neighbor->segments, *segment);
+
+          if (! neighbor->queued && ! neighbor->busy)
+            {
+              neighbor->queued = TRUE;
+              g_array_append_val (region->ready, target);
+            }
         }
 
-      if (new_end > end)
+      g_array_set_size (worker.outgoing, 0);
+
+      tile->busy = FALSE;
+      region->n_busy--;
+
+      /*  segments which entered the tile while we were busy with it  */
+      if (tile->segments->len > 0 && ! tile->queued)
         {
-          g_queue_push_tail (segment_queue, GINT_TO_POINTER (new_y));
-          g_queue_push_tail (segment_queue, GINT_TO_POINTER (y));
-          g_queue_push_tail (segment_queue, GINT_TO_POINTER (end - 1));
-          g_queue_push_tail (segment_queue, GINT_TO_POINTER (new_end));
+          tile->queued = TRUE;
+          g_array_append_val (region->ready, index);
         }
+
+      g_cond_broadcast (&region->cond);
     }
-}
 
-static void
-pop_segment (GQueue *segment_queue,
-             gint   *y,
-             gint   *old_y,
-             gint   *start,
-             gint   *end)
-{
-  *y     = GPOINTER_TO_INT (g_queue_pop_head (segment_queue));
-  *old_y = GPOINTER_TO_INT (g_queue_pop_head (segment_queue));
-  *start = GPOINTER_TO_INT (g_queue_pop_head (segment_queue));
-  *end   = GPOINTER_TO_INT (g_queue_pop_head (segment_queue));
+  g_mutex_unlock (&region->mutex);
+
+  g_array_free (worker.outgoing, TRUE);
+  g_array_free (worker.stack, TRUE);
+  g_free (worker.rejected);
+  g_free (worker.mask);
+  g_free (worker.src);
 }
 
-/* #define FETCH_ROW 1 */
-
-static gboolean
-find_contiguous_segment (const gfloat        *col,
-                         GeglBuffer          *src_buffer,
-                         GeglBuffer          *mask_buffer,
-                         const Babl          *src_format,
-                         const Babl          *mask_format,
-                         gint                 n_components,
-                         gboolean             has_alpha,
-                         gint                 width,
-                         gboolean             select_transparent,
-                         GimpSelectCriterion  select_criterion,
-                         gboolean             antialias,
-                         gfloat               threshold,
-                         gint                 initial_x,
-                         gint                 initial_y,
-                         gint                *start,
-                         gint                *end,
-                         gfloat              *row)
+/*  pushes the segment from 'start' to 'end' of row 'y', split along the
+ *  tile columns, either onto the stack of the current tile, or to the
+ *  outgoing segments for the other tiles
+ */
+static void
+region_worker_push (const Region *region,
+                    RegionWorker *worker,
+                    gint          y,
+                    gint          start,
+                    gint          end)
 {
-  gfloat *s;
-  gfloat  mask_row[width];
-  gfloat  diff;
-
-#ifdef FETCH_ROW
-  gegl_buffer_get (src_buffer, GEGL_RECTANGLE (0, initial_y, width, 1), 1.0,
-                   src_format,
-                   row, GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-  s = row + initial_x * n_components;
-#else
-  s = g_alloca (n_components * sizeof (gfloat));
-
-  gegl_buffer_sample (src_buffer, initial_x, initial_y, NULL, s, src_format,
-                      GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
-#endif
-
-  diff = pixel_difference (col, s, antialias, threshold,
-                           n_components, has_alpha, select_transparent,
-                           select_criterion);
-
-  /* check the starting pixel */
-  if (! diff)
-    return FALSE;
+  const GeglRectangle *rect = &worker->rect;
+  Segment              segment;
 
-  mask_row[initial_x] = diff;
+  start = MAX (start, region->extent.x);
+  end   = MIN (end,   region->extent.x + region->extent.width - 1);
 
-  *start = initial_x - 1;
-#ifdef FETCH_ROW
-  s = row + *start * n_components;
-#endif
+  segment.y = y;
 
-  while (*start >= 0)
+  for (segment.start = start; segment.start <= end; segment.start = segment.end + 1)
     {
-#ifndef FETCH_ROW
-      gegl_buffer_sample (src_buffer, *start, initial_y, NULL, s, src_format,
-                          GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
-#endif
-
-      diff = pixel_difference (col, s, antialias, threshold,
-                               n_components, has_alpha, select_transparent,
-                               select_criterion);
-      if (diff == 0.0)
-        break;
+      gint col = (segment.start - region->extent.x) / REGION_TILE_SIZE;
 
-      mask_row[*start] = diff;
+      segment.end = MIN (end,
+                         region->extent.x + (col + 1) * REGION_TILE_SIZE - 1);
 
-      (*start)--;
-#ifdef FETCH_ROW
-      s -= n_components;
-#endif
+      if (y             >= rect->y && y             < rect->y + rect->height &&
+          segment.start >= rect->x && segment.start < rect->x + rect->width)
+        {
+          g_array_append_val (worker->stack, segment);
+        }
+      else
+        {
+          g_array_append_val (worker->outgoing, segment);
+        }
     }
+}
+
+/*  checks the pixel at 'index' of the current tile, and selects it if
+ *  it wasn't visited yet and is similar enough
+ */
+static inline gboolean
+region_worker_select (const Region *region,
+                      RegionWorker *worker,
+                      gint          index)
+{
+  gfloat diff;
 
-  *end = initial_x + 1;
-#ifdef FETCH_ROW
-  s = row + *end * n_components;
-#endif
+  if (worker->mask[index] != 0.0 || worker->rejected[index])
+    return FALSE;
 
-  while (*end < width)
-    {
-#ifndef FETCH_ROW
-      gegl_buffer_sample (src_buffer, *end, initial_y, NULL, s, src_format,
-                          GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
-#endif
-
-      diff = pixel_difference (col, s, antialias, threshold,
-                               n_components, has_alpha, select_transparent,
-                               select_criterion);
-      if (diff == 0.0)
-        break;
+  diff = pixel_difference (region->col,
+                           worker->src + index * region->n_components,
+                           region->antialias,
+                           region->threshold,
+                           region->n_components,
+                           region->has_alpha,
+                           region->select_transparent,
+                           region->select_criterion);
 
-      mask_row[*end] = diff;
+  if (diff == 0.0)
+    {
+      worker->rejected[index] = TRUE;
 
-      (*end)++;
-#ifdef FETCH_ROW
-      s += n_components;
-#endif
+      return FALSE;
     }
 
-  gegl_buffer_set (mask_buffer, GEGL_RECTANGLE (*start + 1, initial_y,
-                                                *end - *start - 1, 1),
-                   0, mask_format, &mask_row[*start + 1],
-                   GEGL_AUTO_ROWSTRIDE);
+  worker->mask[index] = diff;
 
   return TRUE;
 }
 
 static void
-find_contiguous_region (GeglBuffer          *src_buffer,
-                        GeglBuffer          *mask_buffer,
-                        const Babl          *format,
-                        gint                 n_components,
-                        gboolean             has_alpha,
-                        gboolean             select_transparent,
-                        GimpSelectCriterion  select_criterion,
-                        gboolean             antialias,
-                        gfloat               threshold,
-                        gboolean             diagonal_neighbors,
-                        gint                 x,
-                        gint                 y,
-                        const gfloat        *col)
+region_worker_fill_tile (const Region *region,
+                         RegionWorker *worker,
+                         gint          tile)
 {
-  const Babl *mask_format = babl_format ("Y float");
-  gint        old_y;
-  gint        start, end;
-  gint        new_start, new_end;
-  GQueue     *segment_queue;
-  gfloat     *row = NULL;
-
-#ifdef FETCH_ROW
-  row = g_new (gfloat, gegl_buffer_get_width (src_buffer) * n_components);
-#endif
-
-  segment_queue = g_queue_new ();
+  GeglRectangle *rect     = &worker->rect;
+  gboolean       selected = FALSE;
+
+  rect->x      = region->extent.x +
+                 (tile % region->n_tile_cols) * REGION_TILE_SIZE;
+  rect->y      = region->extent.y +
+                 (tile / region->n_tile_cols) * REGION_TILE_SIZE;
+  rect->width  = MIN (REGION_TILE_SIZE,
+                      region->extent.x + region->extent.width  - rect->x);
+  rect->height = MIN (REGION_TILE_SIZE,
+                      region->extent.y + region->extent.height - rect->y);
+
+  gegl_buffer_get (region->src_buffer, rect, 1.0,
+                   region->format, worker->src,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+  gegl_buffer_get (region->mask_buffer, rect, 1.0,
+                   babl_format ("Y float"), worker->mask,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  memset (worker->rejected, 0, rect->width * rect->height);
+
+  while (worker->stack->len > 0)
+    {
+      Segment segment;
+      gint    row;
+      gint    x;
 
-  push_segment (segment_queue,
-                y, /* dummy values: */ -1, 0, 0,
-                y, x - 1, x + 1);
+      segment = g_array_index (worker->stack, Segment, worker->stack->len - 1);
+      g_array_set_size (worker->stack, worker->stack->len - 1);
 
-  do
-    {
-      pop_segment (segment_queue,
-                   &y, &old_y, &start, &end);
+      row = (segment.y - rect->y) * rect->width - rect->x;
 
-      for (x = start + 1; x < end; x++)
+      for (x = segment.start; x <= segment.end; x++)
         {
-          gfloat val;
+          gint start, end;
 
-          gegl_buffer_sample (mask_buffer, x, y, NULL, &val,
-                              mask_format,
-                              GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
-          if (val != 0.0)
-            {
-              /* If the current pixel is selected, then we've already visited
-               * the next pixel.  (Note that we assume that the maximal image
-               * width is sufficiently low that `x` won't overflow.)
-               */
-              x++;
-              continue;
-            }
-
-          if (! find_contiguous_segment (col, src_buffer, mask_buffer,
-                                         format, mask_format,
-                                         n_components,
-                                         has_alpha,
-                                         gegl_buffer_get_width (src_buffer),
-                                         select_transparent, select_criterion,
-                                         antialias, threshold, x, y,
-                                         &new_start, &new_end,
-                                         row))
+          if (! region_worker_select (region, worker, row + x))
             continue;
 
-          /* We can skip directly to `new_end + 1` on the next iteration, since
-           * we've just selected all pixels in the range `[x, new_end)`, and
-           * the pixel at `new_end` is above threshold.  (Note that we assume
-           * that the maximal image width is sufficiently low that `x` won't
-           * overflow.)
-           */
-          x = new_end;
+          selected = TRUE;
 
-          if (diagonal_neighbors)
-            {
-              if (new_start >= 0)
-                new_start--;
+          /*  grow the run to both sides, within the tile  */
+          for (start = x;
+               start > rect->x &&
+               region_worker_select (region, worker, row + start - 1);
+               start--);
 
-              if (new_end < gegl_buffer_get_width (src_buffer))
-                new_end++;
-            }
+          for (end = x;
+               end < rect->x + rect->width - 1 &&
+               region_worker_select (region, worker, row + end + 1);
+               end++);
 
-          if (y + 1 < gegl_buffer_get_height (src_buffer))
-            {
-              push_segment (segment_queue,
-                            y, old_y, start, end,
-                            y + 1, new_start, new_end);
-            }
+          /*  let the neighbor tiles continue the run  */
+          if (start == rect->x)
+            region_worker_push (region, worker, segment.y, start - 1, start - 1);
+
+          if (end == rect->x + rect->width - 1)
+            region_worker_push (region, worker, segment.y, end + 1, end + 1);
 
-          if (y - 1 >= 0)
+          /*  and check the rows above and below it  */
+          if (region->diagonal_neighbors)
             {
-              push_segment (segment_queue,
-                            y, old_y, start, end,
-                            y - 1, new_start, new_end);
+              start--;
+              end++;
             }
 
+          if (segment.y > region->extent.y)
+            region_worker_push (region, worker, segment.y - 1, start, end);
+
+          if (segment.y < region->extent.y + region->extent.height - 1)
+            region_worker_push (region, worker, segment.y + 1, start, end);
+
+          /*  the pixel after the run is either rejected already, or in
+           *  another tile
+           */
+          x = region->diagonal_neighbors ? end - 1 : end;
         }
     }
-  while (! g_queue_is_empty (segment_queue));
-
-  g_queue_free (segment_queue);
 
-#ifdef FETCH_ROW
-  g_free (row);
-#endif
+  if (selected)
+    gegl_buffer_set (region->mask_buffer, rect, 0,
+                     babl_format ("Y float"), worker->mask,
+                     GEGL_AUTO_ROWSTRIDE);
 }
@@ -30,6 +30,7 @@
 
 #include "gegl/gimp-babl.h"
 #include "gegl/gimp-gegl-utils.h"
+#include "gegl/gimptilehandlerdownscale.h"
 #include "gegl/gimptilehandlervalidate.h"
 
 #include "gimp.h"
@@ -53,6 +54,11 @@ static gint GIMP_PROJECTION_CHUNK_HEIGHT = 128;
  */
 static gdouble GIMP_PROJECTION_CHUNK_TIME = 0.0666;
 
+/*  number of reduced levels, each half the size of the previous one,
+ *  kept for rendering the projection at small scales
+ */
+#define GIMP_PROJECTION_N_LEVELS 8
+
 
 enum
 {
@@ -91,6 +97,9 @@ struct _GimpProjectionPrivate
   GeglBuffer                *buffer;
   GimpTileHandlerValidate   *validate_handler;
 
+  GeglBuffer                *levels[GIMP_PROJECTION_N_LEVELS];
+  GimpTileHandlerValidate   *level_handlers[GIMP_PROJECTION_N_LEVELS];
+
   cairo_region_t            *update_region;
   GimpProjectionChunkRender  chunk_render;
   cairo_rectangle_int_t      priority_rect;
@@ -138,6 +147,13 @@ static void        gimp_projection_srgb_to_pixel         (GimpPickable    *picka
                                                           gpointer         pixel);
 
 static void        gimp_projection_free_buffer           (GimpProjection  *proj);
+static GeglBuffer *gimp_projection_get_level             (GimpProjection  *proj,
+                                                          gint             level);
+static void        gimp_projection_invalidate_levels     (GimpProjection  *proj,
+                                                          gint             x,
+                                                          gint             y,
+                                                          gint             w,
+                                                          gint             h);
 static void        gimp_projection_add_update_area       (GimpProjection  *proj,
                                                           gint             x,
                                                           gint             y,
@@ -151,8 +167,9 @@ static gboolean    gimp_projection_chunk_render_callback (gpointer         data)
 static void        gimp_projection_chunk_render_init     (GimpProjection  *proj);
 static gboolean    gimp_projection_chunk_render_iteration(GimpProjection  *proj);
 static gboolean    gimp_projection_chunk_render_next_area(GimpProjection  *proj);
+static void        gimp_projection_paint_chunk           (GimpProjection  *proj,
+                                                          GeglRectangle   *chunk);
 static void        gimp_projection_paint_area            (GimpProjection  *proj,
-                                                          gboolean         now,
                                                           gint             x,
                                                           gint             y,
                                                           gint             w,
@@ -303,9 +320,13 @@ gimp_projection_get_memsize (GimpObject *object,
 {
   GimpProjection *projection = GIMP_PROJECTION (object);
   gint64          memsize    = 0;
+  gint            i;
 
   memsize += gimp_gegl_pyramid_get_memsize (projection->priv->buffer);
 
+  for (i = 0; i < GIMP_PROJECTION_N_LEVELS; i++)
+    memsize += gimp_gegl_pyramid_get_memsize (projection->priv->levels[i]);
+
   return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
                                                                   gui_size);
 }
@@ -613,12 +634,55 @@ gimp_projection_finish_draw (GimpProjection *proj)
     }
 }
 
+/**
+ * gimp_projection_get_buffer_at_scale:
+ * @proj:  a #GimpProjection
+ * @scale: the scale at which the buffer is going to be read
+ *
+ * Returns the level of the projection's pyramid which is best suited
+ * for reading the projection at @scale, and adjusts @scale to be
+ * relative to the returned buffer, which has the same origin as the
+ * projection's buffer.
+ *
+ * The reduced levels are rendered from the projection on demand, and
+ * are kept up to date with it, so reading the returned buffer at the
+ * adjusted scale gives the same pixels as reading the projection's
+ * buffer at @scale, without downsampling full-size tiles every time.
+ *
+ * Return value: the buffer to read the projection from.
+ **/
+GeglBuffer *
+gimp_projection_get_buffer_at_scale (GimpProjection *proj,
+                                     gdouble        *scale)
+{
+  GeglBuffer *buffer;
+  gint        level = 0;
+
+  g_return_val_if_fail (GIMP_IS_PROJECTION (proj), NULL);
+  g_return_val_if_fail (scale != NULL, NULL);
+
+  buffer = gimp_projection_get_buffer (GIMP_PICKABLE (proj));
+
+  while (*scale <= 0.5 && level < GIMP_PROJECTION_N_LEVELS)
+    {
+      *scale *= 2.0;
+      level++;
+    }
+
+  if (level > 0)
+    buffer = gimp_projection_get_level (proj, level);
+
+  return buffer;
+}
+
 
 /*  private functions  */
 
 static void
 gimp_projection_free_buffer (GimpProjection  *proj)
 {
+  gint i;
+
   if (proj->priv->chunk_render.idle_id)
     gimp_projection_chunk_render_stop (proj);
 
@@ -649,6 +713,90 @@ gimp_projection_free_buffer (GimpProjection  *proj)
       g_object_unref (proj->priv->validate_handler);
       proj->priv->validate_handler = NULL;
     }
+
+  for (i = 0; i < GIMP_PROJECTION_N_LEVELS; i++)
+    {
+      if (proj->priv->levels[i])
+        {
+          gegl_buffer_remove_handler (proj->priv->levels[i],
+                                      proj->priv->level_handlers[i]);
+
+          g_object_unref (proj->priv->levels[i]);
+          proj->priv->levels[i] = NULL;
+
+          g_object_unref (proj->priv->level_handlers[i]);
+          proj->priv->level_handlers[i] = NULL;
+        }
+    }
+}
+
+/*  returns the buffer of reduced 'level' (counting from 1), creating
+ *  it and the levels above it if they don't exist yet
+ */
+static GeglBuffer *
+gimp_projection_get_level (GimpProjection *proj,
+                           gint            level)
+{
+  GimpProjectionPrivate *priv = proj->priv;
+
+  if (! priv->levels[level - 1])
+    {
+      GeglBuffer *source;
+      gint        width;
+      gint        height;
+
+      if (level > 1)
+        source = gimp_projection_get_level (proj, level - 1);
+      else
+        source = priv->buffer;
+
+      width  = (gegl_buffer_get_width  (source) + 1) / 2;
+      height = (gegl_buffer_get_height (source) + 1) / 2;
+
+      priv->levels[level - 1] =
+        gegl_buffer_new (GEGL_RECTANGLE (0, 0, width, height),
+                         gegl_buffer_get_format (source));
+
+      priv->level_handlers[level - 1] =
+        GIMP_TILE_HANDLER_VALIDATE (gimp_tile_handler_downscale_new (source));
+
+      gimp_tile_handler_validate_assign (priv->level_handlers[level - 1],
+                                         priv->levels[level - 1]);
+
+      /*  the level is rendered from its source when it is first read  */
+      gimp_tile_handler_validate_invalidate (priv->level_handlers[level - 1],
+                                             0, 0, width, height);
+    }
+
+  return priv->levels[level - 1];
+}
+
+/*  invalidates the area of the reduced levels which is rendered from
+ *  the given area of the projection
+ */
+static void
+gimp_projection_invalidate_levels (GimpProjection *proj,
+                                   gint            x,
+                                   gint            y,
+                                   gint            w,
+                                   gint            h)
+{
+  gint x1 = x;
+  gint y1 = y;
+  gint x2 = x + w;
+  gint y2 = y + h;
+  gint i;
+
+  for (i = 0; i < GIMP_PROJECTION_N_LEVELS && proj->priv->levels[i]; i++)
+    {
+      x1 = x1 / 2;
+      y1 = y1 / 2;
+      x2 = (x2 + 1) / 2;
+      y2 = (y2 + 1) / 2;
+
+      gimp_tile_handler_validate_invalidate (proj->priv->level_handlers[i],
+                                             x1, y1, x2 - x1, y2 - y1);
+    }
 }
 
 static void
@@ -702,7 +850,6 @@ gimp_projection_flush_whenever (GimpProjection *proj,
                                           i, &rect);
 
               gimp_projection_paint_area (proj,
-                                          FALSE, /* sic! */
                                           rect.x,
                                           rect.y,
                                           rect.width,
@@ -843,50 +990,56 @@ gimp_projection_chunk_render_init (GimpProjection *proj)
  * them into bite-sized chunks which are chewed on in an idle
  * function. This greatly improves responsiveness for many GIMP
  * operations.  -- Adam
+ *
+ * Each iteration renders one chunk of the current area, aligned to the
+ * chunk grid. The graph is not safe to process from several threads at
+ * once, so the chunk is blitted from this thread; the operations of the
+ * graph spread the blit over GEGL's own worker threads.
  */
 static gboolean
 gimp_projection_chunk_render_iteration (GimpProjection *proj)
 {
   GimpProjectionChunkRender *chunk_render = &proj->priv->chunk_render;
+  GeglRectangle              chunk;
   gint                       work_x       = chunk_render->work_x;
   gint                       work_y       = chunk_render->work_y;
-  gint                       work_w;
-  gint                       work_h;
-
-  work_w = MIN (GIMP_PROJECTION_CHUNK_WIDTH,
-                chunk_render->x + chunk_render->width - work_x);
-
-  work_h = MIN (GIMP_PROJECTION_CHUNK_HEIGHT,
-                chunk_render->y + chunk_render->height - work_y);
 
-  gimp_projection_paint_area (proj, TRUE /* sic! */,
-                              work_x, work_y, work_w, work_h);
+  chunk.x      = work_x;
+  chunk.y      = work_y;
+  chunk.width  = MIN (GIMP_PROJECTION_CHUNK_WIDTH -
+                      work_x % GIMP_PROJECTION_CHUNK_WIDTH,
+                      chunk_render->x + chunk_render->width - work_x);
+  chunk.height = MIN (GIMP_PROJECTION_CHUNK_HEIGHT -
+                      work_y % GIMP_PROJECTION_CHUNK_HEIGHT,
+                      chunk_render->y + chunk_render->height - work_y);
 
-  chunk_render->work_x += work_w;
+  chunk_render->work_x += chunk.width;
 
   if (chunk_render->work_x >= chunk_render->x + chunk_render->width)
     {
       chunk_render->work_x = chunk_render->x;
 
-      chunk_render->work_y += work_h;
+      chunk_render->work_y += chunk.height;
+    }
+
+  gimp_projection_paint_chunk (proj, &chunk);
 
-      if (chunk_render->work_y >= chunk_render->y + chunk_render->height)
+  if (chunk_render->work_y >= chunk_render->y + chunk_render->height)
+    {
+      if (! gimp_projection_chunk_render_next_area (proj))
         {
-          if (! gimp_projection_chunk_render_next_area (proj))
+          if (proj->priv->invalidate_preview)
             {
-              if (proj->priv->invalidate_preview)
-                {
-                  /* invalidate the preview here since it is constructed from
-                   * the projection
-                   */
-                  proj->priv->invalidate_preview = FALSE;
-
-                  gimp_projectable_invalidate_preview (proj->priv->projectable);
-                }
-
-              /* FINISHED */
-              return FALSE;
+              /* invalidate the preview here since it is constructed from
+               * the projection
+               */
+              proj->priv->invalidate_preview = FALSE;
+
+              gimp_projectable_invalidate_preview (proj->priv->projectable);
             }
+
+          /* FINISHED */
+          return FALSE;
         }
     }
 
@@ -941,9 +1094,63 @@ gimp_projection_chunk_render_next_area (GimpProjection *proj)
   return TRUE;
 }
 
+/* renders 'chunk' right away, and emits "update" for it */
+static void
+gimp_projection_paint_chunk (GimpProjection *proj,
+                             GeglRectangle  *chunk)
+{
+  gint off_x, off_y;
+  gint width, height;
+
+  gimp_projectable_get_offset (proj->priv->projectable, &off_x, &off_y);
+  gimp_projectable_get_size   (proj->priv->projectable, &width, &height);
+
+  if (gimp_rectangle_intersect (chunk->x, chunk->y,
+                                chunk->width, chunk->height,
+                                0, 0, width, height,
+                                &chunk->x, &chunk->y,
+                                &chunk->width, &chunk->height))
+    {
+      GeglNode *graph = gimp_projectable_get_graph (proj->priv->projectable);
+
+      if (proj->priv->validate_handler)
+        {
+          gimp_tile_handler_validate_invalidate (proj->priv->validate_handler,
+                                                 chunk->x,
+                                                 chunk->y,
+                                                 chunk->width,
+                                                 chunk->height);
+          gimp_tile_handler_validate_undo_invalidate (proj->priv->validate_handler,
+                                                      chunk->x,
+                                                      chunk->y,
+                                                      chunk->width,
+                                                      chunk->height);
+        }
+
+      gimp_projection_invalidate_levels (proj,
+                                         chunk->x,
+                                         chunk->y,
+                                         chunk->width,
+                                         chunk->height);
+
+      gegl_node_blit_buffer (graph, proj->priv->buffer,
+                             chunk, 0, GEGL_ABYSS_NONE);
+
+      /*  add the projectable's offsets because the list of update areas
+       *  is in tile-pyramid coordinates, but our external API is always
+       *  in terms of image coordinates.
+       */
+      g_signal_emit (proj, projection_signals[UPDATE], 0,
+                     TRUE,
+                     chunk->x + off_x,
+                     chunk->y + off_y,
+                     chunk->width,
+                     chunk->height);
+    }
+}
+
 static void
 gimp_projection_paint_area (GimpProjection *proj,
-                            gboolean        now,
                             gint            x,
                             gint            y,
                             gint            w,
@@ -962,24 +1169,15 @@ gimp_projection_paint_area (GimpProjection *proj,
       if (proj->priv->validate_handler)
         gimp_tile_handler_validate_invalidate (proj->priv->validate_handler,
                                                x, y, w, h);
-      if (now)
-        {
-          GeglNode *graph = gimp_projectable_get_graph (proj->priv->projectable);
-
-          if (proj->priv->validate_handler)
-            gimp_tile_handler_validate_undo_invalidate (proj->priv->validate_handler,
-                                                        x, y, w, h);
 
-          gegl_node_blit_buffer (graph, proj->priv->buffer,
-                                 GEGL_RECTANGLE (x, y, w, h), 0, GEGL_ABYSS_NONE);
-        }
+      gimp_projection_invalidate_levels (proj, x, y, w, h);
 
       /*  add the projectable's offsets because the list of update areas
        *  is in tile-pyramid coordinates, but our external API is always
        *  in terms of image coordinates.
        */
       g_signal_emit (proj, projection_signals[UPDATE], 0,
-                     now,
+                     FALSE,
                      x + off_x,
                      y + off_y,
                      w,
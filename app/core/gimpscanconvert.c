@@ -29,6 +29,7 @@
 
 #include "core-types.h"
 
+#include "gimp-parallel.h"
 #include "gimpboundary.h"
 #include "gimpbezierdesc.h"
 #include "gimpscanconvert.h"
@@ -56,6 +57,40 @@ struct _GimpScanConvert
   GArray         *path_data;
 };
 
+typedef struct
+{
+  GimpScanConvert *sc;
+  GeglBuffer      *buffer;
+  cairo_path_t     path;
+  gint             off_x;
+  gint             off_y;
+  gboolean         replace;
+  gboolean         antialias;
+  gdouble          value;
+} GimpScanConvertRenderData;
+
+
+#define SCAN_CONVERT_MIN_SUB_AREA (64 * 64)
+
+
+/*  local function prototypes  */
+
+static void   gimp_scan_convert_setup_context (GimpScanConvert           *sc,
+                                               cairo_t                   *cr,
+                                               cairo_path_t              *path,
+                                               gboolean                   antialias,
+                                               gdouble                    value);
+static void   gimp_scan_convert_draw          (GimpScanConvert           *sc,
+                                               cairo_t                   *cr);
+static void   gimp_scan_convert_get_extents   (GimpScanConvert           *sc,
+                                               cairo_path_t              *path,
+                                               gint                       off_x,
+                                               gint                       off_y,
+                                               gboolean                   antialias,
+                                               GeglRectangle             *extents);
+static void   gimp_scan_convert_render_area   (const GeglRectangle       *area,
+                                               GimpScanConvertRenderData *data);
+
 
 /*  public functions  */
 
@@ -496,47 +531,190 @@ gimp_scan_convert_render_full (GimpScanConvert *sc,
                                gboolean         antialias,
                                gdouble          value)
 {
-  const Babl         *format;
-  GeglBufferIterator *iter;
-  GeglRectangle      *roi;
-  cairo_t            *cr;
-  cairo_surface_t    *surface;
-  cairo_path_t        path;
-  gint                bpp;
-  gint                x, y;
-  gint                width, height;
+  GimpScanConvertRenderData data;
+  GeglRectangle             extents;
+  GeglRectangle             area;
 
   g_return_if_fail (sc != NULL);
   g_return_if_fail (GEGL_IS_BUFFER (buffer));
 
-  x      = 0;
-  y      = 0;
-  width  = gegl_buffer_get_width  (buffer);
-  height = gegl_buffer_get_height (buffer);
+  area = *GEGL_RECTANGLE (0, 0,
+                          gegl_buffer_get_width  (buffer),
+                          gegl_buffer_get_height (buffer));
+
+  /*  uncovered pixels are cleared, no matter where they are  */
+  if (replace)
+    gegl_buffer_clear (buffer, &area);
 
-  if (sc->clip && ! gimp_rectangle_intersect (x, y, width, height,
+  if (sc->clip && ! gimp_rectangle_intersect (area.x, area.y,
+                                              area.width, area.height,
                                               sc->clip_x, sc->clip_y,
                                               sc->clip_w, sc->clip_h,
-                                              &x, &y, &width, &height))
+                                              &area.x, &area.y,
+                                              &area.width, &area.height))
     return;
 
-  path.status   = CAIRO_STATUS_SUCCESS;
-  path.data     = (cairo_path_data_t *) sc->path_data->data;
-  path.num_data = sc->path_data->len;
+  data.sc        = sc;
+  data.buffer    = buffer;
+  data.off_x     = off_x;
+  data.off_y     = off_y;
+  data.replace   = replace;
+  data.antialias = antialias;
+  data.value     = value;
+
+  data.path.status   = CAIRO_STATUS_SUCCESS;
+  data.path.data     = (cairo_path_data_t *) sc->path_data->data;
+  data.path.num_data = sc->path_data->len;
+
+  /*  only the tiles covered by the path need to be rendered  */
+  gimp_scan_convert_get_extents (sc, &data.path, off_x, off_y, antialias,
+                                 &extents);
+
+  if (! gegl_rectangle_intersect (&area, &area, &extents))
+    return;
+
+  gimp_parallel_distribute_area (&area, SCAN_CONVERT_MIN_SUB_AREA,
+                                 (GimpParallelDistributeAreaFunc)
+                                 gimp_scan_convert_render_area,
+                                 &data);
+}
+
+
+/*  private functions  */
+
+static void
+gimp_scan_convert_setup_context (GimpScanConvert *sc,
+                                 cairo_t         *cr,
+                                 cairo_path_t    *path,
+                                 gboolean         antialias,
+                                 gdouble          value)
+{
+  cairo_set_source_rgba (cr, 0, 0, 0, value);
+  cairo_append_path (cr, path);
+
+  cairo_set_antialias (cr, antialias ?
+                       CAIRO_ANTIALIAS_GRAY : CAIRO_ANTIALIAS_NONE);
+  cairo_set_miter_limit (cr, sc->miter);
+
+  if (sc->do_stroke)
+    {
+      cairo_set_line_cap (cr,
+                          sc->cap == GIMP_CAP_BUTT ? CAIRO_LINE_CAP_BUTT :
+                          sc->cap == GIMP_CAP_ROUND ? CAIRO_LINE_CAP_ROUND :
+                          CAIRO_LINE_CAP_SQUARE);
+      cairo_set_line_join (cr,
+                           sc->join == GIMP_JOIN_MITER ? CAIRO_LINE_JOIN_MITER :
+                           sc->join == GIMP_JOIN_ROUND ? CAIRO_LINE_JOIN_ROUND :
+                           CAIRO_LINE_JOIN_BEVEL);
+
+      cairo_set_line_width (cr, sc->width);
+
+      if (sc->dash_info)
+        cairo_set_dash (cr,
+                        (double *) sc->dash_info->data,
+                        sc->dash_info->len,
+                        sc->dash_offset);
+
+      cairo_scale (cr, 1.0, sc->ratio_xy);
+    }
+  else
+    {
+      cairo_set_fill_rule (cr, CAIRO_FILL_RULE_EVEN_ODD);
+    }
+}
+
+static void
+gimp_scan_convert_draw (GimpScanConvert *sc,
+                        cairo_t         *cr)
+{
+  if (sc->do_stroke)
+    cairo_stroke (cr);
+  else
+    cairo_fill (cr);
+}
+
+/*  returns the area of the buffer which the path can cover  */
+static void
+gimp_scan_convert_get_extents (GimpScanConvert *sc,
+                               cairo_path_t    *path,
+                               gint             off_x,
+                               gint             off_y,
+                               gboolean         antialias,
+                               GeglRectangle   *extents)
+{
+  cairo_surface_t *surface;
+  cairo_t         *cr;
+  gdouble          x1, y1, x2, y2;
+  gdouble          x[4], y[4];
+  gint             i;
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_A8, 1, 1);
+  cr      = cairo_create (surface);
+
+  gimp_scan_convert_setup_context (sc, cr, path, antialias, 1.0);
+
+  if (sc->do_stroke)
+    cairo_stroke_extents (cr, &x1, &y1, &x2, &y2);
+  else
+    cairo_fill_extents (cr, &x1, &y1, &x2, &y2);
+
+  /*  the extents are in user space, which is scaled when stroking.
+   *  cairo_user_to_device() ignores the surface's device offset, so
+   *  the offset is applied below
+   */
+  x[0] = x1; y[0] = y1;
+  x[1] = x2; y[1] = y1;
+  x[2] = x1; y[2] = y2;
+  x[3] = x2; y[3] = y2;
+
+  for (i = 0; i < 4; i++)
+    cairo_user_to_device (cr, &x[i], &y[i]);
+
+  x1 = MIN (MIN (x[0], x[1]), MIN (x[2], x[3]));
+  y1 = MIN (MIN (y[0], y[1]), MIN (y[2], y[3]));
+  x2 = MAX (MAX (x[0], x[1]), MAX (x[2], x[3]));
+  y2 = MAX (MAX (y[0], y[1]), MAX (y[2], y[3]));
+
+  cairo_destroy (cr);
+  cairo_surface_destroy (surface);
+
+  /*  leave a pixel of room for antialiasing, and move the extents
+   *  from image to buffer coordinates
+   */
+  extents->x      = floor (x1) - 1;
+  extents->y      = floor (y1) - 1;
+  extents->width  = ceil (x2) + 1 - extents->x;
+  extents->height = ceil (y2) + 1 - extents->y;
+
+  extents->x -= off_x;
+  extents->y -= off_y;
+}
+
+static void
+gimp_scan_convert_render_area (const GeglRectangle       *area,
+                               GimpScanConvertRenderData *data)
+{
+  GimpScanConvert    *sc = data->sc;
+  const Babl         *format;
+  GeglBufferIterator *iter;
+  GeglRectangle      *roi;
+  cairo_t            *cr;
+  cairo_surface_t    *surface;
+  gint                bpp;
 
   format = babl_format ("Y u8");
   bpp    = babl_format_get_bytes_per_pixel (format);
 
-  iter = gegl_buffer_iterator_new (buffer, NULL, 0, format,
+  iter = gegl_buffer_iterator_new (data->buffer, area, 0, format,
                                    GEGL_ACCESS_READWRITE, GEGL_ABYSS_NONE);
   roi = &iter->roi[0];
 
   while (gegl_buffer_iterator_next (iter))
     {
-      guchar     *data    = iter->data[0];
-      guchar     *tmp_buf = NULL;
-      const gint  stride  = cairo_format_stride_for_width (CAIRO_FORMAT_A8,
-                                                           roi->width);
+      guchar     *data_buf = iter->data[0];
+      guchar     *tmp_buf  = NULL;
+      const gint  stride   = cairo_format_stride_for_width (CAIRO_FORMAT_A8,
+                                                            roi->width);
 
       /*  cairo rowstrides are always multiples of 4, whereas
        *  maskPR.rowstride can be anything, so to be able to create an
@@ -547,9 +725,9 @@ gimp_scan_convert_render_full (GimpScanConvert *sc,
         {
           tmp_buf = g_alloca (stride * roi->height);
 
-          if (! replace)
+          if (! data->replace)
             {
-              const guchar *src  = data;
+              const guchar *src  = data_buf;
               guchar       *dest = tmp_buf;
               gint          i;
 
@@ -564,57 +742,26 @@ gimp_scan_convert_render_full (GimpScanConvert *sc,
         }
 
       surface = cairo_image_surface_create_for_data (tmp_buf ?
-                                                     tmp_buf : data,
+                                                     tmp_buf : data_buf,
                                                      CAIRO_FORMAT_A8,
                                                      roi->width, roi->height,
                                                      stride);
 
       cairo_surface_set_device_offset (surface,
-                                       -off_x - roi->x,
-                                       -off_y - roi->y);
+                                       -data->off_x - roi->x,
+                                       -data->off_y - roi->y);
       cr = cairo_create (surface);
       cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
 
-      if (replace)
+      if (data->replace)
         {
           cairo_set_source_rgba (cr, 0, 0, 0, 0);
           cairo_paint (cr);
         }
 
-      cairo_set_source_rgba (cr, 0, 0, 0, value);
-      cairo_append_path (cr, &path);
-
-      cairo_set_antialias (cr, antialias ?
-                           CAIRO_ANTIALIAS_GRAY : CAIRO_ANTIALIAS_NONE);
-      cairo_set_miter_limit (cr, sc->miter);
-
-      if (sc->do_stroke)
-        {
-          cairo_set_line_cap (cr,
-                              sc->cap == GIMP_CAP_BUTT ? CAIRO_LINE_CAP_BUTT :
-                              sc->cap == GIMP_CAP_ROUND ? CAIRO_LINE_CAP_ROUND :
-                              CAIRO_LINE_CAP_SQUARE);
-          cairo_set_line_join (cr,
-                               sc->join == GIMP_JOIN_MITER ? CAIRO_LINE_JOIN_MITER :
-                               sc->join == GIMP_JOIN_ROUND ? CAIRO_LINE_JOIN_ROUND :
-                               CAIRO_LINE_JOIN_BEVEL);
-
-          cairo_set_line_width (cr, sc->width);
-
-          if (sc->dash_info)
-            cairo_set_dash (cr,
-                            (double *) sc->dash_info->data,
-                            sc->dash_info->len,
-                            sc->dash_offset);
-
-          cairo_scale (cr, 1.0, sc->ratio_xy);
-          cairo_stroke (cr);
-        }
-      else
-        {
-          cairo_set_fill_rule (cr, CAIRO_FILL_RULE_EVEN_ODD);
-          cairo_fill (cr);
-        }
+      gimp_scan_convert_setup_context (sc, cr, &data->path,
+                                       data->antialias, data->value);
+      gimp_scan_convert_draw (sc, cr);
 
       cairo_destroy (cr);
       cairo_surface_destroy (surface);
@@ -622,7 +769,7 @@ gimp_scan_convert_render_full (GimpScanConvert *sc,
       if (tmp_buf)
         {
           const guchar *src  = tmp_buf;
-          guchar       *dest = data;
+          guchar       *dest = data_buf;
           gint          i;
 
           for (i = 0; i < roi->height; i++)
@@ -27,6 +27,7 @@
 
 #include "gegl/gimp-babl.h"
 #include "gegl/gimp-gegl-apply-operation.h"
+#include "gegl/gimp-gegl-mask.h"
 
 #include "gimp.h"
 #include "gimp-edit.h"
@@ -608,6 +609,8 @@ gimp_selection_new (GimpImage *image,
   channel->x2 = width;
   channel->y2 = height;
 
+  gimp_gegl_mask_track_tiles (gimp_drawable_get_buffer (GIMP_DRAWABLE (channel)));
+
   return channel;
 }
 
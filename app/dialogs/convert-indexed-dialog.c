@@ -47,6 +47,7 @@ typedef struct
   GimpImage                  *image;
   GimpConvertPaletteType      palette_type;
   gint                        max_colors;
+  GimpConvertQuantizer        quantizer;
   gboolean                    remove_duplicates;
   GimpConvertDitherType       dither_type;
   gboolean                    dither_alpha;
@@ -81,6 +82,7 @@ convert_indexed_dialog_new (GimpImage                  *image,
                             GtkWidget                  *parent,
                             GimpConvertPaletteType      palette_type,
                             gint                        max_colors,
+                            GimpConvertQuantizer        quantizer,
                             gboolean                    remove_duplicates,
                             GimpConvertDitherType       dither_type,
                             gboolean                    dither_alpha,
@@ -115,6 +117,7 @@ convert_indexed_dialog_new (GimpImage                  *image,
   private->image              = image;
   private->palette_type       = palette_type;
   private->max_colors         = max_colors;
+  private->quantizer          = quantizer;
   private->remove_duplicates  = remove_duplicates;
   private->dither_type        = dither_type;
   private->dither_alpha       = dither_alpha;
@@ -209,6 +212,21 @@ convert_indexed_dialog_new (GimpImage                  *image,
                     G_CALLBACK (gimp_int_adjustment_update),
                     &private->max_colors);
 
+  /*  quantizer  */
+  label = gtk_label_new_with_mnemonic (_("_Quantizer:"));
+  gtk_box_pack_start (GTK_BOX (hbox), label, FALSE, FALSE, 0);
+  gtk_widget_show (label);
+
+  combo = gimp_enum_combo_box_new (GIMP_TYPE_CONVERT_QUANTIZER);
+  gtk_label_set_mnemonic_widget (GTK_LABEL (label), combo);
+  gtk_box_pack_start (GTK_BOX (hbox), combo, TRUE, TRUE, 0);
+  gtk_widget_show (combo);
+
+  gimp_int_combo_box_connect (GIMP_INT_COMBO_BOX (combo),
+                              private->quantizer,
+                              G_CALLBACK (gimp_int_combo_box_get_active),
+                              &private->quantizer);
+
   /*  custom palette  */
   if (palette_box)
     {
@@ -306,6 +324,7 @@ convert_dialog_response (GtkWidget     *dialog,
                          private->image,
                          private->palette_type,
                          private->max_colors,
+                         private->quantizer,
                          private->remove_duplicates,
                          private->dither_type,
                          private->dither_alpha,
@@ -23,6 +23,7 @@ typedef void (* GimpConvertIndexedCallback) (GtkWidget              *dialog,
                                              GimpImage              *image,
                                              GimpConvertPaletteType  palette_type,
                                              gint                    max_colors,
+                                             GimpConvertQuantizer    quantizer,
                                              gboolean                remove_duplicates,
                                              GimpConvertDitherType   dither_type,
                                              gboolean                dither_alpha,
@@ -36,6 +37,7 @@ GtkWidget * convert_indexed_dialog_new (GimpImage                  *image,
                                         GtkWidget                  *parent,
                                         GimpConvertPaletteType      palette_type,
                                         gint                        max_colors,
+                                        GimpConvertQuantizer        quantizer,
                                         gboolean                    remove_duplicates,
                                         GimpConvertDitherType       dither_type,
                                         gboolean                    dither_alpha,
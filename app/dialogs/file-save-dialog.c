@@ -189,6 +189,9 @@ file_save_dialog_response (GtkWidget *dialog,
 
             xcf_compat = save_dialog->compat &&
               gtk_widget_get_sensitive (save_dialog->compat_toggle);
+
+            gimp_image_set_xcf_fast_compression (file_dialog->image,
+                                                 save_dialog->fast_compression);
           }
         if (file_save_dialog_save_image (GIMP_PROGRESS (dialog),
                                          gimp,
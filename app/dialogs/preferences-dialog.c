@@ -1082,6 +1082,10 @@ prefs_dialog_new (Gimp       *gimp,
                            _("Maximum _filesize for thumbnailing:"),
                            GTK_TABLE (table), 1, size_group);
 
+  prefs_check_button_add (object, "xcf-reduced-levels",
+                          _("Save _reduced-size levels in XCF files"),
+                          GTK_BOX (vbox2));
+
   g_object_unref (size_group);
   size_group = NULL;
 
@@ -1862,7 +1866,7 @@ prefs_dialog_new (Gimp       *gimp,
   /*  Convert Indexed Dialog  */
   vbox2 = prefs_frame_new (_("Indexed Conversion Dialog"),
                            GTK_CONTAINER (vbox), FALSE);
-  table = prefs_table_new (2, GTK_CONTAINER (vbox2));
+  table = prefs_table_new (3, GTK_CONTAINER (vbox2));
 
   prefs_enum_combo_box_add (object, "image-convert-indexed-palette-type", 0, 0,
                             _("Colormap:"),
@@ -1870,6 +1874,9 @@ prefs_dialog_new (Gimp       *gimp,
   prefs_spin_button_add (object, "image-convert-indexed-max-colors", 1.0, 8.0, 0,
                          _("Maximum number of colors:"),
                          GTK_TABLE (table), 1, size_group);
+  prefs_enum_combo_box_add (object, "image-convert-indexed-quantizer", 0, 0,
+                            _("Quantizer:"),
+                            GTK_TABLE (table), 2, size_group);
 
   prefs_check_button_add (object, "image-convert-indexed-remove-duplicates",
                           _("Remove unused and duplicate colors "
@@ -20,6 +20,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <gegl.h>
 #include <gtk/gtk.h>
 
@@ -31,6 +33,7 @@
 #include "display/display-types.h"
 
 #include "core/gimpchannel.h"
+#include "core/gimpdrawable-transform.h"
 #include "core/gimpimage.h"
 #include "core/gimp-transform-utils.h"
 #include "core/gimp-utils.h"
@@ -38,6 +41,7 @@
 #include "gimpcanvas.h"
 #include "gimpcanvastransformpreview.h"
 #include "gimpdisplayshell.h"
+#include "gimpdisplayshell-transform.h"
 
 
 #define INT_MULT(a,b,t)    ((t) = (a) * (b) + 0x80, ((((t) >> 8) + (t)) >> 8))
@@ -47,6 +51,8 @@
 #define MAX_SUB_COLS       6 /* number of columns and  */
 #define MAX_SUB_ROWS       6 /* rows to use in perspective preview subdivision */
 
+#define REFINE_CHUNK_SIZE  128    /* size of the chunks of the refinement */
+
 
 enum
 {
@@ -58,7 +64,8 @@ enum
   PROP_X2,
   PROP_Y2,
   PROP_PERSPECTIVE,
-  PROP_OPACITY
+  PROP_OPACITY,
+  PROP_INTERPOLATION
 };
 
 
@@ -66,12 +73,22 @@ typedef struct _GimpCanvasTransformPreviewPrivate GimpCanvasTransformPreviewPriv
 
 struct _GimpCanvasTransformPreviewPrivate
 {
-  GimpDrawable      *drawable;
-  GimpMatrix3        transform;
-  gdouble            x1, y1;
-  gdouble            x2, y2;
-  gboolean           perspective;
-  gdouble            opacity;
+  GimpDrawable          *drawable;
+  GimpMatrix3            transform;
+  gdouble                x1, y1;
+  gdouble                x2, y2;
+  gboolean               perspective;
+  gdouble                opacity;
+  GimpInterpolationType  interpolation;
+
+  /*  the full-quality rendering which progressively replaces the
+   *  preview, in unrotated canvas coordinates
+   */
+  GimpDrawableTransformJob *refine_job;
+  GimpMatrix3               refine_matrix;
+  cairo_surface_t          *refine_surface;
+  cairo_rectangle_int_t     refine_rect;
+  cairo_region_t           *refine_region;
 };
 
 #define GET_PRIVATE(transform_preview) \
@@ -82,6 +99,7 @@ struct _GimpCanvasTransformPreviewPrivate
 
 /*  local function prototypes  */
 
+static void             gimp_canvas_transform_preview_finalize     (GObject        *object);
 static void             gimp_canvas_transform_preview_set_property (GObject        *object,
                                                                     guint           property_id,
                                                                     const GValue   *value,
@@ -153,6 +171,20 @@ static void   gimp_canvas_transform_preview_trace_tri_edge    (gint            *
                                                                gint             x2,
                                                                gint             y2);
 
+static void     gimp_canvas_transform_preview_get_matrix      (GimpCanvasItem              *item,
+                                                               GimpMatrix3                 *matrix);
+static void     gimp_canvas_transform_preview_refine_start    (GimpCanvasItem              *item,
+                                                               const GimpMatrix3           *matrix,
+                                                               const cairo_rectangle_int_t *extents);
+static void     gimp_canvas_transform_preview_refine_stop     (GimpCanvasItem              *item);
+static void     gimp_canvas_transform_preview_refine_chunks   (GimpDrawableTransformJob    *job,
+                                                               const GeglRectangle         *chunks,
+                                                               gint                         n_chunks,
+                                                               GimpCanvasItem              *item);
+static gint     gimp_canvas_transform_preview_chunk_compare   (const GeglRectangle         *chunk1,
+                                                               const GeglRectangle         *chunk2,
+                                                               const GeglRectangle         *center);
+
 
 G_DEFINE_TYPE (GimpCanvasTransformPreview, gimp_canvas_transform_preview,
                GIMP_TYPE_CANVAS_ITEM)
@@ -166,6 +198,7 @@ gimp_canvas_transform_preview_class_init (GimpCanvasTransformPreviewClass *klass
   GObjectClass        *object_class = G_OBJECT_CLASS (klass);
   GimpCanvasItemClass *item_class   = GIMP_CANVAS_ITEM_CLASS (klass);
 
+  object_class->finalize     = gimp_canvas_transform_preview_finalize;
   object_class->set_property = gimp_canvas_transform_preview_set_property;
   object_class->get_property = gimp_canvas_transform_preview_get_property;
 
@@ -228,6 +261,13 @@ gimp_canvas_transform_preview_class_init (GimpCanvasTransformPreviewClass *klass
                                                         0.0, 1.0, 1.0,
                                                         GIMP_PARAM_READWRITE));
 
+  g_object_class_install_property (object_class, PROP_INTERPOLATION,
+                                   g_param_spec_enum ("interpolation",
+                                                      NULL, NULL,
+                                                      GIMP_TYPE_INTERPOLATION_TYPE,
+                                                      GIMP_INTERPOLATION_NONE,
+                                                      GIMP_PARAM_READWRITE));
+
   g_type_class_add_private (klass, sizeof (GimpCanvasTransformPreviewPrivate));
 }
 
@@ -236,6 +276,14 @@ gimp_canvas_transform_preview_init (GimpCanvasTransformPreview *transform_previe
 {
 }
 
+static void
+gimp_canvas_transform_preview_finalize (GObject *object)
+{
+  gimp_canvas_transform_preview_refine_stop (GIMP_CANVAS_ITEM (object));
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
 static void
 gimp_canvas_transform_preview_set_property (GObject      *object,
                                             guint         property_id,
@@ -244,6 +292,9 @@ gimp_canvas_transform_preview_set_property (GObject      *object,
 {
   GimpCanvasTransformPreviewPrivate *private = GET_PRIVATE (object);
 
+  /*  whatever changed, the refinement is outdated  */
+  gimp_canvas_transform_preview_refine_stop (GIMP_CANVAS_ITEM (object));
+
   switch (property_id)
     {
     case PROP_DRAWABLE:
@@ -285,6 +336,10 @@ gimp_canvas_transform_preview_set_property (GObject      *object,
       private->opacity = g_value_get_double (value);
       break;
 
+    case PROP_INTERPOLATION:
+      private->interpolation = g_value_get_enum (value);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -333,6 +388,10 @@ gimp_canvas_transform_preview_get_property (GObject    *object,
       g_value_set_double (value, private->opacity);
       break;
 
+    case PROP_INTERPOLATION:
+      g_value_set_enum (value, private->interpolation);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -422,13 +481,95 @@ gimp_canvas_transform_preview_draw (GimpCanvasItem *item,
   gfloat                             u[MAX_SUB_COLS * MAX_SUB_ROWS][4];
   gfloat                             v[MAX_SUB_COLS * MAX_SUB_ROWS][4];
   guchar                             opacity;
+  cairo_rectangle_int_t              extents;
+  gboolean                           clipped = FALSE;
 
   opacity = private->opacity * 255.999;
 
   /* only draw convex polygons */
-  if (! gimp_canvas_transform_preview_transform (item, NULL))
+  if (! gimp_canvas_transform_preview_transform (item, &extents))
     return;
 
+  /* the nearest-neighbor preview below is cheap enough to follow the
+   * handles, replace it by a full-quality rendering in the background
+   * once they rest
+   */
+  if (private->interpolation != GIMP_INTERPOLATION_NONE)
+    {
+      GimpMatrix3 matrix;
+
+      gimp_canvas_transform_preview_get_matrix (item, &matrix);
+
+      if (private->refine_job &&
+          memcmp (&matrix, &private->refine_matrix, sizeof (GimpMatrix3)))
+        {
+          gimp_canvas_transform_preview_refine_stop (item);
+        }
+
+      if (! private->refine_job)
+        gimp_canvas_transform_preview_refine_start (item, &matrix, &extents);
+    }
+
+  if (private->refine_region &&
+      ! cairo_region_is_empty (private->refine_region))
+    {
+      cairo_rectangle_int_t rect;
+      gdouble               clip_x1, clip_y1, clip_x2, clip_y2;
+      gint                  n_rects;
+      gint                  i;
+
+      n_rects = cairo_region_num_rectangles (private->refine_region);
+
+      cairo_save (cr);
+
+      for (i = 0; i < n_rects; i++)
+        {
+          cairo_region_get_rectangle (private->refine_region, i, &rect);
+          cairo_rectangle (cr, rect.x, rect.y, rect.width, rect.height);
+        }
+
+      cairo_clip (cr);
+
+      cairo_set_source_surface (cr, private->refine_surface,
+                                private->refine_rect.x,
+                                private->refine_rect.y);
+      cairo_paint_with_alpha (cr, private->opacity);
+
+      cairo_restore (cr);
+
+      /* skip the preview if the refined chunks cover everything */
+      cairo_clip_extents (cr, &clip_x1, &clip_y1, &clip_x2, &clip_y2);
+
+      if (gimp_rectangle_intersect (extents.x, extents.y,
+                                    extents.width, extents.height,
+                                    floor (clip_x1), floor (clip_y1),
+                                    ceil (clip_x2) - floor (clip_x1),
+                                    ceil (clip_y2) - floor (clip_y1),
+                                    &rect.x, &rect.y,
+                                    &rect.width, &rect.height) &&
+          cairo_region_contains_rectangle (private->refine_region,
+                                           &rect) == CAIRO_REGION_OVERLAP_IN)
+        {
+          return;
+        }
+
+      /* and draw the preview only where they don't */
+      cairo_save (cr);
+
+      cairo_rectangle (cr, extents.x, extents.y, extents.width, extents.height);
+
+      for (i = 0; i < n_rects; i++)
+        {
+          cairo_region_get_rectangle (private->refine_region, i, &rect);
+          cairo_rectangle (cr, rect.x, rect.y, rect.width, rect.height);
+        }
+
+      cairo_set_fill_rule (cr, CAIRO_FILL_RULE_EVEN_ODD);
+      cairo_clip (cr);
+
+      clipped = TRUE;
+    }
+
   mask      = NULL;
   mask_offx = 0;
   mask_offy = 0;
@@ -555,6 +696,9 @@ gimp_canvas_transform_preview_draw (GimpCanvasItem *item,
                                              mask, mask_offx, mask_offy,
                                              x[j], y[j], u[j], v[j],
                                              opacity);
+
+  if (clipped)
+    cairo_restore (cr);
 }
 
 static cairo_region_t *
@@ -569,30 +713,32 @@ gimp_canvas_transform_preview_get_extents (GimpCanvasItem *item)
 }
 
 GimpCanvasItem *
-gimp_canvas_transform_preview_new (GimpDisplayShell  *shell,
-                                   GimpDrawable      *drawable,
-                                   const GimpMatrix3 *transform,
-                                   gdouble            x1,
-                                   gdouble            y1,
-                                   gdouble            x2,
-                                   gdouble            y2,
-                                   gboolean           perspective,
-                                   gdouble            opacity)
+gimp_canvas_transform_preview_new (GimpDisplayShell      *shell,
+                                   GimpDrawable          *drawable,
+                                   const GimpMatrix3     *transform,
+                                   gdouble                x1,
+                                   gdouble                y1,
+                                   gdouble                x2,
+                                   gdouble                y2,
+                                   gboolean               perspective,
+                                   gdouble                opacity,
+                                   GimpInterpolationType  interpolation)
 {
   g_return_val_if_fail (GIMP_IS_DISPLAY_SHELL (shell), NULL);
   g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), NULL);
   g_return_val_if_fail (transform != NULL, NULL);
 
   return g_object_new (GIMP_TYPE_CANVAS_TRANSFORM_PREVIEW,
-                       "shell",       shell,
-                       "drawable",    drawable,
-                       "transform",   transform,
-                       "x1",          x1,
-                       "y1",          y1,
-                       "x2",          x2,
-                       "y2",          y2,
-                       "perspective", perspective,
-                       "opacity",     CLAMP (opacity, 0.0, 1.0),
+                       "shell",         shell,
+                       "drawable",      drawable,
+                       "transform",     transform,
+                       "x1",            x1,
+                       "y1",            y1,
+                       "x2",            x2,
+                       "y2",            y2,
+                       "perspective",   perspective,
+                       "opacity",       CLAMP (opacity, 0.0, 1.0),
+                       "interpolation", interpolation,
                        NULL);
 }
 
@@ -1218,3 +1364,202 @@ gimp_canvas_transform_preview_trace_tri_edge (gint *dest,
         }
     }
 }
+
+/*  returns the item's transform followed by the transform from image
+ *  to unrotated canvas coordinates.  The canvas' cairo context is
+ *  already rotated when the item is drawn.
+ */
+static void
+gimp_canvas_transform_preview_get_matrix (GimpCanvasItem *item,
+                                          GimpMatrix3    *matrix)
+{
+  GimpCanvasTransformPreviewPrivate *private = GET_PRIVATE (item);
+  GimpDisplayShell                  *shell   = gimp_canvas_item_get_shell (item);
+
+  *matrix = private->transform;
+
+  gimp_matrix3_scale (matrix, shell->scale_x, shell->scale_y);
+  gimp_matrix3_translate (matrix, -shell->offset_x, -shell->offset_y);
+}
+
+/**
+ * gimp_canvas_transform_preview_refine_start:
+ * @item:    the #GimpCanvasTransformPreview
+ * @matrix:  the transform from drawable to canvas coordinates
+ * @extents: the canvas extents of the transformed drawable
+ *
+ * Starts a #GimpDrawableTransformJob which renders the transformed
+ * drawable like the final transform will, in chunks, beginning at the
+ * center of the canvas.  Only the visible part is rendered.
+ **/
+static void
+gimp_canvas_transform_preview_refine_start (GimpCanvasItem              *item,
+                                            const GimpMatrix3           *matrix,
+                                            const cairo_rectangle_int_t *extents)
+{
+  GimpCanvasTransformPreviewPrivate *private = GET_PRIVATE (item);
+  GimpDisplayShell                  *shell   = gimp_canvas_item_get_shell (item);
+  GArray                            *chunks;
+  GeglRectangle                      bounds;
+  GeglRectangle                      center;
+  gdouble                            visible_x1, visible_y1;
+  gdouble                            visible_x2, visible_y2;
+  gdouble                            center_x, center_y;
+  gint                               x, y;
+
+  /*  the visible part of the canvas, in unrotated coordinates  */
+  gimp_display_shell_unrotate_bounds (shell,
+                                      0, 0,
+                                      shell->disp_width, shell->disp_height,
+                                      &visible_x1, &visible_y1,
+                                      &visible_x2, &visible_y2);
+
+  if (! gimp_rectangle_intersect (extents->x, extents->y,
+                                  extents->width, extents->height,
+                                  floor (visible_x1), floor (visible_y1),
+                                  ceil (visible_x2) - floor (visible_x1),
+                                  ceil (visible_y2) - floor (visible_y1),
+                                  &private->refine_rect.x,
+                                  &private->refine_rect.y,
+                                  &private->refine_rect.width,
+                                  &private->refine_rect.height))
+    return;
+
+  private->refine_matrix  = *matrix;
+  private->refine_surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                                        private->refine_rect.width,
+                                                        private->refine_rect.height);
+  private->refine_region  = cairo_region_create ();
+
+  /*  the job writes to the surface behind cairo's back  */
+  cairo_surface_flush (private->refine_surface);
+
+  chunks = g_array_new (FALSE, FALSE, sizeof (GeglRectangle));
+
+  for (y = 0; y < private->refine_rect.height; y += REFINE_CHUNK_SIZE)
+    {
+      for (x = 0; x < private->refine_rect.width; x += REFINE_CHUNK_SIZE)
+        {
+          GeglRectangle chunk;
+
+          chunk.x      = private->refine_rect.x + x;
+          chunk.y      = private->refine_rect.y + y;
+          chunk.width  = MIN (REFINE_CHUNK_SIZE,
+                              private->refine_rect.width - x);
+          chunk.height = MIN (REFINE_CHUNK_SIZE,
+                              private->refine_rect.height - y);
+
+          g_array_append_val (chunks, chunk);
+        }
+    }
+
+  gimp_display_shell_unrotate_xy_f (shell,
+                                    shell->disp_width  / 2,
+                                    shell->disp_height / 2,
+                                    &center_x, &center_y);
+
+  center.x      = RINT (center_x);
+  center.y      = RINT (center_y);
+  center.width  = 0;
+  center.height = 0;
+
+  g_array_sort_with_data (chunks,
+                          (GCompareDataFunc)
+                          gimp_canvas_transform_preview_chunk_compare,
+                          &center);
+
+  bounds.x      = floor (private->x1);
+  bounds.y      = floor (private->y1);
+  bounds.width  = ceil (private->x2) - bounds.x;
+  bounds.height = ceil (private->y2) - bounds.y;
+
+  private->refine_job =
+    gimp_drawable_transform_job_new (private->drawable,
+                                     &bounds,
+                                     matrix,
+                                     private->interpolation,
+                                     babl_format ("cairo-ARGB32"),
+                                     cairo_image_surface_get_data (private->refine_surface),
+                                     GEGL_RECTANGLE (private->refine_rect.x,
+                                                     private->refine_rect.y,
+                                                     private->refine_rect.width,
+                                                     private->refine_rect.height),
+                                     cairo_image_surface_get_stride (private->refine_surface),
+                                     (const GeglRectangle *) chunks->data,
+                                     chunks->len,
+                                     (GimpDrawableTransformJobFunc)
+                                     gimp_canvas_transform_preview_refine_chunks,
+                                     item);
+
+  g_array_free (chunks, TRUE);
+}
+
+static void
+gimp_canvas_transform_preview_refine_stop (GimpCanvasItem *item)
+{
+  GimpCanvasTransformPreviewPrivate *private = GET_PRIVATE (item);
+
+  /*  the job must be stopped before its surface is destroyed  */
+  if (private->refine_job)
+    {
+      gimp_drawable_transform_job_cancel (private->refine_job);
+      private->refine_job = NULL;
+    }
+
+  if (private->refine_surface)
+    {
+      cairo_surface_destroy (private->refine_surface);
+      private->refine_surface = NULL;
+    }
+
+  if (private->refine_region)
+    {
+      cairo_region_destroy (private->refine_region);
+      private->refine_region = NULL;
+    }
+}
+
+/*  called from the main loop with the chunks the job has rendered  */
+static void
+gimp_canvas_transform_preview_refine_chunks (GimpDrawableTransformJob *job,
+                                             const GeglRectangle      *chunks,
+                                             gint                      n_chunks,
+                                             GimpCanvasItem           *item)
+{
+  GimpCanvasTransformPreviewPrivate *private = GET_PRIVATE (item);
+  cairo_region_t                    *update  = cairo_region_create ();
+  gint                               i;
+
+  for (i = 0; i < n_chunks; i++)
+    {
+      cairo_surface_mark_dirty_rectangle (private->refine_surface,
+                                          chunks[i].x - private->refine_rect.x,
+                                          chunks[i].y - private->refine_rect.y,
+                                          chunks[i].width,
+                                          chunks[i].height);
+
+      cairo_region_union_rectangle (update,
+                                    (cairo_rectangle_int_t *) &chunks[i]);
+    }
+
+  cairo_region_union (private->refine_region, update);
+
+  if (_gimp_canvas_item_needs_update (item))
+    _gimp_canvas_item_update (item, update);
+
+  cairo_region_destroy (update);
+}
+
+/*  orders chunks by the distance of their centers from 'center'  */
+static gint
+gimp_canvas_transform_preview_chunk_compare (const GeglRectangle *chunk1,
+                                             const GeglRectangle *chunk2,
+                                             const GeglRectangle *center)
+{
+  gint dx1 = chunk1->x + chunk1->width  / 2 - center->x;
+  gint dy1 = chunk1->y + chunk1->height / 2 - center->y;
+  gint dx2 = chunk2->x + chunk2->width  / 2 - center->x;
+  gint dy2 = chunk2->y + chunk2->height / 2 - center->y;
+
+  return (dx1 * dx1 + dy1 * dy1) - (dx2 * dx2 + dy2 * dy2);
+}
@@ -49,15 +49,16 @@ struct _GimpCanvasTransformPreviewClass
 
 GType            gimp_canvas_transform_preview_get_type (void) G_GNUC_CONST;
 
-GimpCanvasItem * gimp_canvas_transform_preview_new      (GimpDisplayShell  *shell,
-                                                         GimpDrawable      *drawable,
-                                                         const GimpMatrix3 *transform,
-                                                         gdouble            x1,
-                                                         gdouble            y1,
-                                                         gdouble            x2,
-                                                         gdouble            y2,
-                                                         gboolean           perspective,
-                                                         gdouble            opacity);
+GimpCanvasItem * gimp_canvas_transform_preview_new      (GimpDisplayShell      *shell,
+                                                         GimpDrawable          *drawable,
+                                                         const GimpMatrix3     *transform,
+                                                         gdouble                x1,
+                                                         gdouble                y1,
+                                                         gdouble                x2,
+                                                         gdouble                y2,
+                                                         gboolean               perspective,
+                                                         gdouble                opacity,
+                                                         GimpInterpolationType  interpolation);
 
 
 #endif /* __GIMP_CANVAS_TRANSFORM_PREVIEW_H__ */
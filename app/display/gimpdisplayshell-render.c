@@ -32,8 +32,8 @@
 
 #include "core/gimpdrawable.h"
 #include "core/gimpimage.h"
-#include "core/gimppickable.h"
 #include "core/gimpprojectable.h"
+#include "core/gimpprojection.h"
 
 #include "gimpdisplay.h"
 #include "gimpdisplayshell.h"
@@ -64,6 +64,7 @@ gimp_display_shell_render (GimpDisplayShell *shell,
   gdouble          scale_x       = 1.0;
   gdouble          scale_y       = 1.0;
   gdouble          buffer_scale  = 1.0;
+  gdouble          projection_scale;
   gint             viewport_offset_x;
   gint             viewport_offset_y;
   gint             viewport_width;
@@ -86,7 +87,6 @@ gimp_display_shell_render (GimpDisplayShell *shell,
   g_return_if_fail (w > 0 && h > 0);
 
   image  = gimp_display_get_image (shell->display);
-  buffer = gimp_pickable_get_buffer (GIMP_PICKABLE (image));
 #ifdef USE_NODE_BLIT
   node   = gimp_projectable_get_graph (GIMP_PROJECTABLE (image));
 #endif
@@ -116,6 +116,14 @@ gimp_display_shell_render (GimpDisplayShell *shell,
       buffer_scale = shell->scale_x * scale_x;
     }
 
+  /*  zoomed-out views are read from a reduced level of the projection,
+   *  at a scale relative to that level
+   */
+  projection_scale = buffer_scale;
+
+  buffer = gimp_projection_get_buffer_at_scale (gimp_image_get_projection (image),
+                                                &projection_scale);
+
   gimp_display_shell_scroll_get_scaled_viewport (shell,
                                                  &viewport_offset_x,
                                                  &viewport_offset_y,
@@ -201,7 +209,7 @@ gimp_display_shell_render (GimpDisplayShell *shell,
           gegl_buffer_get (buffer,
                            GEGL_RECTANGLE (scaled_x, scaled_y,
                                            scaled_width, scaled_height),
-                           buffer_scale,
+                           projection_scale,
                            gimp_projectable_get_format (GIMP_PROJECTABLE (image)),
                            shell->profile_data, shell->profile_stride,
                            GEGL_ABYSS_CLAMP);
@@ -255,7 +263,7 @@ gimp_display_shell_render (GimpDisplayShell *shell,
           gegl_buffer_get (buffer,
                            GEGL_RECTANGLE (scaled_x, scaled_y,
                                            scaled_width, scaled_height),
-                           buffer_scale,
+                           projection_scale,
                            shell->filter_format,
                            shell->filter_data, shell->filter_stride,
                            GEGL_ABYSS_CLAMP);
@@ -304,7 +312,7 @@ gimp_display_shell_render (GimpDisplayShell *shell,
       gegl_buffer_get (buffer,
                        GEGL_RECTANGLE (scaled_x, scaled_y,
                                        scaled_width, scaled_height),
-                       buffer_scale,
+                       projection_scale,
                        babl_format ("cairo-ARGB32"),
                        cairo_data, cairo_stride,
                        GEGL_ABYSS_CLAMP);
@@ -42,6 +42,8 @@
 
 #include "plug-in/gimppluginprocedure.h"
 
+#include "xcf/xcf.h"
+
 #include "file-remote.h"
 #include "file-save.h"
 #include "gimp-file.h"
@@ -167,6 +169,9 @@ file_save (Gimp                *gimp,
 
   uri = g_file_get_uri (file);
 
+  /*  an image loaded from the file may still read tiles from it  */
+  xcf_detach_file (file);
+
   image_ID    = gimp_image_get_ID (image);
   drawable_ID = gimp_item_get_ID (GIMP_ITEM (drawable));
 
@@ -20,6 +20,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <cairo.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <gegl.h>
@@ -31,191 +33,430 @@
 
 #include "gimp-babl.h"
 #include "gimp-gegl-loops.h"
+#include "gimp-gegl-mask.h"
 
+#include "core/gimp-parallel.h"
 #include "core/gimpprogress.h"
 
 
-void
-gimp_gegl_convolve (GeglBuffer          *src_buffer,
-                    const GeglRectangle *src_rect,
-                    GeglBuffer          *dest_buffer,
-                    const GeglRectangle *dest_rect,
-                    const gfloat        *kernel,
-                    gint                 kernel_size,
-                    gdouble              divisor,
-                    GimpConvolutionType  mode,
-                    gboolean             alpha_weighting)
-{
-  GeglBufferIterator *dest_iter;
-  gfloat             *src;
-  gint                src_rowstride;
+/*  the size of the blocks of dest pixels gimp_gegl_convolve() computes
+ *  at once, which bounds the size of the source halo it has to fetch
+ */
+#define CONVOLVE_BLOCK_SIZE    128
 
-  const Babl         *src_format;
-  const Babl         *dest_format;
-  gint                src_components;
-  gint                dest_components;
+/*  the smallest area worth to be split across threads  */
+#define CONVOLVE_MIN_SUB_AREA  (64 * 64)
 
-  src_format = gegl_buffer_get_format (src_buffer);
 
-  if (babl_format_is_palette (src_format))
-    src_format = gimp_babl_format (GIMP_RGB,
-                                   GIMP_PRECISION_FLOAT_LINEAR,
-                                   babl_format_has_alpha (src_format));
-  else
-    src_format = gimp_babl_format (gimp_babl_format_get_base_type (src_format),
-                                   GIMP_PRECISION_FLOAT_LINEAR,
-                                   babl_format_has_alpha (src_format));
+typedef struct
+{
+  GeglBuffer          *src_buffer;
+  const GeglRectangle *src_rect;
+  const Babl          *src_format;
+  gint                 components;
+  GeglBuffer          *dest_buffer;
+  const gfloat        *kernel;
+  const gfloat        *kernel_x;   /*  NULL if the kernel isn't separable  */
+  const gfloat        *kernel_y;
+  gint                 kernel_size;
+  gdouble              divisor;
+  GimpConvolutionType  mode;
+  gfloat               offset;
+  gboolean             alpha_weighting;
+} ConvolveData;
+
+typedef struct
+{
+  GeglBuffer          *mask_buffer;
+  const GeglRectangle *mask_rect;
+  GeglBuffer          *dest_buffer;
+  const GeglRectangle *dest_rect;
+  const Babl          *dest_format;
+  gint                 dest_components;
+  gdouble              opacity;
+} MaskData;
+
+
+/*  splits 'kernel' into a column vector 'kernel_y' and a row vector
+ *  'kernel_x' whose product is 'kernel', if it has rank one, like
+ *  box and gaussian kernels do.
+ */
+static gboolean
+gimp_gegl_convolve_separate (const gfloat *kernel,
+                             gint          kernel_size,
+                             gfloat       *kernel_x,
+                             gfloat       *kernel_y)
+{
+  gfloat pivot     = 0.0;
+  gint   pivot_row = 0;
+  gint   pivot_col = 0;
+  gint   i, j;
+
+  for (j = 0; j < kernel_size; j++)
+    for (i = 0; i < kernel_size; i++)
+      if (fabs (kernel[j * kernel_size + i]) > fabs (pivot))
+        {
+          pivot     = kernel[j * kernel_size + i];
+          pivot_row = j;
+          pivot_col = i;
+        }
 
-  dest_format = gegl_buffer_get_format (dest_buffer);
+  if (pivot == 0.0)
+    return FALSE;
 
-  if (babl_format_is_palette (dest_format))
-    dest_format = gimp_babl_format (GIMP_RGB,
-                                    GIMP_PRECISION_FLOAT_LINEAR,
-                                    babl_format_has_alpha (dest_format));
-  else
-    dest_format = gimp_babl_format (gimp_babl_format_get_base_type (dest_format),
-                                    GIMP_PRECISION_FLOAT_LINEAR,
-                                    babl_format_has_alpha (dest_format));
+  for (j = 0; j < kernel_size; j++)
+    kernel_y[j] = kernel[j * kernel_size + pivot_col];
 
-  src_components  = babl_format_get_n_components (src_format);
-  dest_components = babl_format_get_n_components (dest_format);
+  for (i = 0; i < kernel_size; i++)
+    kernel_x[i] = kernel[pivot_row * kernel_size + i] / pivot;
 
-  /* Set up dest iterator */
-  dest_iter = gegl_buffer_iterator_new (dest_buffer, dest_rect, 0, dest_format,
-                                        GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
+  for (j = 0; j < kernel_size; j++)
+    for (i = 0; i < kernel_size; i++)
+      {
+        if (fabs (kernel_y[j] * kernel_x[i] - kernel[j * kernel_size + i]) >
+            fabs (pivot) * 1e-6)
+          return FALSE;
+      }
 
-  /* Get source pixel data */
-  src_rowstride = src_components * src_rect->width;
-  src = g_malloc (sizeof(gfloat) * src_rowstride * src_rect->height);
-  gegl_buffer_get (src_buffer, src_rect, 1.0, src_format, src,
-                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+  return TRUE;
+}
+
+/*  accumulates the source pixel 's' with the weight 'm' into 'total'  */
+static inline void
+gimp_gegl_convolve_add (const ConvolveData *data,
+                        gdouble            *total,
+                        const gfloat       *s,
+                        gdouble             m)
+{
+  const gint components = data->components;
+  gint       b;
 
-  while (gegl_buffer_iterator_next (dest_iter))
+  if (data->alpha_weighting)
     {
-      /*  Convolve the src image using the convolution kernel, writing
-       *  to dest Convolve is not tile-enabled--use accordingly
-       */
-      gfloat       *dest        = dest_iter->data[0];
-      const gint    components  = src_components;
-      const gint    a_component = components - 1;
-      const gint    margin      = kernel_size / 2;
-      const gint    x1          = 0;
-      const gint    y1          = 0;
-      const gint    x2          = src_rect->width  - 1;
-      const gint    y2          = src_rect->height - 1;
-      const gint    dest_x1     = dest_iter->roi[0].x;
-      const gint    dest_y1     = dest_iter->roi[0].y;
-      const gint    dest_x2     = dest_iter->roi[0].x + dest_iter->roi[0].width;
-      const gint    dest_y2     = dest_iter->roi[0].y + dest_iter->roi[0].height;
-      gint          x, y;
-      gfloat        offset;
-
-      /*  If the mode is NEGATIVE_CONVOL, the offset should be 128  */
-      if (mode == GIMP_NEGATIVE_CONVOL)
-        {
-          offset = 0.5;
-          mode = GIMP_NORMAL_CONVOL;
-        }
-      else
-        {
-          offset = 0.0;
-        }
+      const gint   a_component = components - 1;
+      const gfloat a           = s[a_component];
 
-      for (y = dest_y1; y < dest_y2; y++)
+      if (a)
         {
-          gfloat *d = dest;
+          gdouble mult_alpha = m * a;
 
-          if (alpha_weighting)
-            {
-              for (x = dest_x1; x < dest_x2; x++)
-                {
-                  const gfloat *m                = kernel;
-                  gdouble       total[4]         = { 0.0, 0.0, 0.0, 0.0 };
-                  gdouble       weighted_divisor = 0.0;
-                  gint          i, j, b;
+          for (b = 0; b < a_component; b++)
+            total[b] += mult_alpha * s[b];
 
-                  for (j = y - margin; j <= y + margin; j++)
-                    {
-                      for (i = x - margin; i <= x + margin; i++, m++)
-                        {
-                          gint          xx = CLAMP (i, x1, x2);
-                          gint          yy = CLAMP (j, y1, y2);
-                          const gfloat *s  = src + yy * src_rowstride + xx * components;
-                          const gfloat  a  = s[a_component];
+          /*  this is the weighted divisor  */
+          total[a_component] += mult_alpha;
+        }
+    }
+  else
+    {
+      for (b = 0; b < components; b++)
+        total[b] += m * s[b];
+    }
+}
+
+static inline void
+gimp_gegl_convolve_store (const ConvolveData *data,
+                          gdouble            *total,
+                          gfloat             *d)
+{
+  const gint components = data->components;
+  gint       b;
 
-                          if (a)
-                            {
-                              gdouble mult_alpha = *m * a;
+  if (data->alpha_weighting)
+    {
+      const gint a_component      = components - 1;
+      gdouble    weighted_divisor = total[a_component];
 
-                              weighted_divisor += mult_alpha;
+      if (weighted_divisor == 0.0)
+        weighted_divisor = data->divisor;
 
-                              for (b = 0; b < a_component; b++)
-                                total[b] += mult_alpha * s[b];
+      for (b = 0; b < a_component; b++)
+        total[b] /= weighted_divisor;
 
-                              total[a_component] += mult_alpha;
-                            }
-                        }
-                    }
+      total[a_component] /= data->divisor;
+    }
+  else
+    {
+      for (b = 0; b < components; b++)
+        total[b] /= data->divisor;
+    }
 
-                  if (weighted_divisor == 0.0)
-                    weighted_divisor = divisor;
+  for (b = 0; b < components; b++)
+    {
+      total[b] += data->offset;
 
-                  for (b = 0; b < a_component; b++)
-                    total[b] /= weighted_divisor;
+      if (data->mode != GIMP_NORMAL_CONVOL && total[b] < 0.0)
+        total[b] = - total[b];
 
-                  total[a_component] /= divisor;
+      d[b] = CLAMP (total[b], 0.0, 1.0);
+    }
+}
 
-                  for (b = 0; b < components; b++)
-                    {
-                      total[b] += offset;
+/*  convolves 'block' into 'dest', 'src' contains the 'halo' part of
+ *  the source rect, which covers the block and its margin, clamped to
+ *  the source rect.  Source pixels outside of the halo are clamped to
+ *  its edges, which are the source rect's edges.
+ */
+static void
+gimp_gegl_convolve_block (const ConvolveData  *data,
+                          const gfloat        *src,
+                          const GeglRectangle *halo,
+                          gfloat              *dest,
+                          const GeglRectangle *block)
+{
+  const gint  components = data->components;
+  const gint  margin     = data->kernel_size / 2;
+  const gint  x1         = halo->x;
+  const gint  y1         = halo->y;
+  const gint  x2         = halo->x + halo->width  - 1;
+  const gint  y2         = halo->y + halo->height - 1;
+  gfloat     *d          = dest;
+  gint        x, y;
+
+  for (y = block->y; y < block->y + block->height; y++)
+    {
+      for (x = block->x; x < block->x + block->width; x++)
+        {
+          const gfloat *m        = data->kernel;
+          gdouble       total[4] = { 0.0, 0.0, 0.0, 0.0 };
+          gint          i, j;
 
-                      if (mode != GIMP_NORMAL_CONVOL && total[b] < 0.0)
-                        total[b] = - total[b];
+          for (j = y - margin; j <= y + margin; j++)
+            {
+              const gfloat *row = src + (CLAMP (j, y1, y2) - y1) *
+                                        halo->width * components;
 
-                      *d++ = CLAMP (total[b], 0.0, 1.0);
-                    }
+              for (i = x - margin; i <= x + margin; i++, m++)
+                {
+                  const gfloat *s = row + (CLAMP (i, x1, x2) - x1) * components;
+
+                  gimp_gegl_convolve_add (data, total, s, *m);
                 }
             }
-          else
-            {
-              for (x = dest_x1; x < dest_x2; x++)
-                {
-                  const gfloat *m        = kernel;
-                  gdouble       total[4] = { 0.0, 0.0, 0.0, 0.0 };
-                  gint          i, j, b;
 
-                  for (j = y - margin; j <= y + margin; j++)
-                    {
-                      for (i = x - margin; i <= x + margin; i++, m++)
-                        {
-                          gint          xx = CLAMP (i, x1, x2);
-                          gint          yy = CLAMP (j, y1, y2);
-                          const gfloat *s  = src + yy * src_rowstride + xx * components;
-
-                          for (b = 0; b < components; b++)
-                            total[b] += *m * s[b];
-                        }
-                    }
+          gimp_gegl_convolve_store (data, total, d);
 
-                  for (b = 0; b < components; b++)
-                    {
-                      total[b] = total[b] / divisor + offset;
+          d += components;
+        }
+    }
+}
+
+/*  like gimp_gegl_convolve_block(), but for separable kernels, using
+ *  a horizontal pass into 'temp', followed by a vertical pass
+ */
+static void
+gimp_gegl_convolve_block_separable (const ConvolveData  *data,
+                                    const gfloat        *src,
+                                    const GeglRectangle *halo,
+                                    gfloat              *dest,
+                                    const GeglRectangle *block,
+                                    gdouble             *temp)
+{
+  const gint  components = data->components;
+  const gint  margin     = data->kernel_size / 2;
+  const gint  x1         = halo->x;
+  const gint  y1         = halo->y;
+  const gint  x2         = halo->x + halo->width  - 1;
+  const gint  y2         = halo->y + halo->height - 1;
+  const gint  n_rows     = block->height + 2 * margin;
+  const gint  rowstride  = block->width * components;
+  gdouble    *t          = temp;
+  gfloat     *d          = dest;
+  gint        x, y;
+  gint        row;
+
+  memset (temp, 0, n_rows * rowstride * sizeof (gdouble));
+
+  for (row = 0; row < n_rows; row++)
+    {
+      const gint    j = block->y - margin + row;
+      const gfloat *s = src + (CLAMP (j, y1, y2) - y1) *
+                              halo->width * components;
 
-                      if (mode != GIMP_NORMAL_CONVOL && total[b] < 0.0)
-                        total[b] = - total[b];
+      for (x = block->x; x < block->x + block->width; x++)
+        {
+          gint i;
 
-                      *d++ = CLAMP (total[b], 0.0, 1.0);
-                    }
-                }
+          for (i = 0; i < data->kernel_size; i++)
+            {
+              gint xx = CLAMP (x - margin + i, x1, x2);
+
+              gimp_gegl_convolve_add (data, t,
+                                      s + (xx - x1) * components,
+                                      data->kernel_x[i]);
             }
 
-          dest += dest_iter->roi[0].width * dest_components;
+          t += components;
+        }
+    }
+
+  for (y = 0; y < block->height; y++)
+    {
+      for (x = 0; x < block->width; x++)
+        {
+          gdouble total[4] = { 0.0, 0.0, 0.0, 0.0 };
+          gint    j, b;
+
+          t = temp + (y * block->width + x) * components;
+
+          for (j = 0; j < data->kernel_size; j++, t += rowstride)
+            for (b = 0; b < components; b++)
+              total[b] += data->kernel_y[j] * t[b];
+
+          gimp_gegl_convolve_store (data, total, d);
+
+          d += components;
         }
     }
+}
 
+static void
+gimp_gegl_convolve_area (const GeglRectangle *area,
+                         gpointer             user_data)
+{
+  const ConvolveData  *data       = user_data;
+  const GeglRectangle *src_rect   = data->src_rect;
+  const gint           components = data->components;
+  const gint           margin     = data->kernel_size / 2;
+  const gint           halo_size  = CONVOLVE_BLOCK_SIZE + 2 * margin;
+  gfloat              *src;
+  gfloat              *dest;
+  gdouble             *temp       = NULL;
+  gint                 x, y;
+
+  src  = g_new (gfloat, halo_size * halo_size * components);
+  dest = g_new (gfloat,
+                CONVOLVE_BLOCK_SIZE * CONVOLVE_BLOCK_SIZE * components);
+
+  if (data->kernel_x)
+    temp = g_new (gdouble, halo_size * CONVOLVE_BLOCK_SIZE * components);
+
+  for (y = area->y; y < area->y + area->height; y += CONVOLVE_BLOCK_SIZE)
+    for (x = area->x; x < area->x + area->width; x += CONVOLVE_BLOCK_SIZE)
+      {
+        GeglRectangle block;
+        GeglRectangle halo;
+        gint          halo_x2, halo_y2;
+
+        block.x      = x;
+        block.y      = y;
+        block.width  = MIN (CONVOLVE_BLOCK_SIZE, area->x + area->width  - x);
+        block.height = MIN (CONVOLVE_BLOCK_SIZE, area->y + area->height - y);
+
+        /*  dest pixels are convolved from the source pixels at the same
+         *  position relative to the source rect
+         */
+        halo.x  = CLAMP (block.x - margin, 0, src_rect->width  - 1);
+        halo.y  = CLAMP (block.y - margin, 0, src_rect->height - 1);
+        halo_x2 = CLAMP (block.x + block.width  - 1 + margin,
+                         0, src_rect->width  - 1);
+        halo_y2 = CLAMP (block.y + block.height - 1 + margin,
+                         0, src_rect->height - 1);
+
+        halo.width  = halo_x2 - halo.x + 1;
+        halo.height = halo_y2 - halo.y + 1;
+
+        gegl_buffer_get (data->src_buffer,
+                         GEGL_RECTANGLE (src_rect->x + halo.x,
+                                         src_rect->y + halo.y,
+                                         halo.width, halo.height),
+                         1.0, data->src_format, src,
+                         GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+        if (data->kernel_x)
+          gimp_gegl_convolve_block_separable (data, src, &halo,
+                                              dest, &block, temp);
+        else
+          gimp_gegl_convolve_block (data, src, &halo, dest, &block);
+
+        gegl_buffer_set (data->dest_buffer, &block, 0,
+                         data->src_format, dest, GEGL_AUTO_ROWSTRIDE);
+      }
+
+  g_free (temp);
+  g_free (dest);
   g_free (src);
 }
 
+void
+gimp_gegl_convolve (GeglBuffer          *src_buffer,
+                    const GeglRectangle *src_rect,
+                    GeglBuffer          *dest_buffer,
+                    const GeglRectangle *dest_rect,
+                    const gfloat        *kernel,
+                    gint                 kernel_size,
+                    gdouble              divisor,
+                    GimpConvolutionType  mode,
+                    gboolean             alpha_weighting)
+{
+  ConvolveData  data;
+  const Babl   *src_format;
+  gfloat       *kernel_x;
+  gfloat       *kernel_y;
+
+  g_return_if_fail (GEGL_IS_BUFFER (src_buffer));
+  g_return_if_fail (src_rect != NULL);
+  g_return_if_fail (GEGL_IS_BUFFER (dest_buffer));
+  g_return_if_fail (dest_rect != NULL);
+  g_return_if_fail (kernel != NULL);
+  g_return_if_fail (kernel_size > 0);
+
+  if (gegl_rectangle_is_empty (src_rect) ||
+      gegl_rectangle_is_empty (dest_rect))
+    return;
+
+  src_format = gegl_buffer_get_format (src_buffer);
+
+  if (babl_format_is_palette (src_format))
+    src_format = gimp_babl_format (GIMP_RGB,
+                                   GIMP_PRECISION_FLOAT_LINEAR,
+                                   babl_format_has_alpha (src_format));
+  else
+    src_format = gimp_babl_format (gimp_babl_format_get_base_type (src_format),
+                                   GIMP_PRECISION_FLOAT_LINEAR,
+                                   babl_format_has_alpha (src_format));
+
+  data.src_buffer      = src_buffer;
+  data.src_rect        = src_rect;
+  data.src_format      = src_format;
+  data.components      = babl_format_get_n_components (src_format);
+  data.dest_buffer     = dest_buffer;
+  data.kernel          = kernel;
+  data.kernel_x        = NULL;
+  data.kernel_y        = NULL;
+  data.kernel_size     = kernel_size;
+  data.divisor         = divisor;
+  data.alpha_weighting = alpha_weighting;
+
+  /*  If the mode is NEGATIVE_CONVOL, the offset should be 128  */
+  if (mode == GIMP_NEGATIVE_CONVOL)
+    {
+      data.offset = 0.5;
+      data.mode   = GIMP_NORMAL_CONVOL;
+    }
+  else
+    {
+      data.offset = 0.0;
+      data.mode   = mode;
+    }
+
+  kernel_x = g_new (gfloat, kernel_size);
+  kernel_y = g_new (gfloat, kernel_size);
+
+  if (kernel_size > 1 &&
+      gimp_gegl_convolve_separate (kernel, kernel_size, kernel_x, kernel_y))
+    {
+      data.kernel_x = kernel_x;
+      data.kernel_y = kernel_y;
+    }
+
+  gimp_parallel_distribute_area (dest_rect, CONVOLVE_MIN_SUB_AREA,
+                                 gimp_gegl_convolve_area, &data);
+
+  g_free (kernel_y);
+  g_free (kernel_x);
+}
+
 void
 gimp_gegl_dodgeburn (GeglBuffer          *src_buffer,
                      const GeglRectangle *src_rect,
@@ -404,39 +645,110 @@ gimp_gegl_smudge_blend (GeglBuffer          *top_buffer,
     }
 }
 
-void
-gimp_gegl_apply_mask (GeglBuffer          *mask_buffer,
-                      const GeglRectangle *mask_rect,
-                      GeglBuffer          *dest_buffer,
-                      const GeglRectangle *dest_rect,
-                      gdouble              opacity)
+/*  multiplies the last component of the dest pixels with the mask,
+ *  which is looked at only where its tiles are not uniform
+ */
+static void
+gimp_gegl_mask_area (const GeglRectangle *mask_area,
+                     GimpMaskTileState    state,
+                     MaskData            *data)
 {
   GeglBufferIterator *iter;
+  GeglRectangle       dest_area;
+  const gint          n = data->dest_components;
 
-  iter = gegl_buffer_iterator_new (mask_buffer, mask_rect, 0,
-                                   babl_format ("Y float"),
-                                   GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
+  if (state == GIMP_MASK_TILE_FULL && data->opacity == 1.0)
+    return;
 
-  gegl_buffer_iterator_add (iter, dest_buffer, dest_rect, 0,
-                            babl_format ("RGBA float"),
-                            GEGL_ACCESS_READWRITE, GEGL_ABYSS_NONE);
+  dest_area    = *mask_area;
+  dest_area.x += data->dest_rect->x - data->mask_rect->x;
+  dest_area.y += data->dest_rect->y - data->mask_rect->y;
 
-  while (gegl_buffer_iterator_next (iter))
+  iter = gegl_buffer_iterator_new (data->dest_buffer, &dest_area, 0,
+                                   data->dest_format,
+                                   GEGL_ACCESS_READWRITE, GEGL_ABYSS_NONE);
+
+  if (state == GIMP_MASK_TILE_MIXED)
     {
-      const gfloat *mask  = iter->data[0];
-      gfloat       *dest  = iter->data[1];
-      gint          count = iter->length;
+      gegl_buffer_iterator_add (iter, data->mask_buffer, mask_area, 0,
+                                babl_format ("Y float"),
+                                GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
 
-      while (count--)
+      while (gegl_buffer_iterator_next (iter))
         {
-          dest[3] *= *mask * opacity;
+          gfloat       *dest  = iter->data[0];
+          const gfloat *mask  = iter->data[1];
+          gint          count = iter->length;
+
+          while (count--)
+            {
+              dest[n - 1] *= *mask * data->opacity;
 
-          mask += 1;
-          dest += 4;
+              mask += 1;
+              dest += n;
+            }
+        }
+    }
+  else
+    {
+      const gfloat value = (state == GIMP_MASK_TILE_FULL) ? 1.0 : 0.0;
+
+      while (gegl_buffer_iterator_next (iter))
+        {
+          gfloat *dest  = iter->data[0];
+          gint    count = iter->length;
+
+          while (count--)
+            {
+              dest[n - 1] *= value * data->opacity;
+
+              dest += n;
+            }
         }
     }
 }
 
+static void
+gimp_gegl_mask_buffer (GeglBuffer          *mask_buffer,
+                       const GeglRectangle *mask_rect,
+                       GeglBuffer          *dest_buffer,
+                       const GeglRectangle *dest_rect,
+                       const Babl          *dest_format,
+                       gdouble              opacity)
+{
+  MaskData data;
+
+  if (! mask_rect)
+    mask_rect = gegl_buffer_get_extent (mask_buffer);
+
+  if (! dest_rect)
+    dest_rect = gegl_buffer_get_extent (dest_buffer);
+
+  data.mask_buffer     = mask_buffer;
+  data.mask_rect       = mask_rect;
+  data.dest_buffer     = dest_buffer;
+  data.dest_rect       = dest_rect;
+  data.dest_format     = dest_format;
+  data.dest_components = babl_format_get_n_components (dest_format);
+  data.opacity         = opacity;
+
+  gimp_gegl_mask_foreach_area (mask_buffer, mask_rect,
+                               (GimpMaskAreaFunc) gimp_gegl_mask_area,
+                               &data);
+}
+
+void
+gimp_gegl_apply_mask (GeglBuffer          *mask_buffer,
+                      const GeglRectangle *mask_rect,
+                      GeglBuffer          *dest_buffer,
+                      const GeglRectangle *dest_rect,
+                      gdouble              opacity)
+{
+  gimp_gegl_mask_buffer (mask_buffer, mask_rect,
+                         dest_buffer, dest_rect, babl_format ("RGBA float"),
+                         opacity);
+}
+
 void
 gimp_gegl_combine_mask (GeglBuffer          *mask_buffer,
                         const GeglRectangle *mask_rect,
@@ -444,30 +756,9 @@ gimp_gegl_combine_mask (GeglBuffer          *mask_buffer,
                         const GeglRectangle *dest_rect,
                         gdouble              opacity)
 {
-  GeglBufferIterator *iter;
-
-  iter = gegl_buffer_iterator_new (mask_buffer, mask_rect, 0,
-                                   babl_format ("Y float"),
-                                   GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
-
-  gegl_buffer_iterator_add (iter, dest_buffer, dest_rect, 0,
-                            babl_format ("Y float"),
-                            GEGL_ACCESS_READWRITE, GEGL_ABYSS_NONE);
-
-  while (gegl_buffer_iterator_next (iter))
-    {
-      const gfloat *mask  = iter->data[0];
-      gfloat       *dest  = iter->data[1];
-      gint          count = iter->length;
-
-      while (count--)
-        {
-          *dest *= *mask * opacity;
-
-          mask += 1;
-          dest += 1;
-        }
-    }
+  gimp_gegl_mask_buffer (mask_buffer, mask_rect,
+                         dest_buffer, dest_rect, babl_format ("Y float"),
+                         opacity);
 }
 
 void
@@ -22,8 +22,10 @@
 #define __GIMP_GEGL_LOOPS_H__
 
 
-/*  this is a pretty stupid port of concolve_region() that only works
- *  on a linear source buffer
+/*  convolves 'src_rect' of 'src_buffer' into 'dest_rect' of 'dest_buffer'
+ *  block by block, using multiple threads, and in two passes if 'kernel'
+ *  is separable.  Source pixels outside 'src_rect' are clamped to its
+ *  edges.
  */
 void   gimp_gegl_convolve              (GeglBuffer               *src_buffer,
                                         const GeglRectangle      *src_rect,
@@ -0,0 +1,122 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimp-gegl-mask-combine-sse2.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gegl.h>
+
+#include "gimp-gegl-types.h"
+
+#include "gimp-gegl-mask-combine.h"
+
+#if COMPILE_SSE2_INTRINISICS
+/* SSE2 */
+#include <emmintrin.h>
+
+
+/*  The SSE2 variants of the span kernels process four mask values at
+ *  once, and the remaining ones like the generic variants do.
+ */
+
+void
+gimp_gegl_mask_combine_add_span_sse2 (gfloat       *mask,
+                                      const gfloat *add_on,
+                                      gint          count)
+{
+  const __m128 zero = _mm_setzero_ps ();
+  const __m128 one  = _mm_set1_ps (1.0f);
+
+  for (; count >= 4; count -= 4, mask += 4, add_on += 4)
+    {
+      __m128 val = _mm_add_ps (_mm_loadu_ps (mask), _mm_loadu_ps (add_on));
+
+      _mm_storeu_ps (mask, _mm_min_ps (_mm_max_ps (val, zero), one));
+    }
+
+  gimp_gegl_mask_combine_add_span (mask, add_on, count);
+}
+
+void
+gimp_gegl_mask_combine_subtract_span_sse2 (gfloat       *mask,
+                                           const gfloat *add_on,
+                                           gint          count)
+{
+  const __m128 zero = _mm_setzero_ps ();
+
+  for (; count >= 4; count -= 4, mask += 4, add_on += 4)
+    {
+      __m128 val = _mm_sub_ps (_mm_loadu_ps (mask), _mm_loadu_ps (add_on));
+
+      _mm_storeu_ps (mask, _mm_max_ps (val, zero));
+    }
+
+  gimp_gegl_mask_combine_subtract_span (mask, add_on, count);
+}
+
+void
+gimp_gegl_mask_combine_intersect_span_sse2 (gfloat       *mask,
+                                            const gfloat *add_on,
+                                            gint          count)
+{
+  for (; count >= 4; count -= 4, mask += 4, add_on += 4)
+    {
+      _mm_storeu_ps (mask, _mm_min_ps (_mm_loadu_ps (mask),
+                                       _mm_loadu_ps (add_on)));
+    }
+
+  gimp_gegl_mask_combine_intersect_span (mask, add_on, count);
+}
+
+void
+gimp_gegl_mask_combine_add_value_span_sse2 (gfloat *mask,
+                                            gfloat  value,
+                                            gint    count)
+{
+  const __m128 one = _mm_set1_ps (1.0f);
+  const __m128 v   = _mm_set1_ps (value);
+
+  for (; count >= 4; count -= 4, mask += 4)
+    {
+      __m128 val = _mm_add_ps (_mm_loadu_ps (mask), v);
+
+      _mm_storeu_ps (mask, _mm_min_ps (val, one));
+    }
+
+  gimp_gegl_mask_combine_add_value_span (mask, value, count);
+}
+
+void
+gimp_gegl_mask_combine_subtract_value_span_sse2 (gfloat *mask,
+                                                 gfloat  value,
+                                                 gint    count)
+{
+  const __m128 zero = _mm_setzero_ps ();
+  const __m128 v    = _mm_set1_ps (value);
+
+  for (; count >= 4; count -= 4, mask += 4)
+    {
+      __m128 val = _mm_sub_ps (_mm_loadu_ps (mask), v);
+
+      _mm_storeu_ps (mask, _mm_max_ps (val, zero));
+    }
+
+  gimp_gegl_mask_combine_subtract_value_span (mask, value, count);
+}
+
+#endif /* COMPILE_SSE2_INTRINISICS */
@@ -27,9 +27,90 @@
 
 #include "gimp-gegl-types.h"
 
+#include "core/gimp-parallel.h"
+
+#include "gimp-gegl-mask.h"
 #include "gimp-gegl-mask-combine.h"
 
 
+#define MASK_COMBINE_MIN_SUB_AREA (64 * 64)
+
+
+typedef void (* GimpMaskCombineSpanFunc)      (gfloat       *mask,
+                                               const gfloat *add_on,
+                                               gint          count);
+typedef void (* GimpMaskCombineValueSpanFunc) (gfloat       *mask,
+                                               gfloat        value,
+                                               gint          count);
+
+typedef struct
+{
+  GimpMaskCombineSpanFunc      add;
+  GimpMaskCombineSpanFunc      subtract;
+  GimpMaskCombineSpanFunc      intersect;
+  GimpMaskCombineValueSpanFunc add_value;
+  GimpMaskCombineValueSpanFunc subtract_value;
+} GimpMaskCombineKernels;
+
+typedef struct
+{
+  const GimpMaskCombineKernels *kernels;
+  GeglBuffer                   *mask;
+  GimpChannelOps                op;
+  gint                          x;
+  gint                          y;
+  gint                          w;
+  gint                          h;
+  gdouble                       a;
+  gdouble                       b;
+  gdouble                       a_sqr;
+  gdouble                       b_sqr;
+  gboolean                      antialias;
+} EllipseRectData;
+
+typedef struct
+{
+  GimpMaskCombineSpanFunc  func;
+  GeglBuffer              *mask;
+  GeglBuffer              *add_on;
+  gint                     off_x;
+  gint                     off_y;
+} CombineBufferData;
+
+
+/*  returns the fastest span kernels supported by the CPU  */
+static const GimpMaskCombineKernels *
+gimp_gegl_mask_combine_get_kernels (void)
+{
+  static GimpMaskCombineKernels kernels;
+  static gsize                  initialized = 0;
+
+  if (g_once_init_enter (&initialized))
+    {
+      kernels.add            = gimp_gegl_mask_combine_add_span;
+      kernels.subtract       = gimp_gegl_mask_combine_subtract_span;
+      kernels.intersect      = gimp_gegl_mask_combine_intersect_span;
+      kernels.add_value      = gimp_gegl_mask_combine_add_value_span;
+      kernels.subtract_value = gimp_gegl_mask_combine_subtract_value_span;
+
+#if COMPILE_SSE2_INTRINISICS
+      if (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_SSE2)
+        {
+          kernels.add            = gimp_gegl_mask_combine_add_span_sse2;
+          kernels.subtract       = gimp_gegl_mask_combine_subtract_span_sse2;
+          kernels.intersect      = gimp_gegl_mask_combine_intersect_span_sse2;
+          kernels.add_value      = gimp_gegl_mask_combine_add_value_span_sse2;
+          kernels.subtract_value = gimp_gegl_mask_combine_subtract_value_span_sse2;
+        }
+#endif /* COMPILE_SSE2_INTRINISICS */
+
+      g_once_init_leave (&initialized, 1);
+    }
+
+  return &kernels;
+}
+
+
 gboolean
 gimp_gegl_mask_combine_rect (GeglBuffer     *mask,
                              GimpChannelOps  op,
@@ -38,8 +119,6 @@ gimp_gegl_mask_combine_rect (GeglBuffer     *mask,
                              gint            w,
                              gint            h)
 {
-  GeglColor *color;
-
   g_return_val_if_fail (GEGL_IS_BUFFER (mask), FALSE);
 
   if (! gimp_rectangle_intersect (x, y, w, h,
@@ -49,13 +128,9 @@ gimp_gegl_mask_combine_rect (GeglBuffer     *mask,
                                   &x, &y, &w, &h))
     return FALSE;
 
-  if (op == GIMP_CHANNEL_OP_ADD || op == GIMP_CHANNEL_OP_REPLACE)
-    color = gegl_color_new ("#fff");
-  else
-    color = gegl_color_new ("#000");
-
-  gegl_buffer_set_color (mask, GEGL_RECTANGLE (x, y, w, h), color);
-  g_object_unref (color);
+  gimp_gegl_mask_fill (mask, GEGL_RECTANGLE (x, y, w, h),
+                       op == GIMP_CHANNEL_OP_ADD ||
+                       op == GIMP_CHANNEL_OP_REPLACE);
 
   return TRUE;
 }
@@ -92,11 +167,12 @@ gimp_gegl_mask_combine_ellipse (GeglBuffer     *mask,
 }
 
 static void
-gimp_gegl_mask_combine_span (gfloat         *data,
-                             GimpChannelOps  op,
-                             gint            x1,
-                             gint            x2,
-                             gfloat          value)
+gimp_gegl_mask_combine_span (const GimpMaskCombineKernels *kernels,
+                             gfloat                       *data,
+                             GimpChannelOps                op,
+                             gint                          x1,
+                             gint                          x2,
+                             gfloat                        value)
 {
   if (x2 <= x1)
     return;
@@ -112,27 +188,18 @@ gimp_gegl_mask_combine_span (gfloat         *data,
         }
       else
         {
-          while (x1 < x2)
-            {
-              const gfloat val = data[x1] + value;
-              data[x1++] = val > 1.0 ? 1.0 : val;
-            }
+          kernels->add_value (data + x1, value, x2 - x1);
         }
       break;
 
     case GIMP_CHANNEL_OP_SUBTRACT:
       if (value == 1.0)
         {
-          while (x1 < x2)
-            data[x1++] = 0.0;
+          memset (data + x1, 0, (x2 - x1) * sizeof (gfloat));
         }
       else
         {
-          while (x1 < x2)
-            {
-              const gfloat val = data[x1] - value;
-              data[x1++] = val > 0.0 ? val : 0.0;
-            }
+          kernels->subtract_value (data + x1, value, x2 - x1);
         }
       break;
 
@@ -142,67 +209,28 @@ gimp_gegl_mask_combine_span (gfloat         *data,
     }
 }
 
-/**
- * gimp_gegl_mask_combine_ellipse_rect:
- * @mask:      the channel with which to combine the elliptic rect
- * @op:        whether to replace, add to, or subtract from the current
- *             contents
- * @x:         x coordinate of upper left corner of bounding rect
- * @y:         y coordinate of upper left corner of bounding rect
- * @w:         width of bounding rect
- * @h:         height of bounding rect
- * @a:         elliptic a-constant applied to corners
- * @b:         elliptic b-constant applied to corners
- * @antialias: if %TRUE, antialias the elliptic corners
- *
- * Used for rounded cornered rectangles and ellipses.  If @op is
- * %GIMP_CHANNEL_OP_REPLACE or %GIMP_CHANNEL_OP_ADD, sets pixels
- * within the ellipse to 255.  If @op is %GIMP_CHANNEL_OP_SUBTRACT,
- * sets pixels within to zero.  If @antialias is %TRUE, pixels that
- * impinge on the edge of the ellipse are set to intermediate values,
- * depending on how much they overlap.
- **/
-gboolean
-gimp_gegl_mask_combine_ellipse_rect (GeglBuffer     *mask,
-                                     GimpChannelOps  op,
-                                     gint            x,
-                                     gint            y,
-                                     gint            w,
-                                     gint            h,
-                                     gdouble         a,
-                                     gdouble         b,
-                                     gboolean        antialias)
+static void
+gimp_gegl_mask_combine_ellipse_rect_area (const GeglRectangle *area,
+                                          EllipseRectData     *ellipse)
 {
-  GeglBufferIterator *iter;
-  GeglRectangle      *roi;
-  gdouble             a_sqr;
-  gdouble             b_sqr;
-  gdouble             ellipse_center_x;
-  gint                x0, y0;
-  gint                width, height;
-
-  g_return_val_if_fail (GEGL_IS_BUFFER (mask), FALSE);
-  g_return_val_if_fail (a >= 0.0 && b >= 0.0, FALSE);
-  g_return_val_if_fail (op != GIMP_CHANNEL_OP_INTERSECT, FALSE);
-
-  /* Make sure the elliptic corners fit into the rect */
-  a = MIN (a, w / 2.0);
-  b = MIN (b, h / 2.0);
-
-  a_sqr = SQR (a);
-  b_sqr = SQR (b);
-
-  if (! gimp_rectangle_intersect (x, y, w, h,
-                                  0, 0,
-                                  gegl_buffer_get_width  (mask),
-                                  gegl_buffer_get_height (mask),
-                                  &x0, &y0, &width, &height))
-    return FALSE;
+  const GimpMaskCombineKernels *kernels   = ellipse->kernels;
+  const GimpChannelOps          op        = ellipse->op;
+  const gint                    x         = ellipse->x;
+  const gint                    y         = ellipse->y;
+  const gint                    w         = ellipse->w;
+  const gint                    h         = ellipse->h;
+  const gdouble                 a         = ellipse->a;
+  const gdouble                 b         = ellipse->b;
+  const gdouble                 a_sqr     = ellipse->a_sqr;
+  const gdouble                 b_sqr     = ellipse->b_sqr;
+  const gboolean                antialias = ellipse->antialias;
+  GeglBufferIterator           *iter;
+  GeglRectangle                *roi;
+  gdouble                       ellipse_center_x;
 
   ellipse_center_x = x + a;
 
-  iter = gegl_buffer_iterator_new (mask,
-                                   GEGL_RECTANGLE (x0, y0, width, height), 0,
+  iter = gegl_buffer_iterator_new (ellipse->mask, area, 0,
                                    babl_format ("Y float"),
                                    GEGL_ACCESS_READWRITE, GEGL_ABYSS_NONE);
   roi = &iter->roi[0];
@@ -222,7 +250,8 @@ gimp_gegl_mask_combine_ellipse_rect (GeglBuffer     *mask,
           if (py >= y + b && py < y + h - b)
             {
               /*  we are on a row without rounded corners  */
-              gimp_gegl_mask_combine_span (data, op, 0, roi->width, 1.0);
+              gimp_gegl_mask_combine_span (kernels, data, op,
+                                           0, roi->width, 1.0);
               continue;
             }
 
@@ -254,7 +283,7 @@ gimp_gegl_mask_combine_ellipse_rect (GeglBuffer     *mask,
               x_end   = ROUND (ellipse_center_x + w - 2 * a +
                                half_ellipse_width_at_y);
 
-              gimp_gegl_mask_combine_span (data, op,
+              gimp_gegl_mask_combine_span (kernels, data, op,
                                            MAX (x_start - px, 0),
                                            MIN (x_end   - px, roi->width), 1.0);
             }
@@ -325,7 +354,7 @@ gimp_gegl_mask_combine_ellipse_rect (GeglBuffer     *mask,
                   if (last_val != val)
                     {
                       if (last_val != -1)
-                        gimp_gegl_mask_combine_span (data, op,
+                        gimp_gegl_mask_combine_span (kernels, data, op,
                                                      MAX (x_start - px, 0),
                                                      MIN (cur_x   - px, roi->width),
                                                      last_val);
@@ -339,7 +368,7 @@ gimp_gegl_mask_combine_ellipse_rect (GeglBuffer     *mask,
                    */
                   if (cur_x >= x + a && cur_x < x + w - a)
                     {
-                      gimp_gegl_mask_combine_span (data, op,
+                      gimp_gegl_mask_combine_span (kernels, data, op,
                                                    MAX (x_start - px, 0),
                                                    MIN (cur_x   - px, roi->width),
                                                    last_val);
@@ -356,17 +385,137 @@ gimp_gegl_mask_combine_ellipse_rect (GeglBuffer     *mask,
                     }
                 }
 
-              gimp_gegl_mask_combine_span (data, op,
+              gimp_gegl_mask_combine_span (kernels, data, op,
                                            MAX (x_start - px, 0),
                                            MIN (cur_x   - px, roi->width),
                                            last_val);
             }
         }
     }
+}
+
+/**
+ * gimp_gegl_mask_combine_ellipse_rect:
+ * @mask:      the channel with which to combine the elliptic rect
+ * @op:        whether to replace, add to, or subtract from the current
+ *             contents
+ * @x:         x coordinate of upper left corner of bounding rect
+ * @y:         y coordinate of upper left corner of bounding rect
+ * @w:         width of bounding rect
+ * @h:         height of bounding rect
+ * @a:         elliptic a-constant applied to corners
+ * @b:         elliptic b-constant applied to corners
+ * @antialias: if %TRUE, antialias the elliptic corners
+ *
+ * Used for rounded cornered rectangles and ellipses.  If @op is
+ * %GIMP_CHANNEL_OP_REPLACE or %GIMP_CHANNEL_OP_ADD, sets pixels
+ * within the ellipse to 255.  If @op is %GIMP_CHANNEL_OP_SUBTRACT,
+ * sets pixels within to zero.  If @antialias is %TRUE, pixels that
+ * impinge on the edge of the ellipse are set to intermediate values,
+ * depending on how much they overlap.
+ **/
+gboolean
+gimp_gegl_mask_combine_ellipse_rect (GeglBuffer     *mask,
+                                     GimpChannelOps  op,
+                                     gint            x,
+                                     gint            y,
+                                     gint            w,
+                                     gint            h,
+                                     gdouble         a,
+                                     gdouble         b,
+                                     gboolean        antialias)
+{
+  EllipseRectData data;
+  GeglRectangle   area;
+  gint            x0, y0;
+  gint            width, height;
+  gint            band_y1, band_y2;
+
+  g_return_val_if_fail (GEGL_IS_BUFFER (mask), FALSE);
+  g_return_val_if_fail (a >= 0.0 && b >= 0.0, FALSE);
+  g_return_val_if_fail (op != GIMP_CHANNEL_OP_INTERSECT, FALSE);
+
+  /* Make sure the elliptic corners fit into the rect */
+  a = MIN (a, w / 2.0);
+  b = MIN (b, h / 2.0);
+
+  if (! gimp_rectangle_intersect (x, y, w, h,
+                                  0, 0,
+                                  gegl_buffer_get_width  (mask),
+                                  gegl_buffer_get_height (mask),
+                                  &x0, &y0, &width, &height))
+    return FALSE;
+
+  data.kernels   = gimp_gegl_mask_combine_get_kernels ();
+  data.mask      = mask;
+  data.op        = op;
+  data.x         = x;
+  data.y         = y;
+  data.w         = w;
+  data.h         = h;
+  data.a         = a;
+  data.b         = b;
+  data.a_sqr     = SQR (a);
+  data.b_sqr     = SQR (b);
+  data.antialias = antialias;
+
+  /*  the rows between the rounded corners are completely covered, so
+   *  fill them without any per-pixel work
+   */
+  band_y1 = CLAMP ((gint) ceil (y + b),     y0, y0 + height);
+  band_y2 = CLAMP ((gint) ceil (y + h - b), y0, y0 + height);
+
+  if (band_y2 > band_y1)
+    gimp_gegl_mask_combine_rect (mask, op,
+                                 x0, band_y1, width, band_y2 - band_y1);
+  else
+    band_y1 = band_y2 = y0 + height;
+
+  /*  and render the rows with the rounded corners in parallel  */
+  area = *GEGL_RECTANGLE (x0, y0, width, band_y1 - y0);
+
+  if (! gegl_rectangle_is_empty (&area))
+    gimp_parallel_distribute_area (&area, MASK_COMBINE_MIN_SUB_AREA,
+                                   (GimpParallelDistributeAreaFunc)
+                                   gimp_gegl_mask_combine_ellipse_rect_area,
+                                   &data);
+
+  area = *GEGL_RECTANGLE (x0, band_y2, width, y0 + height - band_y2);
+
+  if (! gegl_rectangle_is_empty (&area))
+    gimp_parallel_distribute_area (&area, MASK_COMBINE_MIN_SUB_AREA,
+                                   (GimpParallelDistributeAreaFunc)
+                                   gimp_gegl_mask_combine_ellipse_rect_area,
+                                   &data);
 
   return TRUE;
 }
 
+static void
+gimp_gegl_mask_combine_buffer_area (const GeglRectangle *area,
+                                    CombineBufferData   *data)
+{
+  GeglBufferIterator *iter;
+  GeglRectangle       add_on_area;
+
+  iter = gegl_buffer_iterator_new (data->mask, area, 0,
+                                   babl_format ("Y float"),
+                                   GEGL_ACCESS_READWRITE, GEGL_ABYSS_NONE);
+
+  add_on_area    = *area;
+  add_on_area.x -= data->off_x;
+  add_on_area.y -= data->off_y;
+
+  gegl_buffer_iterator_add (iter, data->add_on, &add_on_area, 0,
+                            babl_format ("Y float"),
+                            GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
+
+  while (gegl_buffer_iterator_next (iter))
+    {
+      data->func (iter->data[0], iter->data[1], iter->length);
+    }
+}
+
 gboolean
 gimp_gegl_mask_combine_buffer (GeglBuffer     *mask,
                                GeglBuffer     *add_on,
@@ -374,9 +523,9 @@ gimp_gegl_mask_combine_buffer (GeglBuffer     *mask,
                                gint            off_x,
                                gint            off_y)
 {
-  GeglBufferIterator *iter;
-  GeglRectangle       rect;
-  gint                x, y, w, h;
+  const GimpMaskCombineKernels *kernels;
+  CombineBufferData             data;
+  gint                          x, y, w, h;
 
   g_return_val_if_fail (GEGL_IS_BUFFER (mask), FALSE);
   g_return_val_if_fail (GEGL_IS_BUFFER (add_on), FALSE);
@@ -390,85 +539,114 @@ gimp_gegl_mask_combine_buffer (GeglBuffer     *mask,
                                   &x, &y, &w, &h))
     return FALSE;
 
-  rect.x      = x;
-  rect.y      = y;
-  rect.width  = w;
-  rect.height = h;
-
-  iter = gegl_buffer_iterator_new (mask, &rect, 0,
-                                   babl_format ("Y float"),
-                                   GEGL_ACCESS_READWRITE, GEGL_ABYSS_NONE);
-
-  rect.x -= off_x;
-  rect.y -= off_y;
-
-  gegl_buffer_iterator_add (iter, add_on, &rect, 0,
-                            babl_format ("Y float"),
-                            GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
+  kernels = gimp_gegl_mask_combine_get_kernels ();
 
   switch (op)
     {
     case GIMP_CHANNEL_OP_ADD:
     case GIMP_CHANNEL_OP_REPLACE:
-      while (gegl_buffer_iterator_next (iter))
-        {
-          gfloat       *mask_data   = iter->data[0];
-          const gfloat *add_on_data = iter->data[1];
-          gint          count       = iter->length;
-
-          while (count--)
-            {
-              const gfloat val = *mask_data + *add_on_data;
-
-              *mask_data = CLAMP (val, 0.0, 1.0);
-
-              add_on_data++;
-              mask_data++;
-            }
-        }
+      data.func = kernels->add;
       break;
 
     case GIMP_CHANNEL_OP_SUBTRACT:
-      while (gegl_buffer_iterator_next (iter))
-        {
-          gfloat       *mask_data   = iter->data[0];
-          const gfloat *add_on_data = iter->data[1];
-          gint          count       = iter->length;
-
-          while (count--)
-            {
-              if (*add_on_data > *mask_data)
-                *mask_data = 0.0;
-              else
-                *mask_data -= *add_on_data;
-
-              add_on_data++;
-              mask_data++;
-            }
-        }
+      data.func = kernels->subtract;
       break;
 
     case GIMP_CHANNEL_OP_INTERSECT:
-      while (gegl_buffer_iterator_next (iter))
-        {
-          gfloat       *mask_data   = iter->data[0];
-          const gfloat *add_on_data = iter->data[1];
-          gint          count       = iter->length;
-
-          while (count--)
-            {
-              *mask_data = MIN (*mask_data, *add_on_data);
-
-              add_on_data++;
-              mask_data++;
-            }
-        }
+      data.func = kernels->intersect;
       break;
 
     default:
       g_warning ("%s: unknown operation type", G_STRFUNC);
-      break;
+      return TRUE;
     }
 
+  data.mask   = mask;
+  data.add_on = add_on;
+  data.off_x  = off_x;
+  data.off_y  = off_y;
+
+  gimp_parallel_distribute_area (GEGL_RECTANGLE (x, y, w, h),
+                                 MASK_COMBINE_MIN_SUB_AREA,
+                                 (GimpParallelDistributeAreaFunc)
+                                 gimp_gegl_mask_combine_buffer_area,
+                                 &data);
+
   return TRUE;
 }
+
+
+/*  the generic span kernels  */
+
+void
+gimp_gegl_mask_combine_add_span (gfloat       *mask,
+                                 const gfloat *add_on,
+                                 gint          count)
+{
+  while (count--)
+    {
+      const gfloat val = *mask + *add_on;
+
+      *mask = CLAMP (val, 0.0, 1.0);
+
+      add_on++;
+      mask++;
+    }
+}
+
+void
+gimp_gegl_mask_combine_subtract_span (gfloat       *mask,
+                                      const gfloat *add_on,
+                                      gint          count)
+{
+  while (count--)
+    {
+      if (*add_on > *mask)
+        *mask = 0.0;
+      else
+        *mask -= *add_on;
+
+      add_on++;
+      mask++;
+    }
+}
+
+void
+gimp_gegl_mask_combine_intersect_span (gfloat       *mask,
+                                       const gfloat *add_on,
+                                       gint          count)
+{
+  while (count--)
+    {
+      *mask = MIN (*mask, *add_on);
+
+      add_on++;
+      mask++;
+    }
+}
+
+void
+gimp_gegl_mask_combine_add_value_span (gfloat *mask,
+                                       gfloat  value,
+                                       gint    count)
+{
+  while (count--)
+    {
+      const gfloat val = *mask + value;
+
+      *mask++ = val > 1.0 ? 1.0 : val;
+    }
+}
+
+void
+gimp_gegl_mask_combine_subtract_value_span (gfloat *mask,
+                                            gfloat  value,
+                                            gint    count)
+{
+  while (count--)
+    {
+      const gfloat val = *mask - value;
+
+      *mask++ = val > 0.0 ? val : 0.0;
+    }
+}
@@ -48,4 +48,39 @@ gboolean   gimp_gegl_mask_combine_buffer       (GeglBuffer     *mask,
                                                 gint            off_y);
 
 
+/*  the span kernels, in their generic and SSE2 variants  */
+
+void   gimp_gegl_mask_combine_add_span                 (gfloat       *mask,
+                                                        const gfloat *add_on,
+                                                        gint          count);
+void   gimp_gegl_mask_combine_subtract_span            (gfloat       *mask,
+                                                        const gfloat *add_on,
+                                                        gint          count);
+void   gimp_gegl_mask_combine_intersect_span           (gfloat       *mask,
+                                                        const gfloat *add_on,
+                                                        gint          count);
+void   gimp_gegl_mask_combine_add_value_span           (gfloat       *mask,
+                                                        gfloat        value,
+                                                        gint          count);
+void   gimp_gegl_mask_combine_subtract_value_span      (gfloat       *mask,
+                                                        gfloat        value,
+                                                        gint          count);
+
+void   gimp_gegl_mask_combine_add_span_sse2            (gfloat       *mask,
+                                                        const gfloat *add_on,
+                                                        gint          count);
+void   gimp_gegl_mask_combine_subtract_span_sse2       (gfloat       *mask,
+                                                        const gfloat *add_on,
+                                                        gint          count);
+void   gimp_gegl_mask_combine_intersect_span_sse2      (gfloat       *mask,
+                                                        const gfloat *add_on,
+                                                        gint          count);
+void   gimp_gegl_mask_combine_add_value_span_sse2      (gfloat       *mask,
+                                                        gfloat        value,
+                                                        gint          count);
+void   gimp_gegl_mask_combine_subtract_value_span_sse2 (gfloat       *mask,
+                                                        gfloat        value,
+                                                        gint          count);
+
+
 #endif /* __GIMP_GEGL_MASK_COMBINE_H__ */
@@ -17,13 +17,81 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <gegl.h>
 
 #include "gimp-gegl-types.h"
 
+#include "core/gimp-parallel.h"
+
 #include "gegl/gimp-gegl-mask.h"
 
 
+#define MASK_TILES_KEY "gimp-gegl-mask-tiles"
+
+/*  the state of a tile which wasn't classified since it was changed  */
+#define TILE_UNKNOWN   0xff
+
+
+typedef struct
+{
+  GeglBuffer *buffer;
+  GeglBuffer *full_tile;
+  gint        width;
+  gint        height;
+  gint        tile_width;
+  gint        tile_height;
+  gint        n_cols;
+  gint        n_rows;
+  guchar     *states;
+} GimpMaskTiles;
+
+typedef struct
+{
+  GimpMaskTiles *tiles;
+  const gint    *todo;
+  gint           n_todo;
+} ClassifyData;
+
+
+/*  local function prototypes  */
+
+static GimpMaskTiles   * gimp_gegl_mask_get_tiles       (GeglBuffer          *buffer);
+static void              gimp_gegl_mask_tiles_free      (GimpMaskTiles       *tiles);
+static void              gimp_gegl_mask_tiles_changed   (GeglBuffer          *buffer,
+                                                         const GeglRectangle *rect,
+                                                         GimpMaskTiles       *tiles);
+
+static void              gimp_gegl_mask_tiles_range     (GimpMaskTiles       *tiles,
+                                                         const GeglRectangle *rect,
+                                                         gint                *col1,
+                                                         gint                *row1,
+                                                         gint                *col2,
+                                                         gint                *row2);
+static void              gimp_gegl_mask_tiles_get_rect  (GimpMaskTiles       *tiles,
+                                                         gint                 col,
+                                                         gint                 row,
+                                                         GeglRectangle       *rect);
+static GimpMaskTileState gimp_gegl_mask_tiles_get_state (GimpMaskTiles       *tiles,
+                                                         const GeglRectangle *rect);
+static gboolean          gimp_gegl_mask_tiles_bounds    (GimpMaskTiles       *tiles,
+                                                         GeglRectangle       *bounds);
+static void              gimp_gegl_mask_tiles_fill_full (GimpMaskTiles       *tiles,
+                                                         const GeglRectangle *rect);
+
+static void              gimp_gegl_mask_tiles_classify  (GimpMaskTiles       *tiles,
+                                                         const GeglRectangle *rect);
+static void              gimp_gegl_mask_classify_tiles  (gint                 i,
+                                                         gint                 n,
+                                                         ClassifyData        *data);
+static GimpMaskTileState gimp_gegl_mask_classify_tile   (GimpMaskTiles       *tiles,
+                                                         gint                 col,
+                                                         gint                 row);
+
+
+/*  public functions  */
+
 gboolean
 gimp_gegl_mask_bounds (GeglBuffer *buffer,
                        gint        *x1,
@@ -31,6 +99,8 @@ gimp_gegl_mask_bounds (GeglBuffer *buffer,
                        gint        *x2,
                        gint        *y2)
 {
+  GimpMaskTiles      *tiles;
+  GeglRectangle       area;
   GeglBufferIterator *iter;
   GeglRectangle      *roi;
   gint                tx1, tx2, ty1, ty2;
@@ -47,7 +117,22 @@ gimp_gegl_mask_bounds (GeglBuffer *buffer,
   tx2 = 0;
   ty2 = 0;
 
-  iter = gegl_buffer_iterator_new (buffer, NULL, 0, babl_format ("Y float"),
+  area = *gegl_buffer_get_extent (buffer);
+
+  tiles = gimp_gegl_mask_get_tiles (buffer);
+
+  /*  only look at the tiles which are not empty  */
+  if (tiles && ! gimp_gegl_mask_tiles_bounds (tiles, &area))
+    {
+      *x1 = 0;
+      *y1 = 0;
+      *x2 = gegl_buffer_get_width  (buffer);
+      *y2 = gegl_buffer_get_height (buffer);
+
+      return FALSE;
+    }
+
+  iter = gegl_buffer_iterator_new (buffer, &area, 0, babl_format ("Y float"),
                                    GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
   roi = &iter->roi[0];
 
@@ -59,6 +144,10 @@ gimp_gegl_mask_bounds (GeglBuffer *buffer,
       gint    ey    = roi->y + roi->height;
       gint    x, y;
 
+      if (tiles &&
+          gimp_gegl_mask_tiles_get_state (tiles, roi) == GIMP_MASK_TILE_EMPTY)
+        continue;
+
       /*  only check the pixels if this tile is not fully within the
        *  currently computed bounds
        */
@@ -137,6 +226,13 @@ gimp_gegl_mask_is_empty (GeglBuffer *buffer)
 
   g_return_val_if_fail (GEGL_IS_BUFFER (buffer), FALSE);
 
+  if (gimp_gegl_mask_get_tiles (buffer))
+    {
+      return gimp_gegl_mask_get_state (buffer,
+                                       gegl_buffer_get_extent (buffer)) ==
+             GIMP_MASK_TILE_EMPTY;
+    }
+
   iter = gegl_buffer_iterator_new (buffer, NULL, 0, babl_format ("Y float"),
                                    GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
 
@@ -158,3 +254,619 @@ gimp_gegl_mask_is_empty (GeglBuffer *buffer)
 
   return TRUE;
 }
+
+/**
+ * gimp_gegl_mask_track_tiles:
+ * @buffer: a mask #GeglBuffer
+ *
+ * Starts tracking which tiles of @buffer are uniformly 0.0 or 1.0.
+ * Tiles are classified when they are first asked for, and forgotten
+ * again when they are changed.  Does nothing if @buffer is already
+ * tracked, or if its tile grid doesn't start at its origin.
+ **/
+void
+gimp_gegl_mask_track_tiles (GeglBuffer *buffer)
+{
+  GimpMaskTiles       *tiles;
+  const GeglRectangle *extent;
+  gint                 shift_x;
+  gint                 shift_y;
+  gint                 n_tiles;
+
+  g_return_if_fail (GEGL_IS_BUFFER (buffer));
+
+  if (g_object_get_data (G_OBJECT (buffer), MASK_TILES_KEY))
+    return;
+
+  extent = gegl_buffer_get_extent (buffer);
+
+  tiles = g_slice_new0 (GimpMaskTiles);
+
+  g_object_get (buffer,
+                "tile-width",  &tiles->tile_width,
+                "tile-height", &tiles->tile_height,
+                "shift-x",     &shift_x,
+                "shift-y",     &shift_y,
+                NULL);
+
+  if (extent->x != 0 || extent->y != 0 || shift_x != 0 || shift_y != 0)
+    {
+      g_slice_free (GimpMaskTiles, tiles);
+
+      return;
+    }
+
+  tiles->buffer = buffer;
+  tiles->width  = extent->width;
+  tiles->height = extent->height;
+  tiles->n_cols = ((extent->width  + tiles->tile_width  - 1) /
+                   tiles->tile_width);
+  tiles->n_rows = ((extent->height + tiles->tile_height - 1) /
+                   tiles->tile_height);
+
+  n_tiles = tiles->n_cols * tiles->n_rows;
+
+  tiles->states = g_new (guchar, n_tiles);
+  memset (tiles->states, TILE_UNKNOWN, n_tiles);
+
+  g_object_set_data_full (G_OBJECT (buffer), MASK_TILES_KEY, tiles,
+                          (GDestroyNotify) gimp_gegl_mask_tiles_free);
+
+  gegl_buffer_signal_connect (buffer, "changed",
+                              G_CALLBACK (gimp_gegl_mask_tiles_changed),
+                              tiles);
+}
+
+/**
+ * gimp_gegl_mask_invalidate:
+ * @buffer: a mask #GeglBuffer
+ * @rect:   the changed area, or %NULL for all of @buffer
+ *
+ * Forgets the state of the tiles of @buffer touching @rect, so they
+ * are classified again when they are next asked for.  This has to be
+ * called after changing @buffer in ways which don't reliably emit its
+ * "changed" signal, like copying tiles into it.  Does nothing if the
+ * tiles of @buffer are not tracked.
+ **/
+void
+gimp_gegl_mask_invalidate (GeglBuffer          *buffer,
+                           const GeglRectangle *rect)
+{
+  GimpMaskTiles *tiles;
+
+  g_return_if_fail (GEGL_IS_BUFFER (buffer));
+
+  tiles = gimp_gegl_mask_get_tiles (buffer);
+
+  if (! tiles)
+    return;
+
+  if (! rect)
+    rect = GEGL_RECTANGLE (0, 0, tiles->width, tiles->height);
+
+  gimp_gegl_mask_tiles_changed (buffer, rect, tiles);
+}
+
+/**
+ * gimp_gegl_mask_fill:
+ * @buffer: a mask #GeglBuffer
+ * @rect:   the area to fill, or %NULL to fill all of @buffer
+ * @full:   whether to fill with 1.0 or 0.0
+ *
+ * Fills @rect of @buffer like gegl_buffer_set_color() would.  If the
+ * tiles of @buffer are tracked, the tiles covered by @rect are marked
+ * as uniform, and the filled tiles share their pixels where possible.
+ **/
+void
+gimp_gegl_mask_fill (GeglBuffer          *buffer,
+                     const GeglRectangle *rect,
+                     gboolean             full)
+{
+  GimpMaskTiles *tiles;
+  GeglRectangle  area;
+
+  g_return_if_fail (GEGL_IS_BUFFER (buffer));
+
+  if (! rect)
+    rect = gegl_buffer_get_extent (buffer);
+
+  tiles = gimp_gegl_mask_get_tiles (buffer);
+
+  if (! full)
+    {
+      gegl_buffer_clear (buffer, rect);
+    }
+  else if (tiles)
+    {
+      gimp_gegl_mask_tiles_fill_full (tiles, rect);
+    }
+  else
+    {
+      GeglColor *color = gegl_color_new ("#fff");
+
+      gegl_buffer_set_color (buffer, rect, color);
+      g_object_unref (color);
+    }
+
+  /*  filling made all tiles of the area unknown, but the ones which are
+   *  completely covered are uniform now
+   */
+  if (tiles &&
+      gegl_rectangle_intersect (&area, rect,
+                                GEGL_RECTANGLE (0, 0,
+                                                tiles->width, tiles->height)))
+    {
+      gint col1, row1, col2, row2;
+      gint col, row;
+
+      gimp_gegl_mask_tiles_range (tiles, &area, &col1, &row1, &col2, &row2);
+
+      for (row = row1; row <= row2; row++)
+        for (col = col1; col <= col2; col++)
+          {
+            GeglRectangle tile_rect;
+
+            gimp_gegl_mask_tiles_get_rect (tiles, col, row, &tile_rect);
+
+            if (gegl_rectangle_contains (&area, &tile_rect))
+              {
+                tiles->states[row * tiles->n_cols + col] =
+                  full ? GIMP_MASK_TILE_FULL : GIMP_MASK_TILE_EMPTY;
+              }
+          }
+    }
+}
+
+/**
+ * gimp_gegl_mask_get_state:
+ * @buffer: a mask #GeglBuffer
+ * @rect:   an area of @buffer
+ *
+ * Classifies the tiles of @buffer touching @rect, unless they are
+ * known already.
+ *
+ * Return value: %GIMP_MASK_TILE_EMPTY or %GIMP_MASK_TILE_FULL if all
+ *               tiles touching @rect are uniformly 0.0 or 1.0, and
+ *               %GIMP_MASK_TILE_MIXED otherwise, or if the tiles of
+ *               @buffer are not tracked.
+ **/
+GimpMaskTileState
+gimp_gegl_mask_get_state (GeglBuffer          *buffer,
+                          const GeglRectangle *rect)
+{
+  GimpMaskTiles *tiles;
+
+  g_return_val_if_fail (GEGL_IS_BUFFER (buffer), GIMP_MASK_TILE_MIXED);
+  g_return_val_if_fail (rect != NULL, GIMP_MASK_TILE_MIXED);
+
+  tiles = gimp_gegl_mask_get_tiles (buffer);
+
+  if (! tiles                                                         ||
+      gegl_rectangle_is_empty (rect)                                  ||
+      ! gegl_rectangle_contains (GEGL_RECTANGLE (0, 0,
+                                                 tiles->width,
+                                                 tiles->height), rect))
+    {
+      return GIMP_MASK_TILE_MIXED;
+    }
+
+  gimp_gegl_mask_tiles_classify (tiles, rect);
+
+  return gimp_gegl_mask_tiles_get_state (tiles, rect);
+}
+
+/**
+ * gimp_gegl_mask_foreach_area:
+ * @buffer:    a mask #GeglBuffer
+ * @rect:      an area of @buffer
+ * @func:      the function to call
+ * @user_data: data to pass to @func
+ *
+ * Splits @rect into areas whose tiles have the same state, and calls
+ * @func for each of them, so it can skip the per-pixel work for the
+ * uniform ones.  If the tiles of @buffer are not tracked, @func is
+ * called once for all of @rect, with %GIMP_MASK_TILE_MIXED.
+ **/
+void
+gimp_gegl_mask_foreach_area (GeglBuffer          *buffer,
+                             const GeglRectangle *rect,
+                             GimpMaskAreaFunc     func,
+                             gpointer             user_data)
+{
+  GimpMaskTiles *tiles;
+  gint           col1, row1, col2, row2;
+  gint           col, row;
+
+  g_return_if_fail (GEGL_IS_BUFFER (buffer));
+  g_return_if_fail (rect != NULL);
+  g_return_if_fail (func != NULL);
+
+  if (gegl_rectangle_is_empty (rect))
+    return;
+
+  tiles = gimp_gegl_mask_get_tiles (buffer);
+
+  if (! tiles ||
+      ! gegl_rectangle_contains (GEGL_RECTANGLE (0, 0,
+                                                 tiles->width,
+                                                 tiles->height), rect))
+    {
+      func (rect, GIMP_MASK_TILE_MIXED, user_data);
+
+      return;
+    }
+
+  gimp_gegl_mask_tiles_classify (tiles, rect);
+
+  gimp_gegl_mask_tiles_range (tiles, rect, &col1, &row1, &col2, &row2);
+
+  /*  merge the runs of tiles with the same state on each tile row  */
+  for (row = row1; row <= row2; row++)
+    {
+      const guchar *states = tiles->states + row * tiles->n_cols;
+      gint          y1     = MAX (rect->y, row * tiles->tile_height);
+      gint          y2     = MIN (rect->y + rect->height,
+                                  (row + 1) * tiles->tile_height);
+      gint          x      = rect->x;
+
+      for (col = col1 + 1; col <= col2 + 1; col++)
+        {
+          if (col > col2 || states[col] != states[col - 1])
+            {
+              gint x2 = MIN (col * tiles->tile_width, rect->x + rect->width);
+
+              func (GEGL_RECTANGLE (x, y1, x2 - x, y2 - y1),
+                    states[col - 1], user_data);
+
+              x = x2;
+            }
+        }
+    }
+}
+
+
+/*  private functions  */
+
+static GimpMaskTiles *
+gimp_gegl_mask_get_tiles (GeglBuffer *buffer)
+{
+  GimpMaskTiles       *tiles;
+  const GeglRectangle *extent;
+
+  tiles = g_object_get_data (G_OBJECT (buffer), MASK_TILES_KEY);
+
+  if (! tiles)
+    return NULL;
+
+  extent = gegl_buffer_get_extent (buffer);
+
+  /*  the states are only valid for the extent they were made for  */
+  if (extent->x     != 0             ||
+      extent->y     != 0             ||
+      extent->width  != tiles->width ||
+      extent->height != tiles->height)
+    {
+      return NULL;
+    }
+
+  return tiles;
+}
+
+static void
+gimp_gegl_mask_tiles_free (GimpMaskTiles *tiles)
+{
+  g_clear_object (&tiles->full_tile);
+
+  g_free (tiles->states);
+
+  g_slice_free (GimpMaskTiles, tiles);
+}
+
+/*  this can be called from any thread, but the tiles of a mask are
+ *  not classified while it's being changed
+ */
+static void
+gimp_gegl_mask_tiles_changed (GeglBuffer          *buffer,
+                              const GeglRectangle *rect,
+                              GimpMaskTiles       *tiles)
+{
+  GeglRectangle area;
+  gint          col1, row1, col2, row2;
+  gint          row;
+
+  if (! gegl_rectangle_intersect (&area, rect,
+                                  GEGL_RECTANGLE (0, 0,
+                                                  tiles->width,
+                                                  tiles->height)))
+    return;
+
+  gimp_gegl_mask_tiles_range (tiles, &area, &col1, &row1, &col2, &row2);
+
+  for (row = row1; row <= row2; row++)
+    {
+      memset (tiles->states + row * tiles->n_cols + col1,
+              TILE_UNKNOWN, col2 - col1 + 1);
+    }
+}
+
+/*  returns the range of tiles touching 'rect', which has to be inside
+ *  of the mask
+ */
+static void
+gimp_gegl_mask_tiles_range (GimpMaskTiles       *tiles,
+                            const GeglRectangle *rect,
+                            gint                *col1,
+                            gint                *row1,
+                            gint                *col2,
+                            gint                *row2)
+{
+  *col1 = rect->x / tiles->tile_width;
+  *row1 = rect->y / tiles->tile_height;
+  *col2 = (rect->x + rect->width  - 1) / tiles->tile_width;
+  *row2 = (rect->y + rect->height - 1) / tiles->tile_height;
+}
+
+/*  returns the part of a tile inside of the mask  */
+static void
+gimp_gegl_mask_tiles_get_rect (GimpMaskTiles *tiles,
+                               gint           col,
+                               gint           row,
+                               GeglRectangle *rect)
+{
+  rect->x      = col * tiles->tile_width;
+  rect->y      = row * tiles->tile_height;
+  rect->width  = MIN (tiles->tile_width,  tiles->width  - rect->x);
+  rect->height = MIN (tiles->tile_height, tiles->height - rect->y);
+}
+
+/*  returns the common state of the tiles touching 'rect', without
+ *  classifying any of them
+ */
+static GimpMaskTileState
+gimp_gegl_mask_tiles_get_state (GimpMaskTiles       *tiles,
+                                const GeglRectangle *rect)
+{
+  guchar state;
+  gint   col1, row1, col2, row2;
+  gint   col, row;
+
+  gimp_gegl_mask_tiles_range (tiles, rect, &col1, &row1, &col2, &row2);
+
+  state = tiles->states[row1 * tiles->n_cols + col1];
+
+  if (state == TILE_UNKNOWN)
+    return GIMP_MASK_TILE_MIXED;
+
+  for (row = row1; row <= row2; row++)
+    for (col = col1; col <= col2; col++)
+      {
+        if (tiles->states[row * tiles->n_cols + col] != state)
+          return GIMP_MASK_TILE_MIXED;
+      }
+
+  return state;
+}
+
+/*  finds the bounding box of the tiles which are not empty  */
+static gboolean
+gimp_gegl_mask_tiles_bounds (GimpMaskTiles *tiles,
+                             GeglRectangle *bounds)
+{
+  gint col1 = tiles->n_cols;
+  gint row1 = tiles->n_rows;
+  gint col2 = -1;
+  gint row2 = -1;
+  gint col, row;
+
+  if (tiles->n_cols == 0 || tiles->n_rows == 0)
+    return FALSE;
+
+  gimp_gegl_mask_tiles_classify (tiles,
+                                 GEGL_RECTANGLE (0, 0,
+                                                 tiles->width, tiles->height));
+
+  for (row = 0; row < tiles->n_rows; row++)
+    for (col = 0; col < tiles->n_cols; col++)
+      {
+        if (tiles->states[row * tiles->n_cols + col] != GIMP_MASK_TILE_EMPTY)
+          {
+            col1 = MIN (col1, col);
+            row1 = MIN (row1, row);
+            col2 = MAX (col2, col);
+            row2 = MAX (row2, row);
+          }
+      }
+
+  if (col2 < 0)
+    return FALSE;
+
+  bounds->x      = col1 * tiles->tile_width;
+  bounds->y      = row1 * tiles->tile_height;
+  bounds->width  = MIN ((col2 + 1) * tiles->tile_width,  tiles->width)  -
+                   bounds->x;
+  bounds->height = MIN ((row2 + 1) * tiles->tile_height, tiles->height) -
+                   bounds->y;
+
+  return TRUE;
+}
+
+static void
+gimp_gegl_mask_tiles_fill_full (GimpMaskTiles       *tiles,
+                                const GeglRectangle *rect)
+{
+  GeglBuffer    *buffer = tiles->buffer;
+  const gint     tw     = tiles->tile_width;
+  const gint     th     = tiles->tile_height;
+  GeglRectangle  area;
+  GeglRectangle  inner;
+  GeglRectangle  rest[4];
+  GeglColor     *color;
+  gint           x, y;
+  gint           i;
+
+  if (! gegl_rectangle_intersect (&area, rect,
+                                  GEGL_RECTANGLE (0, 0,
+                                                  tiles->width,
+                                                  tiles->height)))
+    return;
+
+  color = gegl_color_new ("#fff");
+
+  /*  the whole tiles inside of the area  */
+  inner.x      = (area.x + tw - 1) / tw * tw;
+  inner.y      = (area.y + th - 1) / th * th;
+  inner.width  = (area.x + area.width)  / tw * tw - inner.x;
+  inner.height = (area.y + area.height) / th * th - inner.y;
+
+  if (inner.width <= 0 || inner.height <= 0)
+    {
+      gegl_buffer_set_color (buffer, &area, color);
+      g_object_unref (color);
+
+      return;
+    }
+
+  /*  fill a single tile, and copy it to all whole tiles, which lets
+   *  them share its pixels where GEGL can
+   */
+  if (! tiles->full_tile)
+    {
+      tiles->full_tile = gegl_buffer_new (GEGL_RECTANGLE (0, 0, tw, th),
+                                          gegl_buffer_get_format (buffer));
+
+      gegl_buffer_set_color (tiles->full_tile, NULL, color);
+    }
+
+  for (y = inner.y; y < inner.y + inner.height; y += th)
+    for (x = inner.x; x < inner.x + inner.width; x += tw)
+      {
+        gegl_buffer_copy (tiles->full_tile, NULL, GEGL_ABYSS_NONE,
+                          buffer, GEGL_RECTANGLE (x, y, tw, th));
+      }
+
+  /*  and fill the rest of the area around them  */
+  rest[0] = *GEGL_RECTANGLE (area.x, area.y,
+                             area.width, inner.y - area.y);
+  rest[1] = *GEGL_RECTANGLE (area.x, inner.y + inner.height,
+                             area.width,
+                             area.y + area.height - inner.y - inner.height);
+  rest[2] = *GEGL_RECTANGLE (area.x, inner.y,
+                             inner.x - area.x, inner.height);
+  rest[3] = *GEGL_RECTANGLE (inner.x + inner.width, inner.y,
+                             area.x + area.width - inner.x - inner.width,
+                             inner.height);
+
+  for (i = 0; i < G_N_ELEMENTS (rest); i++)
+    {
+      if (! gegl_rectangle_is_empty (&rest[i]))
+        gegl_buffer_set_color (buffer, &rest[i], color);
+    }
+
+  g_object_unref (color);
+}
+
+/*  classifies the unknown tiles touching 'rect', in parallel  */
+static void
+gimp_gegl_mask_tiles_classify (GimpMaskTiles       *tiles,
+                               const GeglRectangle *rect)
+{
+  ClassifyData  data;
+  gint         *todo;
+  gint          n_todo = 0;
+  gint          col1, row1, col2, row2;
+  gint          col, row;
+
+  gimp_gegl_mask_tiles_range (tiles, rect, &col1, &row1, &col2, &row2);
+
+  todo = g_new (gint, (col2 - col1 + 1) * (row2 - row1 + 1));
+
+  for (row = row1; row <= row2; row++)
+    for (col = col1; col <= col2; col++)
+      {
+        gint index = row * tiles->n_cols + col;
+
+        if (tiles->states[index] == TILE_UNKNOWN)
+          todo[n_todo++] = index;
+      }
+
+  if (n_todo > 0)
+    {
+      data.tiles  = tiles;
+      data.todo   = todo;
+      data.n_todo = n_todo;
+
+      gimp_parallel_distribute (n_todo,
+                                (GimpParallelDistributeFunc)
+                                gimp_gegl_mask_classify_tiles,
+                                &data);
+    }
+
+  g_free (todo);
+}
+
+static void
+gimp_gegl_mask_classify_tiles (gint          i,
+                               gint          n,
+                               ClassifyData *data)
+{
+  GimpMaskTiles *tiles = data->tiles;
+  gint           j;
+
+  for (j = i; j < data->n_todo; j += n)
+    {
+      gint index = data->todo[j];
+
+      tiles->states[index] =
+        gimp_gegl_mask_classify_tile (tiles,
+                                      index % tiles->n_cols,
+                                      index / tiles->n_cols);
+    }
+}
+
+static GimpMaskTileState
+gimp_gegl_mask_classify_tile (GimpMaskTiles *tiles,
+                              gint           col,
+                              gint           row)
+{
+  GeglBufferIterator *iter;
+  GeglRectangle       rect;
+  gfloat              value = 0.0;
+  gboolean            first = TRUE;
+
+  gimp_gegl_mask_tiles_get_rect (tiles, col, row, &rect);
+
+  iter = gegl_buffer_iterator_new (tiles->buffer, &rect, 0,
+                                   babl_format ("Y float"),
+                                   GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
+
+  while (gegl_buffer_iterator_next (iter))
+    {
+      const gfloat *data  = iter->data[0];
+      gint          count = iter->length;
+
+      if (first)
+        {
+          value = *data;
+          first = FALSE;
+
+          if (value != 0.0 && value != 1.0)
+            {
+              gegl_buffer_iterator_stop (iter);
+
+              return GIMP_MASK_TILE_MIXED;
+            }
+        }
+
+      while (count--)
+        {
+          if (*data++ != value)
+            {
+              gegl_buffer_iterator_stop (iter);
+
+              return GIMP_MASK_TILE_MIXED;
+            }
+        }
+    }
+
+  return value == 1.0 ? GIMP_MASK_TILE_FULL : GIMP_MASK_TILE_EMPTY;
+}
@@ -19,12 +19,41 @@
 #define __GIMP_GEGL_MASK_H__
 
 
-gboolean   gimp_gegl_mask_bounds   (GeglBuffer *buffer,
-                                    gint        *x1,
-                                    gint        *y1,
-                                    gint        *x2,
-                                    gint        *y2);
-gboolean   gimp_gegl_mask_is_empty (GeglBuffer *buffer);
+/*  A mask buffer can track which of its tiles are uniformly 0.0 or
+ *  1.0, so the per-pixel work on them can be skipped, and their
+ *  storage shared.
+ */
+typedef enum
+{
+  GIMP_MASK_TILE_MIXED,
+  GIMP_MASK_TILE_EMPTY,
+  GIMP_MASK_TILE_FULL
+} GimpMaskTileState;
+
+typedef void (* GimpMaskAreaFunc) (const GeglRectangle *area,
+                                   GimpMaskTileState    state,
+                                   gpointer             user_data);
+
+
+gboolean          gimp_gegl_mask_bounds        (GeglBuffer          *buffer,
+                                                gint                *x1,
+                                                gint                *y1,
+                                                gint                *x2,
+                                                gint                *y2);
+gboolean          gimp_gegl_mask_is_empty      (GeglBuffer          *buffer);
+
+void              gimp_gegl_mask_track_tiles   (GeglBuffer          *buffer);
+void              gimp_gegl_mask_invalidate    (GeglBuffer          *buffer,
+                                                const GeglRectangle *rect);
+void              gimp_gegl_mask_fill          (GeglBuffer          *buffer,
+                                                const GeglRectangle *rect,
+                                                gboolean             full);
+GimpMaskTileState gimp_gegl_mask_get_state     (GeglBuffer          *buffer,
+                                                const GeglRectangle *rect);
+void              gimp_gegl_mask_foreach_area  (GeglBuffer          *buffer,
+                                                const GeglRectangle *rect,
+                                                GimpMaskAreaFunc     func,
+                                                gpointer             user_data);
 
 
 #endif /* __GIMP_GEGL_MASK_H__ */
@@ -151,3 +151,38 @@ gimp_gegl_param_spec_has_key (GParamSpec  *pspec,
 
   return FALSE;
 }
+
+/*  returns a copy of the 'rect' area of 'buffer', whose origin is at
+ *  'rect's position.  The copy uses the same tile grid as 'buffer', so
+ *  the tiles which are completely inside 'rect' are shared with
+ *  'buffer' copy-on-write, instead of being copied.
+ */
+GeglBuffer *
+gimp_gegl_buffer_dup_rect (GeglBuffer          *buffer,
+                           const GeglRectangle *rect)
+{
+  GeglBuffer *aligned;
+  GeglBuffer *shifted;
+
+  g_return_val_if_fail (GEGL_IS_BUFFER (buffer), NULL);
+  g_return_val_if_fail (rect != NULL, NULL);
+
+  aligned = gegl_buffer_new (rect, gegl_buffer_get_format (buffer));
+
+  gegl_buffer_copy (buffer,  rect, GEGL_ABYSS_NONE,
+                    aligned, rect);
+
+  shifted = g_object_new (GEGL_TYPE_BUFFER,
+                          "source",  aligned,
+                          "shift-x", rect->x,
+                          "shift-y", rect->y,
+                          "x",       0,
+                          "y",       0,
+                          "width",   rect->width,
+                          "height",  rect->height,
+                          NULL);
+
+  g_object_unref (aligned);
+
+  return shifted;
+}
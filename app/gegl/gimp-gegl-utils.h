@@ -38,5 +38,8 @@ gboolean     gimp_gegl_param_spec_has_key (GParamSpec    *pspec,
                                            const gchar   *key,
                                            const gchar   *value);
 
+GeglBuffer * gimp_gegl_buffer_dup_rect    (GeglBuffer          *buffer,
+                                           const GeglRectangle *rect);
+
 
 #endif /* __GIMP_GEGL_UTILS_H__ */
@@ -30,6 +30,8 @@
 #include "operations/gimp-operations.h"
 
 #include "core/gimp.h"
+#include "core/gimp-parallel.h"
+#include "core/gimp-undo-swap.h"
 
 #include "gimp-babl.h"
 #include "gimp-gegl.h"
@@ -71,11 +73,23 @@ gimp_gegl_init (Gimp *gimp)
                     G_CALLBACK (gimp_gegl_notify_use_opencl),
                     NULL);
 
+  gimp_parallel_init (gimp);
+
   gimp_babl_init ();
 
   gimp_operations_init ();
 }
 
+void
+gimp_gegl_exit (Gimp *gimp)
+{
+  g_return_if_fail (GIMP_IS_GIMP (gimp));
+
+  gimp_undo_swap_exit (gimp);
+
+  gimp_parallel_exit (gimp);
+}
+
 static void
 gimp_gegl_notify_tile_cache_size (GimpGeglConfig *config)
 {
@@ -20,23 +20,53 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <gegl.h>
 
 #include "gimp-gegl-types.h"
 
+#include "operations/gimplayermodefunctions.h"
+
+#include "core/gimp-parallel.h"
+
+#include "gimp-gegl-mask.h"
 #include "gimp-gegl-nodes.h"
 #include "gimpapplicator.h"
 
 
-static void   gimp_applicator_finalize     (GObject      *object);
-static void   gimp_applicator_set_property (GObject      *object,
-                                            guint         property_id,
-                                            const GValue *value,
-                                            GParamSpec   *pspec);
-static void   gimp_applicator_get_property (GObject      *object,
-                                            guint         property_id,
-                                            GValue       *value,
-                                            GParamSpec   *pspec);
+/*  the smallest area worth to be split across threads  */
+#define APPLICATOR_MIN_SUB_AREA (64 * 64)
+
+
+typedef struct
+{
+  GimpApplicator *applicator;
+  gboolean        use_mask;
+} GimpApplicatorFusedData;
+
+
+static void     gimp_applicator_finalize        (GObject             *object);
+static void     gimp_applicator_set_property    (GObject             *object,
+                                                 guint                property_id,
+                                                 const GValue        *value,
+                                                 GParamSpec          *pspec);
+static void     gimp_applicator_get_property    (GObject             *object,
+                                                 guint                property_id,
+                                                 GValue              *value,
+                                                 GParamSpec          *pspec);
+
+static gboolean gimp_applicator_can_fuse        (GimpApplicator      *applicator);
+static void     gimp_applicator_blit_fused      (GimpApplicator      *applicator,
+                                                 const GeglRectangle *rect);
+static void     gimp_applicator_blit_mask_area  (const GeglRectangle *mask_area,
+                                                 GimpMaskTileState    state,
+                                                 GimpApplicator      *applicator);
+static void     gimp_applicator_blit_fused_rect (GimpApplicator      *applicator,
+                                                 const GeglRectangle *rect,
+                                                 gboolean             use_mask);
+static void     gimp_applicator_blit_fused_area (const GeglRectangle *area,
+                                                 GimpApplicatorFusedData *data);
 
 
 G_DEFINE_TYPE (GimpApplicator, gimp_applicator, G_TYPE_OBJECT)
@@ -575,8 +605,11 @@ gimp_applicator_blit (GimpApplicator      *applicator,
 {
   g_return_if_fail (GIMP_IS_APPLICATOR (applicator));
 
-  gegl_node_blit (applicator->dest_node, 1.0, rect,
-                  NULL, NULL, 0, GEGL_BLIT_DEFAULT);
+  if (gimp_applicator_can_fuse (applicator))
+    gimp_applicator_blit_fused (applicator, rect);
+  else
+    gegl_node_blit (applicator->dest_node, 1.0, rect,
+                    NULL, NULL, 0, GEGL_BLIT_DEFAULT);
 }
 
 GeglBuffer *
@@ -635,3 +668,224 @@ gimp_applicator_get_cache_buffer (GimpApplicator  *applicator,
 
   return NULL;
 }
+
+
+/*  private functions  */
+
+/*  returns TRUE if blitting is the plain chain of src and apply buffer
+ *  through the mode and affect nodes into the dest buffer, which can be
+ *  done in a single pass over the dest buffer, without going through
+ *  the graph and its intermediate buffers.
+ */
+static gboolean
+gimp_applicator_can_fuse (GimpApplicator *applicator)
+{
+  GeglBuffer *dup_buffer;
+
+  if (! applicator->src_buffer   ||
+      ! applicator->apply_buffer ||
+      ! applicator->dest_buffer)
+    return FALSE;
+
+  /*  the caches have to see the result  */
+  if (applicator->output_cache_node || applicator->preview_enabled)
+    return FALSE;
+
+  gegl_node_get (applicator->dup_apply_buffer_node,
+                 "buffer", &dup_buffer,
+                 NULL);
+
+  if (dup_buffer)
+    {
+      g_object_unref (dup_buffer);
+
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+gimp_applicator_blit_fused (GimpApplicator      *applicator,
+                            const GeglRectangle *rect)
+{
+  if (applicator->mask_buffer)
+    {
+      /*  only use the mask where its tiles are not uniform  */
+      gimp_gegl_mask_foreach_area (applicator->mask_buffer,
+                                   GEGL_RECTANGLE (rect->x -
+                                                   applicator->mask_offset_x,
+                                                   rect->y -
+                                                   applicator->mask_offset_y,
+                                                   rect->width, rect->height),
+                                   (GimpMaskAreaFunc)
+                                   gimp_applicator_blit_mask_area,
+                                   applicator);
+    }
+  else
+    {
+      gimp_applicator_blit_fused_rect (applicator, rect, FALSE);
+    }
+}
+
+static void
+gimp_applicator_blit_mask_area (const GeglRectangle *mask_area,
+                                GimpMaskTileState    state,
+                                GimpApplicator      *applicator)
+{
+  GeglRectangle rect = *mask_area;
+
+  rect.x += applicator->mask_offset_x;
+  rect.y += applicator->mask_offset_y;
+
+  switch (state)
+    {
+    case GIMP_MASK_TILE_EMPTY:
+      /*  the mask hides the apply buffer, so dest is just src  */
+      if (applicator->src_buffer != applicator->dest_buffer)
+        gegl_buffer_copy (applicator->src_buffer,  &rect, GEGL_ABYSS_NONE,
+                          applicator->dest_buffer, &rect);
+      break;
+
+    case GIMP_MASK_TILE_FULL:
+      gimp_applicator_blit_fused_rect (applicator, &rect, FALSE);
+      break;
+
+    case GIMP_MASK_TILE_MIXED:
+      gimp_applicator_blit_fused_rect (applicator, &rect, TRUE);
+      break;
+    }
+}
+
+/*  the fused pass is split across threads, as each pixel of dest only
+ *  depends on the same pixel of the src, apply and mask buffers
+ */
+static void
+gimp_applicator_blit_fused_rect (GimpApplicator      *applicator,
+                                 const GeglRectangle *rect,
+                                 gboolean             use_mask)
+{
+  GimpApplicatorFusedData data;
+
+  data.applicator = applicator;
+  data.use_mask   = use_mask;
+
+  gimp_parallel_distribute_area (rect, APPLICATOR_MIN_SUB_AREA,
+                                 (GimpParallelDistributeAreaFunc)
+                                 gimp_applicator_blit_fused_area,
+                                 &data);
+}
+
+static void
+gimp_applicator_blit_fused_area (const GeglRectangle     *rect,
+                                 GimpApplicatorFusedData *data)
+{
+  GimpApplicator        *applicator = data->applicator;
+  gboolean               use_mask   = data->use_mask;
+  GimpLayerModeFunction  apply_func;
+  GimpComponentMask      affect     = applicator->affect;
+  gboolean               in_place   = (applicator->src_buffer ==
+                                       applicator->dest_buffer);
+  const Babl            *iterator_format;
+  GeglBufferIterator    *iter;
+  gint                   src_index;
+  gint                   apply_index;
+  gint                   mask_index = -1;
+  gfloat                *comp       = NULL;
+  gint                   comp_size  = 0;
+
+  apply_func = get_layer_mode_function (applicator->paint_mode,
+                                        applicator->linear);
+
+  if (applicator->linear)
+    iterator_format = babl_format ("RGBA float");
+  else
+    iterator_format = babl_format ("R'G'B'A float");
+
+  iter = gegl_buffer_iterator_new (applicator->dest_buffer, rect, 0,
+                                   iterator_format,
+                                   in_place ?
+                                   GEGL_ACCESS_READWRITE : GEGL_ACCESS_WRITE,
+                                   GEGL_ABYSS_NONE);
+
+  if (in_place)
+    {
+      src_index = 0;
+    }
+  else
+    {
+      src_index = gegl_buffer_iterator_add (iter, applicator->src_buffer,
+                                            rect, 0,
+                                            iterator_format,
+                                            GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
+    }
+
+  apply_index =
+    gegl_buffer_iterator_add (iter, applicator->apply_buffer,
+                              GEGL_RECTANGLE (rect->x -
+                                              applicator->apply_offset_x,
+                                              rect->y -
+                                              applicator->apply_offset_y,
+                                              rect->width, rect->height),
+                              0, iterator_format,
+                              GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
+
+  if (use_mask)
+    {
+      mask_index =
+        gegl_buffer_iterator_add (iter, applicator->mask_buffer,
+                                  GEGL_RECTANGLE (rect->x -
+                                                  applicator->mask_offset_x,
+                                                  rect->y -
+                                                  applicator->mask_offset_y,
+                                                  rect->width, rect->height),
+                                  0, babl_format ("Y float"),
+                                  GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
+    }
+
+  while (gegl_buffer_iterator_next (iter))
+    {
+      gfloat *out     = iter->data[0];
+      gfloat *in      = iter->data[src_index];
+      gfloat *layer   = iter->data[apply_index];
+      gfloat *mask    = NULL;
+      glong   samples = iter->length;
+
+      if (mask_index >= 0)
+        mask = iter->data[mask_index];
+
+      if (affect == GIMP_COMPONENT_MASK_ALL)
+        {
+          apply_func (in, layer, mask, out, applicator->opacity,
+                      samples, &iter->roi[0], 0);
+        }
+      else if (affect == 0)
+        {
+          if (! in_place)
+            memcpy (out, in, samples * 4 * sizeof (gfloat));
+        }
+      else
+        {
+          gfloat *c;
+
+          if (samples > comp_size)
+            {
+              comp_size = samples;
+              comp      = g_renew (gfloat, comp, comp_size * 4);
+            }
+
+          apply_func (in, layer, mask, comp, applicator->opacity,
+                      samples, &iter->roi[0], 0);
+
+          for (c = comp; samples--; c += 4, in += 4, out += 4)
+            {
+              out[RED]   = (affect & GIMP_COMPONENT_MASK_RED)   ? c[RED]   : in[RED];
+              out[GREEN] = (affect & GIMP_COMPONENT_MASK_GREEN) ? c[GREEN] : in[GREEN];
+              out[BLUE]  = (affect & GIMP_COMPONENT_MASK_BLUE)  ? c[BLUE]  : in[BLUE];
+              out[ALPHA] = (affect & GIMP_COMPONENT_MASK_ALPHA) ? c[ALPHA] : in[ALPHA];
+            }
+        }
+    }
+
+  g_free (comp);
+}
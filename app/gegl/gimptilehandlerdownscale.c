@@ -0,0 +1,157 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <cairo.h>
+#include <gegl.h>
+
+#include "gimp-gegl-types.h"
+
+#include "gimptilehandlerdownscale.h"
+
+
+static void   gimp_tile_handler_downscale_finalize (GObject                 *object);
+
+static void   gimp_tile_handler_downscale_validate (GimpTileHandlerValidate *validate,
+                                                    const GeglRectangle     *rect,
+                                                    const Babl              *format,
+                                                    gpointer                 dest_buf,
+                                                    gint                     dest_stride);
+
+
+G_DEFINE_TYPE (GimpTileHandlerDownscale, gimp_tile_handler_downscale,
+               GIMP_TYPE_TILE_HANDLER_VALIDATE)
+
+#define parent_class gimp_tile_handler_downscale_parent_class
+
+
+static void
+gimp_tile_handler_downscale_class_init (GimpTileHandlerDownscaleClass *klass)
+{
+  GObjectClass                 *object_class   = G_OBJECT_CLASS (klass);
+  GimpTileHandlerValidateClass *validate_class = GIMP_TILE_HANDLER_VALIDATE_CLASS (klass);
+
+  object_class->finalize   = gimp_tile_handler_downscale_finalize;
+
+  validate_class->validate = gimp_tile_handler_downscale_validate;
+}
+
+static void
+gimp_tile_handler_downscale_init (GimpTileHandlerDownscale *downscale)
+{
+}
+
+static void
+gimp_tile_handler_downscale_finalize (GObject *object)
+{
+  GimpTileHandlerDownscale *downscale = GIMP_TILE_HANDLER_DOWNSCALE (object);
+
+  if (downscale->source)
+    {
+      g_object_unref (downscale->source);
+      downscale->source = NULL;
+    }
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gimp_tile_handler_downscale_validate (GimpTileHandlerValidate *validate,
+                                      const GeglRectangle     *rect,
+                                      const Babl              *format,
+                                      gpointer                 dest_buf,
+                                      gint                     dest_stride)
+{
+  GimpTileHandlerDownscale *downscale = GIMP_TILE_HANDLER_DOWNSCALE (validate);
+  const Babl               *float_format;
+  const Babl               *fish;
+  GeglRectangle             src_rect;
+  gfloat                   *src;
+  gfloat                   *dest;
+  gint                      n_components;
+  gint                      src_stride;
+  gint                      x, y, c;
+
+  /*  average premultiplied linear pixels, so that transparent pixels
+   *  don't bleed into their neighbors
+   */
+  if (babl_format_get_n_components (format) > 2)
+    float_format = babl_format ("RaGaBaA float");
+  else
+    float_format = babl_format ("YaA float");
+
+  n_components = babl_format_get_n_components (float_format);
+  fish         = babl_fish (float_format, format);
+
+  src_rect.x      = rect->x      * 2;
+  src_rect.y      = rect->y      * 2;
+  src_rect.width  = rect->width  * 2;
+  src_rect.height = rect->height * 2;
+
+  src_stride = src_rect.width * n_components;
+
+  src  = g_new (gfloat, src_stride * src_rect.height);
+  dest = g_new (gfloat, rect->width * n_components);
+
+  gegl_buffer_get (downscale->source, &src_rect, 1.0,
+                   float_format, src, GEGL_AUTO_ROWSTRIDE,
+                   GEGL_ABYSS_CLAMP);
+
+  for (y = 0; y < rect->height; y++)
+    {
+      const gfloat *row1 = src + 2 * y * src_stride;
+      const gfloat *row2 = row1 + src_stride;
+      gfloat       *d    = dest;
+
+      for (x = 0; x < rect->width; x++)
+        {
+          for (c = 0; c < n_components; c++)
+            {
+              *d++ = (row1[c] + row1[n_components + c] +
+                      row2[c] + row2[n_components + c]) * 0.25f;
+            }
+
+          row1 += 2 * n_components;
+          row2 += 2 * n_components;
+        }
+
+      babl_process (fish,
+                    dest, (guchar *) dest_buf + y * dest_stride,
+                    rect->width);
+    }
+
+  g_free (src);
+  g_free (dest);
+}
+
+
+/*  public functions  */
+
+GeglTileHandler *
+gimp_tile_handler_downscale_new (GeglBuffer *source)
+{
+  GimpTileHandlerDownscale *downscale;
+
+  g_return_val_if_fail (GEGL_IS_BUFFER (source), NULL);
+
+  downscale = g_object_new (GIMP_TYPE_TILE_HANDLER_DOWNSCALE, NULL);
+
+  downscale->source = g_object_ref (source);
+
+  return GEGL_TILE_HANDLER (downscale);
+}
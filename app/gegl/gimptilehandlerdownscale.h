@@ -0,0 +1,62 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_TILE_HANDLER_DOWNSCALE_H__
+#define __GIMP_TILE_HANDLER_DOWNSCALE_H__
+
+#include "gimptilehandlervalidate.h"
+
+/***
+ * GimpTileHandlerDownscale is a GimpTileHandlerValidate that renders
+ * a buffer at half the size of its source buffer, by averaging each
+ * 2x2 block of source pixels.
+ */
+
+G_BEGIN_DECLS
+
+#define GIMP_TYPE_TILE_HANDLER_DOWNSCALE            (gimp_tile_handler_downscale_get_type ())
+#define GIMP_TILE_HANDLER_DOWNSCALE(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), GIMP_TYPE_TILE_HANDLER_DOWNSCALE, GimpTileHandlerDownscale))
+#define GIMP_TILE_HANDLER_DOWNSCALE_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  GIMP_TYPE_TILE_HANDLER_DOWNSCALE, GimpTileHandlerDownscaleClass))
+#define GIMP_IS_TILE_HANDLER_DOWNSCALE(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GIMP_TYPE_TILE_HANDLER_DOWNSCALE))
+#define GIMP_IS_TILE_HANDLER_DOWNSCALE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  GIMP_TYPE_TILE_HANDLER_DOWNSCALE))
+#define GIMP_TILE_HANDLER_DOWNSCALE_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  GIMP_TYPE_TILE_HANDLER_DOWNSCALE, GimpTileHandlerDownscaleClass))
+
+
+typedef struct _GimpTileHandlerDownscale      GimpTileHandlerDownscale;
+typedef struct _GimpTileHandlerDownscaleClass GimpTileHandlerDownscaleClass;
+
+struct _GimpTileHandlerDownscale
+{
+  GimpTileHandlerValidate  parent_instance;
+
+  GeglBuffer              *source;
+};
+
+struct _GimpTileHandlerDownscaleClass
+{
+  GimpTileHandlerValidateClass  parent_class;
+};
+
+
+GType             gimp_tile_handler_downscale_get_type (void) G_GNUC_CONST;
+
+GeglTileHandler * gimp_tile_handler_downscale_new      (GeglBuffer *source);
+
+
+G_END_DECLS
+
+#endif /* __GIMP_TILE_HANDLER_DOWNSCALE_H__ */
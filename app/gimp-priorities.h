@@ -33,6 +33,9 @@
 /*  just a bit less than GDK_PRIORITY_REDRAW   */
 #define GIMP_PRIORITY_PROJECTION_IDLE (G_PRIORITY_HIGH_IDLE + 22)
 
+/*  after the projection, which transform previews are drawn on top of  */
+#define GIMP_PRIORITY_TRANSFORM_JOB_IDLE (G_PRIORITY_HIGH_IDLE + 23)
+
 /* #define G_PRIORITY_DEFAULT_IDLE 200 */
 
 #define GIMP_PRIORITY_VIEWABLE_IDLE (G_PRIORITY_LOW)
@@ -0,0 +1,323 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimplayermodefunctions-sse2.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gegl-plugin.h>
+
+#include "operations-types.h"
+
+#include "gimpoperationadditionmode.h"
+#include "gimpoperationburnmode.h"
+#include "gimpoperationdarkenonlymode.h"
+#include "gimpoperationdifferencemode.h"
+#include "gimpoperationdividemode.h"
+#include "gimpoperationdodgemode.h"
+#include "gimpoperationgrainextractmode.h"
+#include "gimpoperationgrainmergemode.h"
+#include "gimpoperationhardlightmode.h"
+#include "gimpoperationlightenonlymode.h"
+#include "gimpoperationmultiplymode.h"
+#include "gimpoperationoverlaymode.h"
+#include "gimpoperationscreenmode.h"
+#include "gimpoperationsoftlightmode.h"
+#include "gimpoperationsubtractmode.h"
+
+#if COMPILE_SSE2_INTRINISICS
+/* SSE2 */
+#include <emmintrin.h>
+
+
+/*  The SSE2 variants of the separable layer modes.  Each of them
+ *  computes the blended color of all channels of a pixel at once,
+ *  using the same math as the generic variant, and composites it
+ *  onto the input using the alpha computed the same way as the
+ *  generic variant does.
+ */
+
+typedef __m128 (* GimpBlendFuncSSE2) (__m128 in,
+                                      __m128 layer);
+
+
+static inline void
+gimp_layer_mode_process_pixels_sse2 (const gfloat      *in,
+                                     const gfloat      *layer,
+                                     const gfloat      *mask,
+                                     gfloat            *out,
+                                     gfloat             opacity,
+                                     glong              samples,
+                                     GimpBlendFuncSSE2  blend_func,
+                                     gboolean           clamp)
+{
+  const __m128 alpha_mask = _mm_castsi128_ps (_mm_set_epi32 (-1, 0, 0, 0));
+  const __m128 zero       = _mm_setzero_ps ();
+  const __m128 one        = _mm_set1_ps (1.0f);
+
+  while (samples--)
+    {
+      __m128 rgba_in = _mm_loadu_ps (in);
+      gfloat comp_alpha, new_alpha;
+
+      comp_alpha = MIN (in[ALPHA], layer[ALPHA]) * opacity;
+      if (mask)
+        comp_alpha *= *mask++;
+
+      new_alpha = in[ALPHA] + (1.0 - in[ALPHA]) * comp_alpha;
+
+      if (comp_alpha && new_alpha)
+        {
+          __m128 rgba_layer = _mm_loadu_ps (layer);
+          __m128 ratio      = _mm_set1_ps (comp_alpha / new_alpha);
+          __m128 rgba_out;
+
+          rgba_out = blend_func (rgba_in, rgba_layer);
+
+          /* out = comp * ratio + in * (1.0 - ratio) */
+          rgba_out = _mm_add_ps (_mm_mul_ps (rgba_out, ratio),
+                                 _mm_mul_ps (rgba_in, _mm_sub_ps (one, ratio)));
+
+          if (clamp)
+            rgba_out = _mm_min_ps (_mm_max_ps (rgba_out, zero), one);
+
+          /* keep the input's alpha */
+          rgba_out = _mm_or_ps (_mm_andnot_ps (alpha_mask, rgba_out),
+                                _mm_and_ps    (alpha_mask, rgba_in));
+
+          _mm_storeu_ps (out, rgba_out);
+        }
+      else
+        {
+          _mm_storeu_ps (out, rgba_in);
+        }
+
+      in    += 4;
+      layer += 4;
+      out   += 4;
+    }
+}
+
+/*  returns 'a' where 'select' is set, and 'b' elsewhere  */
+static inline __m128
+gimp_select_sse2 (__m128 select,
+                  __m128 a,
+                  __m128 b)
+{
+  return _mm_or_ps (_mm_and_ps (select, a), _mm_andnot_ps (select, b));
+}
+
+
+/*  blend functions  */
+
+static inline __m128
+multiply_sse2 (__m128 in,
+               __m128 layer)
+{
+  return _mm_mul_ps (in, layer);
+}
+
+static inline __m128
+screen_sse2 (__m128 in,
+             __m128 layer)
+{
+  const __m128 one = _mm_set1_ps (1.0f);
+
+  return _mm_sub_ps (one, _mm_mul_ps (_mm_sub_ps (one, in),
+                                      _mm_sub_ps (one, layer)));
+}
+
+static inline __m128
+overlay_sse2 (__m128 in,
+              __m128 layer)
+{
+  const __m128 one  = _mm_set1_ps (1.0f);
+  const __m128 two  = _mm_set1_ps (2.0f);
+  const __m128 half = _mm_set1_ps (0.5f);
+  __m128       low;
+  __m128       high;
+
+  /* in < 0.5 ? 2.0 * in * layer : 1.0 - 2.0 * (1.0 - layer) * (1.0 - in) */
+  low  = _mm_mul_ps (_mm_mul_ps (two, in), layer);
+  high = _mm_sub_ps (one, _mm_mul_ps (_mm_mul_ps (two, _mm_sub_ps (one, layer)),
+                                      _mm_sub_ps (one, in)));
+
+  return gimp_select_sse2 (_mm_cmplt_ps (in, half), low, high);
+}
+
+static inline __m128
+softlight_sse2 (__m128 in,
+                __m128 layer)
+{
+  const __m128 one = _mm_set1_ps (1.0f);
+  __m128       multiply;
+  __m128       screen;
+
+  multiply = multiply_sse2 (in, layer);
+  screen   = screen_sse2 (in, layer);
+
+  return _mm_add_ps (_mm_mul_ps (_mm_sub_ps (one, in), multiply),
+                     _mm_mul_ps (in, screen));
+}
+
+static inline __m128
+hardlight_sse2 (__m128 in,
+                __m128 layer)
+{
+  const __m128 one  = _mm_set1_ps (1.0f);
+  const __m128 two  = _mm_set1_ps (2.0f);
+  const __m128 half = _mm_set1_ps (0.5f);
+  __m128       low;
+  __m128       high;
+
+  /* layer > 0.5 ? MIN (1 - (1 - in) * (1 - (layer - 0.5) * 2), 1) :
+   *               MIN (in * (layer * 2), 1)
+   */
+  high = _mm_mul_ps (_mm_sub_ps (one, in),
+                     _mm_sub_ps (one, _mm_mul_ps (_mm_sub_ps (layer, half),
+                                                  two)));
+  high = _mm_min_ps (_mm_sub_ps (one, high), one);
+
+  low  = _mm_min_ps (_mm_mul_ps (in, _mm_mul_ps (layer, two)), one);
+
+  return gimp_select_sse2 (_mm_cmpgt_ps (layer, half), high, low);
+}
+
+static inline __m128
+dodge_sse2 (__m128 in,
+            __m128 layer)
+{
+  const __m128 one = _mm_set1_ps (1.0f);
+
+  /* like MIN(), _mm_min_ps() maps in / 0 == NAN to 1 */
+  return _mm_min_ps (_mm_div_ps (in, _mm_sub_ps (one, layer)), one);
+}
+
+static inline __m128
+burn_sse2 (__m128 in,
+           __m128 layer)
+{
+  const __m128 zero = _mm_setzero_ps ();
+  const __m128 one  = _mm_set1_ps (1.0f);
+  __m128       comp;
+
+  comp = _mm_sub_ps (one, _mm_div_ps (_mm_sub_ps (one, in), layer));
+
+  /* clamp in this order to map comp == NAN (0 / 0) -> 1, like the
+   * generic variant
+   */
+  return _mm_max_ps (_mm_min_ps (comp, one), zero);
+}
+
+static inline __m128
+grain_extract_sse2 (__m128 in,
+                    __m128 layer)
+{
+  return _mm_add_ps (_mm_sub_ps (in, layer), _mm_set1_ps (0.5f));
+}
+
+static inline __m128
+grain_merge_sse2 (__m128 in,
+                  __m128 layer)
+{
+  return _mm_sub_ps (_mm_add_ps (in, layer), _mm_set1_ps (0.5f));
+}
+
+static inline __m128
+addition_sse2 (__m128 in,
+               __m128 layer)
+{
+  return _mm_add_ps (in, layer);
+}
+
+static inline __m128
+subtract_sse2 (__m128 in,
+               __m128 layer)
+{
+  return _mm_sub_ps (in, layer);
+}
+
+static inline __m128
+difference_sse2 (__m128 in,
+                 __m128 layer)
+{
+  /* clear the sign bit */
+  return _mm_andnot_ps (_mm_set1_ps (-0.0f), _mm_sub_ps (in, layer));
+}
+
+static inline __m128
+darken_only_sse2 (__m128 in,
+                  __m128 layer)
+{
+  return _mm_min_ps (in, layer);
+}
+
+static inline __m128
+lighten_only_sse2 (__m128 in,
+                   __m128 layer)
+{
+  return _mm_max_ps (layer, in);
+}
+
+static inline __m128
+divide_sse2 (__m128 in,
+             __m128 layer)
+{
+  const __m128 scale  = _mm_set1_ps (4294967296.0 / 4294967295.0);
+  const __m128 offset = _mm_set1_ps (1.0 / 4294967295.0);
+
+  return _mm_div_ps (_mm_mul_ps (scale, in), _mm_add_ps (offset, layer));
+}
+
+
+/*  process functions  */
+
+#define DEFINE_LAYER_MODE_SSE2(mode, clamp)                                     \
+gboolean                                                                        \
+gimp_operation_##mode##_mode_process_pixels_sse2 (gfloat              *in,      \
+                                                  gfloat              *layer,   \
+                                                  gfloat              *mask,    \
+                                                  gfloat              *out,     \
+                                                  gfloat               opacity, \
+                                                  glong                samples, \
+                                                  const GeglRectangle *roi,     \
+                                                  gint                 level)   \
+{                                                                               \
+  gimp_layer_mode_process_pixels_sse2 (in, layer, mask, out,                    \
+                                       opacity, samples,                        \
+                                       mode##_sse2, clamp);                     \
+                                                                                \
+  return TRUE;                                                                  \
+}
+
+DEFINE_LAYER_MODE_SSE2 (multiply,      TRUE)
+DEFINE_LAYER_MODE_SSE2 (screen,        FALSE)
+DEFINE_LAYER_MODE_SSE2 (overlay,       FALSE)
+DEFINE_LAYER_MODE_SSE2 (softlight,     FALSE)
+DEFINE_LAYER_MODE_SSE2 (hardlight,     FALSE)
+DEFINE_LAYER_MODE_SSE2 (dodge,         FALSE)
+DEFINE_LAYER_MODE_SSE2 (burn,          FALSE)
+DEFINE_LAYER_MODE_SSE2 (grain_extract, TRUE)
+DEFINE_LAYER_MODE_SSE2 (grain_merge,   TRUE)
+DEFINE_LAYER_MODE_SSE2 (addition,      TRUE)
+DEFINE_LAYER_MODE_SSE2 (subtract,      TRUE)
+DEFINE_LAYER_MODE_SSE2 (difference,    FALSE)
+DEFINE_LAYER_MODE_SSE2 (darken_only,   FALSE)
+DEFINE_LAYER_MODE_SSE2 (lighten_only,  FALSE)
+DEFINE_LAYER_MODE_SSE2 (divide,        TRUE)
+
+#endif /* COMPILE_SSE2_INTRINISICS */
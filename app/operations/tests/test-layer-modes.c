@@ -0,0 +1,223 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gio/gio.h>
+#include <gegl.h>
+#include <gegl-plugin.h>
+
+#include "libgimpbase/gimpbase.h"
+#include "libgimpmath/gimpmath.h"
+
+#include "operations/operations-types.h"
+
+#include "operations/gimpoperationadditionmode.h"
+#include "operations/gimpoperationburnmode.h"
+#include "operations/gimpoperationdarkenonlymode.h"
+#include "operations/gimpoperationdifferencemode.h"
+#include "operations/gimpoperationdividemode.h"
+#include "operations/gimpoperationdodgemode.h"
+#include "operations/gimpoperationgrainextractmode.h"
+#include "operations/gimpoperationgrainmergemode.h"
+#include "operations/gimpoperationhardlightmode.h"
+#include "operations/gimpoperationlightenonlymode.h"
+#include "operations/gimpoperationmultiplymode.h"
+#include "operations/gimpoperationoverlaymode.h"
+#include "operations/gimpoperationscreenmode.h"
+#include "operations/gimpoperationsoftlightmode.h"
+#include "operations/gimpoperationsubtractmode.h"
+
+
+/*  the accelerated variants don't compute in double precision  */
+#define EPSILON   1e-5
+
+#define N_PIXELS  4099
+
+
+#define VARIANTS(mode)                                   \
+  { #mode,                                               \
+    gimp_operation_##mode##_mode_process_pixels_core,    \
+    gimp_operation_##mode##_mode_process_pixels_sse2 }
+
+
+typedef struct
+{
+  const gchar           *name;
+  GimpLayerModeFunction  reference;
+  GimpLayerModeFunction  accelerated;
+} LayerModeVariants;
+
+
+/*  values which are likely to hit the edge cases of the modes  */
+static const gfloat special_values[] = { 0.0, 0.25, 0.5, 0.75, 1.0 };
+
+#if COMPILE_SSE2_INTRINISICS
+static const LayerModeVariants sse2_variants[] =
+{
+  VARIANTS (multiply),
+  VARIANTS (screen),
+  VARIANTS (overlay),
+  VARIANTS (softlight),
+  VARIANTS (hardlight),
+  VARIANTS (dodge),
+  VARIANTS (burn),
+  VARIANTS (grain_extract),
+  VARIANTS (grain_merge),
+  VARIANTS (addition),
+  VARIANTS (subtract),
+  VARIANTS (difference),
+  VARIANTS (darken_only),
+  VARIANTS (lighten_only),
+  VARIANTS (divide)
+};
+#endif /* COMPILE_SSE2_INTRINISICS */
+
+
+static void
+fill_pixels (GRand  *rand,
+             gfloat *pixels,
+             gint    n_values)
+{
+  gint i;
+
+  for (i = 0; i < n_values; i++)
+    {
+      if (g_rand_int_range (rand, 0, 8) == 0)
+        {
+          pixels[i] = special_values[g_rand_int_range (rand, 0,
+                                                       G_N_ELEMENTS (special_values))];
+        }
+      else
+        {
+          pixels[i] = g_rand_double (rand);
+        }
+    }
+}
+
+static void
+compare_pixels (const LayerModeVariants *variants,
+                const gfloat            *reference,
+                const gfloat            *accelerated,
+                gint                     n_values)
+{
+  gint i;
+
+  for (i = 0; i < n_values; i++)
+    {
+      if (isnan (reference[i]) != isnan (accelerated[i]) ||
+          fabs (reference[i] - accelerated[i]) > EPSILON)
+        {
+          g_error ("%s: pixel %d, component %d: expected %g, got %g",
+                   variants->name, i / 4, i % 4,
+                   reference[i], accelerated[i]);
+        }
+    }
+}
+
+/**
+ * gimp_test_layer_mode_sse2:
+ *
+ * Test that the SSE2 variant of a layer mode gives the same result as
+ * the generic variant, with and without a mask, at full and partial
+ * opacity, and in place.
+ **/
+static void
+gimp_test_layer_mode_sse2 (gconstpointer data)
+{
+  const LayerModeVariants *variants = data;
+  GRand                   *rand;
+  gfloat                  *in;
+  gfloat                  *layer;
+  gfloat                  *mask;
+  gfloat                  *reference;
+  gfloat                  *accelerated;
+  gint                     n_values = N_PIXELS * 4;
+  gint                     i;
+
+  if (! (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_SSE2))
+    return;
+
+  rand        = g_rand_new_with_seed (42);
+  in          = g_new (gfloat, n_values);
+  layer       = g_new (gfloat, n_values);
+  mask        = g_new (gfloat, N_PIXELS);
+  reference   = g_new (gfloat, n_values);
+  accelerated = g_new (gfloat, n_values);
+
+  fill_pixels (rand, in,    n_values);
+  fill_pixels (rand, layer, n_values);
+  fill_pixels (rand, mask,  N_PIXELS);
+
+  for (i = 0; i < 4; i++)
+    {
+      gfloat  opacity = (i & 1) ? 0.6 : 1.0;
+      gfloat *m       = (i & 2) ? mask : NULL;
+
+      variants->reference   (in, layer, m, reference,   opacity, N_PIXELS,
+                             NULL, 0);
+      variants->accelerated (in, layer, m, accelerated, opacity, N_PIXELS,
+                             NULL, 0);
+
+      compare_pixels (variants, reference, accelerated, n_values);
+    }
+
+  /*  in place, like when compositing onto the destination buffer  */
+  memcpy (accelerated, in, n_values * sizeof (gfloat));
+
+  variants->reference   (in,          layer, mask, reference,   0.6, N_PIXELS,
+                         NULL, 0);
+  variants->accelerated (accelerated, layer, mask, accelerated, 0.6, N_PIXELS,
+                         NULL, 0);
+
+  compare_pixels (variants, reference, accelerated, n_values);
+
+  g_free (accelerated);
+  g_free (reference);
+  g_free (mask);
+  g_free (layer);
+  g_free (in);
+  g_rand_free (rand);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+#if COMPILE_SSE2_INTRINISICS
+  gint i;
+#endif
+
+  g_test_init (&argc, &argv, NULL);
+
+#if COMPILE_SSE2_INTRINISICS
+  for (i = 0; i < G_N_ELEMENTS (sse2_variants); i++)
+    {
+      gchar *path = g_strdup_printf ("/layer-modes/sse2/%s",
+                                     sse2_variants[i].name);
+
+      g_test_add_data_func (path, &sse2_variants[i],
+                            gimp_test_layer_mode_sse2);
+
+      g_free (path);
+    }
+#endif /* COMPILE_SSE2_INTRINISICS */
+
+  return g_test_run ();
+}
@@ -736,6 +736,9 @@ gimp_brush_core_interpolate (GimpPaintCore    *paint_core,
         }
     }
 
+  /*  composite the dabs of this motion together, where possible  */
+  gimp_paint_core_begin_batch (paint_core);
+
   for (n = 0; n < num_points; n++)
     {
       gdouble t = t0 + n * dt;
@@ -792,6 +795,8 @@ gimp_brush_core_interpolate (GimpPaintCore    *paint_core,
                              GIMP_PAINT_STATE_MOTION, time);
     }
 
+  gimp_paint_core_end_batch (paint_core, drawable);
+
   current_coords.x        = last_coords.x        + delta_vec.x;
   current_coords.y        = last_coords.y        + delta_vec.y;
   current_coords.pressure = last_coords.pressure + delta_pressure;
@@ -29,9 +29,53 @@
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include "libgimpcolor/gimpcolor.h"
 
+#include "core/gimp-parallel.h"
+
 #include "gimpmybrushsurface.h"
 
 
+#define MYBRUSH_SURFACE_MIN_SUB_AREA (64 * 64)
+
+
+/*  a dab queued by draw_dab(), with the values which don't depend on
+ *  the pixel already calculated
+ */
+typedef struct
+{
+  GeglRectangle roi;
+  float         x;
+  float         y;
+  float         radius;
+  float         color_r;
+  float         color_g;
+  float         color_b;
+  float         color_a;
+  float         hardness;
+  float         aspect_ratio;
+  float         sn;
+  float         cs;
+  float         one_over_radius2;
+  float         segment1_slope;
+  float         segment2_slope;
+  float         r_aa_start;
+  float         normal_mode;
+  float         colorize;
+} GimpMybrushDab;
+
+typedef struct
+{
+  GimpMybrushSurface *surface;
+  float               x;
+  float               y;
+  float               one_over_radius2;
+  GMutex              mutex;
+  gdouble             sum_weight;
+  gdouble             sum_r;
+  gdouble             sum_g;
+  gdouble             sum_b;
+  gdouble             sum_a;
+} GimpMybrushColorData;
+
 struct _GimpMybrushSurface
 {
   MyPaintSurface surface;
@@ -41,6 +85,9 @@ struct _GimpMybrushSurface
   gint        paint_mask_y;
   GeglRectangle dirty;
   GimpComponentMask component_mask;
+  gint        atomic;
+  GArray     *dabs;        /*  queued dabs, applied in order  */
+  GeglRectangle dabs_rect; /*  the bounds of the queued dabs  */
 };
 
 /* --- Taken from mypaint-tiled-surface.c --- */
@@ -228,170 +275,82 @@ calculate_dab_roi (float x,
   return *GEGL_RECTANGLE (x0, y0, x1 - x0, y1 - y0);
 }
 
+/*  calculate_rr() for a row of pixels, written so that the compiler
+ *  can vectorize it
+ */
 static void
-gimp_mypaint_surface_get_color (MyPaintSurface *base_surface,
-                                float           x,
-                                float           y,
-                                float           radius,
-                                float          *color_r,
-                                float          *color_g,
-                                float          *color_b,
-                                float          *color_a)
+calculate_rr_row (float                *rr,
+                  int                   xp,
+                  int                   yp,
+                  int                   width,
+                  const GimpMybrushDab *dab)
 {
-  GimpMybrushSurface *surface = (GimpMybrushSurface *)base_surface;
-  GeglRectangle dabRect;
-
-  if (radius < 1.0f)
-    radius = 1.0f;
-
-  dabRect = calculate_dab_roi (x, y, radius);
-
-  *color_r = 0.0f;
-  *color_g = 0.0f;
-  *color_b = 0.0f;
-  *color_a = 0.0f;
-
-  if (dabRect.width > 0 || dabRect.height > 0)
-  {
-    const float one_over_radius2 = 1.0f / (radius * radius);
-    float sum_weight = 0.0f;
-    float sum_r = 0.0f;
-    float sum_g = 0.0f;
-    float sum_b = 0.0f;
-    float sum_a = 0.0f;
-
-     /* Read in clamp mode to avoid transparency bleeding in at the edges */
-    GeglBufferIterator *iter = gegl_buffer_iterator_new (surface->buffer, &dabRect, 0,
-                                                         babl_format ("R'aG'aB'aA float"),
-                                                         GEGL_BUFFER_READ,
-                                                         GEGL_ABYSS_CLAMP);
-    if (surface->paint_mask)
-      {
-        GeglRectangle mask_roi = dabRect;
-        mask_roi.x -= surface->paint_mask_x;
-        mask_roi.y -= surface->paint_mask_y;
-        gegl_buffer_iterator_add (iter, surface->paint_mask, &mask_roi, 0,
-                                  babl_format ("Y float"),
-                                  GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
-      }
-
-    while (gegl_buffer_iterator_next (iter))
-      {
-        float *pixel = (float *)iter->data[0];
-        float *mask;
-        int iy, ix;
-
-        if (surface->paint_mask)
-          mask = iter->data[1];
-        else
-          mask = NULL;
-
-        for (iy = iter->roi[0].y; iy < iter->roi[0].y + iter->roi[0].height; iy++)
-          {
-            float yy = (iy + 0.5f - y);
-            for (ix = iter->roi[0].x; ix < iter->roi[0].x +  iter->roi[0].width; ix++)
-              {
-                /* pixel_weight == a standard dab with hardness = 0.5, aspect_ratio = 1.0, and angle = 0.0 */
-                float xx = (ix + 0.5f - x);
-                float rr = (yy * yy + xx * xx) * one_over_radius2;
-                float pixel_weight = 0.0f;
-                if (rr <= 1.0f)
-                  pixel_weight = 1.0f - rr;
-                if (mask)
-                  pixel_weight *= *mask;
-
-                sum_r += pixel_weight * pixel[RED];
-                sum_g += pixel_weight * pixel[GREEN];
-                sum_b += pixel_weight * pixel[BLUE];
-                sum_a += pixel_weight * pixel[ALPHA];
-                sum_weight += pixel_weight;
-
-                pixel += 4;
-                if (mask)
-                  mask += 1;
-              }
-          }
-      }
-
-    if (sum_a > 0.0f && sum_weight > 0.0f)
-      {
-        sum_r /= sum_weight;
-        sum_g /= sum_weight;
-        sum_b /= sum_weight;
-        sum_a /= sum_weight;
+  const float x                = dab->x;
+  const float aspect_ratio     = dab->aspect_ratio;
+  const float sn               = dab->sn;
+  const float cs               = dab->cs;
+  const float one_over_radius2 = dab->one_over_radius2;
+  const float yy               = (yp + 0.5f - dab->y);
+  const float yy_cs            = yy * cs;
+  const float yy_sn            = yy * sn;
+  int         i;
+
+  for (i = 0; i < width; i++)
+    {
+      const float xx  = ((xp + i) + 0.5f - x);
+      const float yyr = (yy_cs - xx * sn) * aspect_ratio;
+      const float xxr = yy_sn + xx * cs;
 
-        sum_r /= sum_a;
-        sum_g /= sum_a;
-        sum_b /= sum_a;
+      rr[i] = (yyr * yyr + xxr * xxr) * one_over_radius2;
+    }
+}
 
-        /* FIXME: Clamping is wrong because GEGL allows alpha > 1, this should probably re-multipy things */
-        *color_r = CLAMP(sum_r, 0.0f, 1.0f);
-        *color_g = CLAMP(sum_g, 0.0f, 1.0f);
-        *color_b = CLAMP(sum_b, 0.0f, 1.0f);
-        *color_a = CLAMP(sum_a, 0.0f, 1.0f);
-      }
-  }
+/*  the base alpha of a row of pixels, from their rr  */
+static void
+calculate_alpha_row (float                *alpha,
+                     const float          *rr,
+                     int                   width,
+                     const GimpMybrushDab *dab)
+{
+  const float hardness = dab->hardness;
+  const float slope1   = dab->segment1_slope;
+  const float slope2   = dab->segment2_slope;
+  int         i;
 
+  for (i = 0; i < width; i++)
+    alpha[i] = calculate_alpha_for_rr (rr[i], hardness, slope1, slope2);
 }
 
-static int
-gimp_mypaint_surface_draw_dab (MyPaintSurface *base_surface,
-                               float           x,
-                               float           y,
-                               float           radius,
-                               float           color_r,
-                               float           color_g,
-                               float           color_b,
-                               float           opaque,
-                               float           hardness,
-                               float           color_a,
-                               float           aspect_ratio,
-                               float           angle,
-                               float           lock_alpha,
-                               float           colorize)
+/*  applies the part of 'dab' inside 'area' to the surface.  'rr' and
+ *  'base_alpha' are scratch rows of at least the width of 'area'.
+ */
+static void
+gimp_mypaint_surface_apply_dab (GimpMybrushSurface   *surface,
+                                const GimpMybrushDab *dab,
+                                const GeglRectangle  *area,
+                                float                *rr,
+                                float                *base_alpha)
 {
-  GimpMybrushSurface *surface = (GimpMybrushSurface *)base_surface;
   GeglBufferIterator *iter;
-  GeglRectangle       dabRect;
+  GeglRectangle       roi;
   GimpComponentMask   component_mask = surface->component_mask;
+  const float         color_r        = dab->color_r;
+  const float         color_g        = dab->color_g;
+  const float         color_b        = dab->color_b;
+  const float         color_a        = dab->color_a;
+  const float         normal_mode    = dab->normal_mode;
+  const float         colorize       = dab->colorize;
 
-  const float one_over_radius2 = 1.0f / (radius * radius);
-  const double angle_rad = angle / 360 * 2 * M_PI;
-  const float cs = cos(angle_rad);
-  const float sn = sin(angle_rad);
-  float normal_mode;
-  float segment1_slope;
-  float segment2_slope;
-  float r_aa_start;
-
-  hardness = CLAMP (hardness, 0.0f, 1.0f);
-  segment1_slope = -(1.0f / hardness - 1.0f);
-  segment2_slope = -hardness / (1.0f - hardness);
-  aspect_ratio = MAX (1.0f, aspect_ratio);
+  if (! gegl_rectangle_intersect (&roi, &dab->roi, area))
+    return;
 
-  r_aa_start = radius - 1.0f;
-  r_aa_start = MAX (r_aa_start, 0);
-  r_aa_start = (r_aa_start * r_aa_start) / aspect_ratio;
-
-  normal_mode = opaque * (1.0f - colorize);
-  colorize = opaque * colorize;
-
-  /* FIXME: This should use the real matrix values to trim aspect_ratio dabs */
-  dabRect = calculate_dab_roi (x, y, radius);
-  gegl_rectangle_intersect (&dabRect, &dabRect, gegl_buffer_get_extent (surface->buffer));
-
-  if (dabRect.width <= 0 || dabRect.height <= 0)
-    return 0;
-
-  gegl_rectangle_bounding_box (&surface->dirty, &surface->dirty, &dabRect);
-
-  iter = gegl_buffer_iterator_new (surface->buffer, &dabRect, 0,
+  iter = gegl_buffer_iterator_new (surface->buffer, &roi, 0,
                                    babl_format ("R'G'B'A float"),
                                    GEGL_BUFFER_READWRITE,
                                    GEGL_ABYSS_NONE);
   if (surface->paint_mask)
     {
-      GeglRectangle mask_roi = dabRect;
+      GeglRectangle mask_roi = roi;
       mask_roi.x -= surface->paint_mask_x;
       mask_roi.y -= surface->paint_mask_y;
       gegl_buffer_iterator_add (iter, surface->paint_mask, &mask_roi, 0,
@@ -403,7 +362,8 @@ gimp_mypaint_surface_draw_dab (MyPaintSurface *base_surface,
     {
       float *pixel = (float *)iter->data[0];
       float *mask;
-      int iy, ix;
+      int    width = iter->roi[0].width;
+      int    iy, i;
 
       if (surface->paint_mask)
         mask = iter->data[1];
@@ -412,15 +372,27 @@ gimp_mypaint_surface_draw_dab (MyPaintSurface *base_surface,
 
       for (iy = iter->roi[0].y; iy < iter->roi[0].y + iter->roi[0].height; iy++)
         {
-          for (ix = iter->roi[0].x; ix < iter->roi[0].x +  iter->roi[0].width; ix++)
+          if (dab->radius < 3.0f)
             {
-              float rr, base_alpha, alpha, dst_alpha, r, g, b, a;
-              if (radius < 3.0f)
-                rr = calculate_rr_antialiased (ix, iy, x, y, aspect_ratio, sn, cs, one_over_radius2, r_aa_start);
-              else
-                rr = calculate_rr (ix, iy, x, y, aspect_ratio, sn, cs, one_over_radius2);
-              base_alpha = calculate_alpha_for_rr (rr, hardness, segment1_slope, segment2_slope);
-              alpha = base_alpha * normal_mode;
+              for (i = 0; i < width; i++)
+                rr[i] = calculate_rr_antialiased (iter->roi[0].x + i, iy,
+                                                  dab->x, dab->y,
+                                                  dab->aspect_ratio,
+                                                  dab->sn, dab->cs,
+                                                  dab->one_over_radius2,
+                                                  dab->r_aa_start);
+            }
+          else
+            {
+              calculate_rr_row (rr, iter->roi[0].x, iy, width, dab);
+            }
+
+          calculate_alpha_row (base_alpha, rr, width, dab);
+
+          for (i = 0; i < width; i++)
+            {
+              float alpha, dst_alpha, r, g, b, a;
+              alpha = base_alpha[i] * normal_mode;
               if (mask)
                 alpha *= *mask;
               dst_alpha = pixel[ALPHA];
@@ -443,9 +415,9 @@ gimp_mypaint_surface_draw_dab (MyPaintSurface *base_surface,
                   b = color_b * src_term + b * dst_term;
                 }
 
-              if (colorize > 0.0f && base_alpha > 0.0f)
+              if (colorize > 0.0f && base_alpha[i] > 0.0f)
                 {
-                  alpha = base_alpha * colorize;
+                  alpha = base_alpha[i] * colorize;
                   a = alpha + dst_alpha - alpha * dst_alpha;
                   if (a > 0.0f)
                     {
@@ -493,6 +465,288 @@ gimp_mypaint_surface_draw_dab (MyPaintSurface *base_surface,
             }
         }
     }
+}
+
+/*  applies all queued dabs, in order, to one part of their bounds  */
+static void
+gimp_mypaint_surface_flush_area (const GeglRectangle *area,
+                                 gpointer             data)
+{
+  GimpMybrushSurface *surface = data;
+  float              *rr;
+  float              *base_alpha;
+  guint               i;
+
+  rr         = g_new (float, area->width);
+  base_alpha = g_new (float, area->width);
+
+  for (i = 0; i < surface->dabs->len; i++)
+    {
+      gimp_mypaint_surface_apply_dab (surface,
+                                      &g_array_index (surface->dabs,
+                                                      GimpMybrushDab, i),
+                                      area, rr, base_alpha);
+    }
+
+  g_free (base_alpha);
+  g_free (rr);
+}
+
+/*  applies the queued dabs in parallel.  Each thread applies all dabs
+ *  to its own part of their bounds, so every pixel still sees them in
+ *  the order they were drawn in.
+ */
+static void
+gimp_mypaint_surface_flush_dabs (GimpMybrushSurface *surface)
+{
+  if (surface->dabs->len == 0)
+    return;
+
+  gimp_parallel_distribute_area (&surface->dabs_rect,
+                                 MYBRUSH_SURFACE_MIN_SUB_AREA,
+                                 gimp_mypaint_surface_flush_area,
+                                 surface);
+
+  g_array_set_size (surface->dabs, 0);
+  surface->dabs_rect = *GEGL_RECTANGLE (0, 0, 0, 0);
+}
+
+static void
+gimp_mypaint_surface_get_color_area (const GeglRectangle *area,
+                                     gpointer             user_data)
+{
+  GimpMybrushColorData *data    = user_data;
+  GimpMybrushSurface   *surface = data->surface;
+  const float           x       = data->x;
+  const float           y       = data->y;
+  const float           one_over_radius2 = data->one_over_radius2;
+  float                *weight;
+  float                 sum_weight = 0.0f;
+  float                 sum_r = 0.0f;
+  float                 sum_g = 0.0f;
+  float                 sum_b = 0.0f;
+  float                 sum_a = 0.0f;
+
+  /* Read in clamp mode to avoid transparency bleeding in at the edges */
+  GeglBufferIterator *iter = gegl_buffer_iterator_new (surface->buffer, area, 0,
+                                                       babl_format ("R'aG'aB'aA float"),
+                                                       GEGL_BUFFER_READ,
+                                                       GEGL_ABYSS_CLAMP);
+  if (surface->paint_mask)
+    {
+      GeglRectangle mask_roi = *area;
+      mask_roi.x -= surface->paint_mask_x;
+      mask_roi.y -= surface->paint_mask_y;
+      gegl_buffer_iterator_add (iter, surface->paint_mask, &mask_roi, 0,
+                                babl_format ("Y float"),
+                                GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
+    }
+
+  weight = g_new (float, area->width);
+
+  while (gegl_buffer_iterator_next (iter))
+    {
+      float *pixel = (float *)iter->data[0];
+      float *mask;
+      int    width = iter->roi[0].width;
+      int    iy, i;
+
+      if (surface->paint_mask)
+        mask = iter->data[1];
+      else
+        mask = NULL;
+
+      for (iy = iter->roi[0].y; iy < iter->roi[0].y + iter->roi[0].height; iy++)
+        {
+          float yy = (iy + 0.5f - y);
+
+          /* pixel_weight == a standard dab with hardness = 0.5, aspect_ratio = 1.0, and angle = 0.0 */
+          for (i = 0; i < width; i++)
+            {
+              float xx = ((iter->roi[0].x + i) + 0.5f - x);
+              float rr = (yy * yy + xx * xx) * one_over_radius2;
+
+              weight[i] = rr <= 1.0f ? 1.0f - rr : 0.0f;
+            }
+
+          if (mask)
+            {
+              for (i = 0; i < width; i++)
+                weight[i] *= mask[i];
+
+              mask += width;
+            }
+
+          for (i = 0; i < width; i++)
+            {
+              sum_r += weight[i] * pixel[RED];
+              sum_g += weight[i] * pixel[GREEN];
+              sum_b += weight[i] * pixel[BLUE];
+              sum_a += weight[i] * pixel[ALPHA];
+              sum_weight += weight[i];
+
+              pixel += 4;
+            }
+        }
+    }
+
+  g_free (weight);
+
+  g_mutex_lock (&data->mutex);
+
+  data->sum_weight += sum_weight;
+  data->sum_r      += sum_r;
+  data->sum_g      += sum_g;
+  data->sum_b      += sum_b;
+  data->sum_a      += sum_a;
+
+  g_mutex_unlock (&data->mutex);
+}
+
+static void
+gimp_mypaint_surface_get_color (MyPaintSurface *base_surface,
+                                float           x,
+                                float           y,
+                                float           radius,
+                                float          *color_r,
+                                float          *color_g,
+                                float          *color_b,
+                                float          *color_a)
+{
+  GimpMybrushSurface *surface = (GimpMybrushSurface *)base_surface;
+  GeglRectangle dabRect;
+
+  /* the color has to include the dabs drawn so far */
+  gimp_mypaint_surface_flush_dabs (surface);
+
+  if (radius < 1.0f)
+    radius = 1.0f;
+
+  dabRect = calculate_dab_roi (x, y, radius);
+
+  *color_r = 0.0f;
+  *color_g = 0.0f;
+  *color_b = 0.0f;
+  *color_a = 0.0f;
+
+  if (dabRect.width > 0 || dabRect.height > 0)
+  {
+    GimpMybrushColorData data = { 0, };
+    float sum_weight;
+    float sum_r;
+    float sum_g;
+    float sum_b;
+    float sum_a;
+
+    data.surface          = surface;
+    data.x                = x;
+    data.y                = y;
+    data.one_over_radius2 = 1.0f / (radius * radius);
+
+    g_mutex_init (&data.mutex);
+
+    gimp_parallel_distribute_area (&dabRect, MYBRUSH_SURFACE_MIN_SUB_AREA,
+                                   gimp_mypaint_surface_get_color_area,
+                                   &data);
+
+    g_mutex_clear (&data.mutex);
+
+    sum_weight = data.sum_weight;
+    sum_r      = data.sum_r;
+    sum_g      = data.sum_g;
+    sum_b      = data.sum_b;
+    sum_a      = data.sum_a;
+
+    if (sum_a > 0.0f && sum_weight > 0.0f)
+      {
+        sum_r /= sum_weight;
+        sum_g /= sum_weight;
+        sum_b /= sum_weight;
+        sum_a /= sum_weight;
+
+        sum_r /= sum_a;
+        sum_g /= sum_a;
+        sum_b /= sum_a;
+
+        /* FIXME: Clamping is wrong because GEGL allows alpha > 1, this should probably re-multipy things */
+        *color_r = CLAMP(sum_r, 0.0f, 1.0f);
+        *color_g = CLAMP(sum_g, 0.0f, 1.0f);
+        *color_b = CLAMP(sum_b, 0.0f, 1.0f);
+        *color_a = CLAMP(sum_a, 0.0f, 1.0f);
+      }
+  }
+
+}
+
+static int
+gimp_mypaint_surface_draw_dab (MyPaintSurface *base_surface,
+                               float           x,
+                               float           y,
+                               float           radius,
+                               float           color_r,
+                               float           color_g,
+                               float           color_b,
+                               float           opaque,
+                               float           hardness,
+                               float           color_a,
+                               float           aspect_ratio,
+                               float           angle,
+                               float           lock_alpha,
+                               float           colorize)
+{
+  GimpMybrushSurface *surface = (GimpMybrushSurface *)base_surface;
+  GimpMybrushDab      dab;
+  GeglRectangle       dabRect;
+
+  const double angle_rad = angle / 360 * 2 * M_PI;
+  float r_aa_start;
+
+  hardness = CLAMP (hardness, 0.0f, 1.0f);
+  aspect_ratio = MAX (1.0f, aspect_ratio);
+
+  r_aa_start = radius - 1.0f;
+  r_aa_start = MAX (r_aa_start, 0);
+  r_aa_start = (r_aa_start * r_aa_start) / aspect_ratio;
+
+  /* FIXME: This should use the real matrix values to trim aspect_ratio dabs */
+  dabRect = calculate_dab_roi (x, y, radius);
+  gegl_rectangle_intersect (&dabRect, &dabRect, gegl_buffer_get_extent (surface->buffer));
+
+  if (dabRect.width <= 0 || dabRect.height <= 0)
+    return 0;
+
+  gegl_rectangle_bounding_box (&surface->dirty, &surface->dirty, &dabRect);
+
+  dab.roi              = dabRect;
+  dab.x                = x;
+  dab.y                = y;
+  dab.radius           = radius;
+  dab.color_r          = color_r;
+  dab.color_g          = color_g;
+  dab.color_b          = color_b;
+  dab.color_a          = color_a;
+  dab.hardness         = hardness;
+  dab.aspect_ratio     = aspect_ratio;
+  dab.cs               = cos (angle_rad);
+  dab.sn               = sin (angle_rad);
+  dab.one_over_radius2 = 1.0f / (radius * radius);
+  dab.segment1_slope   = -(1.0f / hardness - 1.0f);
+  dab.segment2_slope   = -hardness / (1.0f - hardness);
+  dab.r_aa_start       = r_aa_start;
+  dab.normal_mode      = opaque * (1.0f - colorize);
+  dab.colorize         = opaque * colorize;
+
+  if (surface->dabs->len == 0)
+    surface->dabs_rect = dabRect;
+  else
+    gegl_rectangle_bounding_box (&surface->dabs_rect, &surface->dabs_rect,
+                                 &dabRect);
+
+  g_array_append_val (surface->dabs, dab);
+
+  /* outside of begin_atomic() / end_atomic(), draw right away */
+  if (! surface->atomic)
+    gimp_mypaint_surface_flush_dabs (surface);
 
   return 1;
 }
@@ -500,7 +754,9 @@ gimp_mypaint_surface_draw_dab (MyPaintSurface *base_surface,
 static void
 gimp_mypaint_surface_begin_atomic (MyPaintSurface *base_surface)
 {
+  GimpMybrushSurface *surface = (GimpMybrushSurface *)base_surface;
 
+  surface->atomic++;
 }
 
 static void
@@ -508,6 +764,13 @@ gimp_mypaint_surface_end_atomic (MyPaintSurface   *base_surface,
                                  MyPaintRectangle *roi)
 {
   GimpMybrushSurface *surface = (GimpMybrushSurface *)base_surface;
+
+  if (surface->atomic > 0)
+    surface->atomic--;
+
+  if (! surface->atomic)
+    gimp_mypaint_surface_flush_dabs (surface);
+
   roi->x = surface->dirty.x;
   roi->y = surface->dirty.y;
   roi->width = surface->dirty.width;
@@ -519,6 +782,9 @@ static void
 gimp_mypaint_surface_destroy (MyPaintSurface *base_surface)
 {
   GimpMybrushSurface *surface = (GimpMybrushSurface *)base_surface;
+  gimp_mypaint_surface_flush_dabs (surface);
+  g_array_free (surface->dabs, TRUE);
+  surface->dabs = NULL;
   g_object_unref (surface->buffer);
   surface->buffer = NULL;
   if (surface->paint_mask)
@@ -549,6 +815,7 @@ gimp_mypaint_surface_new (GeglBuffer        *buffer,
   surface->paint_mask_x = paint_mask_x;
   surface->paint_mask_y = paint_mask_y;
   surface->dirty = *GEGL_RECTANGLE (0, 0, 0, 0);
+  surface->dabs = g_array_new (FALSE, FALSE, sizeof (GimpMybrushDab));
 
   return surface;
 }
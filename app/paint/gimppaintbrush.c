@@ -245,7 +245,7 @@ _gimp_paintbrush_motion (GimpPaintCore    *paint_core,
                                              &foreground, &foreground);
           color = gimp_gegl_color_new (&foreground);
 
-          gegl_buffer_set_color (paint_buffer, NULL, color);
+          gimp_paint_core_set_paint_buffer_color (paint_core, color);
           g_object_unref (color);
         }
 
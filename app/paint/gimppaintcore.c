@@ -57,6 +57,11 @@
 
 #define STROKE_BUFFER_INIT_SIZE 2000
 
+/*  batched dabs are composited as soon as the bounds of the pending
+ *  dabs get larger than this many times the sum of their areas
+ */
+#define BATCH_MAX_OVERDRAW      4
+
 enum
 {
   PROP_0,
@@ -114,6 +119,22 @@ static GimpUndo* gimp_paint_core_real_push_undo      (GimpPaintCore    *core,
                                                       GimpImage        *image,
                                                       const gchar      *undo_desc);
 
+static void      gimp_paint_core_combine_canvas      (GimpPaintCore        *core,
+                                                      const GimpTempBuf    *paint_mask,
+                                                      gint                  paint_mask_offset_x,
+                                                      gint                  paint_mask_offset_y,
+                                                      gdouble               paint_opacity);
+static void      gimp_paint_core_batch_paste         (GimpPaintCore        *core,
+                                                      const GimpTempBuf    *paint_mask,
+                                                      gint                  paint_mask_offset_x,
+                                                      gint                  paint_mask_offset_y,
+                                                      GimpDrawable         *drawable,
+                                                      gdouble               paint_opacity,
+                                                      gdouble               image_opacity,
+                                                      GimpLayerModeEffects  paint_mode);
+static void      gimp_paint_core_flush_batch         (GimpPaintCore        *core,
+                                                      GimpDrawable         *drawable);
+
 
 G_DEFINE_TYPE (GimpPaintCore, gimp_paint_core, GIMP_TYPE_OBJECT)
 
@@ -162,6 +183,8 @@ gimp_paint_core_finalize (GObject *object)
   g_free (core->undo_desc);
   core->undo_desc = NULL;
 
+  g_clear_object (&core->batch_color);
+
   if (core->stroke_buffer)
     {
       g_array_free (core->stroke_buffer, TRUE);
@@ -288,6 +311,162 @@ gimp_paint_core_real_push_undo (GimpPaintCore *core,
                                NULL);
 }
 
+/*  combines the paint mask into the canvas buffer, at the position
+ *  of the paint buffer
+ */
+static void
+gimp_paint_core_combine_canvas (GimpPaintCore     *core,
+                                const GimpTempBuf *paint_mask,
+                                gint               paint_mask_offset_x,
+                                gint               paint_mask_offset_y,
+                                gdouble            paint_opacity)
+{
+  GimpTempBuf *modified_mask;
+  GeglBuffer  *paint_mask_buffer;
+  gint         width  = gegl_buffer_get_width  (core->paint_buffer);
+  gint         height = gegl_buffer_get_height (core->paint_buffer);
+
+  modified_mask     = gimp_temp_buf_copy (paint_mask);
+  paint_mask_buffer = gimp_temp_buf_create_buffer (modified_mask);
+
+  gimp_gegl_combine_mask_weird (paint_mask_buffer,
+                                GEGL_RECTANGLE (paint_mask_offset_x,
+                                                paint_mask_offset_y,
+                                                width, height),
+                                core->canvas_buffer,
+                                GEGL_RECTANGLE (core->paint_buffer_x,
+                                                core->paint_buffer_y,
+                                                width, height),
+                                paint_opacity,
+                                GIMP_IS_AIRBRUSH (core));
+
+  g_object_unref (paint_mask_buffer);
+  gimp_temp_buf_unref (modified_mask);
+}
+
+/*  like the constant mode of gimp_paint_core_paste(), but only combines
+ *  the paint mask into the canvas buffer, and leaves compositing to
+ *  gimp_paint_core_flush_batch()
+ */
+static void
+gimp_paint_core_batch_paste (GimpPaintCore        *core,
+                             const GimpTempBuf    *paint_mask,
+                             gint                  paint_mask_offset_x,
+                             gint                  paint_mask_offset_y,
+                             GimpDrawable         *drawable,
+                             gdouble               paint_opacity,
+                             gdouble               image_opacity,
+                             GimpLayerModeEffects  paint_mode)
+{
+  GeglRectangle  rect;
+  const Babl    *format = gegl_buffer_get_format (core->paint_buffer);
+  gint64         area;
+
+  rect.x      = core->paint_buffer_x;
+  rect.y      = core->paint_buffer_y;
+  rect.width  = gegl_buffer_get_width  (core->paint_buffer);
+  rect.height = gegl_buffer_get_height (core->paint_buffer);
+
+  area = (gint64) rect.width * rect.height;
+
+  if (core->batch_color)
+    {
+      GeglRectangle bounds;
+      gdouble       rgba1[4];
+      gdouble       rgba2[4];
+
+      gegl_color_get_rgba (core->batch_color,
+                           &rgba1[0], &rgba1[1], &rgba1[2], &rgba1[3]);
+      gegl_color_get_rgba (core->paint_buffer_color,
+                           &rgba2[0], &rgba2[1], &rgba2[2], &rgba2[3]);
+
+      gegl_rectangle_bounding_box (&bounds, &core->batch_rect, &rect);
+
+      /*  the pending dabs must be composited with their own color,
+       *  and before they cover too much area they don't paint on
+       */
+      if (memcmp (rgba1, rgba2, sizeof (rgba1)) ||
+          format        != core->batch_format  ||
+          image_opacity != core->batch_opacity ||
+          paint_mode    != core->batch_mode    ||
+          (gint64) bounds.width * bounds.height >
+          BATCH_MAX_OVERDRAW * (core->batch_area + area))
+        {
+          gimp_paint_core_flush_batch (core, drawable);
+        }
+    }
+
+  gimp_paint_core_combine_canvas (core, paint_mask,
+                                  paint_mask_offset_x,
+                                  paint_mask_offset_y,
+                                  paint_opacity);
+
+  if (core->batch_color)
+    {
+      gegl_rectangle_bounding_box (&core->batch_rect, &core->batch_rect,
+                                   &rect);
+      core->batch_area += area;
+    }
+  else
+    {
+      core->batch_color   = g_object_ref (core->paint_buffer_color);
+      core->batch_format  = format;
+      core->batch_opacity = image_opacity;
+      core->batch_mode    = paint_mode;
+      core->batch_rect    = rect;
+      core->batch_area    = area;
+    }
+
+  /*  Update the undo extents  */
+  core->x1 = MIN (core->x1, rect.x);
+  core->y1 = MIN (core->y1, rect.y);
+  core->x2 = MAX (core->x2, rect.x + rect.width);
+  core->y2 = MAX (core->y2, rect.y + rect.height);
+}
+
+/*  composites the pending batched dabs onto the drawable at once.
+ *  Since constant mode always composites from the undo buffer, through
+ *  the accumulated canvas buffer, this gives the same result as
+ *  compositing each of them in turn.
+ */
+static void
+gimp_paint_core_flush_batch (GimpPaintCore *core,
+                             GimpDrawable  *drawable)
+{
+  GeglRectangle *rect = &core->batch_rect;
+  GeglBuffer    *paint_buffer;
+
+  if (! core->batch_color)
+    return;
+
+  paint_buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0,
+                                                  rect->width, rect->height),
+                                  core->batch_format);
+
+  gegl_buffer_set_color (paint_buffer, NULL, core->batch_color);
+
+  gimp_gegl_apply_mask (core->canvas_buffer, rect,
+                        paint_buffer,
+                        GEGL_RECTANGLE (0, 0, rect->width, rect->height),
+                        1.0);
+
+  gimp_applicator_set_src_buffer (core->applicator, core->undo_buffer);
+  gimp_applicator_set_apply_buffer (core->applicator, paint_buffer);
+  gimp_applicator_set_apply_offset (core->applicator, rect->x, rect->y);
+
+  gimp_applicator_set_opacity (core->applicator, core->batch_opacity);
+  gimp_applicator_set_mode (core->applicator, core->batch_mode);
+
+  gimp_applicator_blit (core->applicator, rect);
+
+  g_object_unref (paint_buffer);
+
+  gimp_drawable_update (drawable,
+                        rect->x, rect->y, rect->width, rect->height);
+
+  g_clear_object (&core->batch_color);
+}
+
 
 /*  public functions  */
 
@@ -558,14 +737,10 @@ gimp_paint_core_finish (GimpPaintCore *core,
 
       GIMP_PAINT_CORE_GET_CLASS (core)->push_undo (core, image, NULL);
 
-      buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0, width, height),
-                                gimp_drawable_get_format (drawable));
-
-      gegl_buffer_copy (core->undo_buffer,
-                        GEGL_RECTANGLE (x, y, width, height),
-                        GEGL_ABYSS_NONE,
-                        buffer,
-                        GEGL_RECTANGLE (0, 0, 0, 0));
+      /*  share the unchanged tiles with the undo buffer  */
+      buffer = gimp_gegl_buffer_dup_rect (core->undo_buffer,
+                                          GEGL_RECTANGLE (x, y,
+                                                          width, height));
 
       gimp_drawable_push_undo (drawable, NULL,
                                buffer, x, y, width, height);
@@ -661,6 +836,8 @@ gimp_paint_core_cleanup (GimpPaintCore *core)
       g_object_unref (core->paint_buffer);
       core->paint_buffer = NULL;
     }
+
+  g_clear_object (&core->paint_buffer_color);
 }
 
 void
@@ -758,6 +935,36 @@ gimp_paint_core_round_line (GimpPaintCore    *core,
                          GIMP_CONSTRAIN_LINE_15_DEGREES);
 }
 
+/*  Between gimp_paint_core_begin_batch() and gimp_paint_core_end_batch(),
+ *  consecutive GIMP_PAINT_CONSTANT dabs with the same flat paint color,
+ *  opacity and mode are only combined into the canvas mask, and are
+ *  composited onto the drawable, and the drawable is updated, once for
+ *  all of them.  Since constant dabs are always composited from the
+ *  undo buffer through the canvas mask, this gives the same result as
+ *  compositing each dab separately.
+ */
+void
+gimp_paint_core_begin_batch (GimpPaintCore *core)
+{
+  g_return_if_fail (GIMP_IS_PAINT_CORE (core));
+
+  core->batch_level++;
+}
+
+void
+gimp_paint_core_end_batch (GimpPaintCore *core,
+                           GimpDrawable  *drawable)
+{
+  g_return_if_fail (GIMP_IS_PAINT_CORE (core));
+  g_return_if_fail (GIMP_IS_DRAWABLE (drawable));
+  g_return_if_fail (core->batch_level > 0);
+
+  core->batch_level--;
+
+  if (core->batch_level == 0)
+    gimp_paint_core_flush_batch (core, drawable);
+}
+
 
 /*  protected functions  */
 
@@ -793,9 +1000,27 @@ gimp_paint_core_get_paint_buffer (GimpPaintCore    *core,
   core->paint_buffer_x = *paint_buffer_x;
   core->paint_buffer_y = *paint_buffer_y;
 
+  g_clear_object (&core->paint_buffer_color);
+
   return paint_buffer;
 }
 
+/*  fills the paint buffer with 'color', and remembers that it is a
+ *  flat color, which allows batching the dab
+ */
+void
+gimp_paint_core_set_paint_buffer_color (GimpPaintCore *core,
+                                        GeglColor     *color)
+{
+  g_return_if_fail (GIMP_IS_PAINT_CORE (core));
+  g_return_if_fail (GEGL_IS_COLOR (color));
+  g_return_if_fail (core->paint_buffer != NULL);
+
+  gegl_buffer_set_color (core->paint_buffer, NULL, color);
+
+  g_set_object (&core->paint_buffer_color, color);
+}
+
 GeglBuffer *
 gimp_paint_core_get_orig_image (GimpPaintCore *core)
 {
@@ -828,6 +1053,24 @@ gimp_paint_core_paste (GimpPaintCore            *core,
   gint width  = gegl_buffer_get_width  (core->paint_buffer);
   gint height = gegl_buffer_get_height (core->paint_buffer);
 
+  if (core->batch_level > 0       &&
+      core->applicator            &&
+      core->paint_buffer_color    &&
+      mode == GIMP_PAINT_CONSTANT &&
+      paint_mask != NULL)
+    {
+      gimp_paint_core_batch_paste (core, paint_mask,
+                                   paint_mask_offset_x,
+                                   paint_mask_offset_y,
+                                   drawable,
+                                   paint_opacity,
+                                   image_opacity, paint_mode);
+      return;
+    }
+
+  /*  composite the pending dabs before anything else  */
+  gimp_paint_core_flush_batch (core, drawable);
+
   if (core->applicator)
     {
       /*  If the mode is CONSTANT:
@@ -839,25 +1082,10 @@ gimp_paint_core_paste (GimpPaintCore            *core,
            * directly. Don't need to copy it in this case.
            */
           if (paint_mask != NULL)
-            {
-              GimpTempBuf *modified_mask     = gimp_temp_buf_copy (paint_mask);
-              GeglBuffer  *paint_mask_buffer =
-                gimp_temp_buf_create_buffer ((GimpTempBuf *) modified_mask);
-
-              gimp_gegl_combine_mask_weird (paint_mask_buffer,
-                                            GEGL_RECTANGLE (paint_mask_offset_x,
-                                                            paint_mask_offset_y,
-                                                            width, height),
-                                            core->canvas_buffer,
-                                            GEGL_RECTANGLE (core->paint_buffer_x,
-                                                            core->paint_buffer_y,
-                                                            width, height),
-                                            paint_opacity,
-                                            GIMP_IS_AIRBRUSH (core));
-
-              g_object_unref (paint_mask_buffer);
-              gimp_temp_buf_unref (modified_mask);
-            }
+            gimp_paint_core_combine_canvas (core, paint_mask,
+                                            paint_mask_offset_x,
+                                            paint_mask_offset_y,
+                                            paint_opacity);
 
           gimp_gegl_apply_mask (core->canvas_buffer,
                                 GEGL_RECTANGLE (core->paint_buffer_x,
@@ -1024,6 +1252,8 @@ gimp_paint_core_replace (GimpPaintCore            *core,
   GeglBuffer    *paint_mask_buffer;
   gint           width, height;
 
+  gimp_paint_core_flush_batch (core, drawable);
+
   if (! gimp_drawable_has_alpha (drawable))
     {
       gimp_paint_core_paste (core, paint_mask,
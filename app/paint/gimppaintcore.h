@@ -72,6 +72,16 @@ struct _GimpPaintCore
   GimpApplicator *applicator;
 
   GArray      *stroke_buffer;
+
+  GeglColor   *paint_buffer_color; /*  the flat color of paint_buffer, if any */
+
+  gint                  batch_level;   /*  > 0 while dabs are batched       */
+  GeglColor            *batch_color;   /*  color of the pending dabs, or NULL */
+  const Babl           *batch_format;
+  gdouble               batch_opacity;
+  GimpLayerModeEffects  batch_mode;
+  GeglRectangle         batch_rect;    /*  bounds of the pending dabs       */
+  gint64                batch_area;    /*  sum of their areas               */
 };
 
 struct _GimpPaintCoreClass
@@ -162,6 +172,10 @@ void      gimp_paint_core_round_line                (GimpPaintCore    *core,
                                                      GimpPaintOptions *options,
                                                      gboolean          constrain_15_degrees);
 
+void      gimp_paint_core_begin_batch               (GimpPaintCore    *core);
+void      gimp_paint_core_end_batch                 (GimpPaintCore    *core,
+                                                     GimpDrawable     *drawable);
+
 
 /*  protected functions  */
 
@@ -174,6 +188,9 @@ GeglBuffer * gimp_paint_core_get_paint_buffer       (GimpPaintCore    *core,
                                                      gint             *paint_width,
                                                      gint             *paint_height);
 
+void      gimp_paint_core_set_paint_buffer_color    (GimpPaintCore    *core,
+                                                     GeglColor        *color);
+
 GeglBuffer * gimp_paint_core_get_orig_image         (GimpPaintCore    *core);
 GeglBuffer * gimp_paint_core_get_orig_proj          (GimpPaintCore    *core);
 
@@ -173,7 +173,9 @@ image_convert_indexed_invoker (GimpProcedure         *procedure,
 
       if (success)
         success = gimp_image_convert_indexed (image,
-                                              palette_type, num_cols, remove_unused,
+                                              palette_type, num_cols,
+                                              GIMP_CONVERT_QUANTIZER_MEDIAN_CUT,
+                                              remove_unused,
                                               dither_type, alpha_dither, FALSE,
                                               pal,
                                               NULL, error);
@@ -21,6 +21,7 @@
 
 #include <string.h>
 
+#include <glib/gstdio.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <gegl.h>
 
@@ -35,6 +36,7 @@
 #include "gegl/gimp-gegl-tile-compat.h"
 
 #include "core/gimp.h"
+#include "core/gimp-utils.h"
 #include "core/gimpdrawable.h"
 #include "core/gimpdrawable-shadow.h"
 
@@ -54,27 +56,52 @@
 #include "gimp-intl.h"
 
 
+typedef struct
+{
+  GimpPlugIn       *plug_in;
+  GeglBuffer       *buffer;
+  const Babl       *format;
+  GPDrawableExport  drawable_export;
+} GimpPlugInExport;
+
+
 /*  local function prototypes  */
 
-static void gimp_plug_in_handle_quit             (GimpPlugIn      *plug_in);
-static void gimp_plug_in_handle_tile_request     (GimpPlugIn      *plug_in,
-                                                  GPTileReq       *request);
-static void gimp_plug_in_handle_tile_put         (GimpPlugIn      *plug_in,
-                                                  GPTileReq       *request);
-static void gimp_plug_in_handle_tile_get         (GimpPlugIn      *plug_in,
-                                                  GPTileReq       *request);
-static void gimp_plug_in_handle_proc_run         (GimpPlugIn      *plug_in,
-                                                  GPProcRun       *proc_run);
-static void gimp_plug_in_handle_proc_return      (GimpPlugIn      *plug_in,
-                                                  GPProcReturn    *proc_return);
-static void gimp_plug_in_handle_temp_proc_return (GimpPlugIn      *plug_in,
-                                                  GPProcReturn    *proc_return);
-static void gimp_plug_in_handle_proc_install     (GimpPlugIn      *plug_in,
-                                                  GPProcInstall   *proc_install);
-static void gimp_plug_in_handle_proc_uninstall   (GimpPlugIn      *plug_in,
-                                                  GPProcUninstall *proc_uninstall);
-static void gimp_plug_in_handle_extension_ack    (GimpPlugIn      *plug_in);
-static void gimp_plug_in_handle_has_init         (GimpPlugIn      *plug_in);
+static void     gimp_plug_in_handle_quit             (GimpPlugIn       *plug_in);
+static void     gimp_plug_in_handle_tile_request     (GimpPlugIn       *plug_in,
+                                                      GPTileReq        *request);
+static void     gimp_plug_in_handle_tile_put         (GimpPlugIn       *plug_in,
+                                                      GPTileReq        *request);
+static void     gimp_plug_in_handle_tile_get         (GimpPlugIn       *plug_in,
+                                                      GPTileReq        *request);
+static void     gimp_plug_in_handle_tile_rect        (GimpPlugIn       *plug_in,
+                                                      GPTileRect       *request);
+static void     gimp_plug_in_handle_tile_rect_put    (GimpPlugIn       *plug_in,
+                                                      GPTileRect       *tile_rect,
+                                                      GeglBuffer       *buffer,
+                                                      const Babl       *format);
+static void     gimp_plug_in_handle_tile_rect_get    (GimpPlugIn       *plug_in,
+                                                      GPTileRect       *tile_rect,
+                                                      GeglBuffer       *buffer,
+                                                      const Babl       *format);
+static void     gimp_plug_in_handle_drawable_export  (GimpPlugIn       *plug_in,
+                                                      GPDrawableExport *request);
+static gpointer gimp_plug_in_export_thread           (GimpPlugInExport *export);
+static gboolean gimp_plug_in_export_idle             (GimpPlugInExport *export);
+static gchar  * gimp_plug_in_export_buffer           (GeglBuffer       *buffer,
+                                                      const Babl       *format);
+static void     gimp_plug_in_handle_proc_run         (GimpPlugIn       *plug_in,
+                                                      GPProcRun        *proc_run);
+static void     gimp_plug_in_handle_proc_return      (GimpPlugIn       *plug_in,
+                                                      GPProcReturn     *proc_return);
+static void     gimp_plug_in_handle_temp_proc_return (GimpPlugIn       *plug_in,
+                                                      GPProcReturn     *proc_return);
+static void     gimp_plug_in_handle_proc_install     (GimpPlugIn       *plug_in,
+                                                      GPProcInstall    *proc_install);
+static void     gimp_plug_in_handle_proc_uninstall   (GimpPlugIn       *plug_in,
+                                                      GPProcUninstall  *proc_uninstall);
+static void     gimp_plug_in_handle_extension_ack    (GimpPlugIn       *plug_in);
+static void     gimp_plug_in_handle_has_init         (GimpPlugIn       *plug_in);
 
 
 /*  public functions  */
@@ -160,6 +187,32 @@ gimp_plug_in_handle_message (GimpPlugIn      *plug_in,
     case GP_HAS_INIT:
       gimp_plug_in_handle_has_init (plug_in);
       break;
+
+    case GP_TILE_RECT_REQ:
+      gimp_plug_in_handle_tile_rect (plug_in, msg->data);
+      break;
+
+    case GP_TILE_RECT_DATA:
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "sent a TILE_RECT_DATA message.  This should not happen.",
+                    gimp_object_get_name (plug_in),
+                    gimp_file_get_utf8_name (plug_in->file));
+      gimp_plug_in_close (plug_in, TRUE);
+      break;
+
+    case GP_DRAWABLE_EXPORT_REQ:
+      gimp_plug_in_handle_drawable_export (plug_in, msg->data);
+      break;
+
+    case GP_DRAWABLE_EXPORT:
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "sent a DRAWABLE_EXPORT message.  This should not happen.",
+                    gimp_object_get_name (plug_in),
+                    gimp_file_get_utf8_name (plug_in->file));
+      gimp_plug_in_close (plug_in, TRUE);
+      break;
     }
 }
 
@@ -504,6 +557,513 @@ gimp_plug_in_handle_proc_error (GimpPlugIn          *plug_in,
     }
 }
 
+/*  Moves a whole rectangle of pixels in one exchange, instead of one
+ *  tile per exchange.  Reading pixels works like reading a tile:
+ *  the pixels are sent, and the plug-in acknowledges them.  Writing
+ *  pixels works like writing a tile: the request is acknowledged,
+ *  the plug-in sends the pixels, and they are acknowledged again.
+ *  Either way the shared memory segment stays reserved for the
+ *  plug-in until the exchange is complete.
+ */
+static void
+gimp_plug_in_handle_tile_rect (GimpPlugIn *plug_in,
+                               GPTileRect *request)
+{
+  GPTileRect       tile_rect;
+  GimpDrawable    *drawable;
+  GeglBuffer      *buffer;
+  const Babl      *format;
+  GeglRectangle    rect;
+  gsize            size;
+
+  g_return_if_fail (request != NULL);
+
+  drawable = (GimpDrawable *) gimp_item_get_by_ID (plug_in->manager->gimp,
+                                                   request->drawable_ID);
+
+  if (! GIMP_IS_DRAWABLE (drawable))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "tried accessing invalid drawable %d (killing)",
+                    gimp_object_get_name (plug_in),
+                    gimp_file_get_utf8_name (plug_in->file),
+                    request->drawable_ID);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+  else if (gimp_item_is_removed (GIMP_ITEM (drawable)))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "tried accessing drawable %d which was removed "
+                    "from the image (killing)",
+                    gimp_object_get_name (plug_in),
+                    gimp_file_get_utf8_name (plug_in->file),
+                    request->drawable_ID);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  if (request->shadow)
+    {
+      buffer = gimp_drawable_get_shadow_buffer (drawable);
+
+      gimp_plug_in_cleanup_add_shadow (plug_in, drawable);
+    }
+  else
+    {
+      if (request->put &&
+          gimp_item_is_content_locked (GIMP_ITEM (drawable)))
+        {
+          gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        "Plug-In \"%s\"\n(%s)\n\n"
+                        "tried writing to a locked drawable %d (killing)",
+                        gimp_object_get_name (plug_in),
+                        gimp_file_get_utf8_name (plug_in->file),
+                        request->drawable_ID);
+          gimp_plug_in_close (plug_in, TRUE);
+          return;
+        }
+      else if (request->put &&
+               gimp_viewable_get_children (GIMP_VIEWABLE (drawable)))
+        {
+          gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        "Plug-In \"%s\"\n(%s)\n\n"
+                        "tried writing to a group layer %d (killing)",
+                        gimp_object_get_name (plug_in),
+                        gimp_file_get_utf8_name (plug_in->file),
+                        request->drawable_ID);
+          gimp_plug_in_close (plug_in, TRUE);
+          return;
+        }
+
+      buffer = gimp_drawable_get_buffer (drawable);
+    }
+
+  rect.x      = request->x;
+  rect.y      = request->y;
+  rect.width  = request->width;
+  rect.height = request->height;
+
+  if (rect.width <= 0 || rect.height <= 0 ||
+      ! gegl_rectangle_contains (gegl_buffer_get_extent (buffer), &rect))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "requested invalid tile rectangle (killing)",
+                    gimp_object_get_name (plug_in),
+                    gimp_file_get_utf8_name (plug_in->file));
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  format = gegl_buffer_get_format (buffer);
+
+  if (! gimp_plug_in_precision_enabled (plug_in))
+    {
+      format = gimp_babl_compat_u8_format (format);
+    }
+
+  size = ((gsize) rect.width * (gsize) rect.height *
+          babl_format_get_bytes_per_pixel (format));
+
+  tile_rect.drawable_ID = request->drawable_ID;
+  tile_rect.shadow      = request->shadow;
+  tile_rect.put         = request->put;
+  tile_rect.x           = rect.x;
+  tile_rect.y           = rect.y;
+  tile_rect.width       = rect.width;
+  tile_rect.height      = rect.height;
+  tile_rect.bpp         = babl_format_get_bytes_per_pixel (format);
+  tile_rect.use_shm     = (plug_in->manager->shm != NULL &&
+                           size <= GP_SHM_SIZE);
+  tile_rect.data        = NULL;
+
+  if (size > G_MAXINT)
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "requested a tile rectangle which is too large (killing)",
+                    gimp_object_get_name (plug_in),
+                    gimp_file_get_utf8_name (plug_in->file));
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  if (request->put)
+    gimp_plug_in_handle_tile_rect_put (plug_in, &tile_rect, buffer, format);
+  else
+    gimp_plug_in_handle_tile_rect_get (plug_in, &tile_rect, buffer, format);
+}
+
+static void
+gimp_plug_in_handle_tile_rect_put (GimpPlugIn *plug_in,
+                                   GPTileRect *tile_rect,
+                                   GeglBuffer *buffer,
+                                   const Babl *format)
+{
+  GPTileRect      *tile_info;
+  GimpWireMessage  msg;
+  const guchar    *data;
+
+  if (! gp_tile_ack_write (plug_in->my_write, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  if (msg.type != GP_TILE_RECT_DATA)
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "expected tile data and received: %d", msg.type);
+      gimp_wire_destroy (&msg);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  tile_info = msg.data;
+
+  /*  the plug-in may send the pixels over the pipe even if it could
+   *  have used shared memory, but not the other way around
+   */
+  if (tile_info->drawable_ID != tile_rect->drawable_ID ||
+      tile_info->shadow      != tile_rect->shadow      ||
+      tile_info->x           != tile_rect->x           ||
+      tile_info->y           != tile_rect->y           ||
+      tile_info->width       != tile_rect->width       ||
+      tile_info->height      != tile_rect->height      ||
+      tile_info->bpp         != tile_rect->bpp         ||
+      (tile_info->use_shm && ! tile_rect->use_shm))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "sent tile data which doesn't match its request (killing)",
+                    gimp_object_get_name (plug_in),
+                    gimp_file_get_utf8_name (plug_in->file));
+      gimp_wire_destroy (&msg);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  if (tile_info->use_shm)
+    data = gimp_plug_in_shm_get_addr (plug_in->manager->shm);
+  else
+    data = tile_info->data;
+
+  gegl_buffer_set (buffer,
+                   GEGL_RECTANGLE (tile_rect->x,     tile_rect->y,
+                                   tile_rect->width, tile_rect->height),
+                   0, format, data, GEGL_AUTO_ROWSTRIDE);
+
+  gimp_wire_destroy (&msg);
+
+  if (! gp_tile_ack_write (plug_in->my_write, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+}
+
+static void
+gimp_plug_in_handle_tile_rect_get (GimpPlugIn *plug_in,
+                                   GPTileRect *tile_rect,
+                                   GeglBuffer *buffer,
+                                   const Babl *format)
+{
+  GimpWireMessage  msg;
+  guchar          *data;
+
+  if (tile_rect->use_shm)
+    {
+      data = gimp_plug_in_shm_get_addr (plug_in->manager->shm);
+    }
+  else
+    {
+      data = g_malloc ((gsize) tile_rect->width * tile_rect->height *
+                       tile_rect->bpp);
+
+      tile_rect->data = data;
+    }
+
+  gegl_buffer_get (buffer,
+                   GEGL_RECTANGLE (tile_rect->x,     tile_rect->y,
+                                   tile_rect->width, tile_rect->height),
+                   1.0, format, data,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  if (! gp_tile_rect_data_write (plug_in->my_write, tile_rect, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      g_free (tile_rect->data);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  g_free (tile_rect->data);
+  tile_rect->data = NULL;
+
+  if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  if (msg.type != GP_TILE_ACK)
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "expected tile ack and received: %d", msg.type);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  gimp_wire_destroy (&msg);
+}
+
+/*  Writes all pixels of a drawable to a file next to GEGL's swap,
+ *  which the plug-in maps into its memory, so it can read them
+ *  without any further exchange.  The file is written from a snapshot
+ *  of the drawable by a separate thread, so the main loop keeps
+ *  running meanwhile; the plug-in waits for the reply.  The file is
+ *  removed as soon as the plug-in acknowledges that it has mapped it.
+ */
+static void
+gimp_plug_in_handle_drawable_export (GimpPlugIn       *plug_in,
+                                     GPDrawableExport *request)
+{
+  GimpPlugInExport *export;
+  GimpDrawable     *drawable;
+  GeglBuffer       *buffer;
+
+  g_return_if_fail (request != NULL);
+
+  drawable = (GimpDrawable *) gimp_item_get_by_ID (plug_in->manager->gimp,
+                                                   request->drawable_ID);
+
+  if (! GIMP_IS_DRAWABLE (drawable))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "tried exporting invalid drawable %d (killing)",
+                    gimp_object_get_name (plug_in),
+                    gimp_file_get_utf8_name (plug_in->file),
+                    request->drawable_ID);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+  else if (gimp_item_is_removed (GIMP_ITEM (drawable)))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "tried exporting drawable %d which was removed "
+                    "from the image (killing)",
+                    gimp_object_get_name (plug_in),
+                    gimp_file_get_utf8_name (plug_in->file),
+                    request->drawable_ID);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  buffer = gimp_drawable_get_buffer (drawable);
+
+  export = g_slice_new0 (GimpPlugInExport);
+
+  export->plug_in = g_object_ref (plug_in);
+  export->buffer  = gegl_buffer_dup (buffer);
+  export->format  = gegl_buffer_get_format (buffer);
+
+  if (! gimp_plug_in_precision_enabled (plug_in))
+    {
+      export->format = gimp_babl_compat_u8_format (export->format);
+    }
+
+  export->drawable_export.drawable_ID = request->drawable_ID;
+  export->drawable_export.width       = gegl_buffer_get_width  (buffer);
+  export->drawable_export.height      = gegl_buffer_get_height (buffer);
+  export->drawable_export.bpp         =
+    babl_format_get_bytes_per_pixel (export->format);
+
+  g_thread_unref (g_thread_new ("plug-in export",
+                                (GThreadFunc) gimp_plug_in_export_thread,
+                                export));
+}
+
+static gpointer
+gimp_plug_in_export_thread (GimpPlugInExport *export)
+{
+  export->drawable_export.filename =
+    gimp_plug_in_export_buffer (export->buffer, export->format);
+
+  g_idle_add_full (G_PRIORITY_DEFAULT,
+                   (GSourceFunc) gimp_plug_in_export_idle,
+                   export, NULL);
+
+  return NULL;
+}
+
+/*  sends the written file to the plug-in, back on the main thread  */
+static gboolean
+gimp_plug_in_export_idle (GimpPlugInExport *export)
+{
+  GimpPlugIn       *plug_in         = export->plug_in;
+  GPDrawableExport *drawable_export = &export->drawable_export;
+  GimpWireMessage   msg;
+
+  g_clear_object (&export->buffer);
+
+  /*  the plug-in went away while the file was written  */
+  if (! plug_in->open)
+    goto out;
+
+  if (! gp_drawable_export_write (plug_in->my_write, drawable_export,
+                                  plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      gimp_plug_in_close (plug_in, TRUE);
+      goto out;
+    }
+
+  /*  without a file, there is nothing to acknowledge  */
+  if (! drawable_export->filename)
+    goto out;
+
+  if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      gimp_plug_in_close (plug_in, TRUE);
+      goto out;
+    }
+
+  if (msg.type != GP_TILE_ACK)
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "expected tile ack and received: %d", msg.type);
+      gimp_plug_in_close (plug_in, TRUE);
+    }
+
+  gimp_wire_destroy (&msg);
+
+ out:
+  /*  on some platforms, a mapped file can't be removed, the plug-in
+   *  removes it after unmapping it then
+   */
+  if (drawable_export->filename)
+    g_unlink (drawable_export->filename);
+
+  g_free (drawable_export->filename);
+  g_object_unref (plug_in);
+
+  g_slice_free (GimpPlugInExport, export);
+
+  return G_SOURCE_REMOVE;
+}
+
+/*  returns the name of a new file with the pixels of 'buffer' in
+ *  'format', row after row, or NULL if it couldn't be written
+ */
+static gchar *
+gimp_plug_in_export_buffer (GeglBuffer *buffer,
+                            const Babl *format)
+{
+  static gint    export_serial = 0;
+  GFile         *file;
+  GOutputStream *output;
+  gchar         *swap     = NULL;
+  gchar         *basename;
+  gchar         *filename;
+  guchar        *data;
+  gint           width    = gegl_buffer_get_width  (buffer);
+  gint           height   = gegl_buffer_get_height (buffer);
+  gsize          rowstride;
+  gint           n_rows;
+  gint           y;
+  gboolean       success  = TRUE;
+
+  g_object_get (gegl_config (), "swap", &swap, NULL);
+
+  basename = g_strdup_printf ("gimp-drawable-%d-%d",
+                              gimp_get_pid (),
+                              g_atomic_int_add (&export_serial, 1));
+
+  if (swap && g_file_test (swap, G_FILE_TEST_IS_DIR))
+    filename = g_build_filename (swap, basename, NULL);
+  else
+    filename = g_build_filename (g_get_tmp_dir (), basename, NULL);
+
+  g_free (basename);
+  g_free (swap);
+
+  file   = g_file_new_for_path (filename);
+  output = G_OUTPUT_STREAM (g_file_create (file, G_FILE_CREATE_PRIVATE,
+                                           NULL, NULL));
+
+  if (! output)
+    {
+      g_object_unref (file);
+      g_free (filename);
+
+      return NULL;
+    }
+
+  /*  write the pixels in bands of the size of the shared memory
+   *  segment, so exporting doesn't need more memory than a tile
+   *  transfer
+   */
+  rowstride = (gsize) width * babl_format_get_bytes_per_pixel (format);
+  n_rows    = MAX (GP_SHM_SIZE / rowstride, 1);
+  n_rows    = MIN (n_rows, height);
+
+  data = g_malloc (rowstride * n_rows);
+
+  for (y = 0; success && y < height; y += n_rows)
+    {
+      gint band_height = MIN (n_rows, height - y);
+
+      gegl_buffer_get (buffer,
+                       GEGL_RECTANGLE (0, y, width, band_height),
+                       1.0, format, data,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+      success = g_output_stream_write_all (output,
+                                           data, rowstride * band_height,
+                                           NULL, NULL, NULL);
+    }
+
+  g_free (data);
+
+  if (! g_output_stream_close (output, NULL, NULL))
+    success = FALSE;
+
+  g_object_unref (output);
+
+  if (! success)
+    {
+      g_file_delete (file, NULL, NULL);
+      g_clear_pointer (&filename, g_free);
+    }
+
+  g_object_unref (file);
+
+  return filename;
+}
+
 static void
 gimp_plug_in_handle_proc_run (GimpPlugIn *plug_in,
                               GPProcRun  *proc_run)
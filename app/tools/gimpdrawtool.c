@@ -976,15 +976,16 @@ gimp_draw_tool_add_transform_guides (GimpDrawTool      *draw_tool,
 }
 
 GimpCanvasItem *
-gimp_draw_tool_add_transform_preview (GimpDrawTool      *draw_tool,
-                                      GimpDrawable      *drawable,
-                                      const GimpMatrix3 *transform,
-                                      gdouble            x1,
-                                      gdouble            y1,
-                                      gdouble            x2,
-                                      gdouble            y2,
-                                      gboolean           perspective,
-                                      gdouble            opacity)
+gimp_draw_tool_add_transform_preview (GimpDrawTool          *draw_tool,
+                                      GimpDrawable          *drawable,
+                                      const GimpMatrix3     *transform,
+                                      gdouble                x1,
+                                      gdouble                y1,
+                                      gdouble                x2,
+                                      gdouble                y2,
+                                      gboolean               perspective,
+                                      gdouble                opacity,
+                                      GimpInterpolationType  interpolation)
 {
   GimpCanvasItem *item;
 
@@ -995,7 +996,8 @@ gimp_draw_tool_add_transform_preview (GimpDrawTool      *draw_tool,
   item = gimp_canvas_transform_preview_new (gimp_display_get_shell (draw_tool->display),
                                             drawable, transform,
                                             x1, y1, x2, y2,
-                                            perspective, opacity);
+                                            perspective, opacity,
+                                            interpolation);
 
   gimp_draw_tool_add_preview (draw_tool, item);
   g_object_unref (item);
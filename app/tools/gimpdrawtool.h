@@ -159,7 +159,8 @@ GimpCanvasItem * gimp_draw_tool_add_transform_preview(GimpDrawTool     *draw_too
                                                       gdouble           x2,
                                                       gdouble           y2,
                                                       gboolean          perspective,
-                                                      gdouble            opacity);
+                                                      gdouble           opacity,
+                                                      GimpInterpolationType interpolation);
 
 GimpCanvasItem * gimp_draw_tool_add_handle           (GimpDrawTool     *draw_tool,
                                                       GimpHandleType    type,
@@ -1098,7 +1098,8 @@ gimp_transform_tool_draw (GimpDrawTool *draw_tool)
                                                 tr_tool->x2,
                                                 tr_tool->y2,
                                                 tr_tool->does_perspective,
-                                                options->preview_opacity);
+                                                options->preview_opacity,
+                                                options->interpolation);
         }
 
       gimp_draw_tool_add_transform_guides (draw_tool,
@@ -54,6 +54,14 @@ static void     gimp_histogram_editor_layer_changed (GimpImage           *image,
 static void     gimp_histogram_editor_frozen_update (GimpHistogramEditor *editor,
                                                      const GParamSpec    *pspec);
 static void     gimp_histogram_editor_update        (GimpHistogramEditor *editor);
+static void     gimp_histogram_editor_drawable_update
+                                                    (GimpDrawable        *drawable,
+                                                     gint                 x,
+                                                     gint                 y,
+                                                     gint                 width,
+                                                     gint                 height,
+                                                     GimpHistogramEditor *editor);
+static void     gimp_histogram_editor_queue_update  (GimpHistogramEditor *editor);
 
 static gboolean gimp_histogram_editor_idle_update   (GimpHistogramEditor *editor);
 static gboolean gimp_histogram_menu_sensitivity     (gint                 value,
@@ -282,6 +290,11 @@ gimp_histogram_editor_set_image (GimpImageEditor *image_editor,
     {
       editor->histogram = gimp_histogram_new (TRUE);
 
+      /*  keep the histogram up to date while painting, by calculating
+       *  only the changed parts of the drawable
+       */
+      gimp_histogram_set_incremental (editor->histogram, TRUE);
+
       gimp_histogram_view_set_histogram (view, editor->histogram);
 
       g_signal_connect_object (image, "mode-changed",
@@ -327,7 +340,7 @@ gimp_histogram_editor_layer_changed (GimpImage           *image,
                                             gimp_histogram_editor_menu_update,
                                             editor);
       g_signal_handlers_disconnect_by_func (editor->drawable,
-                                            gimp_histogram_editor_update,
+                                            gimp_histogram_editor_drawable_update,
                                             editor);
       g_signal_handlers_disconnect_by_func (editor->drawable,
                                             gimp_histogram_editor_frozen_update,
@@ -346,8 +359,8 @@ gimp_histogram_editor_layer_changed (GimpImage           *image,
                                G_CALLBACK (gimp_histogram_editor_frozen_update),
                                editor, G_CONNECT_SWAPPED);
       g_signal_connect_object (editor->drawable, "update",
-                               G_CALLBACK (gimp_histogram_editor_update),
-                               editor, G_CONNECT_SWAPPED);
+                               G_CALLBACK (gimp_histogram_editor_drawable_update),
+                               editor, 0);
       g_signal_connect_object (editor->drawable, "alpha-changed",
                                G_CALLBACK (gimp_histogram_editor_menu_update),
                                editor, G_CONNECT_SWAPPED);
@@ -419,6 +432,30 @@ gimp_histogram_editor_frozen_update (GimpHistogramEditor *editor,
 
 static void
 gimp_histogram_editor_update (GimpHistogramEditor *editor)
+{
+  if (editor->histogram)
+    gimp_histogram_invalidate (editor->histogram, NULL);
+
+  gimp_histogram_editor_queue_update (editor);
+}
+
+static void
+gimp_histogram_editor_drawable_update (GimpDrawable        *drawable,
+                                       gint                 x,
+                                       gint                 y,
+                                       gint                 width,
+                                       gint                 height,
+                                       GimpHistogramEditor *editor)
+{
+  if (editor->histogram)
+    gimp_histogram_invalidate (editor->histogram,
+                               GEGL_RECTANGLE (x, y, width, height));
+
+  gimp_histogram_editor_queue_update (editor);
+}
+
+static void
+gimp_histogram_editor_queue_update (GimpHistogramEditor *editor)
 {
   if (editor->idle_id)
     g_source_remove (editor->idle_id);
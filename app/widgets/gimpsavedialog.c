@@ -47,6 +47,7 @@ struct _GimpSaveDialogState
 {
   gchar    *filter_name;
   gboolean  compat;
+  gboolean  fast_compression;
 };
 
 
@@ -60,6 +61,8 @@ static void     gimp_save_dialog_load_state        (GimpFileDialog      *dialog,
 static void     gimp_save_dialog_add_compat_toggle (GimpSaveDialog      *dialog);
 static void     gimp_save_dialog_compat_toggled    (GtkToggleButton     *button,
                                                     GimpSaveDialog      *dialog);
+static void     gimp_save_dialog_fast_toggled      (GtkToggleButton     *button,
+                                                    GimpSaveDialog      *dialog);
 
 static GimpSaveDialogState
               * gimp_save_dialog_get_state         (GimpSaveDialog      *dialog);
@@ -298,6 +301,16 @@ gimp_save_dialog_set_image (GimpSaveDialog *dialog,
                                 (gimp_image_get_xcf_compat_mode (image) ||
                                  (! gimp_image_get_file (image) && dialog->compat)));
 
+  /* Same for the fast compression, which is only used when not
+   * saving in compatibility mode.
+   */
+  gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (dialog->fast_toggle),
+                                gimp_image_get_xcf_fast_compression (image) ||
+                                (! gimp_image_get_file (image) &&
+                                 dialog->fast_compression));
+  gtk_widget_set_sensitive (dialog->fast_toggle,
+                            ! gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (dialog->compat_toggle)));
+
   if (ext_file)
     {
       GFile *tmp_file = gimp_file_with_new_extension (name_file, ext_file);
@@ -334,6 +347,7 @@ static void
 gimp_save_dialog_add_compat_toggle (GimpSaveDialog *dialog)
 {
   GtkWidget *compat_frame;
+  GtkWidget *vbox;
 
   compat_frame = gimp_frame_new (NULL);
 
@@ -349,7 +363,25 @@ gimp_save_dialog_add_compat_toggle (GimpSaveDialog *dialog)
   gimp_label_set_attributes (GTK_LABEL (dialog->compat_info),
                              PANGO_ATTR_STYLE, PANGO_STYLE_ITALIC,
                              -1);
-  gtk_container_add (GTK_CONTAINER (compat_frame), dialog->compat_info);
+
+  vbox = gtk_box_new (GTK_ORIENTATION_VERTICAL, 2);
+  gtk_container_add (GTK_CONTAINER (compat_frame), vbox);
+  gtk_widget_show (vbox);
+
+  gtk_box_pack_start (GTK_BOX (vbox), dialog->compat_info, FALSE, FALSE, 0);
+
+  /* The faster compression, which needs a newer GIMP. */
+  dialog->fast_toggle =
+    gtk_check_button_new_with_mnemonic (_("Use _fast compression"));
+  gtk_box_pack_start (GTK_BOX (vbox), dialog->fast_toggle, FALSE, FALSE, 0);
+  gtk_widget_show (dialog->fast_toggle);
+
+  gimp_help_set_help_data (dialog->fast_toggle,
+                           _("Compresses the XCF file with zstd, which "
+                             "saves and loads large images much faster. "
+                             "The file can only be opened by GIMP 2.10 "
+                             "and later."),
+                           NULL);
 
   gimp_file_dialog_add_extra_widget (GIMP_FILE_DIALOG (dialog),
                                      compat_frame,
@@ -359,6 +391,9 @@ gimp_save_dialog_add_compat_toggle (GimpSaveDialog *dialog)
   g_signal_connect (dialog->compat_toggle, "toggled",
                     G_CALLBACK (gimp_save_dialog_compat_toggled),
                     dialog);
+  g_signal_connect (dialog->fast_toggle, "toggled",
+                    G_CALLBACK (gimp_save_dialog_fast_toggled),
+                    dialog);
 }
 
 static void
@@ -366,6 +401,15 @@ gimp_save_dialog_compat_toggled (GtkToggleButton *button,
                                  GimpSaveDialog  *dialog)
 {
   dialog->compat = gtk_toggle_button_get_active (button);
+
+  gtk_widget_set_sensitive (dialog->fast_toggle, ! dialog->compat);
+}
+
+static void
+gimp_save_dialog_fast_toggled (GtkToggleButton *button,
+                               GimpSaveDialog  *dialog)
+{
+  dialog->fast_compression = gtk_toggle_button_get_active (button);
 }
 
 static GimpSaveDialogState *
@@ -381,7 +425,8 @@ gimp_save_dialog_get_state (GimpSaveDialog *dialog)
   if (filter)
     state->filter_name = g_strdup (gtk_file_filter_get_name (filter));
 
-  state->compat = dialog->compat;
+  state->compat           = dialog->compat;
+  state->fast_compression = dialog->fast_compression;
 
   return state;
 }
@@ -412,7 +457,8 @@ gimp_save_dialog_set_state (GimpSaveDialog      *dialog,
       g_slist_free (filters);
     }
 
-  dialog->compat = state->compat;
+  dialog->compat           = state->compat;
+  dialog->fast_compression = state->fast_compression;
 }
 
 static void
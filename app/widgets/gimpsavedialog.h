@@ -46,6 +46,9 @@ struct _GimpSaveDialog
   GtkWidget           *compat_toggle;
   GtkWidget           *compat_info;
   gboolean             compat;
+
+  GtkWidget           *fast_toggle;
+  gboolean             fast_compression;
 };
 
 struct _GimpSaveDialogClass
@@ -19,6 +19,7 @@
 
 #include <string.h>
 #include <zlib.h>
+#include <zstd.h>
 
 #include <cairo.h>
 #include <gegl.h>
@@ -34,6 +35,7 @@
 #include "gegl/gimp-gegl-tile-compat.h"
 
 #include "core/gimp.h"
+#include "core/gimp-parallel.h"
 #include "core/gimpcontainer.h"
 #include "core/gimpdrawable-private.h" /* eek */
 #include "core/gimpgrid.h"
@@ -66,6 +68,8 @@
 
 #include "xcf-private.h"
 #include "xcf-load.h"
+#include "xcf-tile-handler.h"
+#include "xcf-tile-table.h"
 #include "xcf-read.h"
 #include "xcf-seek.h"
 
@@ -78,6 +82,32 @@
 /* #define GIMP_XCF_PATH_DEBUG */
 
 
+typedef struct
+{
+  GeglRectangle  rect;
+  guchar        *xcfdata;
+  gint           xcfdata_size;
+  guchar        *tile_data;
+  gint           tile_size;
+  const guchar  *pixels;
+  guint32        checksum;
+  gboolean       skip;
+  gboolean       success;
+} XcfLoadTile;
+
+typedef struct
+{
+  XcfCompressionType  compression;
+  gint                bpp;
+  gint                bpc;
+  gboolean            checksum;
+  XcfLoadTile        *tiles;
+  gint                n_tiles;
+  gint                next;
+  gint                last;
+} XcfLoadBatch;
+
+
 static void            xcf_load_add_masks     (GimpImage     *image);
 static gboolean        xcf_load_image_props   (XcfInfo       *info,
                                                GimpImage     *image);
@@ -105,22 +135,13 @@ static GimpLayerMask * xcf_load_layer_mask    (XcfInfo       *info,
                                                GimpImage     *image);
 static gboolean        xcf_load_buffer        (XcfInfo       *info,
                                                GeglBuffer    *buffer);
+static gboolean        xcf_load_buffer_level  (XcfInfo       *info,
+                                               GeglBuffer    *buffer);
 static gboolean        xcf_load_level         (XcfInfo       *info,
                                                GeglBuffer    *buffer);
-static gboolean        xcf_load_tile          (XcfInfo       *info,
-                                               GeglBuffer    *buffer,
-                                               GeglRectangle *tile_rect,
-                                               const Babl    *format);
-static gboolean        xcf_load_tile_rle      (XcfInfo       *info,
-                                               GeglBuffer    *buffer,
-                                               GeglRectangle *tile_rect,
-                                               const Babl    *format,
-                                               gint           data_length);
-static gboolean        xcf_load_tile_zlib     (XcfInfo       *info,
-                                               GeglBuffer    *buffer,
-                                               GeglRectangle *tile_rect,
-                                               const Babl    *format,
-                                               gint           data_length);
+static void            xcf_decode_tiles       (gint           i,
+                                               gint           n,
+                                               XcfLoadBatch  *batch);
 static GimpParasite  * xcf_load_parasite      (XcfInfo       *info);
 static gboolean        xcf_load_old_paths     (XcfInfo       *info,
                                                GimpImage     *image);
@@ -131,6 +152,8 @@ static gboolean        xcf_load_vectors       (XcfInfo       *info,
 static gboolean        xcf_load_vector        (XcfInfo       *info,
                                                GimpImage     *image);
 
+static gint            xcf_load_level_offset  (XcfInfo       *info,
+                                               gint           offset);
 static gboolean        xcf_skip_unknown_prop  (XcfInfo       *info,
                                                gsize          size);
 
@@ -150,8 +173,8 @@ xcf_load_image (Gimp     *gimp,
   GimpImage          *image = NULL;
   const GimpParasite *parasite;
   gboolean            has_metadata = FALSE;
-  guint32             saved_pos;
-  guint32             offset;
+  goffset             saved_pos;
+  goffset             offset;
   gint                width;
   gint                height;
   gint                image_type;
@@ -213,6 +236,27 @@ xcf_load_image (Gimp     *gimp,
   GIMP_LOG (XCF, "version=%d, width=%d, height=%d, image_type=%d, precision=%d",
             info->file_version, width, height, image_type, precision);
 
+  info->image_width  = width;
+  info->image_height = height;
+
+  /* when loading a preview, pick the smallest reduced level which is
+   * still at least as large as the requested size
+   */
+  if (info->thumb_size > 0)
+    {
+      while (info->level < 30 &&
+             MAX (width, height) >> (info->level + 1) >= info->thumb_size)
+        {
+          info->level++;
+        }
+
+      width  = XCF_LEVEL_SIZE (width,  info->level);
+      height = XCF_LEVEL_SIZE (height, info->level);
+
+      GIMP_LOG (XCF, "loading level %d, width=%d, height=%d",
+                info->level, width, height);
+    }
+
   image = gimp_create_image (gimp, width, height, image_type, precision,
                              FALSE);
 
@@ -393,7 +437,8 @@ xcf_load_image (Gimp     *gimp,
       GList     *item_path = NULL;
 
       /* read in the offset of the next layer */
-      info->cp += xcf_read_int32 (info->input, &offset, 1);
+      info->cp += xcf_read_offset (info->input, info->bytes_per_offset,
+                                   &offset, 1);
 
       /* if the offset is 0 then we are at the end
        *  of the layer list.
@@ -477,7 +522,8 @@ xcf_load_image (Gimp     *gimp,
       GimpChannel *channel;
 
       /* read in the offset of the next channel */
-      info->cp += xcf_read_int32 (info->input, &offset, 1);
+      info->cp += xcf_read_offset (info->input, info->bytes_per_offset,
+                                   &offset, 1);
 
       /* if the offset is 0 then we are at the end
        *  of the channel list.
@@ -539,6 +585,15 @@ xcf_load_image (Gimp     *gimp,
   return image;
 
  error:
+  /* when loading reduced levels, there is nothing to salvage if
+   * the file lacks them
+   */
+  if (info->missing_levels)
+    {
+      g_object_unref (image);
+      return NULL;
+    }
+
   if (num_successful_elements == 0)
     goto hard_error;
 
@@ -685,7 +740,8 @@ xcf_load_image_props (XcfInfo   *info,
             if ((compression != COMPRESS_NONE) &&
                 (compression != COMPRESS_RLE) &&
                 (compression != COMPRESS_ZLIB) &&
-                (compression != COMPRESS_FRACTAL))
+                (compression != COMPRESS_FRACTAL) &&
+                (compression != COMPRESS_ZSTD))
               {
                 gimp_message (info->gimp, G_OBJECT (info->progress),
                               GIMP_MESSAGE_ERROR,
@@ -696,6 +752,10 @@ xcf_load_image_props (XcfInfo   *info,
 
             info->compression = compression;
 
+            /*  keep saving the image with the faster compression  */
+            gimp_image_set_xcf_fast_compression (image,
+                                                 compression == COMPRESS_ZSTD);
+
             GIMP_LOG (XCF, "prop compression=%d", compression);
           }
           break;
@@ -719,6 +779,10 @@ xcf_load_image_props (XcfInfo   *info,
                 if (position < 0)
                   continue;
 
+                /*  guides are of no use in a reduced-size preview  */
+                if (info->level > 0)
+                  continue;
+
                 GIMP_LOG (XCF, "prop guide orientation=%d position=%d",
                           orientation, position);
 
@@ -761,6 +825,10 @@ xcf_load_image_props (XcfInfo   *info,
 
                 GIMP_LOG (XCF, "prop sample point x=%d y=%d", x, y);
 
+                /*  sample points are of no use in a reduced-size preview  */
+                if (info->level > 0)
+                  continue;
+
                 gimp_image_add_sample_point_at_pos (image, x, y, FALSE);
               }
           }
@@ -801,7 +869,7 @@ xcf_load_image_props (XcfInfo   *info,
 
         case PROP_PARASITES:
           {
-            glong base = info->cp;
+            goffset base = info->cp;
 
             while (info->cp - base < prop_size)
               {
@@ -912,14 +980,14 @@ xcf_load_image_props (XcfInfo   *info,
 
         case PROP_VECTORS:
           {
-            guint32 base = info->cp;
+            goffset base = info->cp;
 
             if (xcf_load_vectors (info, image))
               {
                 if (base + prop_size != info->cp)
                   {
                     g_printerr ("Mismatch in PROP_VECTORS size: "
-                                "skipping %d bytes.\n",
+                                "skipping %" G_GOFFSET_FORMAT " bytes.\n",
                                 base + prop_size - info->cp);
                     xcf_seek_pos (info, base + prop_size, NULL);
                   }
@@ -978,9 +1046,8 @@ xcf_load_layer_props (XcfInfo    *info,
 
         case PROP_FLOATING_SELECTION:
           info->floating_sel = *layer;
-          info->cp +=
-            xcf_read_int32 (info->input,
-                            (guint32 *) &info->floating_sel_offset, 1);
+          info->cp += xcf_read_offset (info->input, info->bytes_per_offset,
+                                       &info->floating_sel_offset, 1);
           break;
 
         case PROP_OPACITY:
@@ -1074,7 +1141,9 @@ xcf_load_layer_props (XcfInfo    *info,
             info->cp += xcf_read_int32 (info->input, &offset_x, 1);
             info->cp += xcf_read_int32 (info->input, &offset_y, 1);
 
-            gimp_item_set_offset (GIMP_ITEM (*layer), offset_x, offset_y);
+            gimp_item_set_offset (GIMP_ITEM (*layer),
+                                  xcf_load_level_offset (info, offset_x),
+                                  xcf_load_level_offset (info, offset_y));
           }
           break;
 
@@ -1102,7 +1171,7 @@ xcf_load_layer_props (XcfInfo    *info,
 
         case PROP_PARASITES:
           {
-            glong base = info->cp;
+            goffset base = info->cp;
 
             while (info->cp - base < prop_size)
               {
@@ -1175,8 +1244,8 @@ xcf_load_layer_props (XcfInfo    *info,
 
         case PROP_ITEM_PATH:
           {
-            glong  base = info->cp;
-            GList *path = NULL;
+            goffset base = info->cp;
+            GList   *path = NULL;
 
             while (info->cp - base < prop_size)
               {
@@ -1354,7 +1423,7 @@ xcf_load_channel_props (XcfInfo      *info,
 
         case PROP_PARASITES:
           {
-            glong base = info->cp;
+            goffset base = info->cp;
 
             while ((info->cp - base) < prop_size)
               {
@@ -1427,8 +1496,8 @@ xcf_load_layer (XcfInfo    *info,
 {
   GimpLayer         *layer;
   GimpLayerMask     *layer_mask;
-  guint32            hierarchy_offset;
-  guint32            layer_mask_offset;
+  goffset            hierarchy_offset;
+  goffset            layer_mask_offset;
   gboolean           apply_mask = TRUE;
   gboolean           edit_mask  = FALSE;
   gboolean           show_mask  = FALSE;
@@ -1498,6 +1567,9 @@ xcf_load_layer (XcfInfo    *info,
   if (width <= 0 || height <= 0)
     return NULL;
 
+  width  = XCF_LEVEL_SIZE (width,  info->level);
+  height = XCF_LEVEL_SIZE (height, info->level);
+
   /* do not use gimp_image_get_layer_format() because it might
    * be the floating selection of a channel or mask
    */
@@ -1522,11 +1594,14 @@ xcf_load_layer (XcfInfo    *info,
 
   xcf_progress_update (info);
 
-  /* call the evil text layer hack that might change our layer pointer */
+  /* call the evil text layer hack that might change our layer pointer,
+   * but not for reduced-size previews, whose text layers would be
+   * rendered at the wrong size
+   */
   active   = (info->active_layer == layer);
   floating = (info->floating_sel == layer);
 
-  if (gimp_text_layer_xcf_load_hack (&layer))
+  if (info->level == 0 && gimp_text_layer_xcf_load_hack (&layer))
     {
       gimp_text_layer_set_xcf_flags (GIMP_TEXT_LAYER (layer),
                                      text_layer_flags);
@@ -1538,8 +1613,10 @@ xcf_load_layer (XcfInfo    *info,
     }
 
   /* read the hierarchy and layer mask offsets */
-  info->cp += xcf_read_int32 (info->input, &hierarchy_offset, 1);
-  info->cp += xcf_read_int32 (info->input, &layer_mask_offset, 1);
+  info->cp += xcf_read_offset (info->input, info->bytes_per_offset,
+                               &hierarchy_offset, 1);
+  info->cp += xcf_read_offset (info->input, info->bytes_per_offset,
+                               &layer_mask_offset, 1);
 
   /* read in the hierarchy (ignore it for group layers, both as an
    * optimization and because the hierarchy's extents don't match
@@ -1610,7 +1687,7 @@ xcf_load_channel (XcfInfo   *info,
                   GimpImage *image)
 {
   GimpChannel *channel;
-  guint32      hierarchy_offset;
+  goffset      hierarchy_offset;
   gint         width;
   gint         height;
   gboolean     is_fs_drawable;
@@ -1628,6 +1705,9 @@ xcf_load_channel (XcfInfo   *info,
   if (width <= 0 || height <= 0)
     return NULL;
 
+  width  = XCF_LEVEL_SIZE (width,  info->level);
+  height = XCF_LEVEL_SIZE (height, info->level);
+
   info->cp += xcf_read_string (info->input, &name, 1);
 
   /* create a new channel */
@@ -1643,7 +1723,8 @@ xcf_load_channel (XcfInfo   *info,
   xcf_progress_update (info);
 
   /* read the hierarchy and layer mask offsets */
-  info->cp += xcf_read_int32 (info->input, &hierarchy_offset, 1);
+  info->cp += xcf_read_offset (info->input, info->bytes_per_offset,
+                               &hierarchy_offset, 1);
 
   /* read in the hierarchy */
   if (!xcf_seek_pos (info, hierarchy_offset, NULL))
@@ -1671,7 +1752,7 @@ xcf_load_layer_mask (XcfInfo   *info,
 {
   GimpLayerMask *layer_mask;
   GimpChannel   *channel;
-  guint32        hierarchy_offset;
+  goffset        hierarchy_offset;
   gint           width;
   gint           height;
   gboolean       is_fs_drawable;
@@ -1689,6 +1770,9 @@ xcf_load_layer_mask (XcfInfo   *info,
   if (width <= 0 || height <= 0)
     return NULL;
 
+  width  = XCF_LEVEL_SIZE (width,  info->level);
+  height = XCF_LEVEL_SIZE (height, info->level);
+
   info->cp += xcf_read_string (info->input, &name, 1);
 
   /* create a new layer mask */
@@ -1705,7 +1789,8 @@ xcf_load_layer_mask (XcfInfo   *info,
   xcf_progress_update (info);
 
   /* read the hierarchy and layer mask offsets */
-  info->cp += xcf_read_int32 (info->input, &hierarchy_offset, 1);
+  info->cp += xcf_read_offset (info->input, info->bytes_per_offset,
+                               &hierarchy_offset, 1);
 
   /* read in the hierarchy */
   if (! xcf_seek_pos (info, hierarchy_offset, NULL))
@@ -1733,7 +1818,7 @@ xcf_load_buffer (XcfInfo    *info,
                  GeglBuffer *buffer)
 {
   const Babl *format;
-  guint32     offset;
+  goffset     offset;
   gint        width;
   gint        height;
   gint        bpp;
@@ -1747,12 +1832,16 @@ xcf_load_buffer (XcfInfo    *info,
   /* make sure the values in the file correspond to the values
    *  calculated when the TileManager was created.
    */
-  if (width  != gegl_buffer_get_width (buffer)  ||
-      height != gegl_buffer_get_height (buffer) ||
-      bpp    != babl_format_get_bytes_per_pixel (format))
+  if (XCF_LEVEL_SIZE (width,  info->level) != gegl_buffer_get_width (buffer)  ||
+      XCF_LEVEL_SIZE (height, info->level) != gegl_buffer_get_height (buffer) ||
+      bpp != babl_format_get_bytes_per_pixel (format))
     return FALSE;
 
-  info->cp += xcf_read_int32 (info->input, &offset, 1); /* top level */
+  if (info->level > 0)
+    return xcf_load_buffer_level (info, buffer);
+
+  info->cp += xcf_read_offset (info->input, info->bytes_per_offset,
+                               &offset, 1); /* top level */
 
   /* seek to the level offset */
   if (!xcf_seek_pos (info, offset, NULL))
@@ -1768,22 +1857,124 @@ xcf_load_buffer (XcfInfo    *info,
   return TRUE;
 }
 
+/* loads 'info->level' into 'buffer', or the last level if the
+ * hierarchy has fewer levels, in which case it is scaled down
+ */
+static gboolean
+xcf_load_buffer_level (XcfInfo    *info,
+                       GeglBuffer *buffer)
+{
+  const Babl *format = gegl_buffer_get_format (buffer);
+  goffset     offset = 0;
+  goffset     tile_offset;
+  gint        width;
+  gint        height;
+  gint        level;
+  gboolean    success;
+
+  for (level = 0; level <= info->level; level++)
+    {
+      goffset level_offset;
+
+      info->cp += xcf_read_offset (info->input, info->bytes_per_offset,
+                                   &level_offset, 1);
+
+      if (level_offset == 0)
+        break;
+
+      offset = level_offset;
+    }
+
+  /* 'level' is now one past the last level we can use */
+  level--;
+
+  if (level < 0)
+    return FALSE;
+
+  /* peek at the level's first tile offset, which is '0' if the file
+   * contains only an empty placeholder instead of the real level
+   */
+  if (! xcf_seek_pos (info, offset, NULL))
+    return FALSE;
+
+  info->cp += xcf_read_int32 (info->input, (guint32 *) &width, 1);
+  info->cp += xcf_read_int32 (info->input, (guint32 *) &height, 1);
+  info->cp += xcf_read_offset (info->input, info->bytes_per_offset,
+                               &tile_offset, 1);
+
+  if (tile_offset == 0)
+    {
+      info->missing_levels = TRUE;
+      return FALSE;
+    }
+
+  if (! xcf_seek_pos (info, offset, NULL))
+    return FALSE;
+
+  if (level == info->level)
+    {
+      success = xcf_load_level (info, buffer);
+    }
+  else
+    {
+      GeglBuffer   *level_buffer;
+      GeglRectangle rect = { 0, 0,
+                             gegl_buffer_get_width  (buffer),
+                             gegl_buffer_get_height (buffer) };
+
+      level_buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0, width, height),
+                                      format);
+
+      success = xcf_load_level (info, level_buffer);
+
+      if (success)
+        {
+          guchar *data;
+
+          /* this is the hierarchy's smallest level, so it's small
+           * enough for a temporary linear copy
+           */
+          data = g_malloc ((gsize) rect.width * rect.height *
+                           babl_format_get_bytes_per_pixel (format));
+
+          gegl_buffer_get (level_buffer, &rect,
+                           1.0 / (1 << (info->level - level)),
+                           format, data,
+                           GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+          gegl_buffer_set (buffer, &rect, 0, format, data,
+                           GEGL_AUTO_ROWSTRIDE);
+
+          g_free (data);
+        }
+
+      g_object_unref (level_buffer);
+    }
+
+  return success;
+}
+
 
 static gboolean
 xcf_load_level (XcfInfo    *info,
                 GeglBuffer *buffer)
 {
-  const Babl *format;
-  gint        bpp;
-  guint32     saved_pos;
-  guint32     offset, offset2;
-  gint        n_tile_rows;
-  gint        n_tile_cols;
-  guint       ntiles;
-  gint        width;
-  gint        height;
-  gint        i;
-  gint        fail;
+  const Babl   *format;
+  gint          bpp;
+  goffset      *offset_table;
+  goffset       offset;
+  gint          n_tile_rows;
+  gint          n_tile_cols;
+  guint         ntiles;
+  gint          width;
+  gint          height;
+  gint          max_tile_size;
+  gint          max_data_size;
+  XcfLoadBatch  batch;
+  guchar       *tile_data;
+  guchar       *xcfdata;
+  guint32      *checksums = NULL;
+  gint          i, j;
+  gboolean      success = FALSE;
 
   format = gegl_buffer_get_format (buffer);
   bpp    = babl_format_get_bytes_per_pixel (format);
@@ -1799,7 +1990,8 @@ xcf_load_level (XcfInfo    *info,
    *  if it is '0', then this tile level is empty
    *  and we can simply return.
    */
-  info->cp += xcf_read_int32 (info->input, &offset, 1);
+  info->cp += xcf_read_offset (info->input, info->bytes_per_offset,
+                               &offset, 1);
   if (offset == 0)
     return TRUE;
 
@@ -1807,163 +1999,301 @@ xcf_load_level (XcfInfo    *info,
   n_tile_cols = gimp_gegl_buffer_get_n_tile_cols (buffer, XCF_TILE_WIDTH);
 
   ntiles = n_tile_rows * n_tile_cols;
-  for (i = 0; i < ntiles; i++)
-    {
-      GeglRectangle rect;
 
-      fail = FALSE;
+  /* read in the rest of the offset table, so we know the amount of
+   * data needed for each tile without seeking back and forth
+   */
+  offset_table = g_new (goffset, ntiles + 1);
+  offset_table[0] = offset;
 
-      if (offset == 0)
+  info->cp += xcf_read_offset (info->input, info->bytes_per_offset,
+                               offset_table + 1, ntiles);
+
+  for (i = 0; i < ntiles; i++)
+    {
+      if (offset_table[i] == 0)
         {
           gimp_message_literal (info->gimp, G_OBJECT (info->progress),
                                 GIMP_MESSAGE_ERROR,
                                 "not enough tiles found in level");
+          g_free (offset_table);
           return FALSE;
         }
+    }
 
-      /* save the current position as it is where the
-       *  next tile offset is stored.
-       */
-      saved_pos = info->cp;
+  if (offset_table[ntiles] != 0)
+    {
+      gimp_message (info->gimp, G_OBJECT (info->progress), GIMP_MESSAGE_ERROR,
+                    "encountered garbage after reading level: %"
+                    G_GOFFSET_FORMAT, offset_table[ntiles]);
+      g_free (offset_table);
+      return FALSE;
+    }
 
-      /* read in the offset of the next tile so we can calculate the amount
-         of data needed for this tile*/
-      info->cp += xcf_read_int32 (info->input, &offset2, 1);
+  /* if the tiles can be read later, don't load anything now, they
+   * are read and decoded when they are first accessed
+   */
+  if (info->tile_file)
+    {
+      GeglTileHandler *handler;
 
-      /* if the offset is 0 then we need to read in the maximum possible
-         allowing for negative compression */
-      if (offset2 == 0)
-        offset2 = offset + XCF_TILE_WIDTH * XCF_TILE_WIDTH * bpp * 1.5;
-                                        /* 1.5 is probably more
-                                           than we need to allow */
+      handler = xcf_tile_handler_new (info->tile_file, buffer,
+                                      info->compression,
+                                      width, height, bpp,
+                                      offset_table, ntiles);
 
-      /* seek to the tile offset */
-      if (! xcf_seek_pos (info, offset, NULL))
-        return FALSE;
+      gimp_tile_handler_validate_assign (GIMP_TILE_HANDLER_VALIDATE (handler),
+                                         buffer);
+      gimp_tile_handler_validate_invalidate (GIMP_TILE_HANDLER_VALIDATE (handler),
+                                             0, 0, width, height);
+
+      /* the buffer keeps the handler alive */
+      g_object_unref (handler);
+
+      /* the checksums are recorded as the tiles are read */
+      if (info->tile_serial && info->level == 0)
+        xcf_tile_table_set (buffer, info->tile_serial, info->compression,
+                            offset_table, NULL, ntiles, 0);
+
+      g_free (offset_table);
+
+      return TRUE;
+    }
+
+  max_tile_size = XCF_TILE_WIDTH * XCF_TILE_HEIGHT * bpp;
+
+  /* the maximum amount of data a valid tile can occupy in the file,
+   * allowing for negative compression
+   */
+  max_data_size = MAX (max_tile_size * 1.5, compressBound (max_tile_size));
+  max_data_size = MAX (max_data_size, ZSTD_compressBound (max_tile_size));
+
+  /* tiles are read in batches by this thread, and then decompressed
+   * by all threads
+   */
+  batch.compression = info->compression;
+  batch.bpp         = bpp;
+  batch.bpc         = bpp / babl_format_get_n_components (format);
+  batch.checksum    = (info->tile_serial && info->level == 0);
+  batch.n_tiles     = MIN (ntiles,
+                           XCF_TILE_BATCH_SIZE * gimp_parallel_get_n_threads ());
+  batch.tiles       = g_new0 (XcfLoadTile, batch.n_tiles);
+
+  tile_data = g_malloc ((gsize) batch.n_tiles * max_tile_size);
+  xcfdata   = g_malloc ((gsize) batch.n_tiles * max_data_size);
+
+  if (batch.checksum)
+    checksums = g_new (guint32, ntiles);
+
+  for (j = 0; j < batch.n_tiles; j++)
+    {
+      batch.tiles[j].tile_data = tile_data + (gsize) j * max_tile_size;
+      batch.tiles[j].xcfdata   = xcfdata   + (gsize) j * max_data_size;
+    }
+
+  for (i = 0; i < ntiles; i += batch.n_tiles)
+    {
+      gint n = MIN (batch.n_tiles, ntiles - i);
+
+      for (j = 0; j < n; j++)
+        {
+          XcfLoadTile *tile    = &batch.tiles[j];
+          goffset      offset2 = offset_table[i + j + 1];
+          gsize        bytes_read;
+          gint         data_length;
+
+          offset = offset_table[i + j];
+
+          gimp_gegl_buffer_get_tile_rect (buffer,
+                                          XCF_TILE_WIDTH, XCF_TILE_HEIGHT,
+                                          i + j, &tile->rect);
+
+          tile->tile_size = bpp * tile->rect.width * tile->rect.height;
+          tile->skip      = FALSE;
+
+          /* if the offset is 0 then we need to read in the maximum possible
+           * allowing for negative compression
+           */
+          if (offset2 == 0)
+            offset2 = offset + max_data_size;
+
+          if (info->compression == COMPRESS_NONE)
+            data_length = tile->tile_size;
+          else
+            data_length = CLAMP (offset2 - offset, -1, max_data_size);
+
+          /* Workaround for bug #357809: avoid crashing on g_malloc() and
+           * skip this tile (without storing data) as if it did not
+           * contain any data.  It is better than failing, which would
+           * skip the whole hierarchy while there may still be some valid
+           * tiles in the file.
+           */
+          if (data_length <= 0)
+            {
+              tile->skip = TRUE;
+              continue;
+            }
+
+          /* seek to the tile offset */
+          if (! xcf_seek_pos (info, offset, NULL))
+            goto out;
 
-      /* get the tile from the tile manager */
-      gimp_gegl_buffer_get_tile_rect (buffer,
-                                      XCF_TILE_WIDTH, XCF_TILE_HEIGHT,
-                                      i, &rect);
+          GIMP_LOG (XCF, "loading tile %d/%d", i + j + 1, ntiles);
 
-      GIMP_LOG (XCF, "loading tile %d/%d", i + 1, ntiles);
+          /* we have to read directly instead of xcf_read_* because we
+           * may be reading past the end of the file here
+           */
+          g_input_stream_read_all (info->input, tile->xcfdata, data_length,
+                                   &bytes_read, NULL, NULL);
 
-      /* read in the tile */
-      switch (info->compression)
+          info->cp += bytes_read;
+
+          if (bytes_read == 0 && info->compression != COMPRESS_NONE)
+            tile->skip = TRUE;
+
+          tile->xcfdata_size = bytes_read;
+        }
+
+      batch.next = 0;
+      batch.last = n;
+
+      gimp_parallel_distribute (n,
+                                (GimpParallelDistributeFunc)
+                                xcf_decode_tiles,
+                                &batch);
+
+      for (j = 0; j < n; j++)
+        {
+          XcfLoadTile *tile = &batch.tiles[j];
+
+          if (checksums)
+            checksums[i + j] = tile->checksum;
+
+          if (tile->skip)
+            continue;
+
+          if (! tile->success)
+            goto out;
+
+          gegl_buffer_set (buffer, &tile->rect, 0, format, tile->pixels,
+                           GEGL_AUTO_ROWSTRIDE);
+
+          GIMP_LOG (XCF, "loaded tile %d/%d", i + j + 1, ntiles);
+        }
+    }
+
+  /* the end of the last tile is unknown, because the offset table
+   * doesn't store it
+   */
+  if (checksums)
+    xcf_tile_table_set (buffer, info->tile_serial, info->compression,
+                        offset_table, checksums, ntiles, 0);
+
+  success = TRUE;
+
+ out:
+  g_free (batch.tiles);
+  g_free (tile_data);
+  g_free (xcfdata);
+  g_free (checksums);
+  g_free (offset_table);
+
+  return success;
+}
+
+static void
+xcf_decode_tiles (gint          i,
+                  gint          n,
+                  XcfLoadBatch *batch)
+{
+  gint t;
+
+  while ((t = g_atomic_int_add (&batch->next, 1)) < batch->last)
+    {
+      XcfLoadTile *tile = &batch->tiles[t];
+
+      if (tile->skip)
+        {
+          /* skipped tiles stay empty in the buffer */
+          if (batch->checksum)
+            {
+              memset (tile->tile_data, 0, tile->tile_size);
+              tile->checksum = xcf_tile_table_checksum (tile->tile_data,
+                                                        tile->tile_size);
+            }
+
+          continue;
+        }
+
+      switch (batch->compression)
         {
         case COMPRESS_NONE:
-          if (!xcf_load_tile (info, buffer, &rect, format))
-            fail = TRUE;
+          tile->pixels  = tile->xcfdata;
+          tile->success = TRUE;
           break;
+
         case COMPRESS_RLE:
-          if (!xcf_load_tile_rle (info, buffer, &rect, format,
-                                  offset2 - offset))
-            fail = TRUE;
+          tile->pixels  = tile->tile_data;
+          tile->success = xcf_decode_tile_rle (tile->xcfdata,
+                                               tile->xcfdata_size,
+                                               tile->rect.width *
+                                               tile->rect.height,
+                                               batch->bpp,
+                                               tile->tile_data);
           break;
+
         case COMPRESS_ZLIB:
-          if (!xcf_load_tile_zlib (info, buffer, &rect, format,
-                                   offset2 - offset))
-            fail = TRUE;
+          tile->pixels  = tile->tile_data;
+          tile->success = xcf_decode_tile_zlib (tile->xcfdata,
+                                                tile->xcfdata_size,
+                                                tile->tile_data,
+                                                tile->tile_size);
           break;
+
+        case COMPRESS_ZSTD:
+          tile->pixels  = tile->tile_data;
+          tile->success = xcf_decode_tile_zstd (tile->xcfdata,
+                                                tile->xcfdata_size,
+                                                batch->bpc,
+                                                tile->tile_data,
+                                                tile->tile_size);
+          break;
+
         case COMPRESS_FRACTAL:
           g_printerr ("xcf: fractal compression unimplemented. "
                       "Possibly corrupt XCF file.");
-          fail = TRUE;
+          tile->success = FALSE;
           break;
+
         default:
           g_printerr ("xcf: unknown compression. "
                       "Possibly corrupt XCF file.");
-          fail = TRUE;
+          tile->success = FALSE;
           break;
         }
 
-      if (fail)
-        return FALSE;
-
-      GIMP_LOG (XCF, "loaded tile %d/%d", i + 1, ntiles);
-
-      /* restore the saved position so we'll be ready to
-       *  read the next offset.
-       */
-      if (!xcf_seek_pos (info, saved_pos, NULL))
-        return FALSE;
-
-      /* read in the offset of the next tile */
-      info->cp += xcf_read_int32 (info->input, &offset, 1);
-    }
-
-  if (offset != 0)
-    {
-      gimp_message (info->gimp, G_OBJECT (info->progress), GIMP_MESSAGE_ERROR,
-                    "encountered garbage after reading level: %d", offset);
-      return FALSE;
+      if (tile->success && batch->checksum)
+        tile->checksum = xcf_tile_table_checksum (tile->pixels,
+                                                  tile->tile_size);
     }
-
-  return TRUE;
-}
-
-static gboolean
-xcf_load_tile (XcfInfo       *info,
-               GeglBuffer    *buffer,
-               GeglRectangle *tile_rect,
-               const Babl    *format)
-{
-  gint    bpp       = babl_format_get_bytes_per_pixel (format);
-  gint    tile_size = bpp * tile_rect->width * tile_rect->height;
-  guchar *tile_data = g_alloca (tile_size);
-
-  info->cp += xcf_read_int8 (info->input, tile_data, tile_size);
-
-  gegl_buffer_set (buffer, tile_rect, 0, format, tile_data,
-                   GEGL_AUTO_ROWSTRIDE);
-
-  return TRUE;
 }
 
-static gboolean
-xcf_load_tile_rle (XcfInfo       *info,
-                   GeglBuffer    *buffer,
-                   GeglRectangle *tile_rect,
-                   const Babl    *format,
-                   gint           data_length)
+gboolean
+xcf_decode_tile_rle (const guchar *xcfdata,
+                     gint          data_length,
+                     gint          n_pixels,
+                     gint          bpp,
+                     guchar       *tile_data)
 {
-  gint    bpp       = babl_format_get_bytes_per_pixel (format);
-  gint    tile_size = bpp * tile_rect->width * tile_rect->height;
-  guchar *tile_data = g_alloca (tile_size);
-  gint    i;
-  gsize   nmemb_read_successfully;
-  guchar *xcfdata;
-  guchar *xcfodata;
-  guchar *xcfdatalimit;
-
-  /* Workaround for bug #357809: avoid crashing on g_malloc() and skip
-   * this tile (return TRUE without storing data) as if it did not
-   * contain any data.  It is better than returning FALSE, which would
-   * skip the whole hierarchy while there may still be some valid
-   * tiles in the file.
-   */
-  if (data_length <= 0)
-    return TRUE;
-
-  xcfdata = xcfodata = g_alloca (data_length);
-
-  /* we have to read directly instead of xcf_read_* because we may be
-   * reading past the end of the file here
-   */
-  g_input_stream_read_all (info->input, xcfdata, data_length,
-                           &nmemb_read_successfully, NULL, NULL);
-
-  if (nmemb_read_successfully == 0)
-    return TRUE;
-
-  info->cp += nmemb_read_successfully;
+  const guchar *xcfdatalimit;
+  gint          i;
 
-  xcfdatalimit = &xcfodata[nmemb_read_successfully - 1];
+  xcfdatalimit = &xcfdata[data_length - 1];
 
   for (i = 0; i < bpp; i++)
     {
       guchar *data  = tile_data + i;
-      gint    size  = tile_rect->width * tile_rect->height;
+      gint    size  = n_pixels;
       gint    count = 0;
       guchar  val;
       gint    length;
@@ -2050,52 +2380,21 @@ xcf_load_tile_rle (XcfInfo       *info,
         }
     }
 
-  gegl_buffer_set (buffer, tile_rect, 0, format, tile_data,
-                   GEGL_AUTO_ROWSTRIDE);
-
   return TRUE;
 
  bogus_rle:
   return FALSE;
 }
 
-static gboolean
-xcf_load_tile_zlib (XcfInfo       *info,
-                    GeglBuffer    *buffer,
-                    GeglRectangle *tile_rect,
-                    const Babl    *format,
-                    gint           data_length)
+gboolean
+xcf_decode_tile_zlib (const guchar *xcfdata,
+                      gint          data_length,
+                      guchar       *tile_data,
+                      gint          tile_size)
 {
   z_stream  strm;
   int       action;
   int       status;
-  gint      bpp       = babl_format_get_bytes_per_pixel (format);
-  gint      tile_size = bpp * tile_rect->width * tile_rect->height;
-  guchar   *tile_data = g_alloca (tile_size);
-  gsize     bytes_read;
-  guchar   *xcfdata;
-
-  /* Workaround for bug #357809: avoid crashing on g_malloc() and skip
-   * this tile (return TRUE without storing data) as if it did not
-   * contain any data.  It is better than returning FALSE, which would
-   * skip the whole hierarchy while there may still be some valid
-   * tiles in the file.
-   */
-  if (data_length <= 0)
-    return TRUE;
-
-  xcfdata = g_alloca (data_length);
-
-  /* we have to read directly instead of xcf_read_* because we may be
-   * reading past the end of the file here
-   */
-  g_input_stream_read_all (info->input, xcfdata, data_length,
-                           &bytes_read, NULL, NULL);
-
-  if (bytes_read == 0)
-    return TRUE;
-
-  info->cp      += bytes_read;
 
   strm.next_out  = tile_data;
   strm.avail_out = tile_size;
@@ -2103,8 +2402,8 @@ xcf_load_tile_zlib (XcfInfo       *info,
   strm.zalloc    = Z_NULL;
   strm.zfree     = Z_NULL;
   strm.opaque    = Z_NULL;
-  strm.next_in   = xcfdata;
-  strm.avail_in  = bytes_read;
+  strm.next_in   = (guchar *) xcfdata;
+  strm.avail_in  = data_length;
 
   /* Initialize the stream decompression. */
   status = inflateInit (&strm);
@@ -2141,13 +2440,96 @@ xcf_load_tile_zlib (XcfInfo       *info,
         }
     }
 
-  gegl_buffer_set (buffer, tile_rect, 0, format, tile_data,
-                   GEGL_AUTO_ROWSTRIDE);
-
   inflateEnd (&strm);
   return TRUE;
 }
 
+/*  the inverse of xcf_encode_tile_zstd(): after decompressing, the
+ *  bytes grouped by significance are put back into their components
+ */
+gboolean
+xcf_decode_tile_zstd (const guchar *xcfdata,
+                      gint          data_length,
+                      gint          bpc,
+                      guchar       *tile_data,
+                      gint          tile_size)
+{
+  static GPrivate  dctx_private = G_PRIVATE_INIT ((GDestroyNotify) ZSTD_freeDCtx);
+  ZSTD_DCtx       *dctx;
+  ZSTD_inBuffer    in;
+  ZSTD_outBuffer   out;
+  guchar          *shuffled = NULL;
+  gsize            status;
+
+  /* each thread keeps its decompression context around */
+  dctx = g_private_get (&dctx_private);
+
+  if (! dctx)
+    {
+      dctx = ZSTD_createDCtx ();
+
+      if (! dctx)
+        return FALSE;
+
+      g_private_set (&dctx_private, dctx);
+    }
+
+  if (bpc > 1)
+    shuffled = g_malloc (tile_size);
+
+  in.src   = xcfdata;
+  in.size  = data_length;
+  in.pos   = 0;
+
+  out.dst  = shuffled ? shuffled : tile_data;
+  out.size = tile_size;
+  out.pos  = 0;
+
+  /* use the streaming API, since 'xcfdata' may contain garbage after
+   * the compressed frame, if we didn't know the tile's exact size
+   */
+  ZSTD_initDStream (dctx);
+
+  status = ZSTD_decompressStream (dctx, &out, &in);
+
+  if (ZSTD_isError (status))
+    {
+      g_printerr ("xcf: tile decompression failed: %s",
+                  ZSTD_getErrorName (status));
+      g_free (shuffled);
+      return FALSE;
+    }
+  else if (status != 0 || out.pos != (gsize) tile_size)
+    {
+      g_printerr ("xcf: decompressed tile size differs from the "
+                  "expected size.");
+      g_free (shuffled);
+      return FALSE;
+    }
+
+  if (shuffled)
+    {
+      gint n_values = tile_size / bpc;
+      gint i, j;
+
+      for (i = 0; i < bpc; i++)
+        {
+          const guchar *src  = shuffled  + i * n_values;
+          guchar       *dest = tile_data + i;
+
+          for (j = 0; j < n_values; j++)
+            {
+              *dest = src[j];
+              dest += bpc;
+            }
+        }
+
+      g_free (shuffled);
+    }
+
+  return TRUE;
+}
+
 static GimpParasite *
 xcf_load_parasite (XcfInfo *info)
 {
@@ -2510,6 +2892,16 @@ xcf_load_vector (XcfInfo   *info,
   return TRUE;
 }
 
+static gint
+xcf_load_level_offset (XcfInfo *info,
+                       gint     offset)
+{
+  if (offset < 0)
+    return -((-offset + (1 << info->level) - 1) >> info->level);
+
+  return offset >> info->level;
+}
+
 static gboolean
 xcf_skip_unknown_prop (XcfInfo *info,
                        gsize   size)
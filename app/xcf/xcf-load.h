@@ -19,9 +19,24 @@
 #define __XCF_LOAD_H__
 
 
-GimpImage * xcf_load_image (Gimp     *gimp,
-                            XcfInfo  *info,
-                            GError  **error);
+GimpImage * xcf_load_image       (Gimp          *gimp,
+                                  XcfInfo       *info,
+                                  GError       **error);
+
+gboolean    xcf_decode_tile_rle  (const guchar  *xcfdata,
+                                  gint           data_length,
+                                  gint           n_pixels,
+                                  gint           bpp,
+                                  guchar        *tile_data);
+gboolean    xcf_decode_tile_zlib (const guchar  *xcfdata,
+                                  gint           data_length,
+                                  guchar        *tile_data,
+                                  gint           tile_size);
+gboolean    xcf_decode_tile_zstd (const guchar  *xcfdata,
+                                  gint           data_length,
+                                  gint           bpc,
+                                  guchar        *tile_data,
+                                  gint           tile_size);
 
 
 #endif  /* __XCF_LOAD_H__ */
@@ -22,6 +22,15 @@
 #define XCF_TILE_WIDTH  64
 #define XCF_TILE_HEIGHT 64
 
+/* the number of tiles per thread which are (de)compressed in one batch */
+#define XCF_TILE_BATCH_SIZE 16
+
+/* the zstd compression level, a good compromise between speed and size */
+#define XCF_ZSTD_LEVEL 3
+
+/* the size of a buffer's reduced level, each level halves the size */
+#define XCF_LEVEL_SIZE(size, level) MAX (1, (size) >> (level))
+
 typedef enum
 {
   PROP_END                =  0,
@@ -64,8 +73,9 @@ typedef enum
 {
   COMPRESS_NONE              =  0,
   COMPRESS_RLE               =  1,
-  COMPRESS_ZLIB              =  2,  /* unused */
-  COMPRESS_FRACTAL           =  3   /* unused */
+  COMPRESS_ZLIB              =  2,
+  COMPRESS_FRACTAL           =  3,  /* unused */
+  COMPRESS_ZSTD              =  4
 } XcfCompressionType;
 
 typedef enum
@@ -85,7 +95,8 @@ typedef enum
   XCF_GROUP_ITEM_EXPANDED      = 1
 } XcfGroupItemFlagsType;
 
-typedef struct _XcfInfo  XcfInfo;
+typedef struct _XcfInfo     XcfInfo;
+typedef struct _XcfTileFile XcfTileFile;
 
 struct _XcfInfo
 {
@@ -94,16 +105,27 @@ struct _XcfInfo
   GInputStream       *input;
   GOutputStream      *output;
   GSeekable          *seekable;
-  guint               cp;
+  XcfTileFile        *tile_file;
+  goffset             cp;
+  gint                bytes_per_offset;
   GFile              *file;
   GimpTattoo          tattoo_state;
   GimpLayer          *active_layer;
   GimpChannel        *active_channel;
   GimpDrawable       *floating_sel_drawable;
   GimpLayer          *floating_sel;
-  guint               floating_sel_offset;
+  goffset             floating_sel_offset;
   XcfCompressionType  compression;
   gint                file_version;
+  gboolean            save_levels;
+  gint                thumb_size;
+  gint                image_width;
+  gint                image_height;
+  gint                level;
+  gboolean            missing_levels;
+  guint               tile_serial;
+  GInputStream       *reuse_input;
+  guint               reuse_serial;
 };
 
 
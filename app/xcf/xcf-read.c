@@ -50,6 +50,58 @@ xcf_read_int32 (GInputStream *input,
   return total;
 }
 
+guint
+xcf_read_int64 (GInputStream *input,
+                guint64      *data,
+                gint          count)
+{
+  guint total = 0;
+
+  if (count > 0)
+    {
+      total += xcf_read_int8 (input, (guint8 *) data, count * 8);
+
+      while (count--)
+        {
+          *data = GUINT64_FROM_BE (*data);
+          data++;
+        }
+    }
+
+  return total;
+}
+
+guint
+xcf_read_offset (GInputStream *input,
+                 gint          bytes_per_offset,
+                 goffset      *data,
+                 gint          count)
+{
+  guint total = 0;
+
+  while (count-- > 0)
+    {
+      if (bytes_per_offset == 8)
+        {
+          guint64 offset;
+
+          total += xcf_read_int64 (input, &offset, 1);
+
+          *data++ = offset;
+        }
+      else
+        {
+          guint32 offset;
+
+          total += xcf_read_int32 (input, &offset, 1);
+
+          *data++ = offset;
+        }
+    }
+
+  return total;
+}
+
 guint
 xcf_read_float (GInputStream *input,
                 gfloat       *data,
@@ -22,6 +22,13 @@
 guint   xcf_read_int32  (GInputStream  *input,
                          guint32       *data,
                          gint           count);
+guint   xcf_read_int64  (GInputStream  *input,
+                         guint64       *data,
+                         gint           count);
+guint   xcf_read_offset (GInputStream  *input,
+                         gint           bytes_per_offset,
+                         goffset       *data,
+                         gint           count);
 guint   xcf_read_float  (GInputStream  *input,
                          gfloat        *data,
                          gint           count);
@@ -19,6 +19,7 @@
 
 #include <string.h>
 #include <zlib.h>
+#include <zstd.h>
 
 #include <cairo.h>
 #include <gegl.h>
@@ -30,9 +31,9 @@
 #include "core/core-types.h"
 
 #include "gegl/gimp-babl-compat.h"
-#include "gegl/gimp-gegl-tile-compat.h"
 
 #include "core/gimp.h"
+#include "core/gimp-parallel.h"
 #include "core/gimpcontainer.h"
 #include "core/gimpchannel.h"
 #include "core/gimpdrawable.h"
@@ -64,11 +65,42 @@
 #include "xcf-read.h"
 #include "xcf-save.h"
 #include "xcf-seek.h"
+#include "xcf-tile-table.h"
 #include "xcf-write.h"
 
 #include "gimp-intl.h"
 
 
+typedef struct
+{
+  GeglRectangle  rect;
+  guchar        *tile_data;
+  gint           tile_size;
+  guchar        *out_data;
+  gint           max_out_size;
+  const guchar  *out;
+  gint           out_size;
+  guint32        checksum;
+  gboolean       reusable;     /* the file has the tile at 'reuse_offset' */
+  goffset        reuse_offset;
+  gint           reuse_size;
+  guint32        reuse_checksum;
+  gboolean       reused;       /* the pixels match, copy the tile */
+} XcfSaveTile;
+
+typedef struct
+{
+  XcfCompressionType  compression;
+  gint                bpp;
+  gint                bpc;
+  gboolean            checksum;
+  XcfSaveTile        *tiles;
+  gint                n_tiles;
+  gint                next;
+  gint                last;
+} XcfSaveBatch;
+
+
 static gboolean xcf_save_image_props   (XcfInfo           *info,
                                         GimpImage         *image,
                                         GError           **error);
@@ -98,23 +130,28 @@ static gboolean xcf_save_buffer        (XcfInfo           *info,
                                         GError           **error);
 static gboolean xcf_save_level         (XcfInfo           *info,
                                         GeglBuffer        *buffer,
+                                        gint               level,
                                         GError           **error);
-static gboolean xcf_save_tile          (XcfInfo           *info,
-                                        GeglBuffer        *buffer,
-                                        GeglRectangle     *tile_rect,
-                                        const Babl        *format,
-                                        GError           **error);
-static gboolean xcf_save_tile_rle      (XcfInfo           *info,
-                                        GeglBuffer        *buffer,
-                                        GeglRectangle     *tile_rect,
-                                        const Babl        *format,
-                                        guchar            *rlebuf,
-                                        GError           **error);
-static gboolean xcf_save_tile_zlib     (XcfInfo           *info,
-                                        GeglBuffer        *buffer,
-                                        GeglRectangle     *tile_rect,
-                                        const Babl        *format,
-                                        GError           **error);
+static gboolean xcf_reuse_tile         (XcfInfo           *info,
+                                        XcfSaveTile       *tile);
+static void     xcf_encode_tiles       (gint               i,
+                                        gint               n,
+                                        XcfSaveBatch      *batch);
+static void     xcf_encode_tile        (XcfSaveBatch      *batch,
+                                        XcfSaveTile       *tile);
+static gint     xcf_encode_tile_rle    (const guchar      *tile_data,
+                                        gint               n_pixels,
+                                        gint               bpp,
+                                        guchar            *rlebuf);
+static gint     xcf_encode_tile_zlib   (const guchar      *tile_data,
+                                        gint               tile_size,
+                                        guchar            *buf,
+                                        gint               buf_size);
+static gint     xcf_encode_tile_zstd   (const guchar      *tile_data,
+                                        gint               tile_size,
+                                        gint               bpc,
+                                        guchar            *buf,
+                                        gint               buf_size);
 static gboolean xcf_save_parasite      (XcfInfo           *info,
                                         GimpParasite      *parasite,
                                         GError           **error);
@@ -157,6 +194,27 @@ static gboolean xcf_save_vectors       (XcfInfo           *info,
     }                                                                 \
   } G_STMT_END
 
+#define xcf_write_offset_check_error(info, data, count) G_STMT_START { \
+  info->cp += xcf_write_offset (info->output, info->bytes_per_offset,  \
+                                data, count, &tmp_error);              \
+  if (tmp_error)                                                       \
+    {                                                                  \
+      g_propagate_error (error, tmp_error);                            \
+      return FALSE;                                                    \
+    }                                                                  \
+  } G_STMT_END
+
+#define xcf_write_zero_offset_check_error(info, count) G_STMT_START { \
+  info->cp += xcf_write_zero_offset (info->output,                     \
+                                     info->bytes_per_offset,           \
+                                     count, &tmp_error);               \
+  if (tmp_error)                                                       \
+    {                                                                  \
+      g_propagate_error (error, tmp_error);                            \
+      return FALSE;                                                    \
+    }                                                                  \
+  } G_STMT_END
+
 #define xcf_write_float_check_error(info, data, count) G_STMT_START {  \
   info->cp += xcf_write_float (info->output, data, count, &tmp_error); \
   if (tmp_error)                                                       \
@@ -202,8 +260,8 @@ xcf_save_image (XcfInfo    *info,
   GList   *all_layers;
   GList   *all_channels;
   GList   *list;
-  guint32  saved_pos;
-  guint32  offset;
+  goffset  saved_pos;
+  goffset  offset;
   guint32  value;
   guint    n_layers;
   guint    n_channels;
@@ -266,7 +324,7 @@ xcf_save_image (XcfInfo    *info,
   saved_pos = info->cp;
 
   /* write an empty offset table */
-  xcf_write_zero_int32_check_error (info, n_layers + n_channels + 2);
+  xcf_write_zero_offset_check_error (info, n_layers + n_channels + 2);
 
   /* 'offset' is where we will write the next layer or channel */
   offset = info->cp;
@@ -279,7 +337,7 @@ xcf_save_image (XcfInfo    *info,
        * offset of the layer
        */
       xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-      xcf_write_int32_check_error (info, &offset, 1);
+      xcf_write_offset_check_error (info, &offset, 1);
 
       /* remember the next slot in the offset table */
       saved_pos = info->cp;
@@ -297,7 +355,7 @@ xcf_save_image (XcfInfo    *info,
   /* skip a '0' in the offset table to indicate the end of the layer
    * offsets
    */
-  saved_pos += 4;
+  saved_pos += info->bytes_per_offset;
 
   for (list = all_channels; list; list = g_list_next (list))
     {
@@ -307,7 +365,7 @@ xcf_save_image (XcfInfo    *info,
        * offset of the channel
        */
       xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-      xcf_write_int32_check_error (info, &offset, 1);
+      xcf_write_offset_check_error (info, &offset, 1);
 
       /* remember the next slot in the offset table */
       saved_pos = info->cp;
@@ -672,17 +730,12 @@ xcf_save_prop (XcfInfo    *info,
       break;
 
     case PROP_FLOATING_SELECTION:
-      {
-        guint32 dummy;
+      size = info->bytes_per_offset;
 
-        dummy = 0;
-        size = 4;
-
-        xcf_write_prop_type_check_error (info, prop_type);
-        xcf_write_int32_check_error (info, &size, 1);
-        info->floating_sel_offset = info->cp;
-        xcf_write_int32_check_error (info, &dummy, 1);
-      }
+      xcf_write_prop_type_check_error (info, prop_type);
+      xcf_write_int32_check_error (info, &size, 1);
+      info->floating_sel_offset = info->cp;
+      xcf_write_zero_offset_check_error (info, 1);
       break;
 
     case PROP_OPACITY:
@@ -1005,8 +1058,8 @@ xcf_save_prop (XcfInfo    *info,
 
         if (gimp_parasite_list_persistent_length (list) > 0)
           {
-            guint32 base, length = 0;
-            long    pos;
+            goffset base, pos;
+            guint32 length = 0;
 
             xcf_write_prop_type_check_error (info, prop_type);
 
@@ -1046,8 +1099,8 @@ xcf_save_prop (XcfInfo    *info,
 
     case PROP_PATHS:
       {
-        guint32 base, length = 0;
-        glong   pos;
+        goffset base, pos;
+        guint32 length = 0;
 
         xcf_write_prop_type_check_error (info, prop_type);
 
@@ -1107,8 +1160,8 @@ xcf_save_prop (XcfInfo    *info,
 
     case PROP_VECTORS:
       {
-        guint32 base, length = 0;
-        glong   pos;
+        goffset base, pos;
+        guint32 length = 0;
 
         xcf_write_prop_type_check_error (info, prop_type);
 
@@ -1191,8 +1244,8 @@ xcf_save_layer (XcfInfo    *info,
                 GimpLayer  *layer,
                 GError    **error)
 {
-  guint32      saved_pos;
-  guint32      offset;
+  goffset      saved_pos;
+  goffset      offset;
   guint32      value;
   const gchar *string;
   GError      *tmp_error = NULL;
@@ -1204,7 +1257,7 @@ xcf_save_layer (XcfInfo    *info,
     {
       saved_pos = info->cp;
       xcf_check_error (xcf_seek_pos (info, info->floating_sel_offset, error));
-      xcf_write_int32_check_error (info, &saved_pos, 1);
+      xcf_write_offset_check_error (info, &saved_pos, 1);
       xcf_check_error (xcf_seek_pos (info, saved_pos, error));
     }
 
@@ -1226,13 +1279,13 @@ xcf_save_layer (XcfInfo    *info,
   xcf_save_layer_props (info, image, layer, error);
 
   /* write out the layer tile hierarchy */
-  offset = info->cp + 8;
-  xcf_write_int32_check_error (info, &offset, 1);
+  offset = info->cp + 2 * info->bytes_per_offset;
+  xcf_write_offset_check_error (info, &offset, 1);
 
   saved_pos = info->cp;
 
   /* write a zero layer mask offset */
-  xcf_write_zero_int32_check_error (info, 1);
+  xcf_write_zero_offset_check_error (info, 1);
 
   xcf_check_error (xcf_save_buffer (info,
                                     gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
@@ -1246,7 +1299,7 @@ xcf_save_layer (XcfInfo    *info,
       GimpLayerMask *mask = gimp_layer_get_mask (layer);
 
       xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-      xcf_write_int32_check_error (info, &offset, 1);
+      xcf_write_offset_check_error (info, &offset, 1);
 
       xcf_check_error (xcf_seek_pos (info, offset, error));
       xcf_check_error (xcf_save_channel (info, image, GIMP_CHANNEL (mask),
@@ -1262,8 +1315,8 @@ xcf_save_channel (XcfInfo      *info,
                   GimpChannel  *channel,
                   GError      **error)
 {
-  guint32      saved_pos;
-  guint32      offset;
+  goffset      saved_pos;
+  goffset      offset;
   guint32      value;
   const gchar *string;
   GError      *tmp_error = NULL;
@@ -1275,7 +1328,7 @@ xcf_save_channel (XcfInfo      *info,
     {
       saved_pos = info->cp;
       xcf_check_error (xcf_seek_pos (info, info->floating_sel_offset, error));
-      xcf_write_int32_check_error (info, &saved_pos, 1);
+      xcf_write_offset_check_error (info, &saved_pos, 1);
       xcf_check_error (xcf_seek_pos (info, saved_pos, error));
     }
 
@@ -1294,8 +1347,8 @@ xcf_save_channel (XcfInfo      *info,
   xcf_save_channel_props (info, image, channel, error);
 
   /* write out the channel tile hierarchy */
-  offset = info->cp + 4;
-  xcf_write_int32_check_error (info, &offset, 1);
+  offset = info->cp + info->bytes_per_offset;
+  xcf_write_offset_check_error (info, &offset, 1);
 
   xcf_check_error (xcf_save_buffer (info,
                                     gimp_drawable_get_buffer (GIMP_DRAWABLE (channel)),
@@ -1327,8 +1380,8 @@ xcf_save_buffer (XcfInfo     *info,
                  GError     **error)
 {
   const Babl *format;
-  guint32     saved_pos;
-  guint32     offset;
+  goffset     saved_pos;
+  goffset     offset;
   guint32     width;
   guint32     height;
   guint32     bpp;
@@ -1357,7 +1410,7 @@ xcf_save_buffer (XcfInfo     *info,
   saved_pos = info->cp;
 
   /* write an empty offset table */
-  xcf_write_zero_int32_check_error (info, nlevels + 1);
+  xcf_write_zero_offset_check_error (info, nlevels + 1);
 
   /* 'offset' is where we will write the next level */
   offset = info->cp;
@@ -1368,7 +1421,7 @@ xcf_save_buffer (XcfInfo     *info,
        * offset of the level
        */
       xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-      xcf_write_int32_check_error (info, &offset, 1);
+      xcf_write_offset_check_error (info, &offset, 1);
 
       /* remember the next slot in the offset table */
       saved_pos = info->cp;
@@ -1376,10 +1429,10 @@ xcf_save_buffer (XcfInfo     *info,
       /* seek to the level offset and save the level */
       xcf_check_error (xcf_seek_pos (info, offset, error));
 
-      if (i == 0)
+      if (i == 0 || info->save_levels)
         {
           /* write out the level. */
-          xcf_check_error (xcf_save_level (info, buffer, error));
+          xcf_check_error (xcf_save_level (info, buffer, i, error));
         }
       else
         {
@@ -1403,147 +1456,341 @@ xcf_save_buffer (XcfInfo     *info,
   return TRUE;
 }
 
+/* saves the reduced 'level' of 'buffer', where each level is half the
+ * size of the previous one; the reduced pixels are taken from the
+ * buffer's mipmap levels
+ */
 static gboolean
 xcf_save_level (XcfInfo     *info,
                 GeglBuffer  *buffer,
+                gint         level,
                 GError     **error)
 {
-  const Babl *format;
-  guint32    *offset_table;
-  guint32    *next_offset;
-  guint32     saved_pos;
-  guint32     offset;
-  guint32     width;
-  guint32     height;
-  gint        bpp;
-  gint        n_tile_rows;
-  gint        n_tile_cols;
-  guint       ntiles;
-  gint        i;
-  guchar     *rlebuf    = NULL;
-  GError     *tmp_error = NULL;
+  const Babl    *format;
+  goffset       *offset_table;
+  goffset        saved_pos;
+  goffset        offset;
+  guint32        width;
+  guint32        height;
+  gint           bpp;
+  gdouble        scale;
+  gint           n_tile_rows;
+  gint           n_tile_cols;
+  guint          ntiles;
+  gint           max_tile_size;
+  gint           max_out_size;
+  XcfSaveBatch   batch;
+  XcfTileTable  *table     = NULL;
+  guchar        *tile_data = NULL;
+  guchar        *out_data  = NULL;
+  guint32       *checksums = NULL;
+  gint           i, j;
+  GError        *tmp_error = NULL;
 
   format = gegl_buffer_get_format (buffer);
 
-  width  = gegl_buffer_get_width (buffer);
-  height = gegl_buffer_get_height (buffer);
+  width  = XCF_LEVEL_SIZE (gegl_buffer_get_width (buffer),  level);
+  height = XCF_LEVEL_SIZE (gegl_buffer_get_height (buffer), level);
   bpp    = babl_format_get_bytes_per_pixel (format);
+  scale  = 1.0 / (1 << level);
 
   xcf_write_int32_check_error (info, (guint32 *) &width, 1);
   xcf_write_int32_check_error (info, (guint32 *) &height, 1);
 
-  saved_pos = info->cp;
+  max_tile_size = XCF_TILE_WIDTH * XCF_TILE_HEIGHT * bpp;
 
-  /* allocate a temporary buffer to store the rle data before it is
-   * written to disk
-   */
-  if (info->compression == COMPRESS_RLE)
-    rlebuf = g_alloca (XCF_TILE_WIDTH * XCF_TILE_HEIGHT * bpp * 1.5);
+  /* the maximum size of a compressed tile */
+  switch (info->compression)
+    {
+    case COMPRESS_NONE:
+      max_out_size = 0;
+      break;
+    case COMPRESS_RLE:
+      max_out_size = max_tile_size * 1.5;
+      break;
+    case COMPRESS_ZLIB:
+      max_out_size = compressBound (max_tile_size);
+      break;
+    case COMPRESS_ZSTD:
+      max_out_size = ZSTD_compressBound (max_tile_size);
+      break;
+    default:
+      g_warning ("xcf: fractal compression unimplemented");
+      return FALSE;
+    }
 
-  n_tile_rows = gimp_gegl_buffer_get_n_tile_rows (buffer, XCF_TILE_HEIGHT);
-  n_tile_cols = gimp_gegl_buffer_get_n_tile_cols (buffer, XCF_TILE_WIDTH);
+  n_tile_rows = (height + XCF_TILE_HEIGHT - 1) / XCF_TILE_HEIGHT;
+  n_tile_cols = (width  + XCF_TILE_WIDTH  - 1) / XCF_TILE_WIDTH;
 
   ntiles = n_tile_rows * n_tile_cols;
 
+  /* 'saved_pos' is the offset of the tile offset table  */
+  saved_pos = info->cp;
+
+  /* write an empty offset table */
+  xcf_write_zero_offset_check_error (info, ntiles + 1);
+
   /* allocate an offset table so we don't have to seek back after each
    * tile, see bug #686862. allocate ntiles + 1 slots because a zero
-   * offset indicates the offset table's end.
+   * offset indicates the offset table's end. the table is allocated
+   * on the heap because it can be several megabytes for huge levels.
    */
-  offset_table = g_alloca ((ntiles + 1) * sizeof (gint32));
-  memset (offset_table, 0, (ntiles + 1) * sizeof (gint32));
-  next_offset = offset_table;
+  offset_table = g_new0 (goffset, ntiles + 1);
 
-  /* 'saved_pos' is the offset of the tile offset table  */
-  saved_pos = info->cp;
+  /* tiles are compressed in batches by all threads, and then written
+   * in order by this thread, so the file is the same as if all tiles
+   * had been compressed sequentially
+   */
+  batch.compression = info->compression;
+  batch.bpp         = bpp;
+  batch.bpc         = bpp / babl_format_get_n_components (format);
+  batch.n_tiles     = MIN (ntiles,
+                           XCF_TILE_BATCH_SIZE * gimp_parallel_get_n_threads ());
+  batch.tiles       = g_new0 (XcfSaveTile, batch.n_tiles);
 
-  /* write an empty offset table */
-  xcf_write_zero_int32_check_error (info, ntiles + 1);
+  tile_data = g_malloc ((gsize) batch.n_tiles * max_tile_size);
+
+  if (max_out_size > 0)
+    out_data = g_malloc ((gsize) batch.n_tiles * max_out_size);
+
+  for (j = 0; j < batch.n_tiles; j++)
+    {
+      batch.tiles[j].tile_data    = tile_data + (gsize) j * max_tile_size;
+      batch.tiles[j].out_data     = out_data  + (gsize) j * max_out_size;
+      batch.tiles[j].max_out_size = max_out_size;
+    }
+
+  /* unchanged tiles of the full-sized level can be copied from the
+   * file we are overwriting, see xcf_save_stream()
+   */
+  if (level == 0 && info->reuse_input && max_out_size > 0)
+    table = xcf_tile_table_get (buffer, info->reuse_serial,
+                                info->compression);
+
+  /* the checksums of the tiles' pixels tell if a tile is unchanged */
+  if (level == 0 && info->tile_serial)
+    checksums = g_new (guint32, ntiles);
+
+  batch.checksum = (table || checksums);
 
   /* 'offset' is where we will write the next tile */
   offset = info->cp;
 
-  for (i = 0; i < ntiles; i++)
+  for (i = 0; i < ntiles; i += batch.n_tiles)
     {
-      GeglRectangle rect;
+      gint n = MIN (batch.n_tiles, ntiles - i);
 
-      /* store the offset in the table and increment the next pointer */
-      *next_offset++ = offset;
+      for (j = 0; j < n; j++)
+        {
+          XcfSaveTile *tile = &batch.tiles[j];
 
-      gimp_gegl_buffer_get_tile_rect (buffer,
-                                      XCF_TILE_WIDTH, XCF_TILE_HEIGHT,
-                                      i, &rect);
+          tile->rect.x      = ((i + j) % n_tile_cols) * XCF_TILE_WIDTH;
+          tile->rect.y      = ((i + j) / n_tile_cols) * XCF_TILE_HEIGHT;
+          tile->rect.width  = MIN (XCF_TILE_WIDTH,  width  - tile->rect.x);
+          tile->rect.height = MIN (XCF_TILE_HEIGHT, height - tile->rect.y);
 
-      /* write out the tile. */
-      switch (info->compression)
-        {
-        case COMPRESS_NONE:
-          xcf_check_error (xcf_save_tile (info, buffer, &rect, format,
-                                          error));
-          break;
-        case COMPRESS_RLE:
-          xcf_check_error (xcf_save_tile_rle (info, buffer, &rect, format,
-                                              rlebuf, error));
-          break;
-        case COMPRESS_ZLIB:
-          xcf_check_error (xcf_save_tile_zlib (info, buffer, &rect, format,
-                                               error));
-          break;
-        case COMPRESS_FRACTAL:
-          g_warning ("xcf: fractal compression unimplemented");
-          return FALSE;
+          tile->tile_size = bpp * tile->rect.width * tile->rect.height;
+
+          tile->reusable = (table &&
+                            xcf_tile_table_get_tile (table, i + j,
+                                                     &tile->reuse_offset,
+                                                     &tile->reuse_size,
+                                                     &tile->reuse_checksum) &&
+                            tile->reuse_size <= tile->max_out_size);
+
+          gegl_buffer_get (buffer, &tile->rect, scale, format,
+                           tile->tile_data,
+                           GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
         }
 
-      /* the next tile's offset is after the tile we just wrote */
-      offset = info->cp;
+      batch.next = 0;
+      batch.last = n;
+
+      gimp_parallel_distribute (n,
+                                (GimpParallelDistributeFunc)
+                                xcf_encode_tiles,
+                                &batch);
+
+      for (j = 0; j < n; j++)
+        {
+          XcfSaveTile *tile = &batch.tiles[j];
+
+          /* the pixels match the old tile, but it can't be read */
+          if (tile->reused && ! xcf_reuse_tile (info, tile))
+            xcf_encode_tile (&batch, tile);
+
+          if (tile->out_size < 0)
+            {
+              g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                           _("Error writing XCF: tile compression failed"));
+              goto error;
+            }
+
+          /* store the offset in the table */
+          offset_table[i + j] = offset;
+
+          /* write out the tile. */
+          info->cp += xcf_write_int8 (info->output, tile->out,
+                                      tile->out_size, &tmp_error);
+
+          if (tmp_error)
+            {
+              g_propagate_error (error, tmp_error);
+              goto error;
+            }
+
+          if (checksums)
+            checksums[i + j] = tile->checksum;
+
+          /* the next tile's offset is after the tile we just wrote */
+          offset = info->cp;
+        }
     }
 
+  g_clear_pointer (&batch.tiles, g_free);
+  g_clear_pointer (&tile_data, g_free);
+  g_clear_pointer (&out_data, g_free);
+
   /* seek back to the offset table and write it  */
-  xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-  xcf_write_int32_check_error (info, offset_table, ntiles + 1);
+  if (! xcf_seek_pos (info, saved_pos, error))
+    goto error;
+
+  info->cp += xcf_write_offset (info->output, info->bytes_per_offset,
+                                offset_table, ntiles + 1, &tmp_error);
+
+  if (tmp_error)
+    {
+      g_propagate_error (error, tmp_error);
+      goto error;
+    }
+
+  /* remember where the tiles are, for the next save, 'offset' is the
+   * end of the last tile
+   */
+  if (checksums)
+    xcf_tile_table_set (buffer, info->tile_serial, info->compression,
+                        offset_table, checksums, ntiles, offset);
+
+  g_free (checksums);
+  g_free (offset_table);
 
   /* seek to the end of the file */
   xcf_check_error (xcf_seek_pos (info, offset, error));
 
   return TRUE;
+
+ error:
+  g_free (batch.tiles);
+  g_free (tile_data);
+  g_free (out_data);
+  g_free (checksums);
+  g_free (offset_table);
+
+  return FALSE;
 }
 
+/* copies the compressed data of the unchanged 'tile' from the file
+ * we are overwriting, returns FALSE if the tile must be compressed
+ * again
+ */
 static gboolean
-xcf_save_tile (XcfInfo        *info,
-               GeglBuffer     *buffer,
-               GeglRectangle  *tile_rect,
-               const Babl     *format,
-               GError        **error)
+xcf_reuse_tile (XcfInfo     *info,
+                XcfSaveTile *tile)
 {
-  gint    bpp       = babl_format_get_bytes_per_pixel (format);
-  gint    tile_size = bpp * tile_rect->width * tile_rect->height;
-  guchar *tile_data = g_alloca (tile_size);
-  GError *tmp_error = NULL;
+  gsize bytes_read;
 
-  gegl_buffer_get (buffer, tile_rect, 1.0, format, tile_data,
-                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+  if (! g_seekable_seek (G_SEEKABLE (info->reuse_input), tile->reuse_offset,
+                         G_SEEK_SET, NULL, NULL))
+    return FALSE;
 
-  xcf_write_int8_check_error (info, tile_data, tile_size);
+  if (! g_input_stream_read_all (info->reuse_input, tile->out_data,
+                                 tile->reuse_size, &bytes_read, NULL, NULL) ||
+      bytes_read != (gsize) tile->reuse_size)
+    return FALSE;
+
+  tile->out      = tile->out_data;
+  tile->out_size = tile->reuse_size;
 
   return TRUE;
 }
 
-static gboolean
-xcf_save_tile_rle (XcfInfo        *info,
-                   GeglBuffer     *buffer,
-                   GeglRectangle  *tile_rect,
-                   const Babl     *format,
-                   guchar         *rlebuf,
-                   GError        **error)
+static void
+xcf_encode_tiles (gint          i,
+                  gint          n,
+                  XcfSaveBatch *batch)
 {
-  gint    bpp       = babl_format_get_bytes_per_pixel (format);
-  gint    tile_size = bpp * tile_rect->width * tile_rect->height;
-  guchar *tile_data = g_alloca (tile_size);
-  gint    len       = 0;
-  gint    i, j;
-  GError *tmp_error  = NULL;
+  gint t;
+
+  while ((t = g_atomic_int_add (&batch->next, 1)) < batch->last)
+    {
+      XcfSaveTile *tile = &batch->tiles[t];
+
+      if (batch->checksum)
+        tile->checksum = xcf_tile_table_checksum (tile->tile_data,
+                                                  tile->tile_size);
+
+      /* not every operation that replaces tiles emits "changed", so
+       * the old tile is only used if the pixels are really the same
+       */
+      tile->reused = (tile->reusable &&
+                      tile->checksum == tile->reuse_checksum);
+
+      if (! tile->reused)
+        xcf_encode_tile (batch, tile);
+    }
+}
+
+static void
+xcf_encode_tile (XcfSaveBatch *batch,
+                 XcfSaveTile  *tile)
+{
+  switch (batch->compression)
+    {
+    case COMPRESS_NONE:
+      tile->out      = tile->tile_data;
+      tile->out_size = tile->tile_size;
+      break;
+
+    case COMPRESS_RLE:
+      tile->out      = tile->out_data;
+      tile->out_size = xcf_encode_tile_rle (tile->tile_data,
+                                            tile->rect.width *
+                                            tile->rect.height,
+                                            batch->bpp,
+                                            tile->out_data);
+      break;
+
+    case COMPRESS_ZLIB:
+      tile->out      = tile->out_data;
+      tile->out_size = xcf_encode_tile_zlib (tile->tile_data,
+                                             tile->tile_size,
+                                             tile->out_data,
+                                             tile->max_out_size);
+      break;
+
+    case COMPRESS_ZSTD:
+      tile->out      = tile->out_data;
+      tile->out_size = xcf_encode_tile_zstd (tile->tile_data,
+                                             tile->tile_size,
+                                             batch->bpc,
+                                             tile->out_data,
+                                             tile->max_out_size);
+      break;
+
+    default:
+      tile->out_size = -1;
+      break;
+    }
+}
 
-  gegl_buffer_get (buffer, tile_rect, 1.0, format, tile_data,
-                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+static gint
+xcf_encode_tile_rle (const guchar *tile_data,
+                     gint          n_pixels,
+                     gint          bpp,
+                     guchar       *rlebuf)
+{
+  gint len = 0;
+  gint i, j;
 
   for (i = 0; i < bpp; i++)
     {
@@ -1551,7 +1798,7 @@ xcf_save_tile_rle (XcfInfo        *info,
       gint          state  = 0;
       gint          length = 0;
       gint          count  = 0;
-      gint          size   = tile_rect->width * tile_rect->height;
+      gint          size   = n_pixels;
       guint         last   = -1;
 
       while (size > 0)
@@ -1637,35 +1884,24 @@ xcf_save_tile_rle (XcfInfo        *info,
             }
         }
 
-      if (count != (tile_rect->width * tile_rect->height))
-        g_message ("xcf: uh oh! xcf rle tile saving error: %d", count);
+      /* this runs in worker threads, so don't use g_message() */
+      if (count != n_pixels)
+        g_printerr ("xcf: uh oh! xcf rle tile saving error: %d\n", count);
     }
 
-  xcf_write_int8_check_error (info, rlebuf, len);
-
-  return TRUE;
+  return len;
 }
 
-static gboolean
-xcf_save_tile_zlib (XcfInfo        *info,
-                    GeglBuffer     *buffer,
-                    GeglRectangle  *tile_rect,
-                    const Babl     *format,
-                    GError        **error)
+static gint
+xcf_encode_tile_zlib (const guchar *tile_data,
+                      gint          tile_size,
+                      guchar       *buf,
+                      gint          buf_size)
 {
-  gint      bpp       = babl_format_get_bytes_per_pixel (format);
-  gint      tile_size = bpp * tile_rect->width * tile_rect->height;
-  guchar   *tile_data = g_alloca (tile_size);
-  /* The buffer for compressed data. */
-  guchar   *buf       = g_alloca (tile_size);
-  GError   *tmp_error = NULL;
   z_stream  strm;
   int       action;
   int       status;
 
-  gegl_buffer_get (buffer, tile_rect, 1.0, format, tile_data,
-                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-
   /* allocate deflate state */
   strm.zalloc = Z_NULL;
   strm.zfree  = Z_NULL;
@@ -1673,16 +1909,16 @@ xcf_save_tile_zlib (XcfInfo        *info,
 
   status = deflateInit (&strm, Z_DEFAULT_COMPRESSION);
   if (status != Z_OK)
-    return FALSE;
+    return -1;
 
-  strm.next_in   = tile_data;
+  strm.next_in   = (guchar *) tile_data;
   strm.avail_in  = tile_size;
   strm.next_out  = buf;
-  strm.avail_out = tile_size;
+  strm.avail_out = buf_size;
 
   action = Z_NO_FLUSH;
 
-  while (status == Z_OK || status == Z_BUF_ERROR)
+  while (status == Z_OK)
     {
       if (strm.avail_in == 0)
         {
@@ -1692,26 +1928,86 @@ xcf_save_tile_zlib (XcfInfo        *info,
 
       status = deflate (&strm, action);
 
-      if (status == Z_STREAM_END || status == Z_BUF_ERROR)
-        {
-          size_t write_size = tile_size - strm.avail_out;
-
-          xcf_write_int8_check_error (info, buf, write_size);
-
-          /* Reset next_out and avail_out. */
-          strm.next_out  = buf;
-          strm.avail_out = tile_size;
-        }
-      else if (status != Z_OK)
+      if (status != Z_OK && status != Z_STREAM_END)
         {
+          /* 'buf' is compressBound() large, so even Z_BUF_ERROR is
+           * a failure here
+           */
           g_printerr ("xcf: tile compression failed: %s", zError (status));
           deflateEnd (&strm);
-          return FALSE;
+          return -1;
         }
     }
 
   deflateEnd (&strm);
-  return TRUE;
+
+  return buf_size - strm.avail_out;
+}
+
+/*  before compressing, the bytes of each 'bpc' sized component are
+ *  grouped by significance, which makes the slowly changing high bytes
+ *  of high bit depth pixels compress a lot better
+ */
+static gint
+xcf_encode_tile_zstd (const guchar *tile_data,
+                      gint          tile_size,
+                      gint          bpc,
+                      guchar       *buf,
+                      gint          buf_size)
+{
+  static GPrivate  cctx_private = G_PRIVATE_INIT ((GDestroyNotify) ZSTD_freeCCtx);
+  ZSTD_CCtx       *cctx;
+  guchar          *shuffled = NULL;
+  gsize            size;
+
+  /* each thread keeps its compression context around */
+  cctx = g_private_get (&cctx_private);
+
+  if (! cctx)
+    {
+      cctx = ZSTD_createCCtx ();
+
+      if (! cctx)
+        return -1;
+
+      g_private_set (&cctx_private, cctx);
+    }
+
+  if (bpc > 1)
+    {
+      gint n_values = tile_size / bpc;
+      gint i, j;
+
+      shuffled = g_malloc (tile_size);
+
+      for (i = 0; i < bpc; i++)
+        {
+          const guchar *src  = tile_data + i;
+          guchar       *dest = shuffled  + i * n_values;
+
+          for (j = 0; j < n_values; j++)
+            {
+              dest[j] = *src;
+              src += bpc;
+            }
+        }
+
+      tile_data = shuffled;
+    }
+
+  size = ZSTD_compressCCtx (cctx, buf, buf_size, tile_data, tile_size,
+                            XCF_ZSTD_LEVEL);
+
+  g_free (shuffled);
+
+  if (ZSTD_isError (size))
+    {
+      g_printerr ("xcf: tile compression failed: %s",
+                  ZSTD_getErrorName (size));
+      return -1;
+    }
+
+  return size;
 }
 
 static gboolean
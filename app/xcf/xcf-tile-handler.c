@@ -0,0 +1,648 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <zlib.h>
+#include <zstd.h>
+
+#include <cairo.h>
+#include <gio/gio.h>
+#include <gegl.h>
+
+#include "core/core-types.h"
+
+#include "xcf-private.h"
+#include "xcf-load.h"
+#include "xcf-tile-handler.h"
+#include "xcf-tile-table.h"
+
+
+/*  the file which XcfTileHandlers read their tiles from.  All levels
+ *  of an image loaded from a file share one XcfTileFile, and reads are
+ *  serialized because they seek the same stream.
+ */
+struct _XcfTileFile
+{
+  gint          ref_count;
+  GFile        *file;
+  GInputStream *input;
+  GMutex        mutex;
+  GList        *handlers;
+};
+
+
+static void           xcf_tile_handler_finalize    (GObject                 *object);
+
+static gpointer       xcf_tile_handler_command     (GeglTileSource          *source,
+                                                    GeglTileCommand          command,
+                                                    gint                     x,
+                                                    gint                     y,
+                                                    gint                     z,
+                                                    gpointer                 data);
+
+static void           xcf_tile_handler_validate    (GimpTileHandlerValidate *validate,
+                                                    const GeglRectangle     *rect,
+                                                    const Babl              *format,
+                                                    gpointer                 dest_buf,
+                                                    gint                     dest_stride);
+
+static const guchar * xcf_tile_handler_decode_tile (XcfTileHandler          *handler,
+                                                    gint                     tile,
+                                                    gint                     n_pixels,
+                                                    gint                     bpc,
+                                                    guchar                  *xcf_data,
+                                                    guchar                  *tile_data);
+static void           xcf_tile_handler_load_level  (XcfTileHandler          *handler,
+                                                    gint                     x,
+                                                    gint                     y,
+                                                    gint                     z);
+static void           xcf_tile_handler_load_all    (XcfTileHandler          *handler);
+
+static gsize          xcf_tile_file_read           (XcfTileFile             *tile_file,
+                                                    goffset                  offset,
+                                                    guchar                  *data,
+                                                    gsize                    size);
+
+
+G_DEFINE_TYPE (XcfTileHandler, xcf_tile_handler,
+               GIMP_TYPE_TILE_HANDLER_VALIDATE)
+
+#define parent_class xcf_tile_handler_parent_class
+
+
+/*  the command of GimpTileHandlerValidate, which validates on get  */
+static GeglTileSourceCommand parent_command = NULL;
+
+
+/*  the open tile files, protected by the lock  */
+static GList *xcf_tile_files = NULL;
+
+G_LOCK_DEFINE_STATIC (xcf_tile_files);
+
+
+static void
+xcf_tile_handler_class_init (XcfTileHandlerClass *klass)
+{
+  GObjectClass                 *object_class   = G_OBJECT_CLASS (klass);
+  GimpTileHandlerValidateClass *validate_class = GIMP_TILE_HANDLER_VALIDATE_CLASS (klass);
+
+  object_class->finalize   = xcf_tile_handler_finalize;
+
+  validate_class->validate = xcf_tile_handler_validate;
+}
+
+static void
+xcf_tile_handler_init (XcfTileHandler *handler)
+{
+  GeglTileSource *source = GEGL_TILE_SOURCE (handler);
+
+  parent_command  = source->command;
+  source->command = xcf_tile_handler_command;
+}
+
+static void
+xcf_tile_handler_finalize (GObject *object)
+{
+  XcfTileHandler *handler = XCF_TILE_HANDLER (object);
+
+  if (handler->tile_file)
+    {
+      G_LOCK (xcf_tile_files);
+      handler->tile_file->handlers = g_list_remove (handler->tile_file->handlers,
+                                                    handler);
+      G_UNLOCK (xcf_tile_files);
+
+      xcf_tile_file_unref (handler->tile_file);
+      handler->tile_file = NULL;
+    }
+
+  if (handler->offsets)
+    {
+      g_free (handler->offsets);
+      handler->offsets = NULL;
+    }
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static gpointer
+xcf_tile_handler_command (GeglTileSource  *source,
+                          GeglTileCommand  command,
+                          gint             x,
+                          gint             y,
+                          gint             z,
+                          gpointer         data)
+{
+  XcfTileHandler          *handler  = XCF_TILE_HANDLER (source);
+  GimpTileHandlerValidate *validate = GIMP_TILE_HANDLER_VALIDATE (source);
+
+  if (handler->tile_file &&
+      ! cairo_region_is_empty (validate->dirty_region))
+    {
+      cairo_rectangle_int_t tile_rect;
+      gboolean              dirty;
+
+      tile_rect.x      = (x << z) * validate->tile_width;
+      tile_rect.y      = (y << z) * validate->tile_height;
+      tile_rect.width  = validate->tile_width  << z;
+      tile_rect.height = validate->tile_height << z;
+
+      dirty = (cairo_region_contains_rectangle (validate->dirty_region,
+                                                &tile_rect) !=
+               CAIRO_REGION_OVERLAP_OUT);
+
+      if (dirty && z > 0)
+        {
+          /*  the level is built from the tiles below it, which the
+           *  zoom handler reads past us, so load them first
+           */
+          if (command == GEGL_TILE_GET || command == GEGL_TILE_COPY)
+            xcf_tile_handler_load_level (handler, x, y, z);
+        }
+      else if (dirty)
+        {
+          switch (command)
+            {
+            case GEGL_TILE_SET:
+            case GEGL_TILE_VOID:
+              /*  the tile's pixels are replaced, the file's are stale  */
+              cairo_region_subtract_rectangle (validate->dirty_region,
+                                               &tile_rect);
+              break;
+
+            case GEGL_TILE_GET:
+              /*  a tile which already exists was stored by a writer
+               *  which doesn't pass us, like the copy-on-write of
+               *  gegl_buffer_copy(), and must not be overwritten
+               */
+              if (gegl_tile_handler_source_command (source, GEGL_TILE_EXIST,
+                                                    x, y, z, NULL))
+                {
+                  cairo_region_subtract_rectangle (validate->dirty_region,
+                                                   &tile_rect);
+                }
+              break;
+
+            case GEGL_TILE_COPY:
+              /*  the copy is made below us, so load the tile first  */
+              {
+                GeglTile *tile = gegl_tile_source_get_tile (source, x, y, z);
+
+                if (tile)
+                  gegl_tile_unref (tile);
+              }
+              break;
+
+            default:
+              break;
+            }
+        }
+    }
+
+  return parent_command (source, command, x, y, z, data);
+}
+
+static void
+xcf_tile_handler_validate (GimpTileHandlerValidate *validate,
+                           const GeglRectangle     *rect,
+                           const Babl              *format,
+                           gpointer                 dest_buf,
+                           gint                     dest_stride)
+{
+  XcfTileHandler *handler = XCF_TILE_HANDLER (validate);
+  GeglRectangle   area;
+  guchar         *xcf_data;
+  guchar         *tile_data;
+  gint            max_tile_size;
+  gint            max_data_size;
+  gint            bpc;
+  gint            n_tile_cols;
+  gint            tile_x1, tile_y1;
+  gint            tile_x2, tile_y2;
+  gint            tile_x, tile_y;
+
+  /*  the file was detached, all tiles were loaded before  */
+  if (! handler->tile_file)
+    return;
+
+  if (! gegl_rectangle_intersect (&area, rect,
+                                  GEGL_RECTANGLE (0, 0,
+                                                  handler->width,
+                                                  handler->height)))
+    return;
+
+  bpc         = handler->bpp / babl_format_get_n_components (format);
+  n_tile_cols = (handler->width + XCF_TILE_WIDTH - 1) / XCF_TILE_WIDTH;
+
+  tile_x1 = area.x / XCF_TILE_WIDTH;
+  tile_y1 = area.y / XCF_TILE_HEIGHT;
+  tile_x2 = (area.x + area.width  - 1) / XCF_TILE_WIDTH  + 1;
+  tile_y2 = (area.y + area.height - 1) / XCF_TILE_HEIGHT + 1;
+
+  /* the maximum amount of data a valid tile can occupy in the file,
+   * allowing for negative compression
+   */
+  max_tile_size = XCF_TILE_WIDTH * XCF_TILE_HEIGHT * handler->bpp;
+  max_data_size = MAX (max_tile_size * 1.5, compressBound (max_tile_size));
+  max_data_size = MAX (max_data_size, ZSTD_compressBound (max_tile_size));
+
+  xcf_data  = g_malloc (max_data_size);
+  tile_data = g_malloc (max_tile_size);
+
+  for (tile_y = tile_y1; tile_y < tile_y2; tile_y++)
+    for (tile_x = tile_x1; tile_x < tile_x2; tile_x++)
+      {
+        GeglRectangle  tile_rect;
+        GeglRectangle  copy_rect;
+        const guchar  *pixels;
+        const guchar  *src;
+        guchar        *dest;
+        gint           tile;
+        gint           y;
+
+        tile_rect.x      = tile_x * XCF_TILE_WIDTH;
+        tile_rect.y      = tile_y * XCF_TILE_HEIGHT;
+        tile_rect.width  = MIN (XCF_TILE_WIDTH,  handler->width  - tile_rect.x);
+        tile_rect.height = MIN (XCF_TILE_HEIGHT, handler->height - tile_rect.y);
+
+        tile = tile_y * n_tile_cols + tile_x;
+
+        pixels = xcf_tile_handler_decode_tile (handler,
+                                               tile,
+                                               tile_rect.width *
+                                               tile_rect.height,
+                                               bpc,
+                                               xcf_data,
+                                               tile_data);
+
+        /*  leave the area of broken tiles empty  */
+        if (! pixels)
+          continue;
+
+        /*  saving may reuse the tile only if its pixels still match  */
+        xcf_tile_table_set_checksum (handler->buffer, tile,
+                                     xcf_tile_table_checksum (pixels,
+                                                              tile_rect.width *
+                                                              tile_rect.height *
+                                                              handler->bpp));
+
+        gegl_rectangle_intersect (&copy_rect, &tile_rect, &area);
+
+        src  = pixels +
+               ((copy_rect.y - tile_rect.y) * tile_rect.width +
+                (copy_rect.x - tile_rect.x)) * handler->bpp;
+        dest = (guchar *) dest_buf +
+               (copy_rect.y - rect->y) * dest_stride +
+               (copy_rect.x - rect->x) * handler->bpp;
+
+        for (y = 0; y < copy_rect.height; y++)
+          {
+            memcpy (dest, src, copy_rect.width * handler->bpp);
+
+            src  += tile_rect.width * handler->bpp;
+            dest += dest_stride;
+          }
+      }
+
+  g_free (tile_data);
+  g_free (xcf_data);
+}
+
+/*  returns the pixels of 'tile', either read into 'xcf_data' or decoded
+ *  into 'tile_data', or NULL if the tile can't be read or decoded
+ */
+static const guchar *
+xcf_tile_handler_decode_tile (XcfTileHandler *handler,
+                              gint            tile,
+                              gint            n_pixels,
+                              gint            bpc,
+                              guchar         *xcf_data,
+                              guchar         *tile_data)
+{
+  goffset offset;
+  goffset offset2;
+  gint    tile_size;
+  gint    max_data_size;
+  gint    data_length;
+
+  tile_size     = n_pixels * handler->bpp;
+  max_data_size = MAX (tile_size * 1.5, compressBound (tile_size));
+  max_data_size = MAX (max_data_size, ZSTD_compressBound (tile_size));
+
+  offset  = handler->offsets[tile];
+  offset2 = handler->offsets[tile + 1];
+
+  if (offset <= 0)
+    return NULL;
+
+  /* if the offset is 0 then we need to read in the maximum possible
+   * allowing for negative compression
+   */
+  if (offset2 == 0)
+    offset2 = offset + max_data_size;
+
+  if (handler->compression == COMPRESS_NONE)
+    data_length = tile_size;
+  else
+    data_length = CLAMP (offset2 - offset, -1, max_data_size);
+
+  if (data_length <= 0)
+    return NULL;
+
+  /* the last tile may end before 'max_data_size', and the file may
+   * have been truncated since it was loaded
+   */
+  data_length = xcf_tile_file_read (handler->tile_file, offset,
+                                    xcf_data, data_length);
+
+  if (data_length > 0)
+    {
+      switch (handler->compression)
+        {
+        case COMPRESS_NONE:
+          if (data_length == tile_size)
+            return xcf_data;
+          break;
+
+        case COMPRESS_RLE:
+          if (xcf_decode_tile_rle (xcf_data, data_length,
+                                   n_pixels, handler->bpp, tile_data))
+            return tile_data;
+          break;
+
+        case COMPRESS_ZLIB:
+          if (xcf_decode_tile_zlib (xcf_data, data_length,
+                                    tile_data, tile_size))
+            return tile_data;
+          break;
+
+        case COMPRESS_ZSTD:
+          if (xcf_decode_tile_zstd (xcf_data, data_length, bpc,
+                                    tile_data, tile_size))
+            return tile_data;
+          break;
+
+        default:
+          break;
+        }
+    }
+
+  g_printerr ("xcf: failed to read tile %d. "
+              "Possibly corrupt XCF file.\n", tile);
+
+  return NULL;
+}
+
+/*  loads the tiles of level 0 which make up tile 'x', 'y' of level 'z'  */
+static void
+xcf_tile_handler_load_level (XcfTileHandler *handler,
+                             gint            x,
+                             gint            y,
+                             gint            z)
+{
+  GimpTileHandlerValidate *validate = GIMP_TILE_HANDLER_VALIDATE (handler);
+  GeglTileSource          *source   = GEGL_TILE_SOURCE (handler);
+  gint                     tile_x;
+  gint                     tile_y;
+
+  for (tile_y = y << z; tile_y < (y + 1) << z; tile_y++)
+    for (tile_x = x << z; tile_x < (x + 1) << z; tile_x++)
+      {
+        cairo_rectangle_int_t  tile_rect;
+        GeglTile              *tile;
+
+        tile_rect.x      = tile_x * validate->tile_width;
+        tile_rect.y      = tile_y * validate->tile_height;
+        tile_rect.width  = validate->tile_width;
+        tile_rect.height = validate->tile_height;
+
+        if (cairo_region_contains_rectangle (validate->dirty_region,
+                                             &tile_rect) ==
+            CAIRO_REGION_OVERLAP_OUT)
+          continue;
+
+        /*  getting the tile validates it  */
+        tile = gegl_tile_source_get_tile (source, tile_x, tile_y, 0);
+
+        if (tile)
+          gegl_tile_unref (tile);
+      }
+}
+
+/*  makes the buffer read all tiles which weren't accessed yet  */
+static void
+xcf_tile_handler_load_all (XcfTileHandler *handler)
+{
+  GimpTileHandlerValidate *validate = GIMP_TILE_HANDLER_VALIDATE (handler);
+  cairo_region_t          *region;
+  gint                     n_rects;
+  gint                     i;
+
+  region  = cairo_region_copy (validate->dirty_region);
+  n_rects = cairo_region_num_rectangles (region);
+
+  for (i = 0; i < n_rects; i++)
+    {
+      GeglBufferIterator    *iter;
+      cairo_rectangle_int_t  rect;
+
+      cairo_region_get_rectangle (region, i, &rect);
+
+      iter = gegl_buffer_iterator_new (handler->buffer,
+                                       GEGL_RECTANGLE (rect.x, rect.y,
+                                                       rect.width,
+                                                       rect.height),
+                                       0, NULL,
+                                       GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
+
+      /*  getting the tiles validates them  */
+      while (gegl_buffer_iterator_next (iter));
+    }
+
+  cairo_region_destroy (region);
+}
+
+/*  reads up to 'size' bytes at 'offset', and returns how many bytes
+ *  could be read
+ */
+static gsize
+xcf_tile_file_read (XcfTileFile *tile_file,
+                    goffset      offset,
+                    guchar      *data,
+                    gsize        size)
+{
+  gsize n_read = 0;
+
+  g_mutex_lock (&tile_file->mutex);
+
+  if (tile_file->input &&
+      g_seekable_seek (G_SEEKABLE (tile_file->input), offset, G_SEEK_SET,
+                       NULL, NULL))
+    {
+      g_input_stream_read_all (tile_file->input, data, size, &n_read,
+                               NULL, NULL);
+    }
+
+  g_mutex_unlock (&tile_file->mutex);
+
+  return n_read;
+}
+
+
+/*  public functions  */
+
+GeglTileHandler *
+xcf_tile_handler_new (XcfTileFile        *tile_file,
+                      GeglBuffer         *buffer,
+                      XcfCompressionType  compression,
+                      gint                width,
+                      gint                height,
+                      gint                bpp,
+                      const goffset      *offsets,
+                      gint                n_tiles)
+{
+  XcfTileHandler *handler;
+
+  g_return_val_if_fail (tile_file != NULL, NULL);
+  g_return_val_if_fail (GEGL_IS_BUFFER (buffer), NULL);
+  g_return_val_if_fail (width > 0 && height > 0, NULL);
+  g_return_val_if_fail (bpp > 0, NULL);
+  g_return_val_if_fail (offsets != NULL, NULL);
+
+  handler = g_object_new (XCF_TYPE_TILE_HANDLER,
+                          "whole-tile", TRUE,
+                          NULL);
+
+  g_atomic_int_inc (&tile_file->ref_count);
+
+  handler->tile_file   = tile_file;
+  handler->buffer      = buffer; /* the buffer owns the handler */
+  handler->compression = compression;
+  handler->width       = width;
+  handler->height      = height;
+  handler->bpp         = bpp;
+  handler->offsets     = g_memdup (offsets, (n_tiles + 1) * sizeof (goffset));
+  handler->n_tiles     = n_tiles;
+
+  G_LOCK (xcf_tile_files);
+  tile_file->handlers = g_list_prepend (tile_file->handlers, handler);
+  G_UNLOCK (xcf_tile_files);
+
+  return GEGL_TILE_HANDLER (handler);
+}
+
+/*  opens 'file' for the tile handlers of an image loaded from it, or
+ *  returns NULL if it can't be read
+ */
+XcfTileFile *
+xcf_tile_file_open (GFile *file)
+{
+  XcfTileFile      *tile_file;
+  GFileInputStream *input;
+
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+
+  input = g_file_read (file, NULL, NULL);
+
+  if (! input)
+    return NULL;
+
+  tile_file = g_slice_new0 (XcfTileFile);
+
+  tile_file->ref_count = 1;
+  tile_file->file      = g_object_ref (file);
+  tile_file->input     = G_INPUT_STREAM (input);
+
+  g_mutex_init (&tile_file->mutex);
+
+  G_LOCK (xcf_tile_files);
+  xcf_tile_files = g_list_prepend (xcf_tile_files, tile_file);
+  G_UNLOCK (xcf_tile_files);
+
+  return tile_file;
+}
+
+void
+xcf_tile_file_unref (XcfTileFile *tile_file)
+{
+  g_return_if_fail (tile_file != NULL);
+
+  if (! g_atomic_int_dec_and_test (&tile_file->ref_count))
+    return;
+
+  G_LOCK (xcf_tile_files);
+  xcf_tile_files = g_list_remove (xcf_tile_files, tile_file);
+  G_UNLOCK (xcf_tile_files);
+
+  g_clear_object (&tile_file->input);
+  g_object_unref (tile_file->file);
+
+  g_mutex_clear (&tile_file->mutex);
+
+  g_slice_free (XcfTileFile, tile_file);
+}
+
+/*  loads all tiles which images still read from 'file' on demand, and
+ *  closes it.  This must be done before anything writes to 'file',
+ *  which could otherwise change or truncate the tiles, and which
+ *  Windows doesn't allow while the file is open.
+ */
+void
+xcf_tile_file_detach (GFile *file)
+{
+  GList *handlers = NULL;
+  GList *list;
+
+  g_return_if_fail (G_IS_FILE (file));
+
+  G_LOCK (xcf_tile_files);
+
+  for (list = xcf_tile_files; list; list = g_list_next (list))
+    {
+      XcfTileFile *tile_file = list->data;
+
+      if (g_file_equal (tile_file->file, file))
+        {
+          GList *iter;
+
+          for (iter = tile_file->handlers; iter; iter = g_list_next (iter))
+            handlers = g_list_prepend (handlers, g_object_ref (iter->data));
+        }
+    }
+
+  G_UNLOCK (xcf_tile_files);
+
+  for (list = handlers; list; list = g_list_next (list))
+    {
+      XcfTileHandler *handler = list->data;
+
+      xcf_tile_handler_load_all (handler);
+
+      G_LOCK (xcf_tile_files);
+      handler->tile_file->handlers = g_list_remove (handler->tile_file->handlers,
+                                                    handler);
+      G_UNLOCK (xcf_tile_files);
+
+      /*  the file is closed with its last handler  */
+      xcf_tile_file_unref (handler->tile_file);
+      handler->tile_file = NULL;
+    }
+
+  g_list_free_full (handlers, g_object_unref);
+}
@@ -0,0 +1,414 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <zlib.h>
+
+#include <gio/gio.h>
+#include <gegl.h>
+
+#include "core/core-types.h"
+
+#include "core/gimpimage.h"
+
+#include "xcf-private.h"
+#include "xcf-tile-table.h"
+
+
+#define XCF_TILE_SOURCE_KEY "gimp-xcf-tile-source"
+#define XCF_TILE_TABLE_KEY  "gimp-xcf-tile-table"
+
+
+typedef struct
+{
+  GFile   *file;
+  guint    serial;
+  gchar   *etag;     /*  NULL until the file is complete  */
+  goffset  size;
+} XcfTileSource;
+
+struct _XcfTileTable
+{
+  guint               serial;
+  XcfCompressionType  compression;
+  const Babl         *format;
+  gint                width;
+  gint                height;
+  gint                n_tiles;
+  goffset            *offsets;  /*  n_tiles + 1, the last one is 0 if
+                                 *  the end of the last tile is unknown
+                                 */
+  guchar             *dirty;
+  guint32            *checksums; /*  of the tiles' pixels, only valid
+                                  *  where 'known' is set
+                                  */
+  guchar             *known;
+};
+
+
+static void     xcf_tile_source_free          (XcfTileSource        *source);
+static gboolean xcf_tile_source_query         (GFile                *file,
+                                               gchar               **etag,
+                                               goffset              *size);
+
+static void     xcf_tile_table_free           (XcfTileTable         *table);
+static void     xcf_tile_table_buffer_changed (GeglBuffer           *buffer,
+                                               const GeglRectangle  *rect,
+                                               XcfTileTable         *table);
+
+
+static gint xcf_tile_table_serial = 0;
+
+
+/*  public functions  */
+
+guint
+xcf_tile_table_new_serial (void)
+{
+  /*  0 is never a valid serial  */
+  return g_atomic_int_add (&xcf_tile_table_serial, 1) + 1;
+}
+
+/*  makes 'file' the image's tile source, whose tables are the ones with
+ *  'serial'.  The source can't be used until it is stamped, which must
+ *  happen after the file has been completely written.
+ */
+void
+xcf_tile_table_set_source (GimpImage *image,
+                           GFile     *file,
+                           guint      serial)
+{
+  XcfTileSource *source;
+
+  g_return_if_fail (GIMP_IS_IMAGE (image));
+  g_return_if_fail (G_IS_FILE (file));
+
+  source = g_slice_new0 (XcfTileSource);
+
+  source->file   = g_object_ref (file);
+  source->serial = serial;
+
+  g_object_set_data_full (G_OBJECT (image), XCF_TILE_SOURCE_KEY, source,
+                          (GDestroyNotify) xcf_tile_source_free);
+}
+
+void
+xcf_tile_table_stamp_source (GimpImage *image,
+                             GFile     *file)
+{
+  XcfTileSource *source;
+
+  g_return_if_fail (GIMP_IS_IMAGE (image));
+  g_return_if_fail (G_IS_FILE (file));
+
+  source = g_object_get_data (G_OBJECT (image), XCF_TILE_SOURCE_KEY);
+
+  if (! source || ! g_file_equal (source->file, file))
+    return;
+
+  g_clear_pointer (&source->etag, g_free);
+
+  if (! xcf_tile_source_query (file, &source->etag, &source->size))
+    g_object_set_data (G_OBJECT (image), XCF_TILE_SOURCE_KEY, NULL);
+}
+
+/*  returns TRUE if 'file' is the image's tile source and wasn't changed
+ *  since it was stamped, and returns the serial of its tables
+ */
+gboolean
+xcf_tile_table_lookup_source (GimpImage *image,
+                              GFile     *file,
+                              guint     *serial)
+{
+  XcfTileSource *source;
+  gchar         *etag;
+  goffset        size;
+  gboolean       unchanged;
+
+  g_return_val_if_fail (GIMP_IS_IMAGE (image), FALSE);
+  g_return_val_if_fail (G_IS_FILE (file), FALSE);
+  g_return_val_if_fail (serial != NULL, FALSE);
+
+  source = g_object_get_data (G_OBJECT (image), XCF_TILE_SOURCE_KEY);
+
+  if (! source || ! source->etag || ! g_file_equal (source->file, file))
+    return FALSE;
+
+  if (! xcf_tile_source_query (file, &etag, &size))
+    return FALSE;
+
+  unchanged = (size == source->size && ! strcmp (etag, source->etag));
+
+  g_free (etag);
+
+  if (unchanged)
+    *serial = source->serial;
+
+  return unchanged;
+}
+
+/*  returns the checksum of a tile's uncompressed pixels  */
+guint32
+xcf_tile_table_checksum (const guchar *data,
+                         gint          size)
+{
+  return crc32 (crc32 (0, NULL, 0), data, size);
+}
+
+/*  records that the tiles of 'buffer' are at 'offsets' in the file of
+ *  the tables with 'serial', and that they are unchanged.  'end' is
+ *  the end of the last tile, or 0 if it's unknown.  'checksums' are
+ *  the checksums of the tiles' pixels, or NULL if they are unknown
+ *  yet, see xcf_tile_table_set_checksum().
+ */
+void
+xcf_tile_table_set (GeglBuffer         *buffer,
+                    guint               serial,
+                    XcfCompressionType  compression,
+                    const goffset      *offsets,
+                    const guint32      *checksums,
+                    gint                n_tiles,
+                    goffset             end)
+{
+  XcfTileTable *table;
+
+  g_return_if_fail (GEGL_IS_BUFFER (buffer));
+  g_return_if_fail (offsets != NULL);
+  g_return_if_fail (n_tiles > 0);
+
+  table = g_object_get_data (G_OBJECT (buffer), XCF_TILE_TABLE_KEY);
+
+  /*  the table stays connected to the buffer for its lifetime, so
+   *  we never have to disconnect from a buffer which is finalized
+   */
+  if (! table)
+    {
+      table = g_slice_new0 (XcfTileTable);
+
+      g_object_set_data_full (G_OBJECT (buffer), XCF_TILE_TABLE_KEY, table,
+                              (GDestroyNotify) xcf_tile_table_free);
+
+      gegl_buffer_signal_connect (buffer, "changed",
+                                  G_CALLBACK (xcf_tile_table_buffer_changed),
+                                  table);
+    }
+
+  if (table->n_tiles != n_tiles)
+    {
+      g_free (table->offsets);
+      g_free (table->dirty);
+      g_free (table->checksums);
+      g_free (table->known);
+
+      table->offsets   = g_new (goffset, n_tiles + 1);
+      table->dirty     = g_new (guchar, n_tiles);
+      table->checksums = g_new (guint32, n_tiles);
+      table->known     = g_new (guchar, n_tiles);
+    }
+
+  table->serial      = serial;
+  table->compression = compression;
+  table->format      = gegl_buffer_get_format (buffer);
+  table->width       = gegl_buffer_get_width (buffer);
+  table->height      = gegl_buffer_get_height (buffer);
+  table->n_tiles     = n_tiles;
+
+  memcpy (table->offsets, offsets, n_tiles * sizeof (goffset));
+  table->offsets[n_tiles] = end;
+
+  memset (table->dirty, 0, n_tiles);
+
+  if (checksums)
+    {
+      memcpy (table->checksums, checksums, n_tiles * sizeof (guint32));
+      memset (table->known, TRUE, n_tiles);
+    }
+  else
+    {
+      memset (table->known, FALSE, n_tiles);
+    }
+}
+
+/*  records the checksum of the pixels of 'tile' as they were read from
+ *  the file, for tiles which are loaded after xcf_tile_table_set().
+ *  This can be called from any thread.
+ */
+void
+xcf_tile_table_set_checksum (GeglBuffer *buffer,
+                             gint        tile,
+                             guint32     checksum)
+{
+  XcfTileTable *table;
+
+  g_return_if_fail (GEGL_IS_BUFFER (buffer));
+
+  table = g_object_get_data (G_OBJECT (buffer), XCF_TILE_TABLE_KEY);
+
+  if (! table || tile < 0 || tile >= table->n_tiles)
+    return;
+
+  table->checksums[tile] = checksum;
+  table->known[tile]     = TRUE;
+}
+
+/*  returns the table of 'buffer', if it belongs to the tables with
+ *  'serial' and can be used for saving with 'compression'
+ */
+XcfTileTable *
+xcf_tile_table_get (GeglBuffer         *buffer,
+                    guint               serial,
+                    XcfCompressionType  compression)
+{
+  XcfTileTable *table;
+
+  g_return_val_if_fail (GEGL_IS_BUFFER (buffer), NULL);
+
+  table = g_object_get_data (G_OBJECT (buffer), XCF_TILE_TABLE_KEY);
+
+  if (table                                                &&
+      table->serial      == serial                         &&
+      table->compression == compression                    &&
+      table->format      == gegl_buffer_get_format (buffer) &&
+      table->width       == gegl_buffer_get_width  (buffer) &&
+      table->height      == gegl_buffer_get_height (buffer))
+    {
+      return table;
+    }
+
+  return NULL;
+}
+
+/*  returns the position of 'tile' in the file, and the checksum of
+ *  its pixels, or FALSE if the tile was changed, or its size or
+ *  checksum is unknown.  The "changed" signal isn't emitted by every
+ *  operation that replaces tiles, so callers must compare the checksum
+ *  to the buffer's current pixels before using the tile.
+ */
+gboolean
+xcf_tile_table_get_tile (XcfTileTable *table,
+                         gint          tile,
+                         goffset      *offset,
+                         gint         *size,
+                         guint32      *checksum)
+{
+  goffset end;
+
+  g_return_val_if_fail (table != NULL, FALSE);
+  g_return_val_if_fail (tile >= 0 && tile < table->n_tiles, FALSE);
+
+  if (table->dirty[tile] || ! table->known[tile])
+    return FALSE;
+
+  end = table->offsets[tile + 1];
+
+  if (end <= table->offsets[tile] || end - table->offsets[tile] > G_MAXINT)
+    return FALSE;
+
+  *offset   = table->offsets[tile];
+  *size     = end - table->offsets[tile];
+  *checksum = table->checksums[tile];
+
+  return TRUE;
+}
+
+
+/*  private functions  */
+
+static void
+xcf_tile_source_free (XcfTileSource *source)
+{
+  g_object_unref (source->file);
+  g_free (source->etag);
+
+  g_slice_free (XcfTileSource, source);
+}
+
+static gboolean
+xcf_tile_source_query (GFile    *file,
+                       gchar   **etag,
+                       goffset  *size)
+{
+  GFileInfo *info;
+
+  info = g_file_query_info (file,
+                            G_FILE_ATTRIBUTE_ETAG_VALUE ","
+                            G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                            G_FILE_QUERY_INFO_NONE,
+                            NULL, NULL);
+
+  if (! info)
+    return FALSE;
+
+  if (! g_file_info_get_etag (info))
+    {
+      g_object_unref (info);
+      return FALSE;
+    }
+
+  *etag = g_strdup (g_file_info_get_etag (info));
+  *size = g_file_info_get_size (info);
+
+  g_object_unref (info);
+
+  return TRUE;
+}
+
+static void
+xcf_tile_table_free (XcfTileTable *table)
+{
+  g_free (table->offsets);
+  g_free (table->dirty);
+  g_free (table->checksums);
+  g_free (table->known);
+
+  g_slice_free (XcfTileTable, table);
+}
+
+/*  this can be called from any thread, but a racing update of a flag
+ *  can only make it dirty
+ */
+static void
+xcf_tile_table_buffer_changed (GeglBuffer          *buffer,
+                               const GeglRectangle *rect,
+                               XcfTileTable        *table)
+{
+  GeglRectangle area;
+  gint          n_tile_cols;
+  gint          tile_x1, tile_y1;
+  gint          tile_x2, tile_y2;
+  gint          tile_x, tile_y;
+
+  if (! table->n_tiles ||
+      ! gegl_rectangle_intersect (&area, rect,
+                                  GEGL_RECTANGLE (0, 0,
+                                                  table->width,
+                                                  table->height)))
+    return;
+
+  n_tile_cols = (table->width + XCF_TILE_WIDTH - 1) / XCF_TILE_WIDTH;
+
+  tile_x1 = area.x / XCF_TILE_WIDTH;
+  tile_y1 = area.y / XCF_TILE_HEIGHT;
+  tile_x2 = (area.x + area.width  - 1) / XCF_TILE_WIDTH  + 1;
+  tile_y2 = (area.y + area.height - 1) / XCF_TILE_HEIGHT + 1;
+
+  for (tile_y = tile_y1; tile_y < tile_y2; tile_y++)
+    for (tile_x = tile_x1; tile_x < tile_x2; tile_x++)
+      table->dirty[tile_y * n_tile_cols + tile_x] = TRUE;
+}
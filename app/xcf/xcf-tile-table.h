@@ -0,0 +1,71 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __XCF_TILE_TABLE_H__
+#define __XCF_TILE_TABLE_H__
+
+
+/*  An XcfTileTable remembers where the tiles of a buffer's full-size
+ *  level are in the XCF file the buffer was last loaded from or saved
+ *  to, and which of them were changed since, so saving the image to
+ *  the same file again can copy the compressed data of the unchanged
+ *  tiles instead of compressing them again.  A tile is only unchanged
+ *  if its pixels still match the checksum of the pixels in the file.
+ *
+ *  The tables of an image are only valid for the file recorded as the
+ *  image's tile source, and only as long as that file is unchanged.
+ */
+
+typedef struct _XcfTileTable XcfTileTable;
+
+
+guint          xcf_tile_table_new_serial    (void);
+
+void           xcf_tile_table_set_source    (GimpImage          *image,
+                                             GFile              *file,
+                                             guint               serial);
+void           xcf_tile_table_stamp_source  (GimpImage          *image,
+                                             GFile              *file);
+gboolean       xcf_tile_table_lookup_source (GimpImage          *image,
+                                             GFile              *file,
+                                             guint              *serial);
+
+guint32        xcf_tile_table_checksum      (const guchar       *data,
+                                             gint                size);
+
+void           xcf_tile_table_set           (GeglBuffer         *buffer,
+                                             guint               serial,
+                                             XcfCompressionType  compression,
+                                             const goffset      *offsets,
+                                             const guint32      *checksums,
+                                             gint                n_tiles,
+                                             goffset             end);
+void           xcf_tile_table_set_checksum  (GeglBuffer         *buffer,
+                                             gint                tile,
+                                             guint32             checksum);
+XcfTileTable * xcf_tile_table_get           (GeglBuffer         *buffer,
+                                             guint               serial,
+                                             XcfCompressionType  compression);
+
+gboolean       xcf_tile_table_get_tile      (XcfTileTable       *table,
+                                             gint                tile,
+                                             goffset            *offset,
+                                             gint               *size,
+                                             guint32            *checksum);
+
+
+#endif  /* __XCF_TILE_TABLE_H__ */
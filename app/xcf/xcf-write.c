@@ -72,6 +72,113 @@ xcf_write_zero_int32 (GOutputStream  *output,
   return 0;
 }
 
+guint
+xcf_write_int64 (GOutputStream  *output,
+                 const guint64  *data,
+                 gint            count,
+                 GError        **error)
+{
+  GError  *tmp_error = NULL;
+  gint     i;
+
+  if (count > 0)
+    {
+      for (i = 0; i < count; i++)
+        {
+          guint64  tmp = GUINT64_TO_BE (data[i]);
+
+          xcf_write_int8 (output, (const guint8 *) &tmp, 8, &tmp_error);
+
+          if (tmp_error)
+            {
+              g_propagate_error (error, tmp_error);
+
+              return i * 8;
+            }
+        }
+    }
+
+  return count * 8;
+}
+
+guint
+xcf_write_offset (GOutputStream  *output,
+                  gint            bytes_per_offset,
+                  const goffset  *data,
+                  gint            count,
+                  GError        **error)
+{
+  GError  *tmp_error = NULL;
+  gint     i;
+
+  for (i = 0; i < count; i++)
+    {
+      if (bytes_per_offset == 8)
+        {
+          guint64 tmp = data[i];
+
+          xcf_write_int64 (output, &tmp, 1, &tmp_error);
+        }
+      else if (data[i] > G_MAXUINT32)
+        {
+          g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                       _("Error writing XCF: offset %" G_GOFFSET_FORMAT
+                         " does not fit into a 32-bit XCF file"),
+                       data[i]);
+
+          return i * bytes_per_offset;
+        }
+      else
+        {
+          guint32 tmp = data[i];
+
+          xcf_write_int32 (output, &tmp, 1, &tmp_error);
+        }
+
+      if (tmp_error)
+        {
+          g_propagate_error (error, tmp_error);
+
+          return i * bytes_per_offset;
+        }
+    }
+
+  return count * bytes_per_offset;
+}
+
+guint
+xcf_write_zero_offset (GOutputStream  *output,
+                       gint            bytes_per_offset,
+                       gint            count,
+                       GError        **error)
+{
+  guint8 zeros[1024] = { 0, };
+  guint  total       = 0;
+  gsize  size        = (gsize) count * bytes_per_offset;
+
+  /* offset tables of huge levels can be too large for the stack, so
+   * write them in chunks instead of using xcf_write_zero_int32()
+   */
+  while (size > 0)
+    {
+      GError *tmp_error = NULL;
+      gint    n         = MIN (size, sizeof (zeros));
+
+      total += xcf_write_int8 (output, zeros, n, &tmp_error);
+
+      if (tmp_error)
+        {
+          g_propagate_error (error, tmp_error);
+
+          return total;
+        }
+
+      size -= n;
+    }
+
+  return total;
+}
+
 guint
 xcf_write_float (GOutputStream  *output,
                  const gfloat   *data,
@@ -29,11 +29,17 @@
 
 #include "core/core-types.h"
 
+#include "config/gimpcoreconfig.h"
+
 #include "core/gimp.h"
 #include "core/gimpimage.h"
 #include "core/gimpparamspecs.h"
 #include "core/gimpprogress.h"
 
+#include "pdb/gimppdb.h"
+#include "pdb/gimppdberror.h"
+#include "pdb/gimpprocedure.h"
+
 #include "plug-in/gimppluginmanager.h"
 #include "plug-in/gimppluginprocedure.h"
 
@@ -42,6 +48,8 @@
 #include "xcf-load.h"
 #include "xcf-read.h"
 #include "xcf-save.h"
+#include "xcf-tile-handler.h"
+#include "xcf-tile-table.h"
 
 #include "gimp-intl.h"
 
@@ -51,18 +59,54 @@ typedef GimpImage * GimpXcfLoaderFunc (Gimp     *gimp,
                                        GError  **error);
 
 
-static GimpValueArray * xcf_load_invoker (GimpProcedure         *procedure,
-                                          Gimp                  *gimp,
-                                          GimpContext           *context,
-                                          GimpProgress          *progress,
-                                          const GimpValueArray  *args,
-                                          GError               **error);
-static GimpValueArray * xcf_save_invoker (GimpProcedure         *procedure,
-                                          Gimp                  *gimp,
-                                          GimpContext           *context,
-                                          GimpProgress          *progress,
-                                          const GimpValueArray  *args,
-                                          GError               **error);
+static GimpImage      * xcf_load_stream_internal (Gimp                  *gimp,
+                                                  GInputStream          *input,
+                                                  GFile                 *input_file,
+                                                  GimpProgress          *progress,
+                                                  gint                   thumb_size,
+                                                  gint                  *image_width,
+                                                  gint                  *image_height,
+                                                  GError               **error);
+
+static GimpValueArray * xcf_load_invoker         (GimpProcedure         *procedure,
+                                                  Gimp                  *gimp,
+                                                  GimpContext           *context,
+                                                  GimpProgress          *progress,
+                                                  const GimpValueArray  *args,
+                                                  GError               **error);
+static GimpValueArray * xcf_load_thumb_invoker   (GimpProcedure         *procedure,
+                                                  Gimp                  *gimp,
+                                                  GimpContext           *context,
+                                                  GimpProgress          *progress,
+                                                  const GimpValueArray  *args,
+                                                  GError               **error);
+static GimpValueArray * xcf_save_invoker         (GimpProcedure         *procedure,
+                                                  Gimp                  *gimp,
+                                                  GimpContext           *context,
+                                                  GimpProgress          *progress,
+                                                  const GimpValueArray  *args,
+                                                  GError               **error);
+static GimpValueArray * xcf_save_with_compression_invoker
+                                                 (GimpProcedure         *procedure,
+                                                  Gimp                  *gimp,
+                                                  GimpContext           *context,
+                                                  GimpProgress          *progress,
+                                                  const GimpValueArray  *args,
+                                                  GError               **error);
+
+static gboolean         xcf_save_stream_internal (Gimp                  *gimp,
+                                                  GimpImage             *image,
+                                                  GOutputStream         *output,
+                                                  GFile                 *output_file,
+                                                  gint                   compression,
+                                                  GimpProgress          *progress,
+                                                  GError               **error);
+static GimpValueArray * xcf_save_file            (GimpProcedure         *procedure,
+                                                  Gimp                  *gimp,
+                                                  GimpProgress          *progress,
+                                                  const GimpValueArray  *args,
+                                                  gint                   compression,
+                                                  GError               **error);
 
 
 static GimpXcfLoaderFunc * const xcf_loaders[] =
@@ -76,7 +120,9 @@ static GimpXcfLoaderFunc * const xcf_loaders[] =
   xcf_load_image,   /* version 6 */
   xcf_load_image,   /* version 7 */
   xcf_load_image,   /* version 8 */
-  xcf_load_image    /* version 9 */
+  xcf_load_image,   /* version 9 */
+  xcf_load_image,   /* version 10 */
+  xcf_load_image    /* version 11 */
 };
 
 
@@ -169,6 +215,77 @@ xcf_init (Gimp *gimp)
   gimp_plug_in_manager_add_procedure (gimp->plug_in_manager, proc);
   g_object_unref (procedure);
 
+  /*  gimp-xcf-save-with-compression  */
+  procedure = gimp_procedure_new (xcf_save_with_compression_invoker);
+
+  gimp_object_set_static_name (GIMP_OBJECT (procedure),
+                               "gimp-xcf-save-with-compression");
+  gimp_procedure_set_static_strings (procedure,
+                                     "gimp-xcf-save-with-compression",
+                                     "Saves file in the .xcf file format, "
+                                     "with the given tile compression",
+                                     "This procedure works like "
+                                     "gimp-xcf-save, but uses the given "
+                                     "tile compression instead of the one "
+                                     "the image would be saved with. The "
+                                     "image's setting is not changed.",
+                                     "Spencer Kimball & Peter Mattis",
+                                     "Spencer Kimball & Peter Mattis",
+                                     "1995-1996",
+                                     NULL);
+
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_int32 ("dummy-param",
+                                                      "Dummy Param",
+                                                      "Dummy parameter",
+                                                      G_MININT32, G_MAXINT32, 0,
+                                                      GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_image_id ("image",
+                                                         "Image",
+                                                         "Input image",
+                                                         gimp, FALSE,
+                                                         GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_drawable_id ("drawable",
+                                                            "Drawable",
+                                                            "Active drawable of input image",
+                                                            gimp, TRUE,
+                                                            GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_string ("filename",
+                                                       "Filename",
+                                                       "The name of the file "
+                                                       "to save the image in, "
+                                                       "in URI format and "
+                                                       "UTF-8 encoding",
+                                                       TRUE, FALSE, TRUE,
+                                                       NULL,
+                                                       GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_string ("raw-filename",
+                                                       "Raw filename",
+                                                       "The basename of the "
+                                                       "file, in UTF-8",
+                                                       FALSE, FALSE, TRUE,
+                                                       NULL,
+                                                       GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_int32 ("compression",
+                                                      "Compression",
+                                                      "The tile compression "
+                                                      "{ RLE (1), ZLIB (2), "
+                                                      "ZSTD (4) }, RLE gives "
+                                                      "the most compatible "
+                                                      "files, ZSTD the "
+                                                      "fastest",
+                                                      COMPRESS_RLE,
+                                                      COMPRESS_ZSTD,
+                                                      COMPRESS_ZLIB,
+                                                      GIMP_PARAM_READWRITE));
+  gimp_pdb_register_procedure (gimp->pdb, procedure);
+  g_object_unref (procedure);
+
   /*  gimp-xcf-load  */
   file = g_file_new_for_path ("gimp-xcf-load");
   procedure = gimp_plug_in_procedure_new (GIMP_PLUGIN, file);
@@ -233,6 +350,75 @@ xcf_init (Gimp *gimp)
                                                              "Output image",
                                                              gimp, FALSE,
                                                              GIMP_PARAM_READWRITE));
+  gimp_plug_in_procedure_set_thumb_loader (proc, "gimp-xcf-load-thumb");
+  gimp_plug_in_manager_add_procedure (gimp->plug_in_manager, proc);
+  g_object_unref (procedure);
+
+  /*  gimp-xcf-load-thumb  */
+  file = g_file_new_for_path ("gimp-xcf-load-thumb");
+  procedure = gimp_plug_in_procedure_new (GIMP_PLUGIN, file);
+  g_object_unref (file);
+
+  procedure->proc_type    = GIMP_INTERNAL;
+  procedure->marshal_func = xcf_load_thumb_invoker;
+
+  proc = GIMP_PLUG_IN_PROCEDURE (procedure);
+  gimp_plug_in_procedure_set_handles_uri (proc);
+
+  gimp_object_set_static_name (GIMP_OBJECT (procedure), "gimp-xcf-load-thumb");
+  gimp_procedure_set_static_strings (procedure,
+                                     "gimp-xcf-load-thumb",
+                                     "Loads a preview of a file saved in "
+                                     "the .xcf file format",
+                                     "This procedure loads the image from "
+                                     "the reduced-size levels stored in the "
+                                     "file, at a size which is at least "
+                                     "the requested thumbnail size. It "
+                                     "fails if the file contains no "
+                                     "reduced-size levels.",
+                                     "Spencer Kimball & Peter Mattis",
+                                     "Spencer Kimball & Peter Mattis",
+                                     "1995-1996",
+                                     NULL);
+
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_string ("filename",
+                                                       "Filename",
+                                                       "The name of the file "
+                                                       "to load, in URI "
+                                                       "format and UTF-8 "
+                                                       "encoding",
+                                                       TRUE, FALSE, TRUE,
+                                                       NULL,
+                                                       GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_int32 ("thumb-size",
+                                                      "Thumb Size",
+                                                      "Preferred thumbnail "
+                                                      "size",
+                                                      1, G_MAXINT32, 128,
+                                                      GIMP_PARAM_READWRITE));
+
+  gimp_procedure_add_return_value (procedure,
+                                   gimp_param_spec_image_id ("image",
+                                                             "Image",
+                                                             "Thumbnail image",
+                                                             gimp, FALSE,
+                                                             GIMP_PARAM_READWRITE));
+  gimp_procedure_add_return_value (procedure,
+                                   gimp_param_spec_int32 ("image-width",
+                                                          "Image Width",
+                                                          "Width of the "
+                                                          "full-sized image",
+                                                          0, G_MAXINT32, 0,
+                                                          GIMP_PARAM_READWRITE));
+  gimp_procedure_add_return_value (procedure,
+                                   gimp_param_spec_int32 ("image-height",
+                                                          "Image Height",
+                                                          "Height of the "
+                                                          "full-sized image",
+                                                          0, G_MAXINT32, 0,
+                                                          GIMP_PARAM_READWRITE));
   gimp_plug_in_manager_add_procedure (gimp->plug_in_manager, proc);
   g_object_unref (procedure);
 }
@@ -250,18 +436,167 @@ xcf_load_stream (Gimp          *gimp,
                  GimpProgress  *progress,
                  GError       **error)
 {
-  XcfInfo      info  = { 0, };
-  const gchar *filename;
-  GimpImage   *image = NULL;
-  gchar        id[14];
-  gboolean     success;
-
   g_return_val_if_fail (GIMP_IS_GIMP (gimp), NULL);
   g_return_val_if_fail (G_IS_INPUT_STREAM (input), NULL);
   g_return_val_if_fail (input_file == NULL || G_IS_FILE (input_file), NULL);
   g_return_val_if_fail (progress == NULL || GIMP_IS_PROGRESS (progress), NULL);
   g_return_val_if_fail (error == NULL || *error == NULL, NULL);
 
+  return xcf_load_stream_internal (gimp, input, input_file, progress, 0,
+                                   NULL, NULL, error);
+}
+
+gboolean
+xcf_save_stream (Gimp           *gimp,
+                 GimpImage      *image,
+                 GOutputStream  *output,
+                 GFile          *output_file,
+                 GimpProgress   *progress,
+                 GError        **error)
+{
+  g_return_val_if_fail (GIMP_IS_GIMP (gimp), FALSE);
+  g_return_val_if_fail (GIMP_IS_IMAGE (image), FALSE);
+  g_return_val_if_fail (G_IS_OUTPUT_STREAM (output), FALSE);
+  g_return_val_if_fail (output_file == NULL || G_IS_FILE (output_file), FALSE);
+  g_return_val_if_fail (progress == NULL || GIMP_IS_PROGRESS (progress), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  return xcf_save_stream_internal (gimp, image, output, output_file, -1,
+                                   progress, error);
+}
+
+
+/*  makes the images loaded from 'file' load all tiles they would
+ *  still read from it, so that it can be written
+ */
+void
+xcf_detach_file (GFile *file)
+{
+  g_return_if_fail (G_IS_FILE (file));
+
+  xcf_tile_file_detach (file);
+}
+
+/*  private functions  */
+
+static gboolean
+xcf_save_stream_internal (Gimp           *gimp,
+                          GimpImage      *image,
+                          GOutputStream  *output,
+                          GFile          *output_file,
+                          gint            compression,
+                          GimpProgress   *progress,
+                          GError        **error)
+{
+  XcfInfo      info     = { 0, };
+  const gchar *filename;
+  gboolean     success  = FALSE;
+  GError      *my_error = NULL;
+
+  if (output_file)
+    filename = gimp_file_get_utf8_name (output_file);
+  else
+    filename = _("Memory Stream");
+
+  info.gimp     = gimp;
+  info.output   = output;
+  info.seekable = G_SEEKABLE (output);
+  info.progress = progress;
+  info.file     = output_file;
+
+  /* reduced levels only speed up loading previews of files */
+  info.save_levels = (output_file != NULL &&
+                      gimp->config->xcf_reduced_levels);
+
+  /* unless a compression is given, use the one the image wants */
+  if (compression != -1)
+    info.compression = compression;
+  else if (gimp_image_get_xcf_compat_mode (image))
+    info.compression = COMPRESS_RLE;
+  else if (gimp_image_get_xcf_fast_compression (image))
+    info.compression = COMPRESS_ZSTD;
+  else
+    info.compression = COMPRESS_ZLIB;
+
+  info.file_version = gimp_image_get_xcf_version (image,
+                                                  info.compression !=
+                                                  COMPRESS_RLE,
+                                                  NULL, NULL);
+
+  /* need version 11 for zstd compression */
+  if (info.compression == COMPRESS_ZSTD)
+    info.file_version = MAX (11, info.file_version);
+
+  /* version 10 and later use 64-bit offsets */
+  if (info.file_version >= 10)
+    info.bytes_per_offset = 8;
+  else
+    info.bytes_per_offset = 4;
+
+  if (output_file)
+    {
+      info.tile_serial = xcf_tile_table_new_serial ();
+
+      /* when saving over the unchanged file the image was loaded from
+       * or last saved to, the unchanged tiles are copied from it
+       * instead of being compressed again, see xcf_save_level()
+       */
+      if (xcf_tile_table_lookup_source (image, output_file,
+                                        &info.reuse_serial))
+        {
+          info.reuse_input = G_INPUT_STREAM (g_file_read (output_file,
+                                                          NULL, NULL));
+        }
+    }
+
+  if (progress)
+    gimp_progress_start (progress, FALSE, _("Saving '%s'"), filename);
+
+  success = xcf_save_image (&info, image, &my_error);
+
+  if (success)
+    {
+      if (progress)
+        gimp_progress_set_text (progress, _("Closing '%s'"), filename);
+
+      success = g_output_stream_close (info.output, NULL, &my_error);
+    }
+
+  if (info.reuse_input)
+    g_object_unref (info.reuse_input);
+
+  if (success && output_file)
+    {
+      xcf_tile_table_set_source (image, output_file, info.tile_serial);
+      xcf_tile_table_stamp_source (image, output_file);
+    }
+
+  if (! success)
+    g_propagate_prefixed_error (error, my_error,
+                                _("Error writing '%s': "), filename);
+
+  if (progress)
+    gimp_progress_end (progress);
+
+  return success;
+}
+
+static GimpImage *
+xcf_load_stream_internal (Gimp          *gimp,
+                          GInputStream  *input,
+                          GFile         *input_file,
+                          GimpProgress  *progress,
+                          gint           thumb_size,
+                          gint          *image_width,
+                          gint          *image_height,
+                          GError       **error)
+{
+  XcfInfo      info  = { 0, };
+  const gchar *filename;
+  GimpImage   *image = NULL;
+  gchar        id[14];
+  gboolean     success;
+
   if (input_file)
     filename = gimp_file_get_utf8_name (input_file);
   else
@@ -273,6 +608,21 @@ xcf_load_stream (Gimp          *gimp,
   info.progress    = progress;
   info.file        = input_file;
   info.compression = COMPRESS_NONE;
+  info.thumb_size  = thumb_size;
+
+  if (input_file && thumb_size == 0)
+    {
+      /* when loading a local file, keep it open so that the tiles of
+       * the image can be read lazily, see xcf_load_level()
+       */
+      if (g_file_is_native (input_file))
+        info.tile_file = xcf_tile_file_open (input_file);
+
+      /* remember where the tiles are, so saving the image to the
+       * same file again can reuse them
+       */
+      info.tile_serial = xcf_tile_table_new_serial ();
+    }
 
   if (progress)
     gimp_progress_start (progress, FALSE, _("Opening '%s'"), filename);
@@ -300,14 +650,38 @@ xcf_load_stream (Gimp          *gimp,
 
   if (success)
     {
+      /* version 10 and later use 64-bit offsets */
+      if (info.file_version >= 10)
+        info.bytes_per_offset = 8;
+      else
+        info.bytes_per_offset = 4;
+
       if (info.file_version >= 0 &&
           info.file_version < G_N_ELEMENTS (xcf_loaders))
         {
           image = (*(xcf_loaders[info.file_version])) (gimp, &info, error);
 
+          /* the caller falls back to loading the full-sized image */
+          if (info.missing_levels)
+            g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                                 _("XCF error: file contains no "
+                                   "reduced-size levels"));
+
+          if (image_width)
+            *image_width = info.image_width;
+
+          if (image_height)
+            *image_height = info.image_height;
+
           if (! image)
             success = FALSE;
 
+          if (image && info.tile_serial)
+            {
+              xcf_tile_table_set_source (image, input_file, info.tile_serial);
+              xcf_tile_table_stamp_source (image, input_file);
+            }
+
           g_input_stream_close (info.input, NULL, NULL);
         }
       else
@@ -319,104 +693,94 @@ xcf_load_stream (Gimp          *gimp,
         }
     }
 
+  /* the image's tile handlers keep the file open */
+  if (info.tile_file)
+    xcf_tile_file_unref (info.tile_file);
+
   if (progress)
     gimp_progress_end (progress);
 
   return image;
 }
 
-gboolean
-xcf_save_stream (Gimp           *gimp,
-                 GimpImage      *image,
-                 GOutputStream  *output,
-                 GFile          *output_file,
-                 GimpProgress   *progress,
-                 GError        **error)
+static GimpValueArray *
+xcf_load_invoker (GimpProcedure         *procedure,
+                  Gimp                  *gimp,
+                  GimpContext           *context,
+                  GimpProgress          *progress,
+                  const GimpValueArray  *args,
+                  GError               **error)
 {
-  XcfInfo      info     = { 0, };
-  const gchar *filename;
-  gboolean     success  = FALSE;
-  GError      *my_error = NULL;
-
-  g_return_val_if_fail (GIMP_IS_GIMP (gimp), FALSE);
-  g_return_val_if_fail (GIMP_IS_IMAGE (image), FALSE);
-  g_return_val_if_fail (G_IS_OUTPUT_STREAM (output), FALSE);
-  g_return_val_if_fail (output_file == NULL || G_IS_FILE (output_file), FALSE);
-  g_return_val_if_fail (progress == NULL || GIMP_IS_PROGRESS (progress), FALSE);
-  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
-
-  if (output_file)
-    filename = gimp_file_get_utf8_name (output_file);
-  else
-    filename = _("Memory Stream");
-
-  info.gimp     = gimp;
-  info.output   = output;
-  info.seekable = G_SEEKABLE (output);
-  info.progress = progress;
-  info.file     = output_file;
-
-  if (gimp_image_get_xcf_compat_mode (image))
-    info.compression = COMPRESS_RLE;
-  else
-    info.compression = COMPRESS_ZLIB;
+  GimpValueArray *return_vals;
+  GimpImage      *image = NULL;
+  const gchar    *uri;
+  GFile          *file;
+  GInputStream   *input;
+  GError         *my_error = NULL;
 
-  info.file_version = gimp_image_get_xcf_version (image,
-                                                  info.compression ==
-                                                  COMPRESS_ZLIB,
-                                                  NULL, NULL);
+  gimp_set_busy (gimp);
 
-  if (progress)
-    gimp_progress_start (progress, FALSE, _("Saving '%s'"), filename);
+  uri  = g_value_get_string (gimp_value_array_index (args, 1));
+  file = g_file_new_for_uri (uri);
 
-  success = xcf_save_image (&info, image, &my_error);
+  input = G_INPUT_STREAM (g_file_read (file, NULL, &my_error));
 
-  if (success)
+  if (input)
     {
-      if (progress)
-        gimp_progress_set_text (progress, _("Closing '%s'"), filename);
+      image = xcf_load_stream (gimp, input, file, progress, error);
 
-      success = g_output_stream_close (info.output, NULL, &my_error);
+      g_object_unref (input);
+    }
+  else
+    {
+      g_propagate_prefixed_error (error, my_error,
+                                  _("Could not open '%s' for reading: "),
+                                  gimp_file_get_utf8_name (file));
     }
 
-  if (! success)
-    g_propagate_prefixed_error (error, my_error,
-                                _("Error writing '%s': "), filename);
+  g_object_unref (file);
 
-  if (progress)
-    gimp_progress_end (progress);
+  return_vals = gimp_procedure_get_return_values (procedure, image != NULL,
+                                                  error ? *error : NULL);
 
-  return success;
-}
+  if (image)
+    gimp_value_set_image (gimp_value_array_index (return_vals, 1), image);
 
+  gimp_unset_busy (gimp);
 
-/*  private functions  */
+  return return_vals;
+}
 
 static GimpValueArray *
-xcf_load_invoker (GimpProcedure         *procedure,
-                  Gimp                  *gimp,
-                  GimpContext           *context,
-                  GimpProgress          *progress,
-                  const GimpValueArray  *args,
-                  GError               **error)
+xcf_load_thumb_invoker (GimpProcedure         *procedure,
+                        Gimp                  *gimp,
+                        GimpContext           *context,
+                        GimpProgress          *progress,
+                        const GimpValueArray  *args,
+                        GError               **error)
 {
   GimpValueArray *return_vals;
-  GimpImage      *image = NULL;
+  GimpImage      *image  = NULL;
+  gint            width  = 0;
+  gint            height = 0;
   const gchar    *uri;
+  gint            size;
   GFile          *file;
   GInputStream   *input;
   GError         *my_error = NULL;
 
   gimp_set_busy (gimp);
 
-  uri  = g_value_get_string (gimp_value_array_index (args, 1));
+  uri  = g_value_get_string (gimp_value_array_index (args, 0));
+  size = g_value_get_int (gimp_value_array_index (args, 1));
   file = g_file_new_for_uri (uri);
 
   input = G_INPUT_STREAM (g_file_read (file, NULL, &my_error));
 
   if (input)
     {
-      image = xcf_load_stream (gimp, input, file, progress, error);
+      image = xcf_load_stream_internal (gimp, input, file, progress, size,
+                                        &width, &height, error);
 
       g_object_unref (input);
     }
@@ -433,7 +797,11 @@ xcf_load_invoker (GimpProcedure         *procedure,
                                                   error ? *error : NULL);
 
   if (image)
-    gimp_value_set_image (gimp_value_array_index (return_vals, 1), image);
+    {
+      gimp_value_set_image (gimp_value_array_index (return_vals, 1), image);
+      g_value_set_int (gimp_value_array_index (return_vals, 2), width);
+      g_value_set_int (gimp_value_array_index (return_vals, 3), height);
+    }
 
   gimp_unset_busy (gimp);
 
@@ -447,6 +815,48 @@ xcf_save_invoker (GimpProcedure         *procedure,
                   GimpProgress          *progress,
                   const GimpValueArray  *args,
                   GError               **error)
+{
+  return xcf_save_file (procedure, gimp, progress, args, -1, error);
+}
+
+static GimpValueArray *
+xcf_save_with_compression_invoker (GimpProcedure         *procedure,
+                                   Gimp                  *gimp,
+                                   GimpContext           *context,
+                                   GimpProgress          *progress,
+                                   const GimpValueArray  *args,
+                                   GError               **error)
+{
+  gint compression = g_value_get_int (gimp_value_array_index (args, 5));
+
+  switch (compression)
+    {
+    case COMPRESS_RLE:
+    case COMPRESS_ZLIB:
+    case COMPRESS_ZSTD:
+      break;
+
+    default:
+      g_set_error (error, GIMP_PDB_ERROR, GIMP_PDB_ERROR_INVALID_ARGUMENT,
+                   _("Unsupported XCF compression: %d"), compression);
+
+      return gimp_procedure_get_return_values (procedure, FALSE,
+                                               error ? *error : NULL);
+    }
+
+  return xcf_save_file (procedure, gimp, progress, args, compression, error);
+}
+
+/*  saves the image of the save procedure's arguments, with 'compression'
+ *  unless it's -1
+ */
+static GimpValueArray *
+xcf_save_file (GimpProcedure         *procedure,
+               Gimp                  *gimp,
+               GimpProgress          *progress,
+               const GimpValueArray  *args,
+               gint                   compression,
+               GError               **error)
 {
   GimpValueArray *return_vals;
   GimpImage      *image;
@@ -456,11 +866,15 @@ xcf_save_invoker (GimpProcedure         *procedure,
   gboolean        success  = FALSE;
   GError         *my_error = NULL;
 
-  gimp_set_busy (gimp);
-
   image = gimp_value_get_image (gimp_value_array_index (args, 1), gimp);
   uri   = g_value_get_string (gimp_value_array_index (args, 3));
-  file  = g_file_new_for_uri (uri);
+
+  gimp_set_busy (gimp);
+
+  file = g_file_new_for_uri (uri);
+
+  /* images loaded from the file may still read tiles from it */
+  xcf_detach_file (file);
 
   output = G_OUTPUT_STREAM (g_file_replace (file,
                                             NULL, FALSE, G_FILE_CREATE_NONE,
@@ -468,7 +882,8 @@ xcf_save_invoker (GimpProcedure         *procedure,
 
   if (output)
     {
-      success = xcf_save_stream (gimp, image, output, file, progress, error);
+      success = xcf_save_stream_internal (gimp, image, output, file,
+                                          compression, progress, error);
 
       g_object_unref (output);
     }
@@ -35,4 +35,6 @@ gboolean    xcf_save_stream (Gimp           *gimp,
                              GimpProgress   *progress,
                              GError        **error);
 
+void        xcf_detach_file (GFile          *file);
+
 #endif /* __XCF_H__ */
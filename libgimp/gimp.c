@@ -125,7 +125,7 @@
  **/
 
 
-#define TILE_MAP_SIZE (_tile_width * _tile_height * 32)
+#define TILE_MAP_SIZE GP_SHM_SIZE
 
 #define ERRMSG_SHM_FAILED "Could not attach to gimp shared memory segment"
 
@@ -1988,6 +1988,10 @@ gimp_loop (void)
         case GP_TILE_REQ:
         case GP_TILE_ACK:
         case GP_TILE_DATA:
+        case GP_TILE_RECT_REQ:
+        case GP_TILE_RECT_DATA:
+        case GP_DRAWABLE_EXPORT_REQ:
+        case GP_DRAWABLE_EXPORT:
           g_warning ("unexpected tile message received (should not happen)");
           break;
 
@@ -2224,6 +2228,10 @@ gimp_process_message (GimpWireMessage *msg)
     case GP_TILE_REQ:
     case GP_TILE_ACK:
     case GP_TILE_DATA:
+    case GP_TILE_RECT_REQ:
+    case GP_TILE_RECT_DATA:
+    case GP_DRAWABLE_EXPORT_REQ:
+    case GP_DRAWABLE_EXPORT:
       g_warning ("unexpected tile message received (should not happen)");
       break;
     case GP_PROC_RUN:
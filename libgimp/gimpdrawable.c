@@ -20,6 +20,8 @@
 
 #include "config.h"
 
+#include <glib/gstdio.h>
+
 #define GIMP_DISABLE_DEPRECATION_WARNINGS
 
 #include "gimp.h"
@@ -31,6 +33,16 @@
 #define TILE_HEIGHT gimp_tile_height()
 
 
+typedef struct
+{
+  GMappedFile *mapped_file;
+  gchar       *filename;
+} GimpDrawableSnapshot;
+
+
+static void   gimp_drawable_snapshot_free (GimpDrawableSnapshot *snapshot);
+
+
 /**
  * gimp_drawable_get:
  * @drawable_ID: the ID of the drawable
@@ -730,6 +742,87 @@ gimp_drawable_get_shadow_buffer (gint32 drawable_ID)
   return NULL;
 }
 
+/**
+ * gimp_drawable_get_buffer_snapshot:
+ * @drawable_ID: the ID of the #GimpDrawable to get the buffer for.
+ *
+ * Returns a #GeglBuffer with a copy of a specified drawable's pixels,
+ * as they are when this function is called.
+ *
+ * Unlike the buffer returned by gimp_drawable_get_buffer(), this
+ * buffer is never synced back with the core drawable. Instead, the
+ * core writes a copy of all of the drawable's pixels to a file once,
+ * without blocking its user interface, and the file is mapped into the
+ * plug-in's memory. Reading the buffer then needs no further exchange
+ * with the core, which makes it the buffer of choice for plug-ins
+ * which read a drawable only, like file exporters.
+ *
+ * The buffer can be written to, the changes are simply kept in the
+ * plug-in's memory.
+ *
+ * Return value: The #GeglBuffer.
+ *
+ * See Also: gimp_drawable_get_buffer()
+ *
+ * Since: 2.10
+ */
+GeglBuffer *
+gimp_drawable_get_buffer_snapshot (gint32 drawable_ID)
+{
+  GimpDrawableSnapshot *snapshot;
+  GeglBuffer           *buffer;
+  GMappedFile          *mapped_file;
+  const Babl           *format;
+  gchar                *filename;
+  gint                  width;
+  gint                  height;
+  gint                  bpp;
+
+  gimp_plugin_enable_precision ();
+
+  if (! gimp_item_is_valid (drawable_ID))
+    return NULL;
+
+  format = gimp_drawable_get_format (drawable_ID);
+
+  mapped_file = _gimp_tile_export (drawable_ID,
+                                   &width, &height, &bpp, &filename);
+
+  if (mapped_file && bpp != babl_format_get_bytes_per_pixel (format))
+    {
+      g_mapped_file_unref (mapped_file);
+      g_unlink (filename);
+      g_free (filename);
+
+      mapped_file = NULL;
+    }
+
+  if (! mapped_file)
+    {
+      GeglBuffer *drawable_buffer = gimp_drawable_get_buffer (drawable_ID);
+
+      if (! drawable_buffer)
+        return NULL;
+
+      buffer = gegl_buffer_dup (drawable_buffer);
+      g_object_unref (drawable_buffer);
+
+      return buffer;
+    }
+
+  snapshot = g_slice_new (GimpDrawableSnapshot);
+
+  snapshot->mapped_file = mapped_file;
+  snapshot->filename    = filename;
+
+  return gegl_buffer_linear_new_from_data (g_mapped_file_get_contents (mapped_file),
+                                           format,
+                                           GEGL_RECTANGLE (0, 0, width, height),
+                                           width * bpp,
+                                           (GDestroyNotify) gimp_drawable_snapshot_free,
+                                           snapshot);
+}
+
 /**
  * gimp_drawable_get_format:
  * @drawable_ID: the ID of the #GimpDrawable to get the format for.
@@ -799,3 +892,20 @@ gimp_drawable_get_format (gint32 drawable_ID)
 
   return format;
 }
+
+
+/*  private functions  */
+
+static void
+gimp_drawable_snapshot_free (GimpDrawableSnapshot *snapshot)
+{
+  g_mapped_file_unref (snapshot->mapped_file);
+
+  /*  the core already removed the file, unless the platform doesn't
+   *  allow removing mapped files
+   */
+  g_unlink (snapshot->filename);
+  g_free (snapshot->filename);
+
+  g_slice_free (GimpDrawableSnapshot, snapshot);
+}
@@ -44,6 +44,7 @@ struct _GimpDrawable
 
 GeglBuffer   * gimp_drawable_get_buffer             (gint32         drawable_ID);
 GeglBuffer   * gimp_drawable_get_shadow_buffer      (gint32         drawable_ID);
+GeglBuffer   * gimp_drawable_get_buffer_snapshot    (gint32         drawable_ID);
 
 const Babl   * gimp_drawable_get_format             (gint32         drawable_ID);
 
@@ -57,6 +57,27 @@ static void  gimp_tile_put          (GimpTile        *tile);
 static void  gimp_tile_cache_insert (GimpTile        *tile);
 static void  gimp_tile_cache_flush  (GimpTile        *tile);
 
+static gint  gimp_tile_rect_n_rows  (gint             width,
+                                     gint             bpp);
+static void  gimp_tile_rect_get     (gint32           drawable_ID,
+                                     gboolean         shadow,
+                                     gint             x,
+                                     gint             y,
+                                     gint             width,
+                                     gint             height,
+                                     gint             bpp,
+                                     guchar          *data,
+                                     gint             stride);
+static void  gimp_tile_rect_put     (gint32           drawable_ID,
+                                     gboolean         shadow,
+                                     gint             x,
+                                     gint             y,
+                                     gint             width,
+                                     gint             height,
+                                     gint             bpp,
+                                     const guchar    *data,
+                                     gint             stride);
+
 
 /*  private variables  */
 
@@ -185,8 +206,272 @@ _gimp_tile_cache_flush_drawable (GimpDrawable *drawable)
 }
 
 
+/*  Reads a rectangle of a drawable's pixels into 'data', in as few
+ *  exchanges with the core as the shared memory segment allows.
+ */
+void
+_gimp_tile_rect_get (gint32    drawable_ID,
+                     gboolean  shadow,
+                     gint      x,
+                     gint      y,
+                     gint      width,
+                     gint      height,
+                     gint      bpp,
+                     guchar   *data,
+                     gint      stride)
+{
+  gint n_rows = gimp_tile_rect_n_rows (width, bpp);
+  gint row;
+
+  for (row = 0; row < height; row += n_rows)
+    {
+      gimp_tile_rect_get (drawable_ID, shadow,
+                          x, y + row, width, MIN (n_rows, height - row),
+                          bpp, data + row * stride, stride);
+    }
+}
+
+/*  Writes a rectangle of a drawable's pixels from 'data', in as few
+ *  exchanges with the core as the shared memory segment allows.
+ */
+void
+_gimp_tile_rect_put (gint32        drawable_ID,
+                     gboolean      shadow,
+                     gint          x,
+                     gint          y,
+                     gint          width,
+                     gint          height,
+                     gint          bpp,
+                     const guchar *data,
+                     gint          stride)
+{
+  gint n_rows = gimp_tile_rect_n_rows (width, bpp);
+  gint row;
+
+  for (row = 0; row < height; row += n_rows)
+    {
+      gimp_tile_rect_put (drawable_ID, shadow,
+                          x, y + row, width, MIN (n_rows, height - row),
+                          bpp, data + row * stride, stride);
+    }
+}
+
+/*  Asks the core to export all of a drawable's pixels to a file, and
+ *  maps that file copy-on-write, so the pixels can be read without
+ *  copying them into the plug-in.  Returns NULL if the core couldn't
+ *  export the drawable.
+ */
+GMappedFile *
+_gimp_tile_export (gint32   drawable_ID,
+                   gint    *width,
+                   gint    *height,
+                   gint    *bpp,
+                   gchar  **filename)
+{
+  extern GIOChannel *_writechannel;
+
+  GPDrawableExport  export_req;
+  GPDrawableExport *drawable_export;
+  GimpWireMessage   msg;
+  GMappedFile      *mapped_file = NULL;
+
+  export_req.drawable_ID = drawable_ID;
+  export_req.width       = 0;
+  export_req.height      = 0;
+  export_req.bpp         = 0;
+  export_req.filename    = NULL;
+
+  if (! gp_drawable_export_req_write (_writechannel, &export_req, NULL))
+    gimp_quit ();
+
+  gimp_read_expect_msg (&msg, GP_DRAWABLE_EXPORT);
+
+  drawable_export = msg.data;
+  if (drawable_export->drawable_ID != drawable_ID)
+    {
+      g_message ("received export info did not match the requested drawable");
+      gimp_quit ();
+    }
+
+  if (drawable_export->filename)
+    {
+      gsize length = ((gsize) drawable_export->width  *
+                      (gsize) drawable_export->height *
+                      (gsize) drawable_export->bpp);
+
+      mapped_file = g_mapped_file_new (drawable_export->filename, TRUE, NULL);
+
+      if (mapped_file && g_mapped_file_get_length (mapped_file) != length)
+        {
+          g_mapped_file_unref (mapped_file);
+          mapped_file = NULL;
+        }
+
+      /*  the core removes the file once we have mapped it  */
+      if (! gp_tile_ack_write (_writechannel, NULL))
+        gimp_quit ();
+    }
+
+  if (mapped_file)
+    {
+      *width    = drawable_export->width;
+      *height   = drawable_export->height;
+      *bpp      = drawable_export->bpp;
+      *filename = g_strdup (drawable_export->filename);
+    }
+
+  gimp_wire_destroy (&msg);
+
+  return mapped_file;
+}
+
+
 /*  private functions  */
 
+/*  returns the number of rows of a rectangle which fit into the
+ *  shared memory segment, or all of them if there is none
+ */
+static gint
+gimp_tile_rect_n_rows (gint width,
+                       gint bpp)
+{
+  if (! gimp_shm_addr ())
+    return G_MAXINT;
+
+  return MAX (GP_SHM_SIZE / (width * bpp), 1);
+}
+
+static void
+gimp_tile_rect_get (gint32    drawable_ID,
+                    gboolean  shadow,
+                    gint      x,
+                    gint      y,
+                    gint      width,
+                    gint      height,
+                    gint      bpp,
+                    guchar   *data,
+                    gint      stride)
+{
+  extern GIOChannel *_writechannel;
+
+  GPTileRect       tile_req;
+  GPTileRect      *tile_data;
+  GimpWireMessage  msg;
+  const guchar    *src;
+  gint             row;
+
+  tile_req.drawable_ID = drawable_ID;
+  tile_req.shadow      = shadow;
+  tile_req.put         = FALSE;
+  tile_req.x           = x;
+  tile_req.y           = y;
+  tile_req.width       = width;
+  tile_req.height      = height;
+  tile_req.bpp         = 0;
+  tile_req.use_shm     = FALSE;
+  tile_req.data        = NULL;
+
+  if (! gp_tile_rect_req_write (_writechannel, &tile_req, NULL))
+    gimp_quit ();
+
+  gimp_read_expect_msg (&msg, GP_TILE_RECT_DATA);
+
+  tile_data = msg.data;
+  if (tile_data->drawable_ID != drawable_ID ||
+      tile_data->shadow      != shadow      ||
+      tile_data->x           != x           ||
+      tile_data->y           != y           ||
+      tile_data->width       != width       ||
+      tile_data->height      != height      ||
+      tile_data->bpp         != bpp)
+    {
+      g_message ("received tile info did not match computed tile info");
+      gimp_quit ();
+    }
+
+  if (tile_data->use_shm)
+    src = gimp_shm_addr ();
+  else
+    src = tile_data->data;
+
+  for (row = 0; row < height; row++)
+    {
+      memcpy (data + row * stride, src + row * width * bpp, width * bpp);
+    }
+
+  if (! gp_tile_ack_write (_writechannel, NULL))
+    gimp_quit ();
+
+  gimp_wire_destroy (&msg);
+}
+
+static void
+gimp_tile_rect_put (gint32        drawable_ID,
+                    gboolean      shadow,
+                    gint          x,
+                    gint          y,
+                    gint          width,
+                    gint          height,
+                    gint          bpp,
+                    const guchar *data,
+                    gint          stride)
+{
+  extern GIOChannel *_writechannel;
+
+  GPTileRect       tile_req;
+  GPTileRect       tile_data;
+  GimpWireMessage  msg;
+  guchar          *dest;
+  gint             row;
+
+  tile_req.drawable_ID = drawable_ID;
+  tile_req.shadow      = shadow;
+  tile_req.put         = TRUE;
+  tile_req.x           = x;
+  tile_req.y           = y;
+  tile_req.width       = width;
+  tile_req.height      = height;
+  tile_req.bpp         = 0;
+  tile_req.use_shm     = FALSE;
+  tile_req.data        = NULL;
+
+  if (! gp_tile_rect_req_write (_writechannel, &tile_req, NULL))
+    gimp_quit ();
+
+  /*  the shared memory segment is ours until the pixels are acked  */
+  gimp_read_expect_msg (&msg, GP_TILE_ACK);
+  gimp_wire_destroy (&msg);
+
+  tile_data         = tile_req;
+  tile_data.bpp     = bpp;
+  tile_data.use_shm = (gimp_shm_addr () != NULL &&
+                       (gsize) width * height * bpp <= GP_SHM_SIZE);
+
+  if (tile_data.use_shm)
+    {
+      dest = gimp_shm_addr ();
+    }
+  else
+    {
+      dest = g_malloc ((gsize) width * height * bpp);
+
+      tile_data.data = dest;
+    }
+
+  for (row = 0; row < height; row++)
+    {
+      memcpy (dest + row * width * bpp, data + row * stride, width * bpp);
+    }
+
+  if (! gp_tile_rect_data_write (_writechannel, &tile_data, NULL))
+    gimp_quit ();
+
+  g_free (tile_data.data);
+
+  gimp_read_expect_msg (&msg, GP_TILE_ACK);
+  gimp_wire_destroy (&msg);
+}
+
 static void
 gimp_tile_get (GimpTile *tile)
 {
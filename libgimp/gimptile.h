@@ -62,7 +62,32 @@ void    gimp_tile_cache_ntiles (gulong     ntiles);
 
 /*  private function  */
 
-G_GNUC_INTERNAL void _gimp_tile_cache_flush_drawable (GimpDrawable *drawable);
+G_GNUC_INTERNAL void          _gimp_tile_cache_flush_drawable (GimpDrawable  *drawable);
+
+G_GNUC_INTERNAL void          _gimp_tile_rect_get             (gint32         drawable_ID,
+                                                               gboolean       shadow,
+                                                               gint           x,
+                                                               gint           y,
+                                                               gint           width,
+                                                               gint           height,
+                                                               gint           bpp,
+                                                               guchar        *data,
+                                                               gint           stride);
+G_GNUC_INTERNAL void          _gimp_tile_rect_put             (gint32         drawable_ID,
+                                                               gboolean       shadow,
+                                                               gint           x,
+                                                               gint           y,
+                                                               gint           width,
+                                                               gint           height,
+                                                               gint           bpp,
+                                                               const guchar  *data,
+                                                               gint           stride);
+
+G_GNUC_INTERNAL GMappedFile * _gimp_tile_export               (gint32         drawable_ID,
+                                                               gint          *width,
+                                                               gint          *height,
+                                                               gint          *bpp,
+                                                               gchar        **filename);
 
 
 G_END_DECLS
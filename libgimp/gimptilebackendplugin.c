@@ -68,6 +68,11 @@ static gpointer gimp_tile_backend_plugin_command  (GeglTileSource  *tile_store,
                                                    gint             z,
                                                    gpointer         data);
 
+static gboolean   gimp_tile_get_rect  (GimpTileBackendPlugin *backend_plugin,
+                                       gint                   x,
+                                       gint                   y,
+                                       GeglRectangle         *rect);
+
 static void       gimp_tile_write_mul (GimpTileBackendPlugin *backend_plugin,
                                        gint                   x,
                                        gint                   y,
@@ -92,8 +97,6 @@ _gimp_tile_backend_plugin_class_init (GimpTileBackendPluginClass *klass)
   object_class->finalize = gimp_tile_backend_plugin_finalize;
 
   g_type_class_add_private (klass, sizeof (GimpTileBackendPluginPrivate));
-
-  gimp_tile_cache_ntiles (64);
 }
 
 static void
@@ -150,6 +153,29 @@ gimp_tile_backend_plugin_command (GeglTileSource  *tile_store,
   return NULL;
 }
 
+/*  returns the area of the drawable covered by the GEGL tile at 'x',
+ *  'y', which is moved to and from the core in one batch
+ */
+static gboolean
+gimp_tile_get_rect (GimpTileBackendPlugin *backend_plugin,
+                    gint                   x,
+                    gint                   y,
+                    GeglRectangle         *rect)
+{
+  GimpTileBackendPluginPrivate *priv        = backend_plugin->priv;
+  gint                          tile_width  = priv->mul * TILE_WIDTH;
+  gint                          tile_height = priv->mul * TILE_HEIGHT;
+
+  return gegl_rectangle_intersect (rect,
+                                   GEGL_RECTANGLE (x * tile_width,
+                                                   y * tile_height,
+                                                   tile_width,
+                                                   tile_height),
+                                   GEGL_RECTANGLE (0, 0,
+                                                   priv->drawable->width,
+                                                   priv->drawable->height));
+}
+
 static GeglTile *
 gimp_tile_read_mul (GimpTileBackendPlugin *backend_plugin,
                     gint                   x,
@@ -158,52 +184,20 @@ gimp_tile_read_mul (GimpTileBackendPlugin *backend_plugin,
   GimpTileBackendPluginPrivate *priv    = backend_plugin->priv;
   GeglTileBackend              *backend = GEGL_TILE_BACKEND (backend_plugin);
   GeglTile                     *tile;
+  GeglRectangle                 rect;
   gint                          tile_size;
-  gint                          u, v;
-  gint                          mul = priv->mul;
-  guchar                       *tile_data;
-
-  x *= mul;
-  y *= mul;
+  gint                          bpp     = priv->drawable->bpp;
+  gint                          mul     = priv->mul;
 
   tile_size  = gegl_tile_backend_get_tile_size (backend);
   tile       = gegl_tile_new (tile_size);
-  tile_data  = gegl_tile_get_data (tile);
 
-  for (u = 0; u < mul; u++)
+  if (gimp_tile_get_rect (backend_plugin, x, y, &rect))
     {
-      for (v = 0; v < mul; v++)
-        {
-          GimpTile *gimp_tile;
-
-          if (x + u >= priv->drawable->ntile_cols ||
-              y + v >= priv->drawable->ntile_rows)
-            continue;
-
-          gimp_tile = gimp_drawable_get_tile (priv->drawable,
-                                              priv->shadow,
-                                              y + v, x + u);
-          gimp_tile_ref (gimp_tile);
-
-          {
-            gint ewidth           = gimp_tile->ewidth;
-            gint eheight          = gimp_tile->eheight;
-            gint bpp              = gimp_tile->bpp;
-            gint tile_stride      = mul * TILE_WIDTH * bpp;
-            gint gimp_tile_stride = ewidth * bpp;
-            gint row;
-
-            for (row = 0; row < eheight; row++)
-              {
-                memcpy (tile_data + (row + TILE_HEIGHT * v) *
-                        tile_stride + u * TILE_WIDTH * bpp,
-                        ((gchar *) gimp_tile->data) + row * gimp_tile_stride,
-                        gimp_tile_stride);
-              }
-          }
-
-          gimp_tile_unref (gimp_tile, FALSE);
-        }
+      _gimp_tile_rect_get (priv->drawable->drawable_id, priv->shadow,
+                           rect.x, rect.y, rect.width, rect.height, bpp,
+                           gegl_tile_get_data (tile),
+                           mul * TILE_WIDTH * bpp);
     }
 
   return tile;
@@ -216,44 +210,16 @@ gimp_tile_write_mul (GimpTileBackendPlugin *backend_plugin,
                      guchar                *source)
 {
   GimpTileBackendPluginPrivate *priv = backend_plugin->priv;
-  gint                          u, v;
-  gint                          mul = priv->mul;
-
-  x *= mul;
-  y *= mul;
+  GeglRectangle                 rect;
+  gint                          bpp  = priv->drawable->bpp;
+  gint                          mul  = priv->mul;
 
-  for (v = 0; v < mul; v++)
+  if (gimp_tile_get_rect (backend_plugin, x, y, &rect))
     {
-      for (u = 0; u < mul; u++)
-        {
-          GimpTile *gimp_tile;
-
-          if (x + u >= priv->drawable->ntile_cols ||
-              y + v >= priv->drawable->ntile_rows)
-            continue;
-
-          gimp_tile = gimp_drawable_get_tile (priv->drawable,
-                                              priv->shadow,
-                                              y+v, x+u);
-          gimp_tile_ref (gimp_tile);
-
-          {
-            gint ewidth           = gimp_tile->ewidth;
-            gint eheight          = gimp_tile->eheight;
-            gint bpp              = gimp_tile->bpp;
-            gint tile_stride      = mul * TILE_WIDTH * bpp;
-            gint gimp_tile_stride = ewidth * bpp;
-            gint row;
-
-            for (row = 0; row < eheight; row++)
-              memcpy (((gchar *)gimp_tile->data) + row * gimp_tile_stride,
-                      source + (row + v * TILE_HEIGHT) *
-                      tile_stride + u * TILE_WIDTH * bpp,
-                      gimp_tile_stride);
-          }
-
-          gimp_tile_unref (gimp_tile, TRUE);
-        }
+      _gimp_tile_rect_put (priv->drawable->drawable_id, priv->shadow,
+                           rect.x, rect.y, rect.width, rect.height, bpp,
+                           source,
+                           mul * TILE_WIDTH * bpp);
     }
 }
 
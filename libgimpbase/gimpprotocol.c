@@ -67,6 +67,22 @@ static void _gp_tile_data_write          (GIOChannel       *channel,
                                           gpointer          user_data);
 static void _gp_tile_data_destroy        (GimpWireMessage  *msg);
 
+static void _gp_tile_rect_read           (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_tile_rect_write          (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_tile_rect_destroy        (GimpWireMessage  *msg);
+
+static void _gp_drawable_export_read     (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_drawable_export_write    (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_drawable_export_destroy  (GimpWireMessage  *msg);
+
 static void _gp_proc_run_read            (GIOChannel       *channel,
                                           GimpWireMessage  *msg,
                                           gpointer          user_data);
@@ -197,6 +213,22 @@ gp_init (void)
                       _gp_has_init_read,
                       _gp_has_init_write,
                       _gp_has_init_destroy);
+  gimp_wire_register (GP_TILE_RECT_REQ,
+                      _gp_tile_rect_read,
+                      _gp_tile_rect_write,
+                      _gp_tile_rect_destroy);
+  gimp_wire_register (GP_TILE_RECT_DATA,
+                      _gp_tile_rect_read,
+                      _gp_tile_rect_write,
+                      _gp_tile_rect_destroy);
+  gimp_wire_register (GP_DRAWABLE_EXPORT_REQ,
+                      _gp_drawable_export_read,
+                      _gp_drawable_export_write,
+                      _gp_drawable_export_destroy);
+  gimp_wire_register (GP_DRAWABLE_EXPORT,
+                      _gp_drawable_export_read,
+                      _gp_drawable_export_write,
+                      _gp_drawable_export_destroy);
 }
 
 gboolean
@@ -292,6 +324,82 @@ gp_tile_data_write (GIOChannel *channel,
   return TRUE;
 }
 
+gboolean
+gp_tile_rect_req_write (GIOChannel *channel,
+                        GPTileRect *tile_rect,
+                        gpointer    user_data)
+{
+  GimpWireMessage msg;
+
+  msg.type = GP_TILE_RECT_REQ;
+  msg.data = tile_rect;
+
+  if (! gimp_wire_write_msg (channel, &msg, user_data))
+    return FALSE;
+
+  if (! gimp_wire_flush (channel, user_data))
+    return FALSE;
+
+  return TRUE;
+}
+
+gboolean
+gp_tile_rect_data_write (GIOChannel *channel,
+                         GPTileRect *tile_rect,
+                         gpointer    user_data)
+{
+  GimpWireMessage msg;
+
+  msg.type = GP_TILE_RECT_DATA;
+  msg.data = tile_rect;
+
+  if (! gimp_wire_write_msg (channel, &msg, user_data))
+    return FALSE;
+
+  if (! gimp_wire_flush (channel, user_data))
+    return FALSE;
+
+  return TRUE;
+}
+
+gboolean
+gp_drawable_export_req_write (GIOChannel       *channel,
+                              GPDrawableExport *drawable_export,
+                              gpointer          user_data)
+{
+  GimpWireMessage msg;
+
+  msg.type = GP_DRAWABLE_EXPORT_REQ;
+  msg.data = drawable_export;
+
+  if (! gimp_wire_write_msg (channel, &msg, user_data))
+    return FALSE;
+
+  if (! gimp_wire_flush (channel, user_data))
+    return FALSE;
+
+  return TRUE;
+}
+
+gboolean
+gp_drawable_export_write (GIOChannel       *channel,
+                          GPDrawableExport *drawable_export,
+                          gpointer          user_data)
+{
+  GimpWireMessage msg;
+
+  msg.type = GP_DRAWABLE_EXPORT;
+  msg.data = drawable_export;
+
+  if (! gimp_wire_write_msg (channel, &msg, user_data))
+    return FALSE;
+
+  if (! gimp_wire_flush (channel, user_data))
+    return FALSE;
+
+  return TRUE;
+}
+
 gboolean
 gp_proc_run_write (GIOChannel *channel,
                    GPProcRun  *proc_run,
@@ -843,6 +951,216 @@ _gp_tile_data_destroy (GimpWireMessage *msg)
     }
 }
 
+/*  tile_rect  */
+
+static void
+_gp_tile_rect_read (GIOChannel      *channel,
+                    GimpWireMessage *msg,
+                    gpointer         user_data)
+{
+  GPTileRect *tile_rect = g_slice_new0 (GPTileRect);
+
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &tile_rect->drawable_ID, 1,
+                               user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_rect->shadow, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_rect->put, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &tile_rect->x, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &tile_rect->y, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_rect->width, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_rect->height, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_rect->bpp, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_rect->use_shm, 1, user_data))
+    goto cleanup;
+
+  if (! tile_rect->use_shm)
+    {
+      gsize length = ((gsize) tile_rect->width  *
+                      (gsize) tile_rect->height *
+                      (gsize) tile_rect->bpp);
+
+      if (length > G_MAXINT)
+        goto cleanup;
+
+      if (length > 0)
+        {
+          tile_rect->data = g_try_malloc (length);
+
+          if (! tile_rect->data)
+            goto cleanup;
+
+          if (! _gimp_wire_read_int8 (channel,
+                                      (guint8 *) tile_rect->data, length,
+                                      user_data))
+            goto cleanup;
+        }
+    }
+
+  msg->data = tile_rect;
+  return;
+
+ cleanup:
+  g_free (tile_rect->data);
+  g_slice_free (GPTileRect, tile_rect);
+  msg->data = NULL;
+}
+
+static void
+_gp_tile_rect_write (GIOChannel      *channel,
+                     GimpWireMessage *msg,
+                     gpointer         user_data)
+{
+  GPTileRect *tile_rect = msg->data;
+
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &tile_rect->drawable_ID, 1,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_rect->shadow, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_rect->put, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &tile_rect->x, 1,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &tile_rect->y, 1,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_rect->width, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_rect->height, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_rect->bpp, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_rect->use_shm, 1, user_data))
+    return;
+
+  if (! tile_rect->use_shm)
+    {
+      gsize length = ((gsize) tile_rect->width  *
+                      (gsize) tile_rect->height *
+                      (gsize) tile_rect->bpp);
+
+      if (length > 0)
+        {
+          if (! _gimp_wire_write_int8 (channel,
+                                       (const guint8 *) tile_rect->data, length,
+                                       user_data))
+            return;
+        }
+    }
+}
+
+static void
+_gp_tile_rect_destroy (GimpWireMessage *msg)
+{
+  GPTileRect *tile_rect = msg->data;
+
+  if (tile_rect)
+    {
+      g_free (tile_rect->data);
+
+      g_slice_free (GPTileRect, tile_rect);
+    }
+}
+
+/*  drawable_export  */
+
+static void
+_gp_drawable_export_read (GIOChannel      *channel,
+                          GimpWireMessage *msg,
+                          gpointer         user_data)
+{
+  GPDrawableExport *drawable_export = g_slice_new0 (GPDrawableExport);
+
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &drawable_export->drawable_ID, 1,
+                               user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &drawable_export->width, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &drawable_export->height, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &drawable_export->bpp, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_string (channel,
+                                &drawable_export->filename, 1, user_data))
+    goto cleanup;
+
+  msg->data = drawable_export;
+  return;
+
+ cleanup:
+  g_free (drawable_export->filename);
+  g_slice_free (GPDrawableExport, drawable_export);
+  msg->data = NULL;
+}
+
+static void
+_gp_drawable_export_write (GIOChannel      *channel,
+                           GimpWireMessage *msg,
+                           gpointer         user_data)
+{
+  GPDrawableExport *drawable_export = msg->data;
+
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &drawable_export->drawable_ID,
+                                1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &drawable_export->width, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &drawable_export->height, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &drawable_export->bpp, 1, user_data))
+    return;
+  if (! _gimp_wire_write_string (channel,
+                                 &drawable_export->filename, 1, user_data))
+    return;
+}
+
+static void
+_gp_drawable_export_destroy (GimpWireMessage *msg)
+{
+  GPDrawableExport *drawable_export = msg->data;
+
+  if (drawable_export)
+    {
+      g_free (drawable_export->filename);
+
+      g_slice_free (GPDrawableExport, drawable_export);
+    }
+}
+
 /*  proc_run  */
 
 static void
@@ -26,7 +26,13 @@ G_BEGIN_DECLS
 
 /* Increment every time the protocol changes
  */
-#define GIMP_PROTOCOL_VERSION  0x0015
+#define GIMP_PROTOCOL_VERSION  0x0017
+
+
+/* The size of the shared memory segment used for transferring pixels,
+ * large enough for a 256x256 rectangle of the largest pixel format
+ */
+#define GP_SHM_SIZE  (4 * 1024 * 1024)
 
 
 enum
@@ -43,20 +49,26 @@ enum
   GP_PROC_INSTALL,
   GP_PROC_UNINSTALL,
   GP_EXTENSION_ACK,
-  GP_HAS_INIT
+  GP_HAS_INIT,
+  GP_TILE_RECT_REQ,
+  GP_TILE_RECT_DATA,
+  GP_DRAWABLE_EXPORT_REQ,
+  GP_DRAWABLE_EXPORT
 };
 
 
-typedef struct _GPConfig        GPConfig;
-typedef struct _GPTileReq       GPTileReq;
-typedef struct _GPTileAck       GPTileAck;
-typedef struct _GPTileData      GPTileData;
-typedef struct _GPParam         GPParam;
-typedef struct _GPParamDef      GPParamDef;
-typedef struct _GPProcRun       GPProcRun;
-typedef struct _GPProcReturn    GPProcReturn;
-typedef struct _GPProcInstall   GPProcInstall;
-typedef struct _GPProcUninstall GPProcUninstall;
+typedef struct _GPConfig         GPConfig;
+typedef struct _GPTileReq        GPTileReq;
+typedef struct _GPTileAck        GPTileAck;
+typedef struct _GPTileData       GPTileData;
+typedef struct _GPTileRect       GPTileRect;
+typedef struct _GPDrawableExport GPDrawableExport;
+typedef struct _GPParam          GPParam;
+typedef struct _GPParamDef       GPParamDef;
+typedef struct _GPProcRun        GPProcRun;
+typedef struct _GPProcReturn     GPProcReturn;
+typedef struct _GPProcInstall    GPProcInstall;
+typedef struct _GPProcUninstall  GPProcUninstall;
 
 
 struct _GPConfig
@@ -103,6 +115,38 @@ struct _GPTileData
   guchar  *data;
 };
 
+/* A rectangle of a drawable's pixels, moved in one round-trip.  The
+ * pixels are in 'data', or in the shared memory segment if 'use_shm'
+ * is set.  A request for reading pixels has no pixels, its 'bpp' is 0.
+ */
+struct _GPTileRect
+{
+  gint32   drawable_ID;
+  guint32  shadow;
+  guint32  put;
+  gint32   x;
+  gint32   y;
+  guint32  width;
+  guint32  height;
+  guint32  bpp;
+  guint32  use_shm;
+  guchar  *data;
+};
+
+/* A drawable's pixels, written by the core to a file the plug-in can
+ * map into its memory.  The file has 'height' rows of 'width' pixels
+ * of 'bpp' bytes each, without padding.  A request only has the
+ * drawable's ID, and 'filename' is NULL if the export failed.
+ */
+struct _GPDrawableExport
+{
+  gint32   drawable_ID;
+  guint32  width;
+  guint32  height;
+  guint32  bpp;
+  gchar   *filename;
+};
+
 struct _GPParam
 {
   guint32 type;
@@ -189,44 +233,56 @@ struct _GPProcUninstall
 
 void      gp_init                   (void);
 
-gboolean  gp_quit_write             (GIOChannel      *channel,
-                                     gpointer         user_data);
-gboolean  gp_config_write           (GIOChannel      *channel,
-                                     GPConfig        *config,
-                                     gpointer         user_data);
-gboolean  gp_tile_req_write         (GIOChannel      *channel,
-                                     GPTileReq       *tile_req,
-                                     gpointer         user_data);
-gboolean  gp_tile_ack_write         (GIOChannel      *channel,
-                                     gpointer         user_data);
-gboolean  gp_tile_data_write        (GIOChannel      *channel,
-                                     GPTileData      *tile_data,
-                                     gpointer         user_data);
-gboolean  gp_proc_run_write         (GIOChannel      *channel,
-                                     GPProcRun       *proc_run,
-                                     gpointer         user_data);
-gboolean  gp_proc_return_write      (GIOChannel      *channel,
-                                     GPProcReturn    *proc_return,
-                                     gpointer         user_data);
-gboolean  gp_temp_proc_run_write    (GIOChannel      *channel,
-                                     GPProcRun       *proc_run,
-                                     gpointer         user_data);
-gboolean  gp_temp_proc_return_write (GIOChannel      *channel,
-                                     GPProcReturn    *proc_return,
-                                     gpointer         user_data);
-gboolean  gp_proc_install_write     (GIOChannel      *channel,
-                                     GPProcInstall   *proc_install,
-                                     gpointer         user_data);
-gboolean  gp_proc_uninstall_write   (GIOChannel      *channel,
-                                     GPProcUninstall *proc_uninstall,
-                                     gpointer         user_data);
-gboolean  gp_extension_ack_write    (GIOChannel      *channel,
-                                     gpointer         user_data);
-gboolean  gp_has_init_write         (GIOChannel      *channel,
-                                     gpointer         user_data);
-
-void      gp_params_destroy         (GPParam         *params,
-                                     gint             nparams);
+gboolean  gp_quit_write                (GIOChannel       *channel,
+                                        gpointer          user_data);
+gboolean  gp_config_write              (GIOChannel       *channel,
+                                        GPConfig         *config,
+                                        gpointer          user_data);
+gboolean  gp_tile_req_write            (GIOChannel       *channel,
+                                        GPTileReq        *tile_req,
+                                        gpointer          user_data);
+gboolean  gp_tile_ack_write            (GIOChannel       *channel,
+                                        gpointer          user_data);
+gboolean  gp_tile_data_write           (GIOChannel       *channel,
+                                        GPTileData       *tile_data,
+                                        gpointer          user_data);
+gboolean  gp_tile_rect_req_write       (GIOChannel       *channel,
+                                        GPTileRect       *tile_rect,
+                                        gpointer          user_data);
+gboolean  gp_tile_rect_data_write      (GIOChannel       *channel,
+                                        GPTileRect       *tile_rect,
+                                        gpointer          user_data);
+gboolean  gp_drawable_export_req_write (GIOChannel       *channel,
+                                        GPDrawableExport *drawable_export,
+                                        gpointer          user_data);
+gboolean  gp_drawable_export_write     (GIOChannel       *channel,
+                                        GPDrawableExport *drawable_export,
+                                        gpointer          user_data);
+gboolean  gp_proc_run_write            (GIOChannel       *channel,
+                                        GPProcRun        *proc_run,
+                                        gpointer          user_data);
+gboolean  gp_proc_return_write         (GIOChannel       *channel,
+                                        GPProcReturn     *proc_return,
+                                        gpointer          user_data);
+gboolean  gp_temp_proc_run_write       (GIOChannel       *channel,
+                                        GPProcRun        *proc_run,
+                                        gpointer          user_data);
+gboolean  gp_temp_proc_return_write    (GIOChannel       *channel,
+                                        GPProcReturn     *proc_return,
+                                        gpointer          user_data);
+gboolean  gp_proc_install_write        (GIOChannel       *channel,
+                                        GPProcInstall    *proc_install,
+                                        gpointer          user_data);
+gboolean  gp_proc_uninstall_write      (GIOChannel       *channel,
+                                        GPProcUninstall  *proc_uninstall,
+                                        gpointer          user_data);
+gboolean  gp_extension_ack_write       (GIOChannel       *channel,
+                                        gpointer          user_data);
+gboolean  gp_has_init_write            (GIOChannel       *channel,
+                                        gpointer          user_data);
+
+void      gp_params_destroy            (GPParam          *params,
+                                        gint             nparams);
 
 
 G_END_DECLS
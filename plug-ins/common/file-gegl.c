@@ -440,7 +440,7 @@ save_image (const gchar  *filename,
   GeglNode   *sink;
   GeglBuffer *src_buf;
 
-  src_buf = gimp_drawable_get_buffer (drawable_ID);
+  src_buf = gimp_drawable_get_buffer_snapshot (drawable_ID);
 
   graph = gegl_node_new ();
 
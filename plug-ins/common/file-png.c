@@ -1546,7 +1546,7 @@ save_image (const gchar  *filename,
    * Get the buffer for the current image...
    */
 
-  buffer = gimp_drawable_get_buffer (drawable_ID);
+  buffer = gimp_drawable_get_buffer_snapshot (drawable_ID);
   width  = gegl_buffer_get_width (buffer);
   height = gegl_buffer_get_height (buffer);
   type   = gimp_drawable_type (drawable_ID);
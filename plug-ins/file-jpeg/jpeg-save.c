@@ -279,7 +279,7 @@ save_image (const gchar  *filename,
   gint             rowstride, yend;
 
   drawable_type = gimp_drawable_type (drawable_ID);
-  buffer = gimp_drawable_get_buffer (drawable_ID);
+  buffer = gimp_drawable_get_buffer_snapshot (drawable_ID);
 
   if (! preview)
     gimp_progress_init_printf (_("Exporting '%s'"),
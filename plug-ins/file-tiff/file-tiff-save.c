@@ -315,7 +315,7 @@ save_image (GFile        *file,
                              gimp_file_get_utf8_name (file));
 
   drawable_type = gimp_drawable_type (layer);
-  buffer        = gimp_drawable_get_buffer (layer);
+  buffer        = gimp_drawable_get_buffer_snapshot (layer);
 
   format = gegl_buffer_get_format (buffer);
   type   = babl_format_get_type (format, 0);